@@ -0,0 +1,62 @@
+/* Benchmark for the camera's per-frame cost.
+ *
+ * Each frame an application moves the camera some number of times (mouse drags, following a
+ * robot, scripted moves) and then every consumer reads the matrices. Eager is the way Camera3D
+ * used to work, the matrix rebuilt in every setter and the consumer multiplying by the projection
+ * itself. Lazy calls the same setters and reads the cached view projection, inverse and frustum
+ * planes once. */
+#include "cvis/camera3d.h"
+#include <chrono>
+#include <cstdio>
+
+static double NowSeconds() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Keeps the compiler from dropping the work */
+static volatile float sink_;
+
+static void RunBenchmark(int settersPerFrame) {
+  const int num_frames = 2000000 / settersPerFrame > 20000 ? 20000 : 2000000 / settersPerFrame;
+  vis::Camera3D camera;
+  camera.SetPerspective(45.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+
+  double start = NowSeconds();
+  for (int frame = 0; frame < num_frames; frame++) {
+    for (int i = 0; i < settersPerFrame; i++) {
+      camera.SetOrientationAngles((float)(frame + i) * 0.01f, (float)i * 0.02f, 0.0f);
+      camera.SetTargetPosition((float)i, (float)frame * 0.001f, 0.0f);
+      /* Reading the view straight after the setter forces the update, as ComputeMatrix did */
+      sink_ = camera.GetViewMatrix()(12);
+    }
+    const Eigen::Matrix4f view_projection = camera.GetProjectionMatrix() * camera.GetViewMatrix();
+    sink_ = view_projection(0);
+  }
+  const double eager_time = (NowSeconds() - start) / num_frames;
+
+  start = NowSeconds();
+  for (int frame = 0; frame < num_frames; frame++) {
+    for (int i = 0; i < settersPerFrame; i++) {
+      camera.SetOrientationAngles((float)(frame + i) * 0.01f, (float)i * 0.02f, 0.0f);
+      camera.SetTargetPosition((float)i, (float)frame * 0.001f, 0.0f);
+    }
+    sink_ = camera.GetViewProjectionMatrix()(0) +
+            camera.GetInverseViewProjectionMatrix()(0) +
+            camera.GetFrustumPlanes()[vis::Camera3D::NEAR_PLANE](3);
+  }
+  const double lazy_time = (NowSeconds() - start) / num_frames;
+
+  std::printf("%5d setters/frame: eager %9.3f us/frame (view and view projection only), "
+              "lazy %7.3f us/frame (everything)\n",
+              settersPerFrame,
+              eager_time * 1.0e6,
+              lazy_time * 1.0e6);
+}
+
+int main() {
+  RunBenchmark(1);
+  RunBenchmark(10);
+  RunBenchmark(100);
+  RunBenchmark(1000);
+  return 0;
+}
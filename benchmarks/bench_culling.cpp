@@ -0,0 +1,121 @@
+/* Benchmark for frustum culling.
+ *
+ * A fleet of 10k robots spread over a 1 km square and a 100-chunk path winding over the same square,
+ * seen by a camera looking at one corner. Times the fleet test four spheres at a time against one
+ * sphere at a time, and the path's chunk test and clip, and reports how much of each is submitted. */
+#include "cvis/camera3d.h"
+#include "cvis/culling.h"
+#include "cvis/fleet.h"
+#include "cvis/polyline_lod.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#define NUM_ROBOTS 10000
+#define NUM_CHUNKS 100
+#define NUM_ITERATIONS 2000
+#define MAX_RANGES 64
+
+static double NowSeconds() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static float RandomFloat(float min,
+                         float max) {
+  return min + (max - min) * (float)rand() / (float)RAND_MAX;
+}
+
+/* Keeps the compiler from dropping the work */
+static volatile uint32_t sink_;
+
+int main() {
+  vis::Camera3D camera;
+  camera.SetPerspective(60.0f, 16.0f / 9.0f, 0.1f, 300.0f);
+  camera.SetOrientationAngles(60.0f, 30.0f, 0.0f);
+  camera.SetTargetPosition(100.0f, 100.0f, 0.0f);
+  visFrustum frustum;
+  visFrustum_FromViewProjection(&frustum, camera.GetViewProjectionMatrix().data());
+
+  srand(1);
+  std::vector<float> x(NUM_ROBOTS), y(NUM_ROBOTS), z(NUM_ROBOTS), radius(NUM_ROBOTS);
+  for (int i = 0; i < NUM_ROBOTS; i++) {
+    const visRobotHandle robot = visFleet_AddRobot(1.0f, 0.6f, 0.4f);
+    x[i] = RandomFloat(-500.0f, 500.0f);
+    y[i] = RandomFloat(-500.0f, 500.0f);
+    z[i] = 0.2f;
+    radius[i] = 0.6f;
+    visFleet_SetPose(robot, x[i], y[i], RandomFloat(0.0f, 6.28f));
+  }
+
+  double start = NowSeconds();
+  uint32_t num_visible = 0;
+  for (int i = 0; i < NUM_ITERATIONS; i++) {
+    num_visible = visFleet_Cull(&frustum);
+  }
+  const double simd_time = (NowSeconds() - start) / NUM_ITERATIONS;
+
+  start = NowSeconds();
+  for (int i = 0; i < NUM_ITERATIONS; i++) {
+    uint32_t visible = 0;
+    for (int r = 0; r < NUM_ROBOTS; r++) {
+      visible += visFrustum_TestSphere(&frustum, x[r], y[r], z[r], radius[r]) ? 1 : 0;
+    }
+    sink_ = visible;
+  }
+  const double scalar_time = (NowSeconds() - start) / NUM_ITERATIONS;
+
+  std::printf("fleet: %d robots, %u visible, %u culled\n",
+              NUM_ROBOTS,
+              num_visible,
+              NUM_ROBOTS - num_visible);
+  std::printf("  sse2 %8.2f us/frame, scalar %8.2f us/frame\n", simd_time * 1.0e6, scalar_time * 1.0e6);
+
+  /* Rows back and forth across the square */
+  visPolylineLod path;
+  visPolylineLod_Init(&path);
+  const uint32_t num_points = NUM_CHUNKS * VIS_CULL_CHUNK_SIZE;
+  const uint32_t points_per_row = 4 * VIS_CULL_CHUNK_SIZE;
+  for (uint32_t i = 0; i < num_points; i++) {
+    const uint32_t row = i / points_per_row;
+    float along = (float)(i % points_per_row) / (float)points_per_row;
+    along = (row & 1) ? 1.0f - along : along;
+    visPolylineLod_Append(&path, -500.0f + 1000.0f * along, -500.0f + 40.0f * (float)row, 0.0f);
+  }
+
+  std::vector<uint8_t> chunk_visible(path.chunks.count);
+  visCullRange ranges[MAX_RANGES];
+  uint32_t num_chunks_visible = 0;
+  uint32_t num_ranges = 0;
+  start = NowSeconds();
+  for (int i = 0; i < NUM_ITERATIONS; i++) {
+    num_chunks_visible = visFrustum_TestAabbs(&frustum, &path.chunks, chunk_visible.data());
+    num_ranges = visCulling_ClipStrip(0,
+                                      num_points,
+                                      0,
+                                      chunk_visible.data(),
+                                      path.chunks.count,
+                                      ranges,
+                                      MAX_RANGES);
+  }
+  const double path_time = (NowSeconds() - start) / NUM_ITERATIONS;
+
+  uint32_t num_submitted = 0;
+  for (uint32_t r = 0; r < num_ranges; r++) {
+    num_submitted += ranges[r].count;
+  }
+  std::printf("path: %u chunks, %u visible, %u culled\n",
+              path.chunks.count,
+              num_chunks_visible,
+              path.chunks.count - num_chunks_visible);
+  std::printf("  %u of %u points submitted in %u draws, %6.2f us/frame\n",
+              num_submitted,
+              num_points,
+              num_ranges,
+              path_time * 1.0e6);
+
+  visPolylineLod_Free(&path);
+  visFleet_Clear();
+  return 0;
+}
@@ -0,0 +1,147 @@
+/* Benchmark for headless rendering.
+ *
+ * Renders a scene (grid, robot, 1000 waypoints, a 1000 robot fleet) offscreen as fast as it can
+ * through the normal frame API and reports the frame rate. Needs the library built with
+ * -DCVIS_HEADLESS=ON, and no display: on a machine with no gpu Mesa falls back to llvmpipe.
+ *
+ *   cvis_bench_headless [frames] [last frame .ppm] [capture .y4m]
+ *
+ * The optional image is the last frame, to check what was rendered. With a capture file the frames
+ * are run a second time recording to it, to compare the frame rate with and without capture. */
+#include "cvis/vis.h"
+#include "cvis/headless.h"
+#include "cvis/robot.h"
+#include "glad/glad.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define WIDTH 1280
+#define HEIGHT 720
+#define NUM_ROBOTS 1000
+
+static double NowSeconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1.0e-9;
+}
+
+/* Binary PPM, flipped since OpenGL rows start at the bottom */
+static bool WritePpm(const char *path,
+                     const uint8_t *rgba) {
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    return false;
+  }
+  fprintf(file, "P6\n%d %d\n255\n", WIDTH, HEIGHT);
+  for (int y = HEIGHT - 1; y >= 0; y--) {
+    for (int x = 0; x < WIDTH; x++) {
+      fwrite(&rgba[4 * (y * WIDTH + x)], 1, 3, file);
+    }
+  }
+  fclose(file);
+  return true;
+}
+
+/* Mean frame time in seconds */
+static double RunFrames(int num_frames,
+                        const Mat4f *view,
+                        const visRobotHandle *robots) {
+  const double frames_start = NowSeconds();
+  for (int frame = 0; frame < num_frames; frame++) {
+    visWindow_NewFrame();
+    vis_PushCamera(view->mat);
+    vis_PushProjection(visWindow_GetProjectionMatrix()->mat);
+    /* Everything moves every frame, so every frame uploads the whole fleet */
+    const float t = (float)frame * 0.01f;
+    for (int i = 0; i < NUM_ROBOTS; i++) {
+      visFleet_SetPose(robots[i], (float)(i % 40) - 20.0f, (float)(i / 40) - 12.0f, t + (float)i);
+    }
+    visGrid_Draw();
+    visRobot_Draw();
+    visWaypoints_Draw();
+    visFleet_Draw();
+    visWindow_EndFrame();
+  }
+  /* Count the frames as done when the gpu is done with them */
+  glFinish();
+  return (NowSeconds() - frames_start) / num_frames;
+}
+
+int main(int argc,
+         char **argv) {
+  const int num_frames = argc > 1 ? atoi(argv[1]) : 1000;
+  const char *image_path = argc > 2 ? argv[2] : NULL;
+  const char *capture_path = argc > 3 ? argv[3] : NULL;
+
+  const double start = NowSeconds();
+  if (!visWindow_InitializeHeadless(WIDTH, HEIGHT)) {
+    return 1;
+  }
+  printf("Renderer:                 %s\n", (const char *)glGetString(GL_RENDERER));
+
+  visGrid_InitDefault();
+  visRobot_Init(1.0, 0.5, 0.5);
+  visWaypoints_Init();
+  visFleet_Init();
+  for (int i = 0; i < 1000; i++) {
+    const float t = (float)i * 0.05f;
+    visWaypoints_Add(10.0f * cosf(t), 10.0f * sinf(t), 0.0f);
+  }
+  visRobotHandle robots[NUM_ROBOTS];
+  for (int i = 0; i < NUM_ROBOTS; i++) {
+    robots[i] = visFleet_AddRobot(0.6f, 0.4f, 0.3f);
+  }
+
+  Mat4f view;
+  Mat4f_SetIdentity(&view);
+  view.mat[13] = -2.0f;
+  view.mat[14] = -40.0f;
+  const double setup_time = NowSeconds() - start;
+
+  /* Shaders may still be compiling for the first few frames, warm up until everything draws */
+  for (int frame = 0; frame < 10; frame++) {
+    visWindow_NewFrame();
+    vis_PushCamera(view.mat);
+    vis_PushProjection(visWindow_GetProjectionMatrix()->mat);
+    visGrid_Draw();
+    visRobot_Draw();
+    visWaypoints_Draw();
+    visFleet_Draw();
+    visWindow_EndFrame();
+  }
+  glFinish();
+
+  const double frame_time = RunFrames(num_frames, &view, robots);
+
+  printf("Setup:                    %.1f ms\n", setup_time * 1.0e3);
+  printf("Frames:                   %d at %dx%d\n", num_frames, WIDTH, HEIGHT);
+  printf("Mean frame time:          %.3f ms\n", frame_time * 1.0e3);
+  printf("Frame rate:               %.1f fps\n", 1.0 / frame_time);
+
+  if (capture_path) {
+    if (!visCapture_Start(capture_path, WIDTH, HEIGHT, visCaptureFormat_Y4m, 60)) {
+      return 1;
+    }
+    const double capture_frame_time = RunFrames(num_frames, &view, robots);
+    visCapture_Stop();
+    const visCaptureStats stats = visCapture_GetStats();
+    printf("Capturing to:             %s\n", capture_path);
+    printf("Mean frame time:          %.3f ms\n", capture_frame_time * 1.0e3);
+    printf("Frame rate:               %.1f fps\n", 1.0 / capture_frame_time);
+    printf("Frames written:           %llu\n", (unsigned long long)stats.written);
+    printf("Dropped (gpu, writer):    %llu, %llu\n",
+           (unsigned long long)stats.dropped_gpu, (unsigned long long)stats.dropped_writer);
+  }
+
+  if (image_path) {
+    uint8_t *rgba = (uint8_t *)malloc(WIDTH * HEIGHT * 4);
+    if (!rgba || !visWindow_ReadPixels(rgba) || !WritePpm(image_path, rgba)) {
+      printf("Failed to write %s\n", image_path);
+    }
+    free(rgba);
+  }
+  visHeadless_Shutdown();
+  return 0;
+}
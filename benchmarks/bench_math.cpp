@@ -0,0 +1,212 @@
+/* Benchmark for the 4x4 matrix kernels.
+ *
+ * Multiply, inverse and compose a translation, rotation and scale over a batch of matrices, and
+ * transform 1M points, with each set of visMat4 kernels the cpu has, Eigen and glm. */
+#include "cvis/mat4.h"
+#include "Eigen/Geometry"
+#include "Eigen/LU"
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/quaternion.hpp"
+#include "glm/gtc/type_ptr.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#define NUM_MATRICES 4096
+#define NUM_POINTS 1000000
+#define NUM_ITERATIONS 20
+
+static double NowSeconds() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static float RandomFloat(float min,
+                         float max) {
+  return min + (max - min) * (float)rand() / (float)RAND_MAX;
+}
+
+/* Keeps the compiler from dropping the work */
+static volatile float sink_;
+
+typedef struct {
+  double multiply;
+  double inverse;
+  double compose;
+  double transform;
+} Times;
+
+static void Print(const char *name,
+                  const Times &times) {
+  std::printf("  %-8s multiply %6.2f ns  inverse %6.2f ns  compose %6.2f ns  transform %7.3f ms\n",
+              name,
+              times.multiply * 1.0e9 / NUM_MATRICES,
+              times.inverse * 1.0e9 / NUM_MATRICES,
+              times.compose * 1.0e9 / NUM_MATRICES,
+              times.transform * 1.0e3);
+}
+
+int main() {
+  srand(1);
+  std::vector<float> matrices(16 * NUM_MATRICES), results(16 * NUM_MATRICES);
+  std::vector<float> translations(3 * NUM_MATRICES), rotations(4 * NUM_MATRICES), scales(3 * NUM_MATRICES);
+  for (int i = 0; i < NUM_MATRICES; i++) {
+    const Eigen::Vector3f axis = Eigen::Vector3f(RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f), 1.0f).normalized();
+    const Eigen::Quaternionf rotation(Eigen::AngleAxisf(RandomFloat(-3.0f, 3.0f), axis));
+    const Eigen::Vector3f translation(RandomFloat(-100.0f, 100.0f), RandomFloat(-100.0f, 100.0f), RandomFloat(0.0f, 5.0f));
+    const Eigen::Vector3f scale(RandomFloat(0.5f, 2.0f), RandomFloat(0.5f, 2.0f), RandomFloat(0.5f, 2.0f));
+    const Eigen::Affine3f transform = Eigen::Translation3f(translation) * rotation * Eigen::Scaling(scale);
+    Eigen::Matrix4f::Map(&matrices[16 * i]) = transform.matrix();
+    Eigen::Vector3f::Map(&translations[3 * i]) = translation;
+    Eigen::Vector4f::Map(&rotations[4 * i]) = rotation.coeffs();
+    Eigen::Vector3f::Map(&scales[3 * i]) = scale;
+  }
+  std::vector<float> xyz(3 * NUM_POINTS), out(3 * NUM_POINTS);
+  for (int i = 0; i < 3 * NUM_POINTS; i++) {
+    xyz[i] = RandomFloat(-200.0f, 200.0f);
+  }
+  const float *view = &matrices[0];
+
+  std::printf("%d matrices, %d points\n", NUM_MATRICES, NUM_POINTS);
+  const visMathIsa best_isa = visMath_GetIsa();
+  const visMathIsa isas[3] = {visMathIsa_Scalar, visMathIsa_Sse2, visMathIsa_Avx2};
+  for (visMathIsa isa : isas) {
+    if (!visMath_SetIsa(isa)) {
+      continue;
+    }
+    Times times;
+    double start = NowSeconds();
+    for (int iteration = 0; iteration < NUM_ITERATIONS; iteration++) {
+      for (int i = 0; i < NUM_MATRICES; i++) {
+        visMat4_Multiply(view, &matrices[16 * i], &results[16 * i]);
+      }
+      sink_ = results[iteration];
+    }
+    times.multiply = (NowSeconds() - start) / NUM_ITERATIONS;
+
+    start = NowSeconds();
+    for (int iteration = 0; iteration < NUM_ITERATIONS; iteration++) {
+      for (int i = 0; i < NUM_MATRICES; i++) {
+        visMat4_Inverse(&matrices[16 * i], &results[16 * i]);
+      }
+      sink_ = results[iteration];
+    }
+    times.inverse = (NowSeconds() - start) / NUM_ITERATIONS;
+
+    start = NowSeconds();
+    for (int iteration = 0; iteration < NUM_ITERATIONS; iteration++) {
+      for (int i = 0; i < NUM_MATRICES; i++) {
+        visMat4_ComposeTrs(&translations[3 * i], &rotations[4 * i], &scales[3 * i], &results[16 * i]);
+      }
+      sink_ = results[iteration];
+    }
+    times.compose = (NowSeconds() - start) / NUM_ITERATIONS;
+
+    start = NowSeconds();
+    for (int iteration = 0; iteration < NUM_ITERATIONS; iteration++) {
+      visMat4_TransformPoints(view, xyz.data(), NUM_POINTS, out.data());
+      sink_ = out[iteration];
+    }
+    times.transform = (NowSeconds() - start) / NUM_ITERATIONS;
+    Print(visMath_IsaName(isa), times);
+  }
+  visMath_SetIsa(best_isa);
+
+  {
+    Times times;
+    const Eigen::Map<const Eigen::Matrix4f> view_matrix(view);
+    double start = NowSeconds();
+    for (int iteration = 0; iteration < NUM_ITERATIONS; iteration++) {
+      for (int i = 0; i < NUM_MATRICES; i++) {
+        Eigen::Matrix4f::Map(&results[16 * i]).noalias() =
+            view_matrix * Eigen::Map<const Eigen::Matrix4f>(&matrices[16 * i]);
+      }
+      sink_ = results[iteration];
+    }
+    times.multiply = (NowSeconds() - start) / NUM_ITERATIONS;
+
+    start = NowSeconds();
+    for (int iteration = 0; iteration < NUM_ITERATIONS; iteration++) {
+      for (int i = 0; i < NUM_MATRICES; i++) {
+        Eigen::Matrix4f::Map(&results[16 * i]) = Eigen::Map<const Eigen::Matrix4f>(&matrices[16 * i]).inverse();
+      }
+      sink_ = results[iteration];
+    }
+    times.inverse = (NowSeconds() - start) / NUM_ITERATIONS;
+
+    start = NowSeconds();
+    for (int iteration = 0; iteration < NUM_ITERATIONS; iteration++) {
+      for (int i = 0; i < NUM_MATRICES; i++) {
+        const Eigen::Affine3f transform = Eigen::Translation3f(Eigen::Map<const Eigen::Vector3f>(&translations[3 * i])) *
+                                          Eigen::Quaternionf(&rotations[4 * i]) *
+                                          Eigen::Scaling(Eigen::Map<const Eigen::Vector3f>(&scales[3 * i]));
+        Eigen::Matrix4f::Map(&results[16 * i]) = transform.matrix();
+      }
+      sink_ = results[iteration];
+    }
+    times.compose = (NowSeconds() - start) / NUM_ITERATIONS;
+
+    start = NowSeconds();
+    const Eigen::Affine3f view_transform(view_matrix);
+    for (int iteration = 0; iteration < NUM_ITERATIONS; iteration++) {
+      const Eigen::Map<const Eigen::Matrix3Xf> points(xyz.data(), 3, NUM_POINTS);
+      Eigen::Map<Eigen::Matrix3Xf>(out.data(), 3, NUM_POINTS).noalias() = view_transform * points;
+      sink_ = out[iteration];
+    }
+    times.transform = (NowSeconds() - start) / NUM_ITERATIONS;
+    Print("eigen", times);
+  }
+
+  {
+    Times times;
+    const glm::mat4 view_matrix = glm::make_mat4(view);
+    double start = NowSeconds();
+    for (int iteration = 0; iteration < NUM_ITERATIONS; iteration++) {
+      for (int i = 0; i < NUM_MATRICES; i++) {
+        const glm::mat4 result = view_matrix * glm::make_mat4(&matrices[16 * i]);
+        std::memcpy(&results[16 * i], glm::value_ptr(result), sizeof(result));
+      }
+      sink_ = results[iteration];
+    }
+    times.multiply = (NowSeconds() - start) / NUM_ITERATIONS;
+
+    start = NowSeconds();
+    for (int iteration = 0; iteration < NUM_ITERATIONS; iteration++) {
+      for (int i = 0; i < NUM_MATRICES; i++) {
+        const glm::mat4 result = glm::inverse(glm::make_mat4(&matrices[16 * i]));
+        std::memcpy(&results[16 * i], glm::value_ptr(result), sizeof(result));
+      }
+      sink_ = results[iteration];
+    }
+    times.inverse = (NowSeconds() - start) / NUM_ITERATIONS;
+
+    start = NowSeconds();
+    for (int iteration = 0; iteration < NUM_ITERATIONS; iteration++) {
+      for (int i = 0; i < NUM_MATRICES; i++) {
+        const float *q = &rotations[4 * i];
+        const glm::mat4 translation = glm::translate(glm::mat4(1.0f), glm::make_vec3(&translations[3 * i]));
+        const glm::mat4 rotation = glm::mat4_cast(glm::quat(q[3], q[0], q[1], q[2]));
+        const glm::mat4 result = glm::scale(translation * rotation, glm::make_vec3(&scales[3 * i]));
+        std::memcpy(&results[16 * i], glm::value_ptr(result), sizeof(result));
+      }
+      sink_ = results[iteration];
+    }
+    times.compose = (NowSeconds() - start) / NUM_ITERATIONS;
+
+    start = NowSeconds();
+    for (int iteration = 0; iteration < NUM_ITERATIONS; iteration++) {
+      for (int i = 0; i < NUM_POINTS; i++) {
+        const glm::vec4 point = view_matrix * glm::vec4(xyz[3 * i], xyz[3 * i + 1], xyz[3 * i + 2], 1.0f);
+        out[3 * i] = point.x;
+        out[3 * i + 1] = point.y;
+        out[3 * i + 2] = point.z;
+      }
+      sink_ = out[iteration];
+    }
+    times.transform = (NowSeconds() - start) / NUM_ITERATIONS;
+    Print("glm", times);
+  }
+  return 0;
+}
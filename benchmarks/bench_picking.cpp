@@ -0,0 +1,114 @@
+/* Benchmark for picking.
+ *
+ * 10k robots and 990k trajectory segments (99 segments of path behind each robot) over a 1 km
+ * square, 1M primitives. Times building the hierarchy, refitting it after every robot moves, and
+ * picks from random cursor positions through a Camera3D looking down at the square. */
+#include "cvis/camera3d.h"
+#include "cvis/picking.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#define NUM_ROBOTS 10000
+#define SEGMENTS_PER_ROBOT 99
+#define NUM_PICKS 100000
+
+static double NowSeconds() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static float RandomFloat(float min,
+                         float max) {
+  return min + (max - min) * (float)rand() / (float)RAND_MAX;
+}
+
+int main() {
+  visPicker picker;
+  visPicker_Init(&picker);
+  visPicker_Reserve(&picker, NUM_ROBOTS * (SEGMENTS_PER_ROBOT + 1));
+
+  srand(1);
+  const visVec3 half_size = {0.5f, 0.3f, 0.2f};
+  std::vector<uint32_t> robots(NUM_ROBOTS);
+  std::vector<visVec3> positions(NUM_ROBOTS);
+  std::vector<float> yaws(NUM_ROBOTS);
+  for (uint32_t r = 0; r < NUM_ROBOTS; r++) {
+    visVec3 point = {RandomFloat(-500.0f, 500.0f), RandomFloat(-500.0f, 500.0f), 0.0f};
+    float heading = RandomFloat(0.0f, 6.28f);
+    for (uint32_t s = 0; s < SEGMENTS_PER_ROBOT; s++) {
+      heading += RandomFloat(-0.3f, 0.3f);
+      const visVec3 next = {point.x + 0.5f * std::cos(heading), point.y + 0.5f * std::sin(heading), 0.0f};
+      visPicker_AddSegment(&picker, &point, &next, 0.05f, NUM_ROBOTS + r * SEGMENTS_PER_ROBOT + s);
+      point = next;
+    }
+    positions[r] = {point.x, point.y, half_size.z};
+    yaws[r] = heading;
+    robots[r] = visPicker_AddBox(&picker, &positions[r], &half_size, heading, r);
+  }
+
+  double start = NowSeconds();
+  visPicker_Build(&picker);
+  const double build_time = NowSeconds() - start;
+
+  /* Every robot drives forward a bit */
+  for (uint32_t r = 0; r < NUM_ROBOTS; r++) {
+    positions[r].x += 0.5f * std::cos(yaws[r]);
+    positions[r].y += 0.5f * std::sin(yaws[r]);
+  }
+  start = NowSeconds();
+  for (uint32_t r = 0; r < NUM_ROBOTS; r++) {
+    visPicker_SetBox(&picker, robots[r], &positions[r], &half_size, yaws[r]);
+  }
+  visPicker_Refit(&picker);
+  const double refit_time = NowSeconds() - start;
+
+  vis::Camera3D camera;
+  camera.SetPerspective(60.0f, 16.0f / 9.0f, 0.1f, 2000.0f);
+  camera.SetOrientationAngles(20.0f, 10.0f, 0.0f);
+  camera.SetTargetPosition(0.0f, -100.0f, 600.0f);
+  camera.SetViewport(0.0f, 0.0f, 1920.0f, 1080.0f);
+
+  std::vector<visRay> rays(NUM_PICKS);
+  for (int i = 0; i < NUM_PICKS; i++) {
+    Eigen::Vector3f origin;
+    Eigen::Vector3f direction;
+    camera.GetCursorRay(RandomFloat(0.0f, 1920.0f), RandomFloat(0.0f, 1080.0f), &origin, &direction);
+    rays[i] = {{origin.x(), origin.y(), origin.z()}, {direction.x(), direction.y(), direction.z()}};
+  }
+  int num_robots_hit = 0;
+  int num_segments_hit = 0;
+  std::vector<double> pick_times(NUM_PICKS);
+  start = NowSeconds();
+  for (int i = 0; i < NUM_PICKS; i++) {
+    const double pick_start = NowSeconds();
+    visPickHit hit;
+    if (visPicker_Pick(&picker, &rays[i], &hit)) {
+      num_robots_hit += hit.type == visPickType_Box ? 1 : 0;
+      num_segments_hit += hit.type == visPickType_Segment ? 1 : 0;
+    }
+    pick_times[i] = NowSeconds() - pick_start;
+  }
+  const double pick_time = (NowSeconds() - start) / NUM_PICKS;
+  std::sort(pick_times.begin(), pick_times.end());
+
+  std::printf("%u primitives (%d robots, %d segments), %u nodes\n",
+              picker.count,
+              NUM_ROBOTS,
+              NUM_ROBOTS * SEGMENTS_PER_ROBOT,
+              picker.num_nodes);
+  std::printf("  build %8.2f ms\n", build_time * 1.0e3);
+  std::printf("  refit %8.2f ms after every robot moved\n", refit_time * 1.0e3);
+  std::printf("  pick  %8.2f us average, %.2f us 99th percentile, %.2f us worst, over %d cursor positions "
+              "(%d robots, %d segments hit)\n",
+              pick_time * 1.0e6,
+              pick_times[NUM_PICKS * 99 / 100] * 1.0e6,
+              pick_times[NUM_PICKS - 1] * 1.0e6,
+              NUM_PICKS,
+              num_robots_hit,
+              num_segments_hit);
+  visPicker_Free(&picker);
+  return 0;
+}
@@ -0,0 +1,90 @@
+/* Benchmark for projecting world points to pixels.
+ *
+ * 1M points scattered around a camera, projected the way labels were placed before, one point at a
+ * time through the Eigen view projection, then with Camera3D::ProjectToScreen on separate x, y, z
+ * arrays and on packed points. */
+#include "cvis/camera3d.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#define NUM_POINTS 1000000
+#define NUM_ITERATIONS 20
+
+static double NowSeconds() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static float RandomFloat(float min,
+                         float max) {
+  return min + (max - min) * (float)rand() / (float)RAND_MAX;
+}
+
+/* Keeps the compiler from dropping the work */
+static volatile float sink_;
+
+int main() {
+  vis::Camera3D camera;
+  camera.SetPerspective(60.0f, 16.0f / 9.0f, 0.1f, 500.0f);
+  camera.SetOrientationAngles(30.0f, 20.0f, 0.0f);
+  camera.SetTargetPosition(0.0f, 0.0f, 0.0f);
+  camera.SetViewport(0.0f, 0.0f, 1920.0f, 1080.0f);
+
+  srand(1);
+  std::vector<float> x(NUM_POINTS), y(NUM_POINTS), z(NUM_POINTS), xyz(3 * NUM_POINTS);
+  for (int i = 0; i < NUM_POINTS; i++) {
+    x[i] = xyz[3 * i] = RandomFloat(-200.0f, 200.0f);
+    y[i] = xyz[3 * i + 1] = RandomFloat(-200.0f, 200.0f);
+    z[i] = xyz[3 * i + 2] = RandomFloat(-200.0f, 200.0f);
+  }
+  std::vector<float> pixel_x(NUM_POINTS), pixel_y(NUM_POINTS), pixel_xy(2 * NUM_POINTS), depth(NUM_POINTS);
+  std::vector<uint8_t> on_screen(NUM_POINTS);
+
+  double start = NowSeconds();
+  size_t num_on_screen = 0;
+  for (int iteration = 0; iteration < NUM_ITERATIONS; iteration++) {
+    const Eigen::Matrix4f view_projection = camera.GetProjectionMatrix() * camera.GetViewMatrix();
+    num_on_screen = 0;
+    for (int i = 0; i < NUM_POINTS; i++) {
+      const Eigen::Vector4f clip = view_projection * Eigen::Vector4f(x[i], y[i], z[i], 1.0f);
+      const bool inside = clip.w() > 0.0f && std::fabs(clip.x()) <= clip.w() &&
+                          std::fabs(clip.y()) <= clip.w() && std::fabs(clip.z()) <= clip.w();
+      pixel_x[i] = 960.0f * (1.0f + clip.x() / clip.w());
+      pixel_y[i] = 540.0f * (1.0f - clip.y() / clip.w());
+      depth[i] = 0.5f * (1.0f + clip.z() / clip.w());
+      on_screen[i] = inside ? 1 : 0;
+      num_on_screen += inside ? 1 : 0;
+    }
+    sink_ = pixel_x[iteration];
+  }
+  const double eigen_time = (NowSeconds() - start) / NUM_ITERATIONS;
+
+  start = NowSeconds();
+  for (int iteration = 0; iteration < NUM_ITERATIONS; iteration++) {
+    num_on_screen = camera.ProjectToScreen(x.data(),
+                                           y.data(),
+                                           z.data(),
+                                           NUM_POINTS,
+                                           pixel_x.data(),
+                                           pixel_y.data(),
+                                           depth.data(),
+                                           on_screen.data());
+    sink_ = pixel_x[iteration];
+  }
+  const double separate_time = (NowSeconds() - start) / NUM_ITERATIONS;
+
+  start = NowSeconds();
+  for (int iteration = 0; iteration < NUM_ITERATIONS; iteration++) {
+    num_on_screen = camera.ProjectToScreen(xyz.data(), NUM_POINTS, pixel_xy.data(), depth.data(), on_screen.data());
+    sink_ = pixel_xy[iteration];
+  }
+  const double packed_time = (NowSeconds() - start) / NUM_ITERATIONS;
+
+  std::printf("%d points, %zu on screen\n", NUM_POINTS, num_on_screen);
+  std::printf("  one at a time (eigen) %7.3f ms, %6.2f ns/point\n", eigen_time * 1.0e3, eigen_time * 1.0e9 / NUM_POINTS);
+  std::printf("  separate x, y, z      %7.3f ms, %6.2f ns/point\n", separate_time * 1.0e3, separate_time * 1.0e9 / NUM_POINTS);
+  std::printf("  packed xyz            %7.3f ms, %6.2f ns/point\n", packed_time * 1.0e3, packed_time * 1.0e9 / NUM_POINTS);
+  return 0;
+}
@@ -0,0 +1,142 @@
+/* Benchmark for building robot model matrices.
+ *
+ * Compares the batch kernel (visRobot_ComputeModelMatrices) against the way visRobot_UpdatePosition
+ * used to build the matrix, separate translation, rotation and scale matrices and two full 4x4
+ * multiplies. The old version also printed all four matrices and set the shader uniform on
+ * every call; that I/O and the OpenGL calls are left out, so this is only the math. The cmat
+ * calls it made are written out here, so the benchmark only needs the core library. */
+#include "cvis/robot_model.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double NowSeconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1.0e-9;
+}
+
+/* Column major, as cmat's Mat4f_SetIdentity */
+static void SetIdentity(float *m) {
+  for (int i = 0; i < 16; i++) {
+    m[i] = (i % 5) == 0 ? 1.0f : 0.0f;
+  }
+}
+
+/* out = a * b, the scalar loop of cmat's Mat4f_MultiplyMat4f */
+static void Multiply(const float *a,
+                     const float *b,
+                     float *out) {
+  for (int column = 0; column < 4; column++) {
+    for (int row = 0; row < 4; row++) {
+      float sum = 0.0f;
+      for (int k = 0; k < 4; k++) {
+        sum += a[4 * k + row] * b[4 * column + k];
+      }
+      out[4 * column + row] = sum;
+    }
+  }
+}
+
+static void PreviousModelMatrix(float x,
+                                float y,
+                                float heading,
+                                float length,
+                                float width,
+                                float height,
+                                float *model) {
+  float translation[16];
+  SetIdentity(translation);
+  translation[12] = x;
+  translation[13] = y;
+  translation[14] = 0.5f * height;
+
+  float rotation[16];
+  SetIdentity(rotation);
+  rotation[0] = cosf(M_PI_2 - heading);
+  rotation[1] = sinf(M_PI_2 - heading);
+  rotation[4] = -sinf(M_PI_2 - heading);
+  rotation[5] = cosf(M_PI_2 - heading);
+
+  float scale[16];
+  SetIdentity(scale);
+  scale[0] = width;
+  scale[5] = length;
+  scale[10] = height;
+
+  float temp[16];
+  Multiply(rotation, scale, temp);
+  Multiply(translation, temp, model);
+}
+
+static void RunBenchmark(uint32_t count) {
+  float *x = (float *)malloc(count * sizeof(float));
+  float *y = (float *)malloc(count * sizeof(float));
+  float *heading = (float *)malloc(count * sizeof(float));
+  float *length = (float *)malloc(count * sizeof(float));
+  float *width = (float *)malloc(count * sizeof(float));
+  float *height = (float *)malloc(count * sizeof(float));
+  float *models = (float *)malloc(16 * count * sizeof(float));
+  float *previous = (float *)malloc(16 * count * sizeof(float));
+
+  srand(1);
+  for (uint32_t i = 0; i < count; i++) {
+    x[i] = (float)rand() / RAND_MAX * 100.0f - 50.0f;
+    y[i] = (float)rand() / RAND_MAX * 100.0f - 50.0f;
+    heading[i] = (float)rand() / RAND_MAX * 2.0f * (float)M_PI - (float)M_PI;
+    length[i] = 1.0f + (float)rand() / RAND_MAX;
+    width[i] = 0.5f + (float)rand() / RAND_MAX;
+    height[i] = 0.5f + (float)rand() / RAND_MAX;
+  }
+
+  /* Enough repeats that every count runs for a similar total number of poses */
+  const uint32_t repeats = count >= 100000 ? 20 : 2000000 / count;
+
+  double start = NowSeconds();
+  for (uint32_t r = 0; r < repeats; r++) {
+    for (uint32_t i = 0; i < count; i++) {
+      PreviousModelMatrix(x[i], y[i], heading[i], length[i], width[i], height[i], &previous[16 * i]);
+    }
+  }
+  const double previous_time = (NowSeconds() - start) / repeats;
+
+  start = NowSeconds();
+  for (uint32_t r = 0; r < repeats; r++) {
+    visRobot_ComputeModelMatrices(x, y, heading, length, width, height, count, models);
+  }
+  const double batch_time = (NowSeconds() - start) / repeats;
+
+  float max_difference = 0.0f;
+  for (uint32_t i = 0; i < count; i++) {
+    for (int j = 0; j < 16; j++) {
+      max_difference = fmaxf(max_difference, fabsf(models[16 * i + j] - previous[16 * i + j]));
+    }
+  }
+
+  printf("%7u poses: previous %10.3f us (%6.2f ns/pose), batch %10.3f us (%6.2f ns/pose), "
+         "speed up %5.1fx, max difference %.2e\n",
+         count,
+         previous_time * 1.0e6,
+         previous_time * 1.0e9 / count,
+         batch_time * 1.0e6,
+         batch_time * 1.0e9 / count,
+         previous_time / batch_time,
+         max_difference);
+
+  free(x);
+  free(y);
+  free(heading);
+  free(length);
+  free(width);
+  free(height);
+  free(models);
+  free(previous);
+}
+
+int main() {
+  RunBenchmark(1);
+  RunBenchmark(1000);
+  RunBenchmark(100000);
+  return 0;
+}
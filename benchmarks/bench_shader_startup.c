@@ -0,0 +1,137 @@
+/* Benchmark for shader startup time.
+ *
+ * Builds every (embedded) shader pair the layers use, in the order they ask for them, and reports
+ * how long that took and where each program came from. Run it twice: the first run compiles and
+ * fills the cache (cold), the second loads the program binaries (warm).
+ *
+ *   cvis_bench_shader_startup [--no-cache] [--async] [cache directory]
+ *
+ * --no-cache compiles everything with the disk cache off. --async submits every program up front
+ * with visProgram_LoadAsync and then polls them once per (pretend) frame like the layers do,
+ * reporting how long the submits blocked for and when everything was ready.
+ *
+ * For Mesa's software rasteriser run with LIBGL_ALWAYS_SOFTWARE=1 (llvmpipe). */
+#include "cvis/embedded_shaders.h"
+#include "cvis/shader.h"
+#include "glad/glad.h"
+#include "GLFW/glfw3.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static double NowSeconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1.0e-9;
+}
+
+/* Vertex and fragment shader of each layer, waypoints and trails reuse the grid pair */
+static const char *const shader_pairs_[][2] = {
+    {visShaderSource_grid_shader_vs, visShaderSource_grid_shader_fs},
+    {visShaderSource_infinite_grid_shader_vs, visShaderSource_infinite_grid_shader_fs},
+    {visShaderSource_simple_shader_vs, visShaderSource_simple_shader_fs},
+    {visShaderSource_grid_shader_vs, visShaderSource_grid_shader_fs},
+    {visShaderSource_grid_shader_vs, visShaderSource_grid_shader_fs},
+    {visShaderSource_fleet_shader_vs, visShaderSource_simple_shader_fs},
+};
+
+int main(int argc,
+         char **argv) {
+  const char *cache_directory = "shader_cache";
+  bool use_cache = true;
+  bool async = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--no-cache") == 0) {
+      use_cache = false;
+    }
+    else if (strcmp(argv[i], "--async") == 0) {
+      async = true;
+    }
+    else {
+      cache_directory = argv[i];
+    }
+  }
+
+  const double start = NowSeconds();
+  if (!glfwInit()) {
+    printf("GLFW ERROR: Failed to initialize\n");
+    return 1;
+  }
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#if defined(__APPLE__)
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+#endif
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  GLFWwindow *window = glfwCreateWindow(64, 64, "bench_shader_startup", NULL, NULL);
+  if (!window) {
+    printf("GLFW ERROR: Failed to create window\n");
+    glfwTerminate();
+    return 1;
+  }
+  glfwMakeContextCurrent(window);
+  if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+    printf("GLAD ERROR: Failed to initialize\n");
+    return 1;
+  }
+  const double context_time = NowSeconds() - start;
+
+  visShader_SetCacheDirectory(use_cache ? cache_directory : NULL);
+  const uint32_t num_pairs = sizeof(shader_pairs_) / sizeof(shader_pairs_[0]);
+  visProgram programs[sizeof(shader_pairs_) / sizeof(shader_pairs_[0])];
+  const double shaders_start = NowSeconds();
+  double submit_time = 0.0;
+  uint32_t num_polls = 0;
+  if (async) {
+    for (uint32_t i = 0; i < num_pairs; i++) {
+      visProgram_LoadAsync(&programs[i], shader_pairs_[i][0], shader_pairs_[i][1]);
+    }
+    submit_time = NowSeconds() - shaders_start;
+    /* Each pass is what the layers would do in one frame, check and skip the ones not ready */
+    bool all_ready = false;
+    while (!all_ready) {
+      all_ready = true;
+      for (uint32_t i = 0; i < num_pairs; i++) {
+        if (programs[i].id != 0 && !visProgram_IsReady(&programs[i])) {
+          all_ready = false;
+        }
+      }
+      num_polls += 1;
+    }
+  }
+  else {
+    for (uint32_t i = 0; i < num_pairs; i++) {
+      visProgram_LoadFromSource(&programs[i], shader_pairs_[i][0], shader_pairs_[i][1]);
+    }
+  }
+  for (uint32_t i = 0; i < num_pairs; i++) {
+    if (programs[i].id == 0) {
+      printf("ERROR: could not build shader pair %u\n", i);
+    }
+  }
+  /* Drivers may hand compiles off to other threads, wait for everything to actually finish */
+  glFinish();
+  const double shaders_time = NowSeconds() - shaders_start;
+
+  const visShaderCacheStats stats = visShader_GetCacheStats();
+  printf("%s\n%s\n", (const char *)glGetString(GL_RENDERER), (const char *)glGetString(GL_VERSION));
+  printf("%s start: context %.2f ms, %u shader pairs %.2f ms "
+         "(compiled %u, from disk %u, rejected %u, shared in process %u)\n",
+         stats.disk_hits > 0 ? "warm" : "cold",
+         context_time * 1.0e3,
+         num_pairs,
+         shaders_time * 1.0e3,
+         stats.compiles,
+         stats.disk_hits,
+         stats.disk_rejected,
+         stats.memory_hits);
+  if (async) {
+    printf("async: submits blocked for %.2f ms, all ready after %u polls\n", submit_time * 1.0e3, num_polls);
+  }
+
+  glfwDestroyWindow(window);
+  glfwTerminate();
+  return 0;
+}
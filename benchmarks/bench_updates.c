@@ -0,0 +1,126 @@
+/* Benchmark for the update queue.
+ *
+ * 8 producer threads push fleet poses as fast as they can while the main thread drains the queue
+ * the way visWindow_NewFrame does, then the drain is timed on its own from a full queue. Reports
+ * how long a push takes (pushes that find the queue full are counted, then retried after yielding)
+ * and how many updates a second the render thread can take off the queue. */
+#include "cvis/updates.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define NUM_PRODUCERS 8
+#define UPDATES_PER_PRODUCER 500000
+/* Pushes between latency samples */
+#define SAMPLE_EVERY 16
+#define NUM_SAMPLES (UPDATES_PER_PRODUCER / SAMPLE_EVERY)
+
+static double NowSeconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1.0e-9;
+}
+
+typedef struct {
+  int index;
+  double *latencies;
+} Producer;
+
+static atomic_int producers_done_;
+
+static void *ProduceUpdates(void *arg) {
+  Producer *producer = (Producer *)arg;
+  for (int i = 0; i < UPDATES_PER_PRODUCER; i++) {
+    for (;;) {
+      /* Only the push that goes in is timed, a full queue gives the consumer the cpu and retries */
+      const double start = NowSeconds();
+      if (visUpdates_PushFleetPose((visRobotHandle)producer->index, (float)i, 0.0f, 0.0f)) {
+        if (i % SAMPLE_EVERY == 0) {
+          producer->latencies[i / SAMPLE_EVERY] = NowSeconds() - start;
+        }
+        break;
+      }
+      sched_yield();
+    }
+  }
+  atomic_fetch_add(&producers_done_, 1);
+  return NULL;
+}
+
+static int CompareDoubles(const void *a,
+                          const void *b) {
+  const double x = *(const double *)a;
+  const double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+int main() {
+  pthread_t threads[NUM_PRODUCERS];
+  Producer producers[NUM_PRODUCERS];
+  double *latencies = (double *)malloc(NUM_PRODUCERS * NUM_SAMPLES * sizeof(double));
+  if (!latencies) {
+    printf("Failed to allocate latency samples\n");
+    return 1;
+  }
+
+  const double start = NowSeconds();
+  for (int p = 0; p < NUM_PRODUCERS; p++) {
+    producers[p].index = p;
+    producers[p].latencies = &latencies[p * NUM_SAMPLES];
+    pthread_create(&threads[p], NULL, ProduceUpdates, &producers[p]);
+  }
+  uint64_t received = 0;
+  visUpdate update;
+  for (;;) {
+    /* Read before draining, once every producer was done beforehand the drain gets the rest */
+    const bool done = atomic_load(&producers_done_) == NUM_PRODUCERS;
+    while (visUpdates_Pop(&update)) {
+      received += 1;
+    }
+    if (done) {
+      break;
+    }
+  }
+  for (int p = 0; p < NUM_PRODUCERS; p++) {
+    pthread_join(threads[p], NULL);
+  }
+  const double concurrent_time = NowSeconds() - start;
+
+  qsort(latencies, NUM_PRODUCERS * NUM_SAMPLES, sizeof(double), CompareDoubles);
+  double mean = 0.0;
+  for (int i = 0; i < NUM_PRODUCERS * NUM_SAMPLES; i++) {
+    mean += latencies[i];
+  }
+  mean /= NUM_PRODUCERS * NUM_SAMPLES;
+
+  /* Drain on its own, the cost the render thread pays per frame */
+  const int num_drains = 200;
+  double drain_time = 0.0;
+  for (int d = 0; d < num_drains; d++) {
+    for (int i = 0; i < VIS_UPDATE_QUEUE_CAPACITY; i++) {
+      visUpdates_PushRobotPose((float)i, 0.0f, 0.0f);
+    }
+    const double drain_start = NowSeconds();
+    while (visUpdates_Pop(&update)) {
+    }
+    drain_time += NowSeconds() - drain_start;
+  }
+
+  printf("Producers:                %d x %d updates\n", NUM_PRODUCERS, UPDATES_PER_PRODUCER);
+  printf("Updates received:         %llu\n", (unsigned long long)received);
+  printf("Pushes that found it full: %llu\n", (unsigned long long)visUpdates_Dropped());
+  printf("Concurrent throughput:    %.2f M updates/s\n", (double)received / concurrent_time * 1.0e-6);
+  printf("Push latency mean:        %.1f ns\n", mean * 1.0e9);
+  printf("Push latency p50:         %.1f ns\n", latencies[NUM_PRODUCERS * NUM_SAMPLES / 2] * 1.0e9);
+  printf("Push latency p99:         %.1f ns\n", latencies[NUM_PRODUCERS * NUM_SAMPLES * 99 / 100] * 1.0e9);
+  printf("Push latency max:         %.1f us\n", latencies[NUM_PRODUCERS * NUM_SAMPLES - 1] * 1.0e6);
+  printf("Drain (full queue):       %.1f us, %.1f M updates/s\n",
+         drain_time / num_drains * 1.0e6,
+         (double)VIS_UPDATE_QUEUE_CAPACITY * num_drains / drain_time * 1.0e-6);
+
+  free(latencies);
+  return 0;
+}
@@ -0,0 +1,66 @@
+/* Benchmark for the waypoint point buffer.
+ *
+ * Appends 1M points spread over a number of frames and reports how many bytes would be sent to
+ * the gpu and how long the cpu side of each frame takes. Runs without an OpenGL context, the
+ * upload sizes come from visPointBuffer_PrepareUpload which is what visPointBuffer_Upload uses. */
+#include "cvis/point_buffer.h"
+#include <stdio.h>
+#include <time.h>
+
+#define NUM_POINTS 1000000
+#define POINTS_PER_FRAME 1000
+
+static double NowSeconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1.0e-9;
+}
+
+int main() {
+  visPointBuffer buffer;
+  if (!visPointBuffer_Init(&buffer, 0)) {
+    printf("Failed to allocate point buffer\n");
+    return 1;
+  }
+
+  uint64_t max_frame_bytes = 0;
+  double max_frame_time = 0.0;
+  const int num_frames = NUM_POINTS / POINTS_PER_FRAME;
+  const double start = NowSeconds();
+  for (int frame = 0; frame < num_frames; frame++) {
+    const double frame_start = NowSeconds();
+    const uint64_t bytes_before = buffer.bytes_uploaded;
+    for (int i = 0; i < POINTS_PER_FRAME; i++) {
+      const float t = (float)(frame * POINTS_PER_FRAME + i) * 0.01f;
+      visPointBuffer_Append(&buffer, t, 0.5f * t, 0.0f);
+    }
+    visPointBuffer_PrepareUpload(&buffer);
+    const double frame_time = NowSeconds() - frame_start;
+    const uint64_t frame_bytes = buffer.bytes_uploaded - bytes_before;
+    if (frame_bytes > max_frame_bytes) {
+      max_frame_bytes = frame_bytes;
+    }
+    if (frame_time > max_frame_time) {
+      max_frame_time = frame_time;
+    }
+  }
+  const double total_time = NowSeconds() - start;
+
+  /* The previous implementation re-sent the whole prefix after every single add */
+  const double prefix_bytes = 0.5 * (double)NUM_POINTS * (double)(NUM_POINTS + 1) * sizeof(visVec3);
+
+  printf("Points appended:          %u\n", buffer.count);
+  printf("Frames:                   %d (%d points per frame)\n", num_frames, POINTS_PER_FRAME);
+  printf("Total bytes uploaded:     %llu (%.2f x the path size)\n",
+         (unsigned long long)buffer.bytes_uploaded,
+         (double)buffer.bytes_uploaded / ((double)buffer.count * sizeof(visVec3)));
+  printf("Mean bytes per frame:     %.1f\n", (double)buffer.bytes_uploaded / num_frames);
+  printf("Max bytes in one frame:   %llu\n", (unsigned long long)max_frame_bytes);
+  printf("GPU reallocations:        %u\n", buffer.gpu_reallocations);
+  printf("Mean time per frame:      %.3f us\n", total_time / num_frames * 1.0e6);
+  printf("Max time in one frame:    %.3f us\n", max_frame_time * 1.0e6);
+  printf("Prefix re-upload (old):   %.3e bytes\n", prefix_bytes);
+
+  visPointBuffer_Free(&buffer);
+  return 0;
+}
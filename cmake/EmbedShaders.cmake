@@ -0,0 +1,66 @@
+# Turns GLSL files into C string constants, run as a script at build time:
+#
+#   cmake -DSHADER_DIR=<dir> -DOUTPUT_DIR=<dir> -DSHADERS=a.vs,a.fs -P EmbedShaders.cmake
+#
+# Writes <OUTPUT_DIR>/cvis/embedded_shaders.h (declarations) and <OUTPUT_DIR>/embedded_shaders.c
+# (definitions). Every shader becomes visShaderSource_<file name with . replaced by _>.
+#
+# Lines of the form #include "file.glsl" are replaced by that file (relative to SHADER_DIR),
+# recursively, so GLSL snippets can be shared between shaders. A file is only included once per
+# shader.
+
+# Set <output> to the contents of <file> with its includes expanded
+function(ResolveIncludes file output depth)
+  if (depth GREATER 16)
+    message(FATAL_ERROR "EmbedShaders: includes nested too deep in ${file}")
+  endif ()
+  if (NOT EXISTS "${SHADER_DIR}/${file}")
+    message(FATAL_ERROR "EmbedShaders: could not find ${SHADER_DIR}/${file}")
+  endif ()
+  file(READ "${SHADER_DIR}/${file}" source)
+
+  string(REGEX MATCHALL "#include[ \t]+\"[^\"]+\"" include_lines "${source}")
+  foreach (include_line ${include_lines})
+    string(REGEX REPLACE "#include[ \t]+\"([^\"]+)\"" "\\1" include_file "${include_line}")
+    list(FIND INCLUDED_FILES "${include_file}" already_included)
+    set(included_source "")
+    if (already_included EQUAL -1)
+      list(APPEND INCLUDED_FILES "${include_file}")
+      set(INCLUDED_FILES "${INCLUDED_FILES}" PARENT_SCOPE)
+      math(EXPR next_depth "${depth} + 1")
+      ResolveIncludes("${include_file}" included_source ${next_depth})
+      # The include line keeps its own line ending
+      string(REGEX REPLACE "\n$" "" included_source "${included_source}")
+    endif ()
+    string(REPLACE "${include_line}" "${included_source}" source "${source}")
+  endforeach ()
+
+  set(${output} "${source}" PARENT_SCOPE)
+endfunction()
+
+# Commas instead of semicolons so the list survives being passed through add_custom_command
+string(REPLACE "," ";" SHADERS "${SHADERS}")
+
+set(header "/* Generated by cmake/EmbedShaders.cmake from the files in shaders/, do not edit */\n")
+set(header "${header}#ifndef CVIS_EMBEDDED_SHADERS_H_\n#define CVIS_EMBEDDED_SHADERS_H_\n\n")
+set(header "${header}#ifdef __cplusplus\nextern \"C\" {\n#endif\n\n")
+set(source "/* Generated by cmake/EmbedShaders.cmake from the files in shaders/, do not edit */\n")
+set(source "${source}#include \"cvis/embedded_shaders.h\"\n")
+
+foreach (shader ${SHADERS})
+  set(INCLUDED_FILES "")
+  ResolveIncludes("${shader}" glsl 0)
+  string(MAKE_C_IDENTIFIER "visShaderSource_${shader}" name)
+
+  string(REPLACE "\\" "\\\\" glsl "${glsl}")
+  string(REPLACE "\"" "\\\"" glsl "${glsl}")
+  string(REPLACE "\n" "\\n\"\n    \"" glsl "${glsl}")
+
+  set(header "${header}extern const char ${name}[];\n")
+  set(source "${source}\nconst char ${name}[] =\n    \"${glsl}\";\n")
+endforeach ()
+
+set(header "${header}\n#ifdef __cplusplus\n}\n#endif\n\n#endif\n")
+
+file(WRITE "${OUTPUT_DIR}/cvis/embedded_shaders.h" "${header}")
+file(WRITE "${OUTPUT_DIR}/embedded_shaders.c" "${source}")
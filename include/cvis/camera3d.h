@@ -2,6 +2,9 @@
 #define CVIS_INCLUDE_CVIS_CAMERA3D_H_
 
 #include "Eigen/Core"
+#include <array>
+#include <cstddef>
+#include <cstdint>
 
 namespace vis {
 
@@ -14,15 +17,51 @@ namespace vis {
  * matrices. Convientently Eigen is also column order by default. So we can get away with
  * single indexing (use index (3) instead of (0, 2)).
  * If the matrix library changes then this would need to be updated.
+ *
+ * The setters only store their values and mark the camera dirty. The matrices and frustum planes
+ * are computed together the first time one of them is asked for after a change, so setting the
+ * camera any number of times in a frame costs one update. The getters return references to the
+ * cached values, valid until the next setter call.
  */
 class Camera3D {
  public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
   enum class ProjectionTypes {
     PERSPECTIVE,
     ORTHOGRAPHIC
   };
 
+  /**
+   * Index into GetFrustumPlanes
+   */
+  enum FrustumPlane {
+    LEFT_PLANE = 0,
+    RIGHT_PLANE,
+    BOTTOM_PLANE,
+    TOP_PLANE,
+    NEAR_PLANE,
+    FAR_PLANE,
+    NUM_FRUSTUM_PLANES
+  };
+
+  /**
+   * Planes as (a, b, c, d) with a unit normal (a, b, c) pointing into the frustum, so
+   * a * x + b * y + c * z + d is the signed distance of a world point, positive inside
+   */
+  using FrustumPlanes = std::array<Eigen::Vector4f, NUM_FRUSTUM_PLANES>;
+
+  /**
+   * The part of the window drawn to, in pixels. x, y is the top left corner, y down the screen like
+   * ImGui and the cursor position
+   */
+  struct Viewport {
+    float x;
+    float y;
+    float width;
+    float height;
+  };
+
   Camera3D();
 
   /**
@@ -92,7 +131,125 @@ class Camera3D {
                             float y,
                             float z);
 
-  const Eigen::Matrix4f GetViewMatrix() const;
+  /**
+   * @brief Set a perspective projection, the same matrix as visProjection_Perspective
+   *
+   * @param fieldOfView degrees, vertical
+   * @param aspectRatio width / height
+   * @param nearPlane metres
+   * @param farPlane metres
+   */
+  void SetPerspective(float fieldOfView,
+                      float aspectRatio,
+                      float nearPlane,
+                      float farPlane);
+
+  /**
+   * @brief Set the projection matrix directly, e.g. an orthographic one
+   *
+   * @param projection
+   */
+  void SetProjectionMatrix(const Eigen::Matrix4f &projection);
+
+  const Eigen::Matrix4f &GetViewMatrix() const;
+
+  const Eigen::Matrix4f &GetProjectionMatrix() const;
+
+  /**
+   * @return projection * view
+   */
+  const Eigen::Matrix4f &GetViewProjectionMatrix() const;
+
+  const Eigen::Matrix4f &GetInverseViewMatrix() const;
+
+  /**
+   * @return the inverse of projection * view, maps clip space back to the world
+   */
+  const Eigen::Matrix4f &GetInverseViewProjectionMatrix() const;
+
+  const FrustumPlanes &GetFrustumPlanes() const;
+
+  /**
+   * @brief Set the viewport ProjectToScreen maps to, in window coordinates like ImGui and the
+   * cursor. For the whole window that is 0, 0 and the size from visWindow_GetWindowSize. On HiDPI
+   * screens that is not the framebuffer size window.c gives glViewport, which is larger by the
+   * content scale. Until set it is 0, 0, 1, 1
+   *
+   * @param x window coordinates
+   * @param y window coordinates, down from the top
+   * @param width window coordinates
+   * @param height window coordinates
+   */
+  void SetViewport(float x,
+                   float y,
+                   float width,
+                   float height);
+
+  const Viewport &GetViewport() const;
+
+  /**
+   * @brief Project world points to pixels in the viewport with the cached view projection, four at
+   * a time with SSE2
+   *
+   * Pixels are window coordinates (see SetViewport) from the top left of the window, y down, so
+   * they can be handed to ImGui as they are. Points in front of the camera but off screen still
+   * get their pixel, outside the viewport. For points behind the camera (clip w <= 0) pixel and
+   * depth are meaningless
+   *
+   * @param x, y, z count world points, metres
+   * @param pixelX, pixelY output, count entries
+   * @param depth output, count entries in [0, 1] like the depth buffer, can be nullptr
+   * @param onScreen output, count entries set to 1 if the point is inside the frustum else 0, can
+   * be nullptr
+   * @return number of points on screen
+   */
+  size_t ProjectToScreen(const float *x,
+                         const float *y,
+                         const float *z,
+                         size_t count,
+                         float *pixelX,
+                         float *pixelY,
+                         float *depth,
+                         uint8_t *onScreen) const;
+
+  /**
+   * @brief ProjectToScreen for packed points
+   *
+   * @param xyz count points, x y z one after the other
+   * @param pixelXY output, count pixels, x y one after the other
+   * @param depth output, count entries, can be nullptr
+   * @param onScreen output, count entries, can be nullptr
+   * @return number of points on screen
+   */
+  size_t ProjectToScreen(const float *xyz,
+                         size_t count,
+                         float *pixelXY,
+                         float *depth,
+                         uint8_t *onScreen) const;
+
+  /**
+   * @brief The ray from the camera through a pixel of the viewport, through the cached inverse
+   * view projection. For picking what is under the cursor (see cvis/picking.h)
+   *
+   * The cursor is in window coordinates, the space of SetViewport and ProjectToScreen, so a click
+   * from visWindow_TakeClick is passed as it is. Not framebuffer pixels, which differ on HiDPI
+   * screens
+   *
+   * @param cursorX window coordinates from the left
+   * @param cursorY window coordinates, down from the top
+   * @param origin output, on the near plane, metres
+   * @param direction output, unit length
+   */
+  void GetCursorRay(float cursorX,
+                    float cursorY,
+                    Eigen::Vector3f *origin,
+                    Eigen::Vector3f *direction) const;
+
+  /**
+   * @return metres, world coordinates
+   */
+  const Eigen::Vector3f &GetPosition() const;
+
  private:
   /**
    * @brief Update the internal view matrix based on the cameras internal members
@@ -101,11 +258,26 @@ class Camera3D {
 
   void UpdateOrientationAngles();
 
-  void ComputeMatrix();
+  /**
+   * @brief Rebuild the rotation from the orientation angles
+   */
+  void ComputeRotation() const;
+
+  void ComputeMatrix() const;
+
+  /**
+   * @brief Recompute whatever is out of date, called by the getters
+   */
+  void Update() const;
 
  private:
+  // What the getters return is out of date. Split so a new projection (window resize) doesn't
+  // redo the view, and new angles only rebuild the rotation when they are next used
+  mutable bool rotation_dirty_;
+  mutable bool view_dirty_;
+  mutable bool view_projection_dirty_;
   // Where is the camera located in real world coordinates (metres)
-  Eigen::Vector3f position_;
+  mutable Eigen::Vector3f position_;
   // The position the camera is looking at in real world coordinates (metres)
   Eigen::Vector3f target_;
   // The up/vertical axis of the camera, this is used to define the coordinate system of the camera
@@ -117,7 +289,14 @@ class Camera3D {
   // The "view" matrix, which is created from the camera parameters.
   // Also called lookAt matrix in some OpenGL contexts
   // It is a homogenous coordinate transformation matrix, rotation and translation
-  Eigen::Matrix4f view_;
+  mutable Eigen::Matrix4f view_;
+  mutable Eigen::Matrix4f inverse_view_;
+  Eigen::Matrix4f projection_;
+  Eigen::Matrix4f inverse_projection_;
+  mutable Eigen::Matrix4f view_projection_;
+  mutable Eigen::Matrix4f inverse_view_projection_;
+  mutable FrustumPlanes frustum_planes_;
+  Viewport viewport_;
   // How far the camera position is from the target. This could be calculated from the
   // position_ and target_ vectors, but typically zooming in and out changes distance.
   // So on zoom we change distance, then back calculate the new position_
@@ -128,7 +307,7 @@ class Camera3D {
 
   // This is a helper member to keep track of just the rotation matrix. This is used
   // as a place holder for some calculations
-  Eigen::Matrix4f rotation_;
+  mutable Eigen::Matrix4f rotation_;
 };
 
 }
@@ -0,0 +1,97 @@
+#ifndef CVIS_INCLUDE_CVIS_CAPTURE_H_
+#define CVIS_INCLUDE_CVIS_CAPTURE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Frame capture, for recording sessions to video.
+ *
+ * visWindow_EndFrame reads every frame back into one of a ring of pixel buffer objects. The read
+ * is asynchronous, a fence marks when it is done, and a buffer is only mapped once its fence has
+ * signalled, so the render thread never waits for the gpu. Mapped frames are copied out and handed
+ * to a worker thread which converts and writes them.
+ *
+ * Nothing ever blocks the frame: if every buffer in the ring is still in flight, or the writer has
+ * fallen behind, the frame is dropped and counted (see visCaptureStats). Frames come out a few
+ * frames late, visCapture_Stop waits for the ones still in flight.
+ *
+ * The frame size is fixed when capture starts.
+ */
+
+/* Pixel buffer objects in the ring */
+#define VIS_CAPTURE_RING_SIZE 4
+/* Frames waiting for the writer thread */
+#define VIS_CAPTURE_MAX_QUEUED 8
+
+typedef enum {
+  /* RGBA, 8 bits a channel, top row first, frames back to back */
+  visCaptureFormat_Raw,
+  /* YUV4MPEG2, 4:2:0 (C420jpeg, full range BT.601 tagged XCOLORRANGE=FULL). ffmpeg and most
+   * players read it directly */
+  visCaptureFormat_Y4m,
+} visCaptureFormat;
+
+typedef struct {
+  /* Frames read back from the gpu */
+  uint64_t captured;
+  /* Frames written to the file */
+  uint64_t written;
+  /* Frames dropped because every pixel buffer was still in flight */
+  uint64_t dropped_gpu;
+  /* Frames dropped because the writer thread had VIS_CAPTURE_MAX_QUEUED frames waiting */
+  uint64_t dropped_writer;
+} visCaptureStats;
+
+/**
+ * Start capturing every frame from the next visWindow_EndFrame
+ * \param path file to write, overwritten
+ * \param width,height framebuffer size in pixels (visWindow_GetFramebufferSize), fixed for the
+ * whole capture
+ * \param fps frame rate written into the Y4M header
+ * \return false if capture is already running, the size is empty, or the file or buffers could
+ * not be created
+ */
+bool visCapture_Start(const char *path,
+                      int width,
+                      int height,
+                      visCaptureFormat format,
+                      int fps);
+
+/**
+ * Finish the frames in flight, wait for the writer and close the file
+ */
+void visCapture_Stop();
+
+bool visCapture_IsActive();
+
+/**
+ * Start reading back the current frame and pass on any earlier frames that have arrived. Called
+ * by visWindow_EndFrame, before swapping buffers
+ */
+void visCapture_Frame();
+
+visCaptureStats visCapture_GetStats();
+
+/**
+ * Convert an image read back from OpenGL (RGBA, bottom row first) to 4:2:0 planes (top row first).
+ * Chroma is the average of each 2x2 block, odd widths and heights repeat the last column or row
+ * \param y width * height bytes
+ * \param u ((width + 1) / 2) * ((height + 1) / 2) bytes, the same for v
+ */
+void visCapture_RgbaToYuv420(const uint8_t *rgba,
+                             int width,
+                             int height,
+                             uint8_t *y,
+                             uint8_t *u,
+                             uint8_t *v);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,228 @@
+#ifndef CVIS_INCLUDE_CVIS_CULLING_H_
+#define CVIS_INCLUDE_CVIS_CULLING_H_
+
+#include "cvis/vec3.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * View frustum culling.
+ *
+ * Every drawable has a bounding volume: a sphere per robot, a box for the finite grid and a box per
+ * chunk of VIS_CULL_CHUNK_SIZE points for waypoints and trails. Before submitting its draws each
+ * layer tests its volumes against the frustum of the camera pushed with vis_PushCamera and
+ * vis_PushProjection (the same planes as Camera3D::GetFrustumPlanes for the same matrices), four at
+ * a time with SSE2, and only submits what is inside.
+ *
+ * Counts of what was visible and culled are kept per layer for the last frame.
+ */
+
+/* Points per chunk of a waypoint path or trail, a power of two */
+#define VIS_CULL_CHUNK_SHIFT 10
+#define VIS_CULL_CHUNK_SIZE (1u << VIS_CULL_CHUNK_SHIFT)
+
+/* Left, right, bottom, top, near, far. The same order as Camera3D::FrustumPlane */
+#define VIS_FRUSTUM_NUM_PLANES 6
+
+typedef struct {
+  /* a, b, c, d with a unit normal (a, b, c) pointing inside, so a * x + b * y + c * z + d is the
+   * signed distance of a point from the plane */
+  float planes[VIS_FRUSTUM_NUM_PLANES][4];
+} visFrustum;
+
+/**
+ * Axis aligned boxes stored as separate arrays of each coordinate, so they can be tested 4 at a time
+ */
+typedef struct {
+  float *min_x;
+  float *min_y;
+  float *min_z;
+  float *max_x;
+  float *max_y;
+  float *max_z;
+  uint32_t count;
+  uint32_t capacity;
+} visAabbArray;
+
+typedef enum {
+  /* Robots */
+  visCullLayer_Robot,
+  /* Robot instances */
+  visCullLayer_Fleet,
+  /* Chunks of the waypoint path */
+  visCullLayer_Waypoints,
+  /* Chunks of every trail drawn */
+  visCullLayer_Trail,
+  /* The finite grid, the infinite one always covers the screen */
+  visCullLayer_Grid,
+  visCullLayer_Count
+} visCullLayer;
+
+typedef struct {
+  uint32_t visible;
+  uint32_t culled;
+} visCullCounts;
+
+/**
+ * A range of vertices [first, first + count) of a line strip
+ */
+typedef struct {
+  uint32_t first;
+  uint32_t count;
+} visCullRange;
+
+/**
+ * Extract the frustum planes from a projection * view matrix
+ * \param viewProjection column major 4x4
+ */
+void visFrustum_FromViewProjection(visFrustum *frustum,
+                                   const float *viewProjection);
+
+/**
+ * A frustum nothing is outside of
+ */
+void visFrustum_SetEverything(visFrustum *frustum);
+
+bool visFrustum_TestSphere(const visFrustum *frustum,
+                           float x,
+                           float y,
+                           float z,
+                           float radius);
+
+bool visFrustum_TestAabb(const visFrustum *frustum,
+                         const visVec3 *min,
+                         const visVec3 *max);
+
+/**
+ * How far a point is from the near plane towards the far plane, for sorting transparent draws
+ * (see visDrawCommand.depth)
+ * \return 0 on the near plane to 1 on the far plane, clamped. 0 if the frustum has no near and far
+ */
+float visFrustum_Depth(const visFrustum *frustum,
+                       float x,
+                       float y,
+                       float z);
+
+/**
+ * Test count spheres
+ * \param visible output, count entries set to 1 if the sphere is (at least partly) inside, else 0
+ * \return number of visible spheres
+ */
+uint32_t visFrustum_TestSpheres(const visFrustum *frustum,
+                                const float *x,
+                                const float *y,
+                                const float *z,
+                                const float *radius,
+                                uint32_t count,
+                                uint8_t *visible);
+
+/**
+ * Test every box in the array. Empty boxes (see visAabbArray_Push) are never visible
+ * \param visible output, boxes->count entries
+ * \return number of visible boxes
+ */
+uint32_t visFrustum_TestAabbs(const visFrustum *frustum,
+                              const visAabbArray *boxes,
+                              uint8_t *visible);
+
+void visAabbArray_Init(visAabbArray *boxes);
+
+void visAabbArray_Free(visAabbArray *boxes);
+
+bool visAabbArray_Reserve(visAabbArray *boxes,
+                          uint32_t capacity);
+
+/**
+ * Add an empty box (min = FLT_MAX, max = -FLT_MAX) to the end
+ */
+bool visAabbArray_Push(visAabbArray *boxes);
+
+/**
+ * Make a box empty again
+ */
+void visAabbArray_Reset(visAabbArray *boxes,
+                        uint32_t index);
+
+/**
+ * Grow a box to include a point
+ */
+static inline void visAabbArray_Extend(visAabbArray *boxes,
+                                       uint32_t index,
+                                       float x,
+                                       float y,
+                                       float z) {
+  boxes->min_x[index] = x < boxes->min_x[index] ? x : boxes->min_x[index];
+  boxes->min_y[index] = y < boxes->min_y[index] ? y : boxes->min_y[index];
+  boxes->min_z[index] = z < boxes->min_z[index] ? z : boxes->min_z[index];
+  boxes->max_x[index] = x > boxes->max_x[index] ? x : boxes->max_x[index];
+  boxes->max_y[index] = y > boxes->max_y[index] ? y : boxes->max_y[index];
+  boxes->max_z[index] = z > boxes->max_z[index] ? z : boxes->max_z[index];
+}
+
+/**
+ * Cut a line strip down to the parts over visible chunks. Vertex i of the strip covers points
+ * [i << shift, (i + 1) << shift) of the chunked path, so the same chunks can cull every level of
+ * detail of a polyline (shift = 2 * level). A segment is kept if any chunk it covers is visible.
+ * Neighbouring kept segments are joined into one range.
+ * \param chunkVisible numChunks entries, chunks past the end count as visible
+ * \param ranges output, at most maxRanges. If there are more, the last one is extended to the end
+ * \return number of ranges
+ */
+uint32_t visCulling_ClipStrip(uint32_t first,
+                              uint32_t count,
+                              uint32_t shift,
+                              const uint8_t *chunkVisible,
+                              uint32_t numChunks,
+                              visCullRange *ranges,
+                              uint32_t maxRanges);
+
+/**
+ * Turn culling on or off (it is on by default). Off, the frustum contains everything
+ */
+void visCulling_SetEnabled(bool enabled);
+
+bool visCulling_IsEnabled();
+
+/**
+ * Set the frustum the layers cull against, called by vis_PushCamera and vis_PushProjection
+ * \param viewProjection column major 4x4
+ */
+void visCulling_SetViewProjection(const float *viewProjection);
+
+const visFrustum *visCulling_GetFrustum();
+
+/**
+ * Depth of the centre of boxes [first, first + count) from the camera pushed with vis_PushCamera,
+ * culling on or off. Empty boxes are left out
+ * \return see visFrustum_Depth, 0 before a camera is pushed
+ */
+float visCulling_GetDepth(const visAabbArray *boxes,
+                          uint32_t first,
+                          uint32_t count);
+
+/**
+ * Start a frame, called by visWindow_NewFrame. Resets the counts
+ */
+void visCulling_NewFrame();
+
+/**
+ * Add to a layer's counts for this frame, called by the layers
+ */
+void visCulling_Count(visCullLayer layer,
+                      uint32_t visible,
+                      uint32_t culled);
+
+/**
+ * \return what a layer drew and culled since the last visCulling_NewFrame
+ */
+visCullCounts visCulling_GetCounts(visCullLayer layer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
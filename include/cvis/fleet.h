@@ -0,0 +1,116 @@
+#ifndef CVIS_INCLUDE_CVIS_FLEET_H_
+#define CVIS_INCLUDE_CVIS_FLEET_H_
+
+#include "cvis/culling.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A fleet is any number of robots drawn with a single instanced draw call. Each robot is
+ * referred to by a handle, which stays valid until the robot is removed (even when other robots
+ * are removed and the instances get moved around). Handles of removed robots are ignored, even
+ * after their index is given to a new robot: the index is in the low VIS_ROBOT_HANDLE_INDEX_BITS
+ * of a handle and a generation count, bumped when the robot is removed, in the rest.
+ *
+ * Every robot has one entry in a per instance buffer (pose, size and color). Changes only update
+ * that buffer, and the changed range is uploaded once when the fleet is drawn.
+ *
+ * Each robot's bounding sphere is tested against the frustum before drawing. When some are
+ * outside, only the visible instances are packed into a second buffer, uploaded and drawn.
+ */
+typedef uint32_t visRobotHandle;
+
+#define VIS_INVALID_ROBOT_HANDLE UINT32_MAX
+/* Up to ~1M robots, and 4096 robots added at the same index before a stale handle matches again */
+#define VIS_ROBOT_HANDLE_INDEX_BITS 20
+#define VIS_ROBOT_HANDLE_INDEX_MASK ((1u << VIS_ROBOT_HANDLE_INDEX_BITS) - 1)
+
+/**
+ * Per robot data, this is exactly what is sent to the gpu
+ */
+typedef struct {
+  /* x, y metres, world coordinates. heading radians, from the Y axis (north) */
+  float x;
+  float y;
+  float heading;
+  /* metres */
+  float length;
+  float width;
+  float height;
+  float color[4];
+} visFleetInstance;
+
+void visFleet_Init();
+
+/**
+ * Add a robot to the fleet, it starts at the origin with a heading of 0
+ * \return handle to refer to the robot by, VIS_INVALID_ROBOT_HANDLE if it could not be added
+ */
+visRobotHandle visFleet_AddRobot(float length,
+                                 float width,
+                                 float height);
+
+void visFleet_RemoveRobot(visRobotHandle robot);
+
+/**
+ * Remove every robot from the fleet, all handles become invalid
+ */
+void visFleet_Clear();
+
+void visFleet_SetPose(visRobotHandle robot,
+                      float x,
+                      float y,
+                      float heading);
+
+/**
+ * Update the pose of many robots at once
+ * \param robots array of count handles
+ * \param x array of count positions, metres
+ * \param y array of count positions, metres
+ * \param heading array of count headings, radians
+ */
+void visFleet_SetPoses(const visRobotHandle *robots,
+                       const float *x,
+                       const float *y,
+                       const float *heading,
+                       uint32_t count);
+
+void visFleet_SetSize(visRobotHandle robot,
+                      float length,
+                      float width,
+                      float height);
+
+void visFleet_SetColor(visRobotHandle robot,
+                       float r,
+                       float g,
+                       float b,
+                       float a);
+
+uint32_t visFleet_Count();
+
+/**
+ * Test every robot against a frustum, the result is kept until the next call
+ * \return number of visible robots
+ */
+uint32_t visFleet_Cull(const visFrustum *frustum);
+
+/**
+ * \return whether the robot was inside the frustum the last time the fleet was culled
+ */
+bool visFleet_IsVisible(visRobotHandle robot);
+
+/**
+ * Cull the fleet against the camera, upload any changed robots and draw the visible ones with one
+ * (instanced) draw call
+ */
+void visFleet_Draw();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
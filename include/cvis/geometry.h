@@ -0,0 +1,120 @@
+#ifndef CVIS_INCLUDE_CVIS_GEOMETRY_H_
+#define CVIS_INCLUDE_CVIS_GEOMETRY_H_
+
+#include "cvis/render_queue.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Shared store of indexed meshes.
+ *
+ * Every mesh lives in one vertex buffer and one index buffer (the "arena") attached to a single
+ * vertex array, so any layer drawing registered meshes can share one vertex array bind. A mesh is
+ * just an offset and count into the arena. The built in primitive shapes are only ever created
+ * once no matter how many layers ask for them.
+ *
+ * All the primitives are unit sized and centred on the origin, scale them with the model matrix.
+ */
+typedef enum {
+  /* 1x1x1 cube */
+  visPrimitive_Box,
+  /* Diameter 1 and height 1, along the Z axis */
+  visPrimitive_Cylinder,
+  /* Length 1 along the Y axis (pointing to +Y), shaft and cone head */
+  visPrimitive_Arrow,
+  /* Diameter 1 */
+  visPrimitive_Sphere,
+  /* Pyramid with the top cut off, along the Z axis, 1x1 base at z = 0.5 and 0.25x0.25 top
+   * at z = -0.5 */
+  visPrimitive_Frustum,
+  visPrimitive_Count
+} visPrimitive;
+
+typedef struct {
+  /* Offset (in indices) of the first index in the index arena */
+  uint32_t first_index;
+  uint32_t index_count;
+  /* Offset (in vertices) added to every index, the first vertex of the mesh in the vertex arena */
+  int32_t base_vertex;
+  uint32_t vertex_count;
+} visMesh;
+
+/**
+ * Create the arena buffers and vertex array. Safe to call more than once, only the first call
+ * does anything. Requires a current OpenGL context
+ */
+void visGeometry_Init();
+
+/**
+ * Add a mesh to the arena
+ * \param vertices 3 * numVertices floats, xyz per vertex
+ * \param indices numIndices indices into vertices, 3 per triangle
+ * \return the mesh, index_count is 0 if it could not be added
+ */
+visMesh visGeometry_AddMesh(const float *vertices,
+                            uint32_t numVertices,
+                            const uint32_t *indices,
+                            uint32_t numIndices);
+
+/**
+ * Get one of the built in shapes, it is generated (once) the first time it is asked for
+ */
+const visMesh *visGeometry_GetPrimitive(visPrimitive primitive);
+
+/**
+ * Upload any meshes added since the last upload. Does not change the vertex array, array buffer
+ * or element buffer bindings
+ */
+void visGeometry_Upload();
+
+/**
+ * Upload any meshes added since the last upload and bind the shared vertex array
+ */
+void visGeometry_Bind();
+
+/**
+ * Attach the arena (vertex buffer as attribute 0 and the index buffer) to the currently bound
+ * vertex array. For layers that need their own vertex array to add extra attributes (such as per
+ * instance data) but still draw meshes from the arena. visGeometry_Upload must be called before
+ * drawing with that vertex array.
+ */
+void visGeometry_AttachToVertexArray();
+
+/**
+ * Draw a mesh, the arena vertex array (or one set up with visGeometry_AttachToVertexArray) and a
+ * shader program must be bound
+ */
+void visGeometry_DrawMesh(const visMesh *mesh);
+
+/**
+ * Draw many instances of a mesh, see visGeometry_DrawMesh
+ */
+void visGeometry_DrawMeshInstanced(const visMesh *mesh,
+                                   uint32_t instanceCount);
+
+/**
+ * \return the shared vertex array, see visGeometry_Bind
+ */
+uint32_t visGeometry_GetVertexArray();
+
+/**
+ * Set up a draw command to draw a mesh (indexed triangles). The vertex array must be the arena's
+ * or one set up with visGeometry_AttachToVertexArray, and visGeometry_Upload called before the
+ * queue runs
+ */
+void visGeometry_SetDrawRange(const visMesh *mesh,
+                              visDrawCommand *command);
+
+/**
+ * \return total bytes of vertex and index data held by the arena
+ */
+uint32_t visGeometry_ArenaBytes();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef CVIS_INCLUDE_CVIS_GL_STATE_H_
+#define CVIS_INCLUDE_CVIS_GL_STATE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Cache of the OpenGL state cvis changes while drawing. Every cvis draw sets its state through
+ * here, and calls that would not change anything are skipped.
+ *
+ * The cache only knows about changes made through these functions. Code that changes the same
+ * state directly (or deletes a bound object) must call visGlState_Invalidate afterwards.
+ * visWindow_NewFrame invalidates it at the start of every frame, so state changed by ImGui or
+ * the application between frames is never trusted.
+ */
+typedef struct {
+  /* Calls passed on to OpenGL */
+  uint32_t issued;
+  /* Calls skipped because the state was already set */
+  uint32_t elided;
+} visGlStateCounters;
+
+/**
+ * Forget all the cached state, the next call for each piece of state always goes to OpenGL
+ */
+void visGlState_Invalidate();
+
+/**
+ * Start a new frame, the current counters become the last frame's and the cache is invalidated
+ */
+void visGlState_NewFrame();
+
+void visGlState_UseProgram(uint32_t program);
+
+void visGlState_BindVertexArray(uint32_t vertexArray);
+
+/**
+ * Bind a buffer. GL_ARRAY_BUFFER, GL_COPY_WRITE_BUFFER and GL_UNIFORM_BUFFER are cached, any
+ * other target is always passed on (GL_ELEMENT_ARRAY_BUFFER belongs to the vertex array)
+ */
+void visGlState_BindBuffer(uint32_t target,
+                           uint32_t buffer);
+
+void visGlState_SetBlend(bool enabled);
+
+void visGlState_SetBlendFunc(uint32_t sourceFactor,
+                             uint32_t destinationFactor);
+
+void visGlState_SetPointSize(float size);
+
+/**
+ * \return counts for the frame so far
+ */
+visGlStateCounters visGlState_GetCounters();
+
+/**
+ * \return counts for the whole of the previous frame
+ */
+visGlStateCounters visGlState_GetLastFrameCounters();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
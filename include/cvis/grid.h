@@ -1,13 +1,22 @@
 #ifndef CVIS_INCLUDE_CVIS_GRID_H_
 #define CVIS_INCLUDE_CVIS_GRID_H_
 
-#include "cvis/camera3d.h"
-
 void visGrid_InitDefault();
 
 void visGrid_InitWithSpacing(float spacing);
 
-void visGrid_Draw(const Mat4f *view,
-                  const Mat4f *projection);
+/**
+ * Use a grid that covers the whole ground plane (z = 0) and is drawn entirely in the shader.
+ * The lines are worked out per pixel from the world position, so there is no vertex data and
+ * no limit on the extent. As the view zooms out the spacing steps up in powers of 10 and
+ * fades between the levels.
+ * \param spacing metres, spacing of the finest lines
+ */
+void visGrid_InitInfinite(float spacing);
+
+/**
+ * Draw the grid with the camera from vis_PushCamera and vis_PushProjection
+ */
+void visGrid_Draw();
 
 #endif
@@ -0,0 +1,43 @@
+#ifndef CVIS_INCLUDE_CVIS_HEADLESS_H_
+#define CVIS_INCLUDE_CVIS_HEADLESS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Offscreen OpenGL context for machines without a display (CI, batch servers).
+ *
+ * A surfaceless EGL context (EGL_MESA_platform_surfaceless, falling back to the default display
+ * with EGL_KHR_surfaceless_context) with a framebuffer object to render into, so it works with
+ * Mesa's llvmpipe on machines with no gpu at all. Only built with the CVIS_HEADLESS CMake option.
+ *
+ * Normally used through visWindow_InitializeHeadless, which also sets up ImGui and the frame API.
+ */
+
+/**
+ * Create an OpenGL 3.3 core context, make it current and load the GL functions. The framebuffer
+ * object (RGBA8 colour, 24 bit depth) is bound as the draw and read framebuffer
+ * \return false if there is no EGL or it can't give a 3.3 core context
+ */
+bool visHeadless_Initialize(int width,
+                            int height);
+
+/**
+ * \return the framebuffer object everything is rendered into
+ */
+uint32_t visHeadless_GetFramebuffer();
+
+/**
+ * Destroy the framebuffer and the context
+ */
+void visHeadless_Shutdown();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef CVIS_INCLUDE_CVIS_MAT4_H_
+#define CVIS_INCLUDE_CVIS_MAT4_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * 4x4 matrix and point kernels shared by the C layers and Camera3D.
+ *
+ * Matrices are 16 floats in column major order, the layout of cmat's Mat4f::mat, Eigen::Matrix4f
+ * and what OpenGL expects, so any of them can be passed in without copying. Pointers don't need to
+ * be aligned, and the output may be one of the inputs.
+ *
+ * Each operation has a scalar, an SSE2 and (for the ones wide enough to use it) an AVX2 + FMA
+ * kernel. The SSE2 kernels are used when the build targets SSE2 (every x86-64 build). AVX2 kernels
+ * are always compiled on x86 with gcc or clang, and picked the first time a kernel is called if the
+ * cpu has AVX2 and FMA, so one binary runs everywhere and is fast on newer cpus.
+ */
+
+typedef enum {
+  visMathIsa_Scalar,
+  visMathIsa_Sse2,
+  visMathIsa_Avx2
+} visMathIsa;
+
+/**
+ * \return the kernels in use
+ */
+visMathIsa visMath_GetIsa();
+
+/**
+ * Use a given set of kernels, e.g. to compare them
+ * \return false if the build or cpu doesn't have them, the kernels in use don't change
+ */
+bool visMath_SetIsa(visMathIsa isa);
+
+const char *visMath_IsaName(visMathIsa isa);
+
+/**
+ * out = a * b
+ */
+void visMat4_Multiply(const float *a,
+                      const float *b,
+                      float *out);
+
+/**
+ * General inverse
+ * \return false if the matrix is singular, out is left as it was
+ */
+bool visMat4_Inverse(const float *m,
+                     float *out);
+
+/**
+ * Transform points by an affine matrix (the bottom row is taken to be 0 0 0 1)
+ * \param xyz count points, x y z one after the other
+ * \param out count points, can be xyz
+ */
+void visMat4_TransformPoints(const float *m,
+                             const float *xyz,
+                             uint32_t count,
+                             float *out);
+
+/**
+ * out = translation * rotation * scale
+ * \param translation x y z
+ * \param rotation unit quaternion x y z w
+ * \param scale x y z
+ */
+void visMat4_ComposeTrs(const float *translation,
+                        const float *rotation,
+                        const float *scale,
+                        float *out);
+
+/**
+ * visMat4_ComposeTrs for count transforms at once, from structure of arrays inputs so a whole
+ * register of transforms is built at a time. Each component is an array of count floats, a NULL
+ * translation or rotation component is 0 for every transform
+ * \param translation x y z arrays
+ * \param rotation x y z w arrays, unit quaternions
+ * \param scale x y z arrays
+ * \param out 16 * count floats, column major 4x4 matrices one after another
+ */
+void visMat4_ComposeTrsBatch(const float *const translation[3],
+                             const float *const rotation[4],
+                             const float *const scale[3],
+                             uint32_t count,
+                             float *out);
+
+/**
+ * OpenGL perspective projection, symmetric about the view axis, looking down -z into clip space
+ * -1 to 1. Computed once per resize, so it has no kernels
+ * \param fovInDegrees vertical field of view
+ * \param aspectRatio width / height
+ * \param nearPlane,farPlane distances to the clipping planes, metres
+ */
+void visMat4_Perspective(float fovInDegrees,
+                         float aspectRatio,
+                         float nearPlane,
+                         float farPlane,
+                         float *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,177 @@
+#ifndef CVIS_INCLUDE_CVIS_PICKING_H_
+#define CVIS_INCLUDE_CVIS_PICKING_H_
+
+#include "cvis/vec3.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Picking objects under the cursor on the cpu, no gpu readback.
+ *
+ * A picker holds boxes (robots) and segments (trajectories, a waypoint is a segment with both
+ * ends the same) in a bounding volume hierarchy, built with the surface area heuristic. A ray from
+ * the cursor (see Camera3D::GetCursorRay and visWindow_TakeClick) is tested against the hierarchy,
+ * which only visits the few nodes the ray goes through, so a pick takes microseconds however many
+ * objects there are.
+ *
+ * Moving an object refits the boxes of the nodes above it on the next pick instead of building
+ * the hierarchy again. Refitting keeps the tree shape, so after objects have moved a long way call
+ * visPicker_Build to get fast picks back. Adding objects always builds it again.
+ */
+
+#define VIS_PICKER_INVALID UINT32_MAX
+/* Most primitives in a leaf */
+#define VIS_PICKER_MAX_LEAF_SIZE 4
+/* Deeper than this the build splits nodes in half, so the pick's stack never runs out */
+#define VIS_PICKER_MAX_DEPTH 64
+
+typedef enum {
+  visPickType_Box,
+  visPickType_Segment
+} visPickType;
+
+typedef struct {
+  float min[3];
+  float max[3];
+} visPickBounds;
+
+typedef struct {
+  /* Box: centre and half size. Segment: the two ends */
+  visVec3 a;
+  visVec3 b;
+  /* Box: yaw about z, radians. Segment: how close the ray has to pass to hit it, metres */
+  float c;
+  /* What a hit returns, the caller's id for the object */
+  uint32_t id;
+  visPickType type;
+} visPickPrimitive;
+
+typedef struct {
+  visPickBounds bounds;
+  /* Interior: the left child, the right one is the next node. Leaf: first index into order */
+  uint32_t first;
+  /* Primitives in a leaf, 0 for interior nodes */
+  uint32_t count;
+} visPickNode;
+
+typedef struct {
+  visVec3 origin;
+  /* Unit length */
+  visVec3 direction;
+} visRay;
+
+typedef struct {
+  visPickType type;
+  uint32_t id;
+  /* Metres along the ray */
+  float distance;
+  /* Where the ray hit a box, or the closest point on a segment to the ray */
+  visVec3 position;
+} visPickHit;
+
+typedef struct {
+  visPickPrimitive *primitives;
+  visPickBounds *primitive_bounds;
+  /* The leaf each primitive is in */
+  uint32_t *primitive_leaf;
+  uint32_t count;
+  uint32_t capacity;
+
+  /* Node 0 is the root, children always come after their parent */
+  visPickNode *nodes;
+  uint32_t *parents;
+  uint32_t num_nodes;
+  /* Primitives in leaf order */
+  uint32_t *order;
+
+  /* Leaves with primitives moved since the last refit */
+  uint32_t *dirty_leaves;
+  uint8_t *leaf_dirty;
+  uint32_t num_dirty;
+
+  /* Primitives were added since the last build */
+  bool needs_build;
+} visPicker;
+
+bool visPicker_Init(visPicker *picker);
+
+void visPicker_Free(visPicker *picker);
+
+/**
+ * Remove every primitive
+ */
+void visPicker_Clear(visPicker *picker);
+
+bool visPicker_Reserve(visPicker *picker,
+                       uint32_t capacity);
+
+/**
+ * Add a box, e.g. a robot
+ * \param centre metres, world coordinates
+ * \param halfSize metres, before the yaw
+ * \param yaw radians about z
+ * \param id returned by a pick that hits it
+ * \return handle for visPicker_SetBox, VIS_PICKER_INVALID if out of memory
+ */
+uint32_t visPicker_AddBox(visPicker *picker,
+                          const visVec3 *centre,
+                          const visVec3 *halfSize,
+                          float yaw,
+                          uint32_t id);
+
+/**
+ * Add a segment, e.g. part of a trajectory
+ * \param radius metres, how close the ray has to pass
+ * \return handle for visPicker_SetSegment, VIS_PICKER_INVALID if out of memory
+ */
+uint32_t visPicker_AddSegment(visPicker *picker,
+                              const visVec3 *start,
+                              const visVec3 *end,
+                              float radius,
+                              uint32_t id);
+
+/**
+ * Move a box, refitted on the next pick
+ */
+void visPicker_SetBox(visPicker *picker,
+                      uint32_t handle,
+                      const visVec3 *centre,
+                      const visVec3 *halfSize,
+                      float yaw);
+
+/**
+ * Move a segment, refitted on the next pick
+ */
+void visPicker_SetSegment(visPicker *picker,
+                          uint32_t handle,
+                          const visVec3 *start,
+                          const visVec3 *end,
+                          float radius);
+
+/**
+ * Build the hierarchy from scratch. Done by the next pick after primitives are added
+ */
+bool visPicker_Build(visPicker *picker);
+
+/**
+ * Grow and shrink the node boxes above primitives that moved. Done by the next pick
+ */
+void visPicker_Refit(visPicker *picker);
+
+/**
+ * Find the closest primitive the ray hits, building or refitting first if needed
+ * \return false if nothing is hit
+ */
+bool visPicker_Pick(visPicker *picker,
+                    const visRay *ray,
+                    visPickHit *hit);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef CVIS_INCLUDE_CVIS_POINT_BUFFER_H_
+#define CVIS_INCLUDE_CVIS_POINT_BUFFER_H_
+
+#include "cvis/vec3.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Growable, append only list of 3D points which is mirrored into an OpenGL vertex buffer.
+ *
+ * Points are only ever added to the end, so the gpu copy only needs the points that were
+ * appended since the last upload (the "tail"). Both the cpu and gpu storage grow by doubling,
+ * so building a path of N points costs O(N) bytes uploaded instead of O(N^2).
+ */
+typedef struct {
+  /* CPU side copy of all the points */
+  visVec3 *points;
+  uint32_t count;
+  uint32_t capacity;
+  /* How many points (from the start of the buffer) are already on the gpu */
+  uint32_t uploaded_count;
+  /* How many points the gpu buffer can hold before it has to be reallocated */
+  uint32_t gpu_capacity;
+  /* OpenGL buffer object, 0 if the buffer is cpu only */
+  uint32_t vbo;
+
+  /* Running totals, used for profiling/benchmarking */
+  uint64_t bytes_uploaded;
+  uint32_t gpu_reallocations;
+} visPointBuffer;
+
+/**
+ * Describes the gpu work required to bring the gpu copy of a point buffer up to date
+ */
+typedef struct {
+  /* If true the gpu buffer must be reallocated to hold `capacity` points */
+  bool reallocate;
+  uint32_t capacity;
+  /* Range of points that must be copied to the gpu */
+  uint32_t first;
+  uint32_t count;
+} visPointBufferUpload;
+
+/**
+ * Allocate the cpu side storage.
+ * \param initialCapacity number of points to reserve, 0 picks a default
+ * \return false if the allocation failed
+ */
+bool visPointBuffer_Init(visPointBuffer *buffer,
+                         uint32_t initialCapacity);
+
+/**
+ * Create the OpenGL buffer object used to mirror the points. Requires a current OpenGL context.
+ */
+void visPointBuffer_InitGpu(visPointBuffer *buffer);
+
+/**
+ * Release the cpu storage and the gpu buffer (if one was created)
+ */
+void visPointBuffer_Free(visPointBuffer *buffer);
+
+/**
+ * Append a single point, growing the storage if needed.
+ * \return false if the storage could not be grown, the point is dropped
+ */
+bool visPointBuffer_Append(visPointBuffer *buffer,
+                           float x,
+                           float y,
+                           float z);
+
+/**
+ * Make sure there is room for at least `count` points without any further allocations.
+ * \return false if the storage could not be grown
+ */
+bool visPointBuffer_Reserve(visPointBuffer *buffer,
+                            uint32_t count);
+
+/**
+ * Remove all the points. Keeps the allocated storage (cpu and gpu) for re-use
+ */
+void visPointBuffer_Clear(visPointBuffer *buffer);
+
+/**
+ * Work out what needs to be sent to the gpu and mark it as uploaded. Does not make any OpenGL
+ * calls, visPointBuffer_Upload uses this to decide what to send.
+ */
+visPointBufferUpload visPointBuffer_PrepareUpload(visPointBuffer *buffer);
+
+/**
+ * Send any points not yet on the gpu. Only the appended tail is uploaded unless the gpu buffer
+ * has to grow. Leaves GL_ARRAY_BUFFER bound to the point buffer's vbo.
+ */
+void visPointBuffer_Upload(visPointBuffer *buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef CVIS_INCLUDE_CVIS_POLYLINE_LOD_H_
+#define CVIS_INCLUDE_CVIS_POLYLINE_LOD_H_
+
+#include "cvis/point_buffer.h"
+#include "cvis/culling.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Each level keeps every 4th point of the level below it */
+#define VIS_POLYLINE_LOD_FACTOR_SHIFT 2
+#define VIS_POLYLINE_LOD_FACTOR (1u << VIS_POLYLINE_LOD_FACTOR_SHIFT)
+/* 4^11 ~ 4M points per segment on the coarsest level */
+#define VIS_POLYLINE_LOD_MAX_LEVELS 12
+/* The level with a single segment per culling chunk */
+#define VIS_POLYLINE_LOD_CHUNK_LEVEL (VIS_CULL_CHUNK_SHIFT / VIS_POLYLINE_LOD_FACTOR_SHIFT)
+
+/**
+ * A range of vertices [first, first + count) on a single level
+ */
+typedef struct {
+  uint32_t level;
+  uint32_t first;
+  uint32_t count;
+} visPolylineLodRange;
+
+/**
+ * Append only polyline with a hierarchy of simplified versions (levels of detail).
+ *
+ * Level 0 is every point. Level l keeps the points whose index is a multiple of 4^l, so each
+ * level l segment replaces 4^l level 0 segments. The levels are built as points are appended,
+ * each new point costs O(1) amortized work per level.
+ *
+ * The largest distance of any original point from the simplified segment that replaced it is
+ * kept per cell of the path: per chunk of VIS_CULL_CHUNK_SIZE points on the levels with at least
+ * one segment per chunk, per segment on the coarser ones. When drawing, each cell uses the
+ * coarsest level whose error is less than the size of a pixel (in world units), so a sharp turn
+ * only keeps its own chunk fine and how many vertices are drawn depends on the zoom level rather
+ * than the length of the path.
+ *
+ * The chunks also have a bounding box each, for frustum culling any of the levels (see
+ * visCulling_ClipStrip).
+ */
+typedef struct {
+  visPointBuffer levels[VIS_POLYLINE_LOD_MAX_LEVELS];
+  /* Max distance (metres) of an original point from its simplified segment, per level and cell
+   * (see visPolylineLod_CellShift). Level 0 has no error and no cells */
+  float *cell_error[VIS_POLYLINE_LOD_MAX_LEVELS];
+  uint32_t num_cells[VIS_POLYLINE_LOD_MAX_LEVELS];
+  uint32_t cell_capacity[VIS_POLYLINE_LOD_MAX_LEVELS];
+  /* Axis aligned bounding box of all the points */
+  visVec3 min;
+  visVec3 max;
+  /* Bounding box of each chunk of original points. A chunk's box also holds the first point of
+   * the next chunk, so it covers every segment starting in the chunk */
+  visAabbArray chunks;
+  /* The last visPolylineLod_Select */
+  visPolylineLodRange *ranges;
+  uint32_t num_ranges;
+  uint32_t range_capacity;
+} visPolylineLod;
+
+bool visPolylineLod_Init(visPolylineLod *lod);
+
+/**
+ * Create the gpu buffers for every level. Requires a current OpenGL context.
+ */
+void visPolylineLod_InitGpu(visPolylineLod *lod);
+
+void visPolylineLod_Free(visPolylineLod *lod);
+
+bool visPolylineLod_Append(visPolylineLod *lod,
+                           float x,
+                           float y,
+                           float z);
+
+/**
+ * Make sure level 0 can hold `count` points without further allocations
+ */
+bool visPolylineLod_Reserve(visPolylineLod *lod,
+                            uint32_t count);
+
+void visPolylineLod_Clear(visPolylineLod *lod);
+
+/**
+ * \return number of original (level 0) points
+ */
+static inline uint32_t visPolylineLod_Count(const visPolylineLod *lod) {
+  return lod->levels[0].count;
+}
+
+/**
+ * \return log2 of the number of original points in a cell of a level's error
+ */
+static inline uint32_t visPolylineLod_CellShift(uint32_t level) {
+  const uint32_t cell_level = level > VIS_POLYLINE_LOD_CHUNK_LEVEL ? level : VIS_POLYLINE_LOD_CHUNK_LEVEL;
+  return VIS_POLYLINE_LOD_FACTOR_SHIFT * cell_level;
+}
+
+/**
+ * Choose the coarsest level whose error is below maxError for each cell, and get the ranges of
+ * vertices that draw the whole polyline that way into lod->ranges. Neighbouring cells on the same
+ * level share a range. Consecutive ranges share their end/start vertex so a line strip per range
+ * draws a connected line. If the ranges can't be allocated the whole of level 0 is one range
+ * \param maxError metres, typically the size of a pixel in world units
+ * \return number of ranges
+ */
+uint32_t visPolylineLod_Select(visPolylineLod *lod,
+                               float maxError);
+
+/**
+ * Upload the newly appended vertices of every level
+ */
+void visPolylineLod_Upload(visPolylineLod *lod);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
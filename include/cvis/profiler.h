@@ -0,0 +1,137 @@
+#ifndef CVIS_INCLUDE_CVIS_PROFILER_H_
+#define CVIS_INCLUDE_CVIS_PROFILER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Frame profiler.
+ *
+ * Named scopes record cpu time from a steady clock and gpu time from GL_TIME_ELAPSED queries. The
+ * layers profile their own Draw, the window profiles the render queue, ImGui and the buffer swap.
+ *
+ * Queries are double buffered: the queries of a frame are only read back two frames later, when
+ * the same set is about to be reused, so reading them never waits for the gpu. A frame whose
+ * results still aren't in by then is kept without gpu times.
+ *
+ * GL_TIME_ELAPSED queries can't be nested, so only the outermost scope gets gpu time.
+ *
+ * Profiling starts off. Disabled, every call returns straight away.
+ */
+
+#define VIS_PROFILER_MAX_SCOPES 32
+/* Frames kept for the panel and for export */
+#define VIS_PROFILER_HISTORY 120
+
+typedef struct {
+  /* String literal, scopes with the same name are added together in the panel */
+  const char *name;
+  /* Milliseconds since the profiler was enabled */
+  double cpu_start_ms;
+  float cpu_ms;
+  /* Negative if the scope has no gpu time */
+  float gpu_ms;
+} visProfilerScope;
+
+/**
+ * A scope name's per frame total averaged over the history
+ */
+typedef struct {
+  const char *name;
+  double cpu_ms;
+  /* Over the frames with gpu times, negative if there are none */
+  double gpu_ms;
+} visProfilerAverage;
+
+typedef struct {
+  uint64_t index;
+  double cpu_start_ms;
+  float cpu_ms;
+  uint32_t num_scopes;
+  visProfilerScope scopes[VIS_PROFILER_MAX_SCOPES];
+} visProfilerFrame;
+
+void visProfiler_SetEnabled(bool enabled);
+
+bool visProfiler_IsEnabled();
+
+/**
+ * Turn gpu timing on or off (it is on by default). Without it the profiler makes no GL calls
+ */
+void visProfiler_SetGpuTiming(bool enabled);
+
+/**
+ * Start a frame, called by visWindow_NewFrame. Collects the gpu times of the frame two before
+ */
+void visProfiler_BeginFrame();
+
+/**
+ * End a frame, called by visWindow_EndFrame after the buffer swap
+ */
+void visProfiler_EndFrame();
+
+/**
+ * Start timing a scope on the cpu and the gpu, ended by visProfiler_EndScope
+ * \param name string literal, the pointer is kept
+ */
+void visProfiler_BeginScope(const char *name);
+
+/**
+ * Same as visProfiler_BeginScope but cpu time only, for work that isn't gpu commands (such as
+ * swapping buffers)
+ */
+void visProfiler_BeginCpuScope(const char *name);
+
+void visProfiler_EndScope();
+
+/**
+ * \return number of complete frames in the history, at most VIS_PROFILER_HISTORY
+ */
+uint32_t visProfiler_FrameCount();
+
+/**
+ * \param i 0 is the oldest frame in the history
+ */
+const visProfilerFrame *visProfiler_GetFrame(uint32_t i);
+
+/**
+ * Per frame totals of each scope name (a layer may be drawn more than once), averaged over the
+ * history, in the order the names first appear
+ * \param averages output, at most maxAverages. Names past that are left out
+ * \param frameMs output, average cpu time of a whole frame. Can be NULL
+ * \return number of averages
+ */
+uint32_t visProfiler_GetAverages(visProfilerAverage *averages,
+                                 uint32_t maxAverages,
+                                 double *frameMs);
+
+/**
+ * Draw the profiler window, see visProfiler_GetAverages. Call between visWindow_NewFrame and
+ * visWindow_EndFrame. Drawn with the Dear ImGui the library is built with (profiler_panel.cpp)
+ */
+void visProfiler_DrawPanel();
+
+/**
+ * Write the history as Chrome trace event JSON (chrome://tracing, Perfetto). Cpu scopes are on
+ * one track, gpu scopes on another starting at the same time as their cpu scope (the queries only
+ * give a duration)
+ * \return false if the file could not be written
+ */
+bool visProfiler_ExportChromeTrace(const char *path);
+
+/**
+ * Write the history as CSV, one row per scope: frame, scope, cpu_start_ms, cpu_ms, gpu_ms (empty
+ * if there is no gpu time)
+ * \return false if the file could not be written
+ */
+bool visProfiler_ExportCsv(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -25,4 +25,16 @@ Mat4f visProjection_Perspective(float fovInDegrees,
                                 float nearPlane,
                                 float farPlane);
 
+/**
+ * Size of a single pixel in world units at some distance from the camera. Used to pick how much
+ * detail is worth drawing.
+ * \param projection perspective (see visProjection_Perspective) or orthographic projection
+ * \param distance metres, distance from the camera, ignored for orthographic projections
+ * \param viewportHeight pixels
+ * \return metres per pixel
+ */
+float visProjection_WorldUnitsPerPixel(const Mat4f *projection,
+                                       float distance,
+                                       int viewportHeight);
+
 #endif
@@ -0,0 +1,18 @@
+#ifndef CVIS_INCLUDE_CVIS_PUSH_CAMERA_H_
+#define CVIS_INCLUDE_CVIS_PUSH_CAMERA_H_
+
+#include "cvis/camera3d.h"
+
+namespace vis {
+
+/**
+ * @brief Push the view and projection of a camera with vis_PushCamera and vis_PushProjection.
+ * Kept out of the C headers since Camera3D needs Eigen
+ *
+ * @param camera
+ */
+void PushCamera(const Camera3D &camera);
+
+}
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef CVIS_INCLUDE_CVIS_REDRAW_H_
+#define CVIS_INCLUDE_CVIS_REDRAW_H_
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Whether the scene changed since the last frame, for on-demand rendering (see
+ * visWindow_SetOnDemand).
+ *
+ * The layers request a redraw whenever their data actually changes, as do the update queue and
+ * scene snapshots when another thread pushes to them, and the window for input. Anything else the
+ * application shows (its own ImGui panels animating, a camera it moves itself) must call
+ * visRedraw_Request too, or it only shows up with the next change.
+ *
+ * The flag is a single atomic. Only the first request after a frame calls the wake function, so
+ * requesting often, even from several threads, costs a load.
+ */
+
+/**
+ * Mark the scene as changed, safe from any thread
+ */
+void visRedraw_Request();
+
+/**
+ * Clear the flag
+ * \return whether a redraw was requested since the last call
+ */
+bool visRedraw_Take();
+
+/**
+ * Called by the first request after visRedraw_Take, from whichever thread requested, to wake a
+ * render thread waiting for events (glfwPostEmptyEvent). NULL for none
+ */
+void visRedraw_SetWakeFunction(void (*wake)(void));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef CVIS_INCLUDE_CVIS_RENDER_QUEUE_H_
+#define CVIS_INCLUDE_CVIS_RENDER_QUEUE_H_
+
+#include "cvis/shader.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Deferred draw commands.
+ *
+ * Layers don't draw straight away, they submit commands to the queue. At the end of the frame
+ * (visWindow_EndFrame) the queue sorts the commands by a 64 bit key and runs them, so the order
+ * layers are drawn in no longer depends on the order the application calls them, and commands
+ * sharing state end up next to each other. Neighbouring commands with the same program, vertex
+ * array, primitive and uniforms are merged into one multi draw.
+ *
+ * Key layout, most significant first:
+ *   pass (2 bits) | program (16) | vertex array (16) | blend (1) | depth (24) | unused (5)
+ * except in the transparent pass, where depth comes straight after the pass so blended geometry
+ * is drawn back to front:
+ *   pass (2 bits) | depth (24, inverted) | program (16) | vertex array (16) | blend (1) | unused (5)
+ * The sort is stable, so commands with equal keys keep their submission order.
+ */
+typedef enum {
+  /* Drawn first, under everything else (the grid) */
+  visRenderPass_Background,
+  visRenderPass_Opaque,
+  visRenderPass_Transparent,
+  /* Drawn last, over everything else */
+  visRenderPass_Overlay,
+} visRenderPass;
+
+typedef struct {
+  visRenderPass pass;
+  uint32_t program;
+  uint32_t vertex_array;
+  /* GL_TRIANGLES, GL_LINE_STRIP, ... */
+  uint32_t mode;
+  /* Alpha blending (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA) on or off */
+  bool blend;
+  /* Draw with the vertex array's element buffer (32 bit indices) instead of straight from the
+   * vertices */
+  bool indexed;
+  /* First vertex, or first index when indexed */
+  uint32_t first;
+  uint32_t count;
+  /* Added to every index, indexed draws only */
+  int32_t base_vertex;
+  /* 0 for a normal draw, otherwise the number of instances */
+  uint32_t instance_count;
+  /* 0 leaves the point size alone */
+  float point_size;
+  /* 0 on the near plane to 1 on the far plane (see visCulling_GetDepth), only used for ordering.
+   * Blended layers set it so the transparent pass is drawn back to front */
+  float depth;
+
+  /* Uniforms set before drawing, a location of -1 is skipped */
+  int32_t color_location;
+  float color[4];
+  int32_t scalar_location;
+  float scalar;
+  /* Column major 4x4, has to stay valid until the queue is run. NULL leaves the uniform alone */
+  int32_t model_location;
+  const float *model;
+
+  /* Profiler scope the draw is timed under (string literal), NULL for none. Consecutive commands
+   * of the same layer share one scope */
+  const char *layer;
+} visDrawCommand;
+
+typedef struct {
+  uint32_t commands;
+  /* Draw calls actually made after merging */
+  uint32_t draw_calls;
+} visRenderQueueStats;
+
+/**
+ * A command for the program and vertex array with everything else at its default: opaque pass,
+ * no blending, not indexed or instanced, no uniforms
+ */
+visDrawCommand visRenderQueue_NewCommand(const visProgram *program,
+                                         uint32_t vertexArray,
+                                         uint32_t mode);
+
+/**
+ * Add a command to the queue, it is copied
+ */
+void visRenderQueue_Submit(const visDrawCommand *command);
+
+uint64_t visRenderQueue_MakeKey(const visDrawCommand *command);
+
+/**
+ * Sort the submitted commands, visRenderQueue_Execute does this itself
+ */
+void visRenderQueue_Sort();
+
+/**
+ * \return the i'th command in sorted order, valid after visRenderQueue_Sort until the next submit
+ */
+const visDrawCommand *visRenderQueue_GetSorted(uint32_t i);
+
+uint32_t visRenderQueue_Count();
+
+/**
+ * \return how many draw calls the sorted commands will take once neighbours are merged
+ */
+uint32_t visRenderQueue_CountDrawCalls();
+
+/**
+ * Sort and draw everything submitted since the last call, then empty the queue. Called by
+ * visWindow_EndFrame before ImGui is drawn
+ */
+void visRenderQueue_Execute();
+
+/**
+ * Empty the queue without drawing anything
+ */
+void visRenderQueue_Clear();
+
+/**
+ * \return what the last visRenderQueue_Execute did
+ */
+visRenderQueueStats visRenderQueue_GetLastStats();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,6 +1,9 @@
 #ifndef CVIS_INCLUDE_CVIS_ROBOT_H_
 #define CVIS_INCLUDE_CVIS_ROBOT_H_
 
+#include "cvis/robot_model.h"
+#include "cmat/vec3f.h"
+
 void visRobot_Init(double length,
                    double width,
                    double height);
@@ -11,6 +14,10 @@ void visRobot_ChangeSize(double length,
                          double width,
                          double height);
 
+/**
+ * Move the robot
+ * \param pose x, y metres and z is the heading in radians from the Y axis (north)
+ */
 void visRobot_UpdatePosition(Vec3f pose);
 
 #endif
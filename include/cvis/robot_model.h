@@ -0,0 +1,37 @@
+#ifndef CVIS_INCLUDE_CVIS_ROBOT_MODEL_H_
+#define CVIS_INCLUDE_CVIS_ROBOT_MODEL_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Compute the model matrix for many robots at once, from structure of array inputs. This is the
+ * same matrix visRobot_UpdatePosition (cvis/robot.h) uses (translation * rotation * scale).
+ * Groups of 4 robots are built with visMat4_ComposeTrsBatch, with the sines and cosines of their
+ * headings 4 at a time when SSE2 is available. No OpenGL calls, so the output can go straight into a mapped gpu buffer.
+ * \param x array of count positions, metres
+ * \param y array of count positions, metres
+ * \param heading array of count headings, radians from the Y axis (north)
+ * \param length array of count robot lengths, metres
+ * \param width array of count robot widths, metres
+ * \param height array of count robot heights, metres
+ * \param count number of robots
+ * \param models output, 16 * count floats, column major 4x4 matrices one after another
+ */
+void visRobot_ComputeModelMatrices(const float *x,
+                                   const float *y,
+                                   const float *heading,
+                                   const float *length,
+                                   const float *width,
+                                   const float *height,
+                                   uint32_t count,
+                                   float *models);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef CVIS_INCLUDE_CVIS_SCENE_H_
+#define CVIS_INCLUDE_CVIS_SCENE_H_
+
+#include "cvis/fleet.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Scene snapshots, for a simulation running at its own rate on another thread.
+ *
+ * The simulation writes the whole state of the scene (the robot and fleet poses) each step and
+ * publishes it, and visWindow_NewFrame applies the newest published snapshot to the layers. Steps
+ * published between two frames are skipped rather than queued, unlike the updates in
+ * cvis/updates.h, so a 1 kHz simulation costs the render thread one snapshot per frame.
+ *
+ * There are three snapshot buffers: the one the writer is filling, the one the reader is using,
+ * and the newest published one in between. Publishing and reading each swap a buffer with the one
+ * in between (an atomic exchange), so neither side ever waits for the other and the reader never
+ * sees a snapshot that is still being written.
+ *
+ * One writer thread and one reader thread.
+ */
+
+/* Most fleet poses in one snapshot, as many robots as a fleet can hold */
+#define VIS_SCENE_MAX_FLEET_POSES VIS_ROBOT_HANDLE_INDEX_MASK
+
+typedef struct {
+  /* Fleet robot, unused for the single robot */
+  visRobotHandle robot;
+  /* x, y metres, heading radians from the Y axis (north) */
+  float x;
+  float y;
+  float heading;
+} visScenePose;
+
+typedef struct {
+  /* Set by visScene_Publish, 1 for the first snapshot. 0 means nothing has been published */
+  uint64_t sequence;
+  /* Simulation time, seconds. Not used by cvis */
+  double time;
+  /* Move the single robot (visRobot_UpdatePosition) */
+  bool has_robot;
+  visScenePose robot;
+  /* Fleet robots to move (visFleet_SetPose), the first num_fleet_poses entries. Make room for them
+   * with visScene_ReserveFleet, each buffer has its own fleet_capacity */
+  uint32_t num_fleet_poses;
+  uint32_t fleet_capacity;
+  visScenePose *fleet;
+} visSceneState;
+
+/**
+ * Get the buffer to write the next snapshot into, writer thread only. It holds an older snapshot
+ * (not necessarily the last one published), so set every field that is used
+ */
+visSceneState *visScene_BeginWrite();
+
+/**
+ * Make room for count fleet poses in the buffer from visScene_BeginWrite, writer thread only. The
+ * poses already in it are kept
+ * \return false if count is over VIS_SCENE_MAX_FLEET_POSES or the memory could not be allocated,
+ * the buffer is left as it was
+ */
+bool visScene_ReserveFleet(visSceneState *scene,
+                           uint32_t count);
+
+/**
+ * Publish the buffer from visScene_BeginWrite, it can't be touched after this
+ * \return false if num_fleet_poses was over fleet_capacity, only the first fleet_capacity poses
+ * are published
+ */
+bool visScene_Publish();
+
+/**
+ * Get the newest published snapshot, reader thread only (visWindow_NewFrame). Stays valid and
+ * unchanged until the next call
+ */
+const visSceneState *visScene_Latest();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
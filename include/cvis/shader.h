@@ -1,13 +1,111 @@
 #ifndef CVIS_INCLUDE_CVIS_SHADER_H_
 #define CVIS_INCLUDE_CVIS_SHADER_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef uint32_t visShader;
 
+/* Binding point of the Camera uniform block (view, projection and view_projection). Every program
+ * reads the camera from the one buffer bound here, see vis_PushCamera */
+#define VIS_CAMERA_BLOCK_BINDING 0
+
+/**
+ * Uniforms set by the layers, besides the camera which comes from the Camera uniform block
+ */
+typedef enum {
+  visUniform_Model,
+  visUniform_Color,
+  visUniform_Spacing,
+  visUniform_Count
+} visUniform;
+
+/**
+ * A linked shader program and the locations of its uniforms. The locations are looked up once
+ * when the program is linked, so drawing never has to look them up by name.
+ */
+typedef struct {
+  visShader id;
+  /* Set once the program is built and the uniforms looked up, see visProgram_IsReady */
+  bool ready;
+  /* Location of each visUniform, -1 if the program does not use it (setting -1 is a no-op) */
+  int32_t uniforms[visUniform_Count];
+} visProgram;
+
+typedef struct {
+  /* Programs handed out again because the same source pair was already built in this process */
+  uint32_t memory_hits;
+  /* Programs loaded from a binary on disk instead of compiled */
+  uint32_t disk_hits;
+  /* Binaries on disk the driver refused, they are deleted and the program compiled instead */
+  uint32_t disk_rejected;
+  uint32_t compiles;
+} visShaderCacheStats;
+
+/**
+ * Build a program from a vertex and fragment shader. Identical source pairs only get built once
+ * per process (so the program, and its uniform values, are shared). Linked programs are saved to
+ * the cache directory with glGetProgramBinary and loaded from there on the next run, keyed by a
+ * hash of the sources and the driver vendor, renderer and version.
+ * #include lines are not resolved here, only in the shaders embedded at build time.
+ * \return the program, 0 if it could not be built
+ */
 visShader visShader_LoadShaderFromFiles(const char *vertexSourceFile,
                                         const char *fragmentShaderFile);
 
+/**
+ * Same as visShader_LoadShaderFromFiles, from sources already in memory such as the shaders
+ * embedded at build time (cvis/embedded_shaders.h)
+ */
+visShader visShader_LoadShaderFromSource(const char *vertexSource,
+                                         const char *fragmentSource);
+
+/**
+ * Set the directory program binaries are saved to, it is created if it does not exist. The
+ * default is ~/.cache/cvis. NULL turns the disk cache off
+ */
+void visShader_SetCacheDirectory(const char *directory);
+
+visShaderCacheStats visShader_GetCacheStats();
+
+/**
+ * Compile and link a program, look up its uniform locations and attach its Camera uniform block
+ * (if it has one) to VIS_CAMERA_BLOCK_BINDING
+ * \return false if the program could not be built, program->id is 0
+ */
+bool visProgram_LoadFromFiles(visProgram *program,
+                              const char *vertexSourceFile,
+                              const char *fragmentShaderFile);
+
+bool visProgram_LoadFromSource(visProgram *program,
+                               const char *vertexSource,
+                               const char *fragmentSource);
+
+/**
+ * Start building a program without waiting for it. The shaders are compiled and linked but none
+ * of the results are checked, so every layer can submit its program up front and the driver
+ * compiles them in parallel (with GL_KHR_parallel_shader_compile) or at least back to back.
+ * Programs found in the cache are ready straight away.
+ */
+void visProgram_LoadAsync(visProgram *program,
+                          const char *vertexSource,
+                          const char *fragmentSource);
+
+/**
+ * Check whether a program from visProgram_LoadAsync can be used yet, layers skip drawing until it
+ * can. With GL_KHR_parallel_shader_compile this never blocks, without it the first call waits
+ * for the driver to finish that program.
+ * \return true once the program is built and its uniforms looked up, false while it is still
+ * compiling or if it failed
+ */
+bool visProgram_IsReady(visProgram *program);
 
+#ifdef __cplusplus
+}
+#endif
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,144 @@
+#ifndef CVIS_INCLUDE_CVIS_TRAIL_H_
+#define CVIS_INCLUDE_CVIS_TRAIL_H_
+
+#include "cvis/vec3.h"
+#include "cvis/culling.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Fixed size "breadcrumb" trail that keeps the last `capacity` points pushed to it.
+ *
+ * The points live in a ring buffer which is allocated once (cpu and gpu), so memory use is
+ * constant no matter how long the trail runs. For a "last N seconds" trail pick the capacity
+ * as N * the rate points are pushed at.
+ *
+ * The ring has one extra slot at the end which mirrors slot 0. Once the ring has wrapped the
+ * trail is drawn as two ranges, [head, capacity] then [0, head), and the mirrored slot joins the
+ * end of the first range to the start of the second so the line strip has no gap.
+ */
+typedef struct {
+  /* capacity + 1 points, the last one is a copy of slot 0 */
+  visVec3 *points;
+  uint32_t capacity;
+  /* Next slot to be written, once the ring is full this is also the oldest point */
+  uint32_t head;
+  /* Number of valid points, never more than capacity */
+  uint32_t count;
+  /* Number of slots written (ending at head) since the last upload, capped at capacity */
+  uint32_t dirty_count;
+
+  /* Bounding box of each chunk of VIS_CULL_CHUNK_SIZE slots, for frustum culling. A chunk's box
+   * also holds the first point of the next chunk. It starts again empty when the ring comes back
+   * round to the chunk */
+  visAabbArray chunks;
+  uint8_t *chunk_visible;
+
+  uint32_t vao;
+  uint32_t vbo;
+  float color[4];
+
+  /* Running total, used for profiling/testing */
+  uint64_t bytes_uploaded;
+} visTrail;
+
+/**
+ * A range of ring slots [first, first + count)
+ */
+typedef struct {
+  uint32_t first;
+  uint32_t count;
+} visTrailRange;
+
+/**
+ * The slots which need to be sent to the gpu. At most 2 ranges (when the dirty slots wrap
+ * around the end of the ring), plus the mirror slot when slot 0 was overwritten.
+ */
+typedef struct {
+  visTrailRange ranges[2];
+  uint32_t num_ranges;
+  bool upload_mirror;
+} visTrailUpload;
+
+/**
+ * Allocate the cpu side ring buffer. This is the only allocation the trail makes.
+ * \param capacity max number of points kept, must be > 0
+ * \return false if the allocation failed
+ */
+bool visTrail_Init(visTrail *trail,
+                   uint32_t capacity);
+
+/**
+ * Create the gpu buffer (sized for the full ring up front) and vertex array.
+ * Requires a current OpenGL context.
+ */
+void visTrail_InitGpu(visTrail *trail);
+
+void visTrail_Free(visTrail *trail);
+
+/**
+ * Push a new point on to the trail, overwriting the oldest point if the trail is full
+ */
+void visTrail_Push(visTrail *trail,
+                   float x,
+                   float y,
+                   float z);
+
+/**
+ * Remove all the points from the trail, keeps the allocated memory
+ */
+void visTrail_Clear(visTrail *trail);
+
+void visTrail_SetColor(visTrail *trail,
+                       float r,
+                       float g,
+                       float b,
+                       float a);
+
+/**
+ * Work out which slots have to be sent to the gpu and mark them as uploaded.
+ * Does not make any OpenGL calls.
+ */
+visTrailUpload visTrail_PrepareUpload(visTrail *trail);
+
+/**
+ * Get the ranges to draw, oldest point first.
+ * \param ranges output, must have room for 2 ranges
+ * \return number of ranges (0, 1 or 2)
+ */
+uint32_t visTrail_GetDrawRanges(const visTrail *trail,
+                                visTrailRange *ranges);
+
+/**
+ * Get the parts of the draw ranges inside a frustum. The chunk the ring is part way through
+ * overwriting is always drawn, its box only covers the new points
+ * \param ranges output, at most maxRanges (at least 2)
+ * \param counts output, chunks visible and culled
+ * \return number of ranges
+ */
+uint32_t visTrail_GetVisibleRanges(visTrail *trail,
+                                   const visFrustum *frustum,
+                                   visCullRange *ranges,
+                                   uint32_t maxRanges,
+                                   visCullCounts *counts);
+
+/**
+ * Upload the overwritten slots and draw the trail as a line strip
+ */
+void visTrail_Draw(visTrail *trail);
+
+/**
+ * \return bytes of memory held by the trail (cpu side)
+ */
+size_t visTrail_MemoryBytes(const visTrail *trail);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef CVIS_INCLUDE_CVIS_UPDATES_H_
+#define CVIS_INCLUDE_CVIS_UPDATES_H_
+
+#include "cvis/fleet.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Updates from other threads.
+ *
+ * The layers are not thread safe and adding data to them can make GL calls, so only the render
+ * thread may touch them. Any other thread (control, perception, ...) pushes updates to this
+ * queue instead, and visWindow_NewFrame applies everything queued once per frame.
+ *
+ * The queue is a fixed size lock-free ring (Vyukov's bounded queue): pushing never takes a lock
+ * or waits for the render thread. When the queue is full the update is dropped and the push
+ * returns false. Updates from one thread are applied in the order they were pushed, there is no
+ * ordering between threads.
+ */
+
+/* Must be a power of two */
+#define VIS_UPDATE_QUEUE_CAPACITY 4096
+/* Waypoints carried by one update, bigger batches are split over several updates */
+#define VIS_UPDATE_MAX_WAYPOINTS 20
+
+typedef enum {
+  /* Move the single robot (visRobot_UpdatePosition) */
+  visUpdate_RobotPose,
+  /* Move one robot of the fleet (visFleet_SetPose) */
+  visUpdate_FleetPose,
+  /* Add waypoints (visWaypoints_AddBatch) */
+  visUpdate_Waypoints,
+  /* Remove every waypoint (visWaypoints_Clear) */
+  visUpdate_ClearWaypoints,
+} visUpdateType;
+
+typedef struct {
+  visUpdateType type;
+  union {
+    /* visUpdate_RobotPose and visUpdate_FleetPose, robot is only used by the fleet */
+    struct {
+      visRobotHandle robot;
+      float x;
+      float y;
+      float heading;
+    } pose;
+    /* visUpdate_Waypoints, packed xyz triplets */
+    struct {
+      uint32_t count;
+      float xyz[3 * VIS_UPDATE_MAX_WAYPOINTS];
+    } waypoints;
+  };
+} visUpdate;
+
+/**
+ * Queue an update, safe from any thread
+ * \return false if the queue is full and the update was dropped
+ */
+bool visUpdates_Push(const visUpdate *update);
+
+bool visUpdates_PushRobotPose(float x,
+                              float y,
+                              float heading);
+
+bool visUpdates_PushFleetPose(visRobotHandle robot,
+                              float x,
+                              float y,
+                              float heading);
+
+/**
+ * Queue waypoints, split into updates of VIS_UPDATE_MAX_WAYPOINTS
+ * \param xyz array of 3 * count floats (x0, y0, z0, x1, y1, z1, ...), copied
+ * \return false if the queue filled up part way, only the waypoints before that were queued
+ */
+bool visUpdates_PushWaypoints(const float *xyz,
+                              uint32_t count);
+
+bool visUpdates_PushClearWaypoints();
+
+/**
+ * Take the oldest update off the queue. Meant for the render thread only (visWindow_NewFrame),
+ * although it is safe to call from several threads
+ * \return false if the queue is empty
+ */
+bool visUpdates_Pop(visUpdate *update);
+
+/**
+ * \return number of updates dropped because the queue was full
+ */
+uint64_t visUpdates_Dropped();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef CVIS_INCLUDE_CVIS_VEC3_H_
+#define CVIS_INCLUDE_CVIS_VEC3_H_
+
+/**
+ * A 3D point or direction, metres. The core library (buffers, culling, picking) uses this instead
+ * of cmat's Vec3f so it builds without cmat. The layout is the same, three packed floats, which is
+ * also what the vertex buffers hold.
+ */
+typedef struct {
+  float x;
+  float y;
+  float z;
+} visVec3;
+
+#endif
@@ -2,17 +2,35 @@
 #define CVIS_INCLUDE_CVIS_VIS_H_
 
 #include "cvis/window.h"
-#include "cvis/camera3d.h"
 #include "cvis/shader.h"
 #include "cvis/grid.h"
 #include "cvis/waypoints.h"
-
-void vis_PushCamera(const visCamera *camera);
-
-void vis_PushProjection(const Mat4f *projection);
+#include "cvis/trail.h"
+#include "cvis/fleet.h"
+#include "cvis/geometry.h"
+#include "cvis/gl_state.h"
+#include "cvis/render_queue.h"
+#include "cvis/profiler.h"
+#include "cvis/updates.h"
+#include "cvis/scene.h"
+#include "cvis/capture.h"
+#include "cvis/redraw.h"
+#include "cvis/culling.h"
+#include "cvis/vis_camera.h"
+#include "cmat/vec3f.h"
 
 const Mat4f* vis_GetCurrentView();
 
 const Mat4f* vis_GetCurrentProjection();
 
+/**
+ * projection * view, as last uploaded to the Camera uniform buffer
+ */
+const Mat4f* vis_GetCurrentViewProjection();
+
+/**
+ * Position of the camera in world coordinates (metres), worked out from the current view matrix
+ */
+Vec3f vis_GetCurrentCameraPosition();
+
 #endif
\ No newline at end of file
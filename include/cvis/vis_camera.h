@@ -0,0 +1,26 @@
+#ifndef CVIS_INCLUDE_CVIS_VIS_CAMERA_H_
+#define CVIS_INCLUDE_CVIS_VIS_CAMERA_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Set the camera for the frame. The view matrix is copied into the Camera uniform buffer shared
+ * by every shader program, so push the camera again after it moves. For a vis::Camera3D see
+ * vis::PushCamera (cvis/push_camera.h)
+ * \param view 16 floats, column major like OpenGL (Mat4f.mat, Eigen::Matrix4f::data())
+ */
+void vis_PushCamera(const float *view);
+
+/**
+ * Set the projection for the frame, copied into the Camera uniform buffer like vis_PushCamera
+ * \param projection 16 floats, column major
+ */
+void vis_PushProjection(const float *projection);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
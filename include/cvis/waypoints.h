@@ -1,12 +1,45 @@
 #ifndef CVIS_INCLUDE_CVIS_WAYPOINTS_H_
 #define CVIS_INCLUDE_CVIS_WAYPOINTS_H_
 
+#include <stdint.h>
+
 void visWaypoints_Init();
 
+/**
+ * Add a single waypoint. Nothing is sent to the gpu until the next visWaypoints_Draw
+ */
 void visWaypoints_Add(float x,
                       float y,
                       float z);
 
+/**
+ * Add a batch of waypoints stored as packed xyz triplets
+ * \param xyz array of 3 * count floats (x0, y0, z0, x1, y1, z1, ...)
+ * \param count number of waypoints
+ */
+void visWaypoints_AddBatch(const float *xyz,
+                           uint32_t count);
+
+/**
+ * Add a batch of waypoints stored as separate x, y, z arrays
+ * \param x array of count floats
+ * \param y array of count floats
+ * \param z array of count floats, can be NULL to place all the waypoints at z = 0
+ * \param count number of waypoints
+ */
+void visWaypoints_AddBatchSoA(const float *x,
+                              const float *y,
+                              const float *z,
+                              uint32_t count);
+
+/**
+ * Remove every waypoint
+ */
+void visWaypoints_Clear();
+
+/**
+ * Draw the waypoints. All the waypoints added since the previous draw are uploaded here in one go
+ */
 void visWaypoints_Draw();
 
 #endif
@@ -2,6 +2,7 @@
 #define CVIS_INCLUDE_CVIS_WINDOW_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "cmat/mat4f.h"
 
 /* Include ImGui here so any users of window.h automatically get imgui function */
@@ -13,13 +14,87 @@ bool visWindow_Initialize(const char *windowName,
                           int width,
                           int height);
 
+/**
+ * Render offscreen instead of to a window, for machines without a display. Uses a surfaceless
+ * EGL context and a framebuffer object (see cvis/headless.h), which needs cvis and cvis_window
+ * built with the CVIS_HEADLESS CMake option. The frame API is the same: NewFrame/EndFrame, with no buffer
+ * swap and never throttled by vsync. There is no input, ShouldClose is always false.
+ * \return false if the context could not be created or headless support wasn't built
+ */
+bool visWindow_InitializeHeadless(int width,
+                                  int height);
+
+bool visWindow_IsHeadless();
+
+/**
+ * Wait for vsync when swapping buffers (the default) or run uncapped. No effect headless
+ */
+void visWindow_SetVsync(bool enabled);
+
+/**
+ * Only render when something changed, to stop idle windows using cpu and gpu. Anything that
+ * changes the scene requests a redraw (see cvis/redraw.h): the layers, the update queue, scene
+ * snapshots and input. visWindow_NewFrame waits for one of those and returns false if there was
+ * none, the application then skips drawing and visWindow_EndFrame:
+ *
+ *   while (!visWindow_ShouldClose()) {
+ *     if (!visWindow_NewFrame()) {
+ *       continue;
+ *     }
+ *     ... draw ...
+ *     visWindow_EndFrame();
+ *   }
+ *
+ * No effect headless.
+ * \param maxWait seconds visWindow_NewFrame waits before giving up, the longest the application's
+ * loop goes without running
+ */
+void visWindow_SetOnDemand(bool enabled,
+                           double maxWait);
+
 bool visWindow_ShouldClose();
 
-void visWindow_NewFrame();
+/**
+ * Poll events, apply queued updates and start a frame
+ * \return false if rendering on demand and nothing changed, there is no frame to draw
+ */
+bool visWindow_NewFrame();
 
 void visWindow_EndFrame();
 
 void visWindow_ChangeFieldOfView(float fovInDegrees);
 
 const Mat4f* visWindow_GetProjectionMatrix();
+
+/**
+ * Get the size of the framebuffer (what is rendered to) in pixels
+ */
+void visWindow_GetFramebufferSize(int *width,
+                                  int *height);
+
+/**
+ * Get the size of the window in screen coordinates, the units of ImGui and the cursor. On HiDPI
+ * screens it is smaller than the framebuffer by the content scale. The size to give
+ * Camera3D::SetViewport
+ */
+void visWindow_GetWindowSize(int *width,
+                             int *height);
+
+/**
+ * The last left click that was not on an ImGui window, once. For picking, see Camera3D::GetCursorRay
+ * which takes it as it is with the viewport from visWindow_GetWindowSize
+ * \param x output, window coordinates from the left (not framebuffer pixels on HiDPI screens)
+ * \param y output, window coordinates down from the top
+ * \return false if there has been no click since the last call
+ */
+bool visWindow_TakeClick(double *x,
+                         double *y);
+
+/**
+ * Read back the last frame rendered offscreen (after visWindow_EndFrame), waits for the gpu to
+ * finish it. Headless only, a window's back buffer is gone once it has been swapped
+ * \param rgba width * height * 4 bytes, rows from the bottom of the image up
+ * \return false if not headless
+ */
+bool visWindow_ReadPixels(uint8_t *rgba);
 #endif
\ No newline at end of file
@@ -0,0 +1,7 @@
+/* Camera matrices shared by every program, one uniform buffer updated by vis_PushCamera and
+ * vis_PushProjection. Must match CameraBlock in src/vis.c */
+layout (std140) uniform Camera {
+  mat4 view;
+  mat4 projection;
+  mat4 view_projection;
+};
@@ -0,0 +1,24 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+/* Per instance (robot) attributes */
+layout (location = 1) in vec3 aPose;
+layout (location = 2) in vec3 aSize;
+layout (location = 3) in vec4 aColor;
+#include "camera_block.glsl"
+
+out vec4 vertexColor;
+void main()
+{
+  /* Same model transform as a single robot, scale the unit cube by (width, length, height), rotate
+   * by the heading and translate so the robot sits on the ground (z = 0).
+   * The rotation is 90 - heading so the heading is measured from the Y axis (north), which makes
+   * cos(90 - heading) = sin(heading) and sin(90 - heading) = cos(heading) */
+  vec3 scaled = aPos * vec3(aSize.y, aSize.x, aSize.z);
+  float c = sin(aPose.z);
+  float s = cos(aPose.z);
+  vec3 world = vec3(c * scaled.x - s * scaled.y + aPose.x,
+                    s * scaled.x + c * scaled.y + aPose.y,
+                    scaled.z + 0.5 * aSize.z);
+  vertexColor = aColor;
+  gl_Position = view_projection * vec4(world, 1.0);
+}
@@ -0,0 +1,54 @@
+#version 330 core
+#include "camera_block.glsl"
+uniform vec4 color;
+/* Spacing of the finest grid lines in metres */
+uniform float spacing;
+
+in vec3 nearPoint;
+in vec3 farPoint;
+out vec4 FragColor;
+
+/* Roughly how many pixels apart grid lines can get before switching to the next level */
+const float MIN_PIXELS_BETWEEN_LINES = 8.0;
+
+/* 1 on a grid line and fading to 0 over about a pixel either side of it */
+float GridLines(vec2 position, float lineSpacing)
+{
+   vec2 coord = position / lineSpacing;
+   vec2 derivative = fwidth(coord);
+   vec2 grid = abs(fract(coord - 0.5) - 0.5) / derivative;
+   return 1.0 - min(min(grid.x, grid.y), 1.0);
+}
+
+void main()
+{
+   /* Intersect the view ray with the ground plane (z = 0) */
+   float t = -nearPoint.z / (farPoint.z - nearPoint.z);
+   if (t <= 0.0) {
+      discard;
+   }
+   vec3 position = nearPoint + t * (farPoint - nearPoint);
+
+   vec4 clip = view_projection * vec4(position, 1.0);
+   gl_FragDepth = 0.5 * (clip.z / clip.w) + 0.5;
+
+   /* Pick the spacing from how much ground a pixel covers here. Spacings go up in powers of 10,
+    * and the finer level fades out as it approaches the switch over point */
+   vec2 derivative = fwidth(position.xy);
+   float pixel_size = max(length(derivative), 1.0e-6);
+   float level = max(log(pixel_size * MIN_PIXELS_BETWEEN_LINES / spacing) / log(10.0), 0.0);
+   float fine_spacing = spacing * pow(10.0, floor(level));
+   float fade = fract(level);
+
+   float fine = GridLines(position.xy, fine_spacing) * (1.0 - fade);
+   float coarse = GridLines(position.xy, fine_spacing * 10.0);
+   float alpha = max(fine, coarse);
+
+   /* Fade out towards the horizon where the grid would alias */
+   float view_angle_fade = clamp(abs(normalize(farPoint - nearPoint).z) * 4.0, 0.0, 1.0);
+
+   FragColor = vec4(color.rgb, color.a * alpha * view_angle_fade);
+   if (FragColor.a <= 0.0) {
+      discard;
+   }
+}
@@ -0,0 +1,24 @@
+#version 330 core
+#include "camera_block.glsl"
+
+out vec3 nearPoint;
+out vec3 farPoint;
+
+/* Full screen quad as a triangle strip, generated from the vertex id so no vertex buffer is needed */
+const vec2 corners[4] = vec2[](vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(-1.0, 1.0), vec2(1.0, 1.0));
+
+vec3 Unproject(vec2 ndc, float depth, mat4 inverseViewProjection)
+{
+   vec4 world = inverseViewProjection * vec4(ndc, depth, 1.0);
+   return world.xyz / world.w;
+}
+
+void main()
+{
+   vec2 ndc = corners[gl_VertexID];
+   mat4 inverse_view_projection = inverse(view_projection);
+   /* The ray through this corner of the screen, from the near plane to the far plane */
+   nearPoint = Unproject(ndc, -1.0, inverse_view_projection);
+   farPoint = Unproject(ndc, 1.0, inverse_view_projection);
+   gl_Position = vec4(ndc, 0.0, 1.0);
+}
@@ -1,13 +1,12 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "camera_block.glsl"
 uniform vec4 color;
 
 out vec4 vertexColor;
 void main()
 {
   vertexColor = color;
-  gl_Position = projection * view * model * vec4(aPos.x, aPos.y, aPos.z, 1.0);
+  gl_Position = view_projection * model * vec4(aPos.x, aPos.y, aPos.z, 1.0);
 }
\ No newline at end of file
@@ -1,18 +1,29 @@
 #include "cvis/camera3d.h"
+#include "cvis/mat4.h"
 #include <cmath>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 
 static constexpr float EPS = 1.0e-5f;
 
-vis::Camera3D::Camera3D() : position_(0, 0, 0),
+vis::Camera3D::Camera3D() : rotation_dirty_(false),
+                            view_dirty_(false),
+                            view_projection_dirty_(true),
+                            position_(0, 0, 0),
                             target_(0, 0, 0),
                             up_direction_(0, 1, 0),
+                            viewport_{0.0f, 0.0f, 1.0f, 1.0f},
                             distance_to_target_(0),
                             field_of_view_(45) {
 
   // Initialize to identity in case forget to set any of the parameters we dont get
   // a zero matrix (no drawing/rendering will no happen)
   view_.setIdentity();
+  inverse_view_.setIdentity();
+  projection_.setIdentity();
+  inverse_projection_.setIdentity();
   rotation_.setIdentity();
 }
 
@@ -27,17 +38,10 @@ void vis::Camera3D::SetPosition(float x,
 }
 
 void vis::Camera3D::SetTargetPosition(const Eigen::Vector3f &newTarget) {
+  // The camera keeps its distance to the target and orientation, so the position moves with the
+  // target. It is worked out with the view matrix
   target_ = newTarget;
-
-  // When we change the target position we want to matain the same distance to target and
-  // orientation of the camera so we need to move the camera positions in the direction
-  // of new current forward/direction vector
-  Eigen::Vector3f forward(-view_(2), -view_(6), -view_(10));
-  position_.x() = target_.x() - distance_to_target_ * forward.x();
-  position_.y() = target_.y() - distance_to_target_ * forward.y();
-  position_.z() = target_.z() - distance_to_target_ * forward.z();
-
-  ComputeMatrix();
+  view_dirty_ = true;
 }
 
 void vis::Camera3D::SetTargetPosition(float x,
@@ -62,15 +66,345 @@ void vis::Camera3D::RotateByIncrement(float x,
 
 void vis::Camera3D::SetOrientationAngles(const Eigen::Vector3f &newAngles) {
   orientation_angles_ = newAngles;
+  rotation_dirty_ = true;
+  view_dirty_ = true;
+}
+
+void vis::Camera3D::SetOrientationAngles(float x,
+                                         float y,
+                                         float z) {
+  SetOrientationAngles(Eigen::Vector3f(x, y, z));
+}
+
+void vis::Camera3D::SetPerspective(float fieldOfView,
+                                   float aspectRatio,
+                                   float nearPlane,
+                                   float farPlane) {
+  field_of_view_ = fieldOfView;
+  Eigen::Matrix4f projection;
+  visMat4_Perspective(fieldOfView, aspectRatio, nearPlane, farPlane, projection.data());
+  SetProjectionMatrix(projection);
+}
+
+void vis::Camera3D::SetProjectionMatrix(const Eigen::Matrix4f &projection) {
+  projection_ = projection;
+  // Only changes with the window size or field of view, cheaper to invert here than every time
+  // the view moves
+  if (!visMat4_Inverse(projection.data(), inverse_projection_.data())) {
+    inverse_projection_.setIdentity();
+  }
+  view_projection_dirty_ = true;
+}
+
+const Eigen::Matrix4f &vis::Camera3D::GetViewMatrix() const {
+  Update();
+  return view_;
+}
+
+const Eigen::Matrix4f &vis::Camera3D::GetProjectionMatrix() const {
+  return projection_;
+}
+
+const Eigen::Matrix4f &vis::Camera3D::GetViewProjectionMatrix() const {
+  Update();
+  return view_projection_;
+}
+
+const Eigen::Matrix4f &vis::Camera3D::GetInverseViewMatrix() const {
+  Update();
+  return inverse_view_;
+}
+
+const Eigen::Matrix4f &vis::Camera3D::GetInverseViewProjectionMatrix() const {
+  Update();
+  return inverse_view_projection_;
+}
+
+const vis::Camera3D::FrustumPlanes &vis::Camera3D::GetFrustumPlanes() const {
+  Update();
+  return frustum_planes_;
+}
+
+const Eigen::Vector3f &vis::Camera3D::GetPosition() const {
+  Update();
+  return position_;
+}
+
+void vis::Camera3D::SetViewport(float x,
+                                float y,
+                                float width,
+                                float height) {
+  viewport_ = {x, y, width, height};
+}
+
+const vis::Camera3D::Viewport &vis::Camera3D::GetViewport() const {
+  return viewport_;
+}
+
+namespace {
+
+// Clip space to pixels: pixel = centre + ndc * half size, y flipped so it runs down the screen
+struct ScreenTransform {
+  const float *m;
+  float centre_x;
+  float centre_y;
+  float half_width;
+  float half_height;
+};
+
+}
+
+static ScreenTransform MakeScreenTransform(const Eigen::Matrix4f &viewProjection,
+                                           const vis::Camera3D::Viewport &viewport) {
+  ScreenTransform transform;
+  transform.m = viewProjection.data();
+  transform.half_width = 0.5f * viewport.width;
+  transform.half_height = 0.5f * viewport.height;
+  transform.centre_x = viewport.x + transform.half_width;
+  transform.centre_y = viewport.y + transform.half_height;
+  return transform;
+}
+
+static bool ProjectPoint(const ScreenTransform &transform,
+                         float x,
+                         float y,
+                         float z,
+                         float *pixelX,
+                         float *pixelY,
+                         float *depth) {
+  const float *m = transform.m;
+  const float clip_x = m[0] * x + m[4] * y + m[8] * z + m[12];
+  const float clip_y = m[1] * x + m[5] * y + m[9] * z + m[13];
+  const float clip_z = m[2] * x + m[6] * y + m[10] * z + m[14];
+  const float clip_w = m[3] * x + m[7] * y + m[11] * z + m[15];
+  const float inverse_w = 1.0f / clip_w;
+  *pixelX = transform.centre_x + clip_x * inverse_w * transform.half_width;
+  *pixelY = transform.centre_y - clip_y * inverse_w * transform.half_height;
+  *depth = 0.5f + 0.5f * clip_z * inverse_w;
+  return clip_w > 0.0f && std::fabs(clip_x) <= clip_w && std::fabs(clip_y) <= clip_w &&
+         std::fabs(clip_z) <= clip_w;
+}
+
+#if defined(__SSE2__)
+// ProjectPoint for four points, returns the on screen mask as 4 bits
+static int ProjectPoints4(const ScreenTransform &transform,
+                          __m128 x,
+                          __m128 y,
+                          __m128 z,
+                          __m128 *pixelX,
+                          __m128 *pixelY,
+                          __m128 *depth) {
+  const float *m = transform.m;
+  const __m128 clip_x = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0]), x),
+                                              _mm_mul_ps(_mm_set1_ps(m[4]), y)),
+                                   _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[8]), z), _mm_set1_ps(m[12])));
+  const __m128 clip_y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[1]), x),
+                                              _mm_mul_ps(_mm_set1_ps(m[5]), y)),
+                                   _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[9]), z), _mm_set1_ps(m[13])));
+  const __m128 clip_z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[2]), x),
+                                              _mm_mul_ps(_mm_set1_ps(m[6]), y)),
+                                   _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[10]), z), _mm_set1_ps(m[14])));
+  const __m128 clip_w = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[3]), x),
+                                              _mm_mul_ps(_mm_set1_ps(m[7]), y)),
+                                   _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[11]), z), _mm_set1_ps(m[15])));
+  const __m128 inverse_w = _mm_div_ps(_mm_set1_ps(1.0f), clip_w);
+  *pixelX = _mm_add_ps(_mm_set1_ps(transform.centre_x),
+                       _mm_mul_ps(_mm_mul_ps(clip_x, inverse_w), _mm_set1_ps(transform.half_width)));
+  *pixelY = _mm_sub_ps(_mm_set1_ps(transform.centre_y),
+                       _mm_mul_ps(_mm_mul_ps(clip_y, inverse_w), _mm_set1_ps(transform.half_height)));
+  *depth = _mm_add_ps(_mm_set1_ps(0.5f), _mm_mul_ps(_mm_set1_ps(0.5f), _mm_mul_ps(clip_z, inverse_w)));
+
+  // |a| <= w by clearing the sign bit
+  const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  __m128 inside = _mm_cmpgt_ps(clip_w, _mm_setzero_ps());
+  inside = _mm_and_ps(inside, _mm_cmple_ps(_mm_and_ps(clip_x, abs_mask), clip_w));
+  inside = _mm_and_ps(inside, _mm_cmple_ps(_mm_and_ps(clip_y, abs_mask), clip_w));
+  inside = _mm_and_ps(inside, _mm_cmple_ps(_mm_and_ps(clip_z, abs_mask), clip_w));
+  return _mm_movemask_ps(inside);
+}
+
+// Write the 4 bit mask from ProjectPoints4 as bytes, returns how many are set
+static size_t StoreMask4(int mask,
+                         uint8_t *onScreen) {
+  if (onScreen != nullptr) {
+    onScreen[0] = (uint8_t)(mask & 1);
+    onScreen[1] = (uint8_t)((mask >> 1) & 1);
+    onScreen[2] = (uint8_t)((mask >> 2) & 1);
+    onScreen[3] = (uint8_t)((mask >> 3) & 1);
+  }
+  return (size_t)((mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1));
+}
+#endif
+
+size_t vis::Camera3D::ProjectToScreen(const float *x,
+                                      const float *y,
+                                      const float *z,
+                                      size_t count,
+                                      float *pixelX,
+                                      float *pixelY,
+                                      float *depth,
+                                      uint8_t *onScreen) const {
+  const ScreenTransform transform = MakeScreenTransform(GetViewProjectionMatrix(), viewport_);
+  size_t num_on_screen = 0;
+  size_t i = 0;
+#if defined(__SSE2__)
+  for (; i + 4 <= count; i += 4) {
+    __m128 pixel_x;
+    __m128 pixel_y;
+    __m128 point_depth;
+    const int mask = ProjectPoints4(transform,
+                                    _mm_loadu_ps(x + i),
+                                    _mm_loadu_ps(y + i),
+                                    _mm_loadu_ps(z + i),
+                                    &pixel_x,
+                                    &pixel_y,
+                                    &point_depth);
+    _mm_storeu_ps(pixelX + i, pixel_x);
+    _mm_storeu_ps(pixelY + i, pixel_y);
+    if (depth != nullptr) {
+      _mm_storeu_ps(depth + i, point_depth);
+    }
+    num_on_screen += StoreMask4(mask, onScreen != nullptr ? onScreen + i : nullptr);
+  }
+#endif
+  for (; i < count; i++) {
+    float point_depth;
+    const bool on_screen = ProjectPoint(transform, x[i], y[i], z[i], &pixelX[i], &pixelY[i], &point_depth);
+    if (depth != nullptr) {
+      depth[i] = point_depth;
+    }
+    if (onScreen != nullptr) {
+      onScreen[i] = on_screen ? 1 : 0;
+    }
+    num_on_screen += on_screen ? 1 : 0;
+  }
+  return num_on_screen;
+}
+
+size_t vis::Camera3D::ProjectToScreen(const float *xyz,
+                                      size_t count,
+                                      float *pixelXY,
+                                      float *depth,
+                                      uint8_t *onScreen) const {
+  const ScreenTransform transform = MakeScreenTransform(GetViewProjectionMatrix(), viewport_);
+  size_t num_on_screen = 0;
+  size_t i = 0;
+#if defined(__SSE2__)
+  for (; i + 4 <= count; i += 4) {
+    // Four packed points are three registers, x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+    const __m128 a = _mm_loadu_ps(xyz + 3 * i);
+    const __m128 b = _mm_loadu_ps(xyz + 3 * i + 4);
+    const __m128 c = _mm_loadu_ps(xyz + 3 * i + 8);
+    const __m128 b2_b3_c0_c1 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 0, 3, 2));
+    const __m128 x = _mm_shuffle_ps(a, b2_b3_c0_c1, _MM_SHUFFLE(3, 0, 3, 0));
+    const __m128 y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+                                    _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)),
+                                    _MM_SHUFFLE(2, 0, 2, 0));
+    const __m128 z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)),
+                                    _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)),
+                                    _MM_SHUFFLE(2, 0, 2, 0));
+    __m128 pixel_x;
+    __m128 pixel_y;
+    __m128 point_depth;
+    const int mask = ProjectPoints4(transform, x, y, z, &pixel_x, &pixel_y, &point_depth);
+    _mm_storeu_ps(pixelXY + 2 * i, _mm_unpacklo_ps(pixel_x, pixel_y));
+    _mm_storeu_ps(pixelXY + 2 * i + 4, _mm_unpackhi_ps(pixel_x, pixel_y));
+    if (depth != nullptr) {
+      _mm_storeu_ps(depth + i, point_depth);
+    }
+    num_on_screen += StoreMask4(mask, onScreen != nullptr ? onScreen + i : nullptr);
+  }
+#endif
+  for (; i < count; i++) {
+    float point_depth;
+    const bool on_screen = ProjectPoint(transform,
+                                        xyz[3 * i],
+                                        xyz[3 * i + 1],
+                                        xyz[3 * i + 2],
+                                        &pixelXY[2 * i],
+                                        &pixelXY[2 * i + 1],
+                                        &point_depth);
+    if (depth != nullptr) {
+      depth[i] = point_depth;
+    }
+    if (onScreen != nullptr) {
+      onScreen[i] = on_screen ? 1 : 0;
+    }
+    num_on_screen += on_screen ? 1 : 0;
+  }
+  return num_on_screen;
+}
+
+void vis::Camera3D::GetCursorRay(float cursorX,
+                                 float cursorY,
+                                 Eigen::Vector3f *origin,
+                                 Eigen::Vector3f *direction) const {
+  // The pixel on the near and far planes in clip space, back to the world
+  const float ndc_x = 2.0f * (cursorX - viewport_.x) / viewport_.width - 1.0f;
+  const float ndc_y = 1.0f - 2.0f * (cursorY - viewport_.y) / viewport_.height;
+  const Eigen::Matrix4f &inverse = GetInverseViewProjectionMatrix();
+  const Eigen::Vector4f near_point = inverse * Eigen::Vector4f(ndc_x, ndc_y, -1.0f, 1.0f);
+  const Eigen::Vector4f far_point = inverse * Eigen::Vector4f(ndc_x, ndc_y, 1.0f, 1.0f);
+  *origin = near_point.head<3>() / near_point.w();
+  *direction = (far_point.head<3>() / far_point.w() - *origin).normalized();
+}
+
+void vis::Camera3D::Update() const {
+  if (rotation_dirty_) {
+    ComputeRotation();
+    rotation_dirty_ = false;
+  }
+  if (view_dirty_) {
+    ComputeMatrix();
+    view_dirty_ = false;
+    view_projection_dirty_ = true;
+  }
+  if (!view_projection_dirty_) {
+    return;
+  }
+  view_projection_dirty_ = false;
+
+  // The view is a rotation and translation, its inverse is the transposed rotation and the
+  // translation rotated back
+  const Eigen::Matrix3f rotation_transpose = view_.topLeftCorner<3, 3>().transpose();
+  inverse_view_.setIdentity();
+  inverse_view_.topLeftCorner<3, 3>() = rotation_transpose;
+  inverse_view_.block<3, 1>(0, 3) = -rotation_transpose * view_.block<3, 1>(0, 3);
+
+  visMat4_Multiply(projection_.data(), view_.data(), view_projection_.data());
+  visMat4_Multiply(inverse_view_.data(), inverse_projection_.data(), inverse_view_projection_.data());
+
+  // Gribb and Hartmann, a point is inside when -w <= x, y, z <= w in clip space. Each plane is
+  // the last row of the view projection plus or minus one of the others
+  const Eigen::Vector4f row_x = view_projection_.row(0).transpose();
+  const Eigen::Vector4f row_y = view_projection_.row(1).transpose();
+  const Eigen::Vector4f row_z = view_projection_.row(2).transpose();
+  const Eigen::Vector4f row_w = view_projection_.row(3).transpose();
+  frustum_planes_[LEFT_PLANE] = row_w + row_x;
+  frustum_planes_[RIGHT_PLANE] = row_w - row_x;
+  frustum_planes_[BOTTOM_PLANE] = row_w + row_y;
+  frustum_planes_[TOP_PLANE] = row_w - row_y;
+  frustum_planes_[NEAR_PLANE] = row_w + row_z;
+  frustum_planes_[FAR_PLANE] = row_w - row_z;
+  for (Eigen::Vector4f &plane : frustum_planes_) {
+    const float length = plane.head<3>().norm();
+    if (length > EPS) {
+      plane /= length;
+    }
+  }
+}
+
+void vis::Camera3D::ComputeRotation() const {
   rotation_.setIdentity();
 
   /* Convert euler to rotation matrix */
-  const float sx = sinf(newAngles.x() * M_PI / 180.0f);
-  const float cx = cosf(newAngles.x() * M_PI / 180.0f);
-  const float sy = sinf(-newAngles.y() * M_PI / 180.0f);
-  const float cy = cosf(-newAngles.y() * M_PI / 180.0f);
-  const float sz = sinf(newAngles.z() * M_PI / 180.0f);
-  const float cz = cosf(newAngles.z() * M_PI / 180.0f);
+  const Eigen::Vector3f &angles = orientation_angles_;
+  const float sx = sinf(angles.x() * M_PI / 180.0f);
+  const float cx = cosf(angles.x() * M_PI / 180.0f);
+  const float sy = sinf(-angles.y() * M_PI / 180.0f);
+  const float cy = cosf(-angles.y() * M_PI / 180.0f);
+  const float sz = sinf(angles.z() * M_PI / 180.0f);
+  const float cz = cosf(angles.z() * M_PI / 180.0f);
 
   rotation_(0) = cy * cz;
   rotation_(1) = sx * sy * cz + cx * sz;
@@ -83,21 +417,10 @@ void vis::Camera3D::SetOrientationAngles(const Eigen::Vector3f &newAngles) {
   rotation_(8) = sy;
   rotation_(9) = -sx * cy;
   rotation_(10) = cx * cy;
-
-  ComputeMatrix();
-}
-
-void vis::Camera3D::SetOrientationAngles(float x,
-                                         float y,
-                                         float z) {
-  SetOrientationAngles(Eigen::Vector3f(x, y, z));
-}
-
-const Eigen::Matrix4f vis::Camera3D::GetViewMatrix() const {
-  return view_;
 }
 
 void vis::Camera3D::UpdateViewMatrix() {
+  view_projection_dirty_ = true;
   // Make sure we reset any entries, dont want to carry forward any off
   // diagonal elements for example
   view_.setZero();
@@ -216,7 +539,7 @@ void vis::Camera3D::UpdateOrientationAngles() {
   orientation_angles_ = Eigen::Vector3f(pitch, -yaw, roll);
 }
 
-void vis::Camera3D::ComputeMatrix() {
+void vis::Camera3D::ComputeMatrix() const {
   Eigen::Vector3f right(rotation_(0), rotation_(1), rotation_(2));
   Eigen::Vector3f up(rotation_(4), rotation_(5), rotation_(6));
   Eigen::Vector3f forward(rotation_(8), rotation_(9), rotation_(10));
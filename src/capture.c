@@ -0,0 +1,318 @@
+#include "cvis/capture.h"
+#include "glad/glad.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* How long visCapture_Stop waits for each frame still in flight, nanoseconds */
+#define CAPTURE_STOP_TIMEOUT 1000000000ull
+
+typedef struct {
+  GLuint pbo;
+  GLsync fence;
+} Slot;
+
+static bool active_ = false;
+static visCaptureFormat format_;
+static FILE *file_ = NULL;
+static int width_ = 0;
+static int height_ = 0;
+static size_t frame_bytes_ = 0;
+static visCaptureStats stats_;
+
+/* Pixel buffers, the ones in flight are num_in_flight_ consecutive slots starting at oldest_ */
+static Slot ring_[VIS_CAPTURE_RING_SIZE];
+static uint32_t oldest_ = 0;
+static uint32_t num_in_flight_ = 0;
+
+/* Frame copies handed to the writer. Indices move between the free stack and the pending queue,
+ * both guarded by mutex_ */
+static uint8_t *frames_[VIS_CAPTURE_MAX_QUEUED];
+static uint32_t free_frames_[VIS_CAPTURE_MAX_QUEUED];
+static uint32_t num_free_ = 0;
+static uint32_t pending_[VIS_CAPTURE_MAX_QUEUED];
+static uint32_t pending_first_ = 0;
+static uint32_t num_pending_ = 0;
+static bool stopping_ = false;
+static pthread_mutex_t mutex_ = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t frame_ready_ = PTHREAD_COND_INITIALIZER;
+static pthread_t writer_;
+
+/* Only touched by the writer thread: a top-down row for raw frames, the planes for Y4M */
+static uint8_t *conversion_ = NULL;
+
+static uint8_t ClampByte(int value) {
+  return (uint8_t)(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+void visCapture_RgbaToYuv420(const uint8_t *rgba,
+                             int width,
+                             int height,
+                             uint8_t *y,
+                             uint8_t *u,
+                             uint8_t *v) {
+  /* Full range BT.601 in 8.8 fixed point. The chroma offset is folded in so the sums stay
+   * positive and the shifts are plain divisions */
+  for (int row = 0; row < height; row++) {
+    const uint8_t *source = &rgba[(size_t)(height - 1 - row) * width * 4];
+    uint8_t *destination = &y[(size_t)row * width];
+    for (int x = 0; x < width; x++) {
+      const int r = source[4 * x];
+      const int g = source[4 * x + 1];
+      const int b = source[4 * x + 2];
+      destination[x] = (uint8_t)((77 * r + 150 * g + 29 * b + 128) >> 8);
+    }
+  }
+
+  const int chroma_width = (width + 1) / 2;
+  const int chroma_height = (height + 1) / 2;
+  for (int row = 0; row < chroma_height; row++) {
+    const int top = 2 * row;
+    const int bottom = top + 1 < height ? top + 1 : top;
+    const uint8_t *source_top = &rgba[(size_t)(height - 1 - top) * width * 4];
+    const uint8_t *source_bottom = &rgba[(size_t)(height - 1 - bottom) * width * 4];
+    for (int x = 0; x < chroma_width; x++) {
+      const int left = 2 * x;
+      const int right = left + 1 < width ? left + 1 : left;
+      const int r = source_top[4 * left] + source_top[4 * right] + source_bottom[4 * left] + source_bottom[4 * right];
+      const int g = source_top[4 * left + 1] + source_top[4 * right + 1] + source_bottom[4 * left + 1] + source_bottom[4 * right + 1];
+      const int b = source_top[4 * left + 2] + source_top[4 * right + 2] + source_bottom[4 * left + 2] + source_bottom[4 * right + 2];
+      /* r, g, b are 4x the average, so 10 bits of shift instead of 8 */
+      u[(size_t)row * chroma_width + x] = ClampByte((-43 * r - 85 * g + 128 * b + (128 << 10) + 512) >> 10);
+      v[(size_t)row * chroma_width + x] = ClampByte((128 * r - 107 * g - 21 * b + (128 << 10) + 512) >> 10);
+    }
+  }
+}
+
+static void WriteFrame(const uint8_t *rgba) {
+  if (format_ == visCaptureFormat_Raw) {
+    /* OpenGL rows start at the bottom */
+    for (int row = height_ - 1; row >= 0; row--) {
+      fwrite(&rgba[(size_t)row * width_ * 4], 4, (size_t)width_, file_);
+    }
+    return;
+  }
+  const size_t luma_bytes = (size_t)width_ * height_;
+  const size_t chroma_bytes = (size_t)((width_ + 1) / 2) * ((height_ + 1) / 2);
+  uint8_t *y = conversion_;
+  uint8_t *u = y + luma_bytes;
+  uint8_t *v = u + chroma_bytes;
+  visCapture_RgbaToYuv420(rgba, width_, height_, y, u, v);
+  fputs("FRAME\n", file_);
+  fwrite(conversion_, 1, luma_bytes + 2 * chroma_bytes, file_);
+}
+
+static void *WriterThread(void *arg) {
+  (void)arg;
+  for (;;) {
+    pthread_mutex_lock(&mutex_);
+    while (num_pending_ == 0 && !stopping_) {
+      pthread_cond_wait(&frame_ready_, &mutex_);
+    }
+    if (num_pending_ == 0) {
+      /* Stopping and nothing left */
+      pthread_mutex_unlock(&mutex_);
+      return NULL;
+    }
+    const uint32_t frame = pending_[pending_first_];
+    pending_first_ = (pending_first_ + 1) % VIS_CAPTURE_MAX_QUEUED;
+    num_pending_ -= 1;
+    pthread_mutex_unlock(&mutex_);
+
+    /* The file work happens outside the lock, the render thread only ever waits for the queue */
+    WriteFrame(frames_[frame]);
+
+    pthread_mutex_lock(&mutex_);
+    free_frames_[num_free_] = frame;
+    num_free_ += 1;
+    stats_.written += 1;
+    pthread_mutex_unlock(&mutex_);
+  }
+}
+
+/* Hand the frame in a completed pixel buffer to the writer */
+static void QueueFrame(Slot *slot) {
+  pthread_mutex_lock(&mutex_);
+  if (num_free_ == 0) {
+    pthread_mutex_unlock(&mutex_);
+    stats_.dropped_writer += 1;
+    return;
+  }
+  num_free_ -= 1;
+  const uint32_t frame = free_frames_[num_free_];
+  pthread_mutex_unlock(&mutex_);
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+  const void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)frame_bytes_, GL_MAP_READ_BIT);
+  if (pixels) {
+    memcpy(frames_[frame], pixels, frame_bytes_);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  pthread_mutex_lock(&mutex_);
+  if (pixels) {
+    pending_[(pending_first_ + num_pending_) % VIS_CAPTURE_MAX_QUEUED] = frame;
+    num_pending_ += 1;
+    stats_.captured += 1;
+    pthread_cond_signal(&frame_ready_);
+  }
+  else {
+    free_frames_[num_free_] = frame;
+    num_free_ += 1;
+  }
+  pthread_mutex_unlock(&mutex_);
+}
+
+/* Pass on every frame whose read back has finished, oldest first. Without wait this never blocks,
+ * it stops at the first fence that hasn't signalled */
+static void CollectFrames(bool wait) {
+  while (num_in_flight_ > 0) {
+    Slot *slot = &ring_[oldest_];
+    const GLenum status = wait ? glClientWaitSync(slot->fence, GL_SYNC_FLUSH_COMMANDS_BIT, CAPTURE_STOP_TIMEOUT)
+                               : glClientWaitSync(slot->fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED && !wait) {
+      return;
+    }
+    glDeleteSync(slot->fence);
+    slot->fence = NULL;
+    if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+      QueueFrame(slot);
+    }
+    oldest_ = (oldest_ + 1) % VIS_CAPTURE_RING_SIZE;
+    num_in_flight_ -= 1;
+  }
+}
+
+static void FreeBuffers() {
+  for (uint32_t i = 0; i < VIS_CAPTURE_MAX_QUEUED; i++) {
+    free(frames_[i]);
+    frames_[i] = NULL;
+  }
+  free(conversion_);
+  conversion_ = NULL;
+  for (uint32_t i = 0; i < VIS_CAPTURE_RING_SIZE; i++) {
+    if (ring_[i].pbo != 0) {
+      glDeleteBuffers(1, &ring_[i].pbo);
+      ring_[i].pbo = 0;
+    }
+  }
+}
+
+bool visCapture_Start(const char *path,
+                      int width,
+                      int height,
+                      visCaptureFormat format,
+                      int fps) {
+  if (active_) {
+    printf("ERROR (Capture): Already capturing\n");
+    return false;
+  }
+  if (width <= 0 || height <= 0) {
+    printf("ERROR (Capture): No framebuffer to capture\n");
+    return false;
+  }
+  width_ = width;
+  height_ = height;
+  format_ = format;
+  frame_bytes_ = (size_t)width_ * height_ * 4;
+
+  bool allocated = true;
+  for (uint32_t i = 0; i < VIS_CAPTURE_MAX_QUEUED; i++) {
+    frames_[i] = (uint8_t *)malloc(frame_bytes_);
+    allocated = allocated && frames_[i];
+    free_frames_[i] = i;
+  }
+  /* Big enough for the Y4M planes, which are always bigger than a raw row */
+  conversion_ = (uint8_t *)malloc((size_t)width_ * height_ + 2 * (size_t)((width_ + 1) / 2) * ((height_ + 1) / 2));
+  if (!allocated || !conversion_) {
+    printf("ERROR (Capture): Could not allocate frame buffers\n");
+    FreeBuffers();
+    return false;
+  }
+
+  file_ = fopen(path, "wb");
+  if (!file_) {
+    printf("ERROR (Capture): Could not open %s\n", path);
+    FreeBuffers();
+    return false;
+  }
+  if (format_ == visCaptureFormat_Y4m) {
+    /* The conversion is full range, which players assume is limited without the tag */
+    fprintf(file_, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg XCOLORRANGE=FULL\n", width_, height_, fps > 0 ? fps : 60);
+  }
+
+  for (uint32_t i = 0; i < VIS_CAPTURE_RING_SIZE; i++) {
+    glGenBuffers(1, &ring_[i].pbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, ring_[i].pbo);
+    glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)frame_bytes_, NULL, GL_STREAM_READ);
+    ring_[i].fence = NULL;
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  memset(&stats_, 0, sizeof(stats_));
+  oldest_ = 0;
+  num_in_flight_ = 0;
+  num_free_ = VIS_CAPTURE_MAX_QUEUED;
+  pending_first_ = 0;
+  num_pending_ = 0;
+  stopping_ = false;
+  if (pthread_create(&writer_, NULL, WriterThread, NULL) != 0) {
+    printf("ERROR (Capture): Could not start the writer thread\n");
+    fclose(file_);
+    file_ = NULL;
+    FreeBuffers();
+    return false;
+  }
+  active_ = true;
+  return true;
+}
+
+void visCapture_Stop() {
+  if (!active_) {
+    return;
+  }
+  CollectFrames(true);
+
+  pthread_mutex_lock(&mutex_);
+  stopping_ = true;
+  pthread_cond_signal(&frame_ready_);
+  pthread_mutex_unlock(&mutex_);
+  pthread_join(writer_, NULL);
+
+  fclose(file_);
+  file_ = NULL;
+  FreeBuffers();
+  active_ = false;
+}
+
+bool visCapture_IsActive() {
+  return active_;
+}
+
+void visCapture_Frame() {
+  if (!active_) {
+    return;
+  }
+  CollectFrames(false);
+  if (num_in_flight_ == VIS_CAPTURE_RING_SIZE) {
+    stats_.dropped_gpu += 1;
+    return;
+  }
+
+  Slot *slot = &ring_[(oldest_ + num_in_flight_) % VIS_CAPTURE_RING_SIZE];
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+  /* Into the bound pixel buffer, so this only queues the copy */
+  glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  num_in_flight_ += 1;
+}
+
+visCaptureStats visCapture_GetStats() {
+  pthread_mutex_lock(&mutex_);
+  visCaptureStats stats = stats_;
+  pthread_mutex_unlock(&mutex_);
+  return stats;
+}
@@ -0,0 +1,369 @@
+#include "cvis/culling.h"
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static bool enabled_ = true;
+/* Frustum of the last pushed camera */
+static visFrustum camera_frustum_;
+/* Handed out when culling is off, see visFrustum_SetEverything */
+static const visFrustum everything_ = {{{0, 0, 0, 1}, {0, 0, 0, 1}, {0, 0, 0, 1},
+                                        {0, 0, 0, 1}, {0, 0, 0, 1}, {0, 0, 0, 1}}};
+static bool has_camera_ = false;
+static visCullCounts counts_[visCullLayer_Count];
+
+void visFrustum_FromViewProjection(visFrustum *frustum,
+                                   const float *viewProjection) {
+  /* Gribb and Hartmann, a point is inside when -w <= x, y, z <= w in clip space. Each plane is
+   * the last row plus or minus one of the others. Column major, row r is m[r], m[4 + r], ... */
+  const float *m = viewProjection;
+  for (int p = 0; p < VIS_FRUSTUM_NUM_PLANES; p++) {
+    const int row = p / 2;
+    const float sign = (p % 2) == 0 ? 1.0f : -1.0f;
+    float *plane = frustum->planes[p];
+    for (int column = 0; column < 4; column++) {
+      plane[column] = m[4 * column + 3] + sign * m[4 * column + row];
+    }
+    const float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+    if (length > 0.0f) {
+      for (int i = 0; i < 4; i++) {
+        plane[i] /= length;
+      }
+    }
+  }
+}
+
+void visFrustum_SetEverything(visFrustum *frustum) {
+  /* Zero normal and a positive distance, every point is 1 metre inside every plane */
+  memset(frustum, 0, sizeof(visFrustum));
+  for (int p = 0; p < VIS_FRUSTUM_NUM_PLANES; p++) {
+    frustum->planes[p][3] = 1.0f;
+  }
+}
+
+bool visFrustum_TestSphere(const visFrustum *frustum,
+                           float x,
+                           float y,
+                           float z,
+                           float radius) {
+  for (int p = 0; p < VIS_FRUSTUM_NUM_PLANES; p++) {
+    const float *plane = frustum->planes[p];
+    if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < -radius) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool visFrustum_TestAabb(const visFrustum *frustum,
+                         const visVec3 *min,
+                         const visVec3 *max) {
+  for (int p = 0; p < VIS_FRUSTUM_NUM_PLANES; p++) {
+    /* The corner furthest along the normal, if that is outside the whole box is */
+    const float *plane = frustum->planes[p];
+    const float x = plane[0] >= 0.0f ? max->x : min->x;
+    const float y = plane[1] >= 0.0f ? max->y : min->y;
+    const float z = plane[2] >= 0.0f ? max->z : min->z;
+    if (!(plane[0] * x + plane[1] * y + plane[2] * z + plane[3] >= 0.0f)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+float visFrustum_Depth(const visFrustum *frustum,
+                       float x,
+                       float y,
+                       float z) {
+  /* Distances inside the near and far planes, which are parallel, so they add up to the distance
+   * between them */
+  const float *near_plane = frustum->planes[4];
+  const float *far_plane = frustum->planes[5];
+  const float near_distance = near_plane[0] * x + near_plane[1] * y + near_plane[2] * z + near_plane[3];
+  const float far_distance = far_plane[0] * x + far_plane[1] * y + far_plane[2] * z + far_plane[3];
+  const float range = near_distance + far_distance;
+  if (!(range > 0.0f) || (near_plane[0] == 0.0f && near_plane[1] == 0.0f && near_plane[2] == 0.0f)) {
+    return 0.0f;
+  }
+  const float depth = near_distance / range;
+  return depth < 0.0f ? 0.0f : (depth > 1.0f ? 1.0f : depth);
+}
+
+uint32_t visFrustum_TestSpheres(const visFrustum *frustum,
+                                const float *x,
+                                const float *y,
+                                const float *z,
+                                const float *radius,
+                                uint32_t count,
+                                uint8_t *visible) {
+  uint32_t num_visible = 0;
+  uint32_t i = 0;
+#if defined(__SSE2__)
+  for (; i + 4 <= count; i += 4) {
+    const __m128 px = _mm_loadu_ps(&x[i]);
+    const __m128 py = _mm_loadu_ps(&y[i]);
+    const __m128 pz = _mm_loadu_ps(&z[i]);
+    const __m128 negative_radius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&radius[i]));
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (int p = 0; p < VIS_FRUSTUM_NUM_PLANES; p++) {
+      const float *plane = frustum->planes[p];
+      __m128 distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[0]), px), _mm_set1_ps(plane[3]));
+      distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane[1]), py));
+      distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane[2]), pz));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negative_radius));
+    }
+    const int mask = _mm_movemask_ps(inside);
+    for (int j = 0; j < 4; j++) {
+      visible[i + j] = (uint8_t)((mask >> j) & 1);
+      num_visible += visible[i + j];
+    }
+  }
+#endif
+  for (; i < count; i++) {
+    visible[i] = visFrustum_TestSphere(frustum, x[i], y[i], z[i], radius[i]) ? 1 : 0;
+    num_visible += visible[i];
+  }
+  return num_visible;
+}
+
+uint32_t visFrustum_TestAabbs(const visFrustum *frustum,
+                              const visAabbArray *boxes,
+                              uint8_t *visible) {
+  /* Which corner is furthest along a plane's normal only depends on the signs of the normal, so
+   * it is picked once per plane for all the boxes */
+  const float *corner[VIS_FRUSTUM_NUM_PLANES][3];
+  for (int p = 0; p < VIS_FRUSTUM_NUM_PLANES; p++) {
+    corner[p][0] = frustum->planes[p][0] >= 0.0f ? boxes->max_x : boxes->min_x;
+    corner[p][1] = frustum->planes[p][1] >= 0.0f ? boxes->max_y : boxes->min_y;
+    corner[p][2] = frustum->planes[p][2] >= 0.0f ? boxes->max_z : boxes->min_z;
+  }
+
+  uint32_t num_visible = 0;
+  uint32_t i = 0;
+#if defined(__SSE2__)
+  for (; i + 4 <= boxes->count; i += 4) {
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (int p = 0; p < VIS_FRUSTUM_NUM_PLANES; p++) {
+      const float *plane = frustum->planes[p];
+      __m128 distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[0]), _mm_loadu_ps(&corner[p][0][i])),
+                                   _mm_set1_ps(plane[3]));
+      distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane[1]), _mm_loadu_ps(&corner[p][1][i])));
+      distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane[2]), _mm_loadu_ps(&corner[p][2][i])));
+      /* Empty boxes give -inf or NaN, which fail the compare */
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+    }
+    const int mask = _mm_movemask_ps(inside);
+    for (int j = 0; j < 4; j++) {
+      visible[i + j] = (uint8_t)((mask >> j) & 1);
+      num_visible += visible[i + j];
+    }
+  }
+#endif
+  for (; i < boxes->count; i++) {
+    bool inside = true;
+    for (int p = 0; p < VIS_FRUSTUM_NUM_PLANES && inside; p++) {
+      const float *plane = frustum->planes[p];
+      const float distance = plane[0] * corner[p][0][i] + plane[1] * corner[p][1][i] +
+                             plane[2] * corner[p][2][i] + plane[3];
+      inside = distance >= 0.0f;
+    }
+    visible[i] = inside ? 1 : 0;
+    num_visible += visible[i];
+  }
+  return num_visible;
+}
+
+void visAabbArray_Init(visAabbArray *boxes) {
+  memset(boxes, 0, sizeof(visAabbArray));
+}
+
+void visAabbArray_Free(visAabbArray *boxes) {
+  free(boxes->min_x);
+  visAabbArray_Init(boxes);
+}
+
+bool visAabbArray_Reserve(visAabbArray *boxes,
+                          uint32_t capacity) {
+  if (capacity <= boxes->capacity) {
+    return true;
+  }
+  uint32_t new_capacity = boxes->capacity > 0 ? boxes->capacity : 16;
+  while (new_capacity < capacity) {
+    new_capacity *= 2;
+  }
+  /* One allocation holding the six arrays back to back */
+  float *data = (float *)malloc(6 * (size_t)new_capacity * sizeof(float));
+  if (!data) {
+    return false;
+  }
+  float *previous = boxes->min_x;
+  float **arrays[6] = {&boxes->min_x, &boxes->min_y, &boxes->min_z,
+                       &boxes->max_x, &boxes->max_y, &boxes->max_z};
+  for (int a = 0; a < 6; a++) {
+    float *array = data + (size_t)a * new_capacity;
+    if (boxes->count > 0) {
+      memcpy(array, *arrays[a], boxes->count * sizeof(float));
+    }
+    *arrays[a] = array;
+  }
+  free(previous);
+  boxes->capacity = new_capacity;
+  return true;
+}
+
+bool visAabbArray_Push(visAabbArray *boxes) {
+  if (boxes->count == boxes->capacity && !visAabbArray_Reserve(boxes, boxes->count + 1)) {
+    return false;
+  }
+  boxes->count += 1;
+  visAabbArray_Reset(boxes, boxes->count - 1);
+  return true;
+}
+
+void visAabbArray_Reset(visAabbArray *boxes,
+                        uint32_t index) {
+  boxes->min_x[index] = boxes->min_y[index] = boxes->min_z[index] = FLT_MAX;
+  boxes->max_x[index] = boxes->max_y[index] = boxes->max_z[index] = -FLT_MAX;
+}
+
+/* Chunks [first, end) has a visible one */
+static bool AnyVisible(const uint8_t *chunkVisible,
+                       uint32_t numChunks,
+                       uint32_t first,
+                       uint32_t end) {
+  if (end > numChunks) {
+    return true;
+  }
+  for (uint32_t c = first; c < end; c++) {
+    if (chunkVisible[c]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+uint32_t visCulling_ClipStrip(uint32_t first,
+                              uint32_t count,
+                              uint32_t shift,
+                              const uint8_t *chunkVisible,
+                              uint32_t numChunks,
+                              visCullRange *ranges,
+                              uint32_t maxRanges) {
+  if (count == 0 || maxRanges == 0) {
+    return 0;
+  }
+  if (count == 1) {
+    /* A single point, no segments */
+    const uint32_t chunk = (first << shift) >> VIS_CULL_CHUNK_SHIFT;
+    if (!AnyVisible(chunkVisible, numChunks, chunk, chunk + 1)) {
+      return 0;
+    }
+    ranges[0].first = first;
+    ranges[0].count = 1;
+    return 1;
+  }
+
+  uint32_t num_ranges = 0;
+  const uint32_t last = first + count - 1;
+  uint32_t v = first;
+  while (v < last) {
+    /* Segments [v, next) are covered by the same chunks. Fine strips step a chunk at a time, coarse
+     * ones a segment at a time, either way the loop runs once per chunk at most */
+    uint32_t next;
+    bool visible;
+    if (shift < VIS_CULL_CHUNK_SHIFT) {
+      const uint32_t per_chunk_shift = VIS_CULL_CHUNK_SHIFT - shift;
+      const uint32_t chunk = v >> per_chunk_shift;
+      next = (chunk + 1) << per_chunk_shift;
+      visible = AnyVisible(chunkVisible, numChunks, chunk, chunk + 1);
+    }
+    else {
+      const uint32_t chunks_shift = shift - VIS_CULL_CHUNK_SHIFT;
+      next = v + 1;
+      visible = AnyVisible(chunkVisible, numChunks, v << chunks_shift, next << chunks_shift);
+    }
+    if (next > last) {
+      next = last;
+    }
+    if (visible) {
+      if (num_ranges > 0 && ranges[num_ranges - 1].first + ranges[num_ranges - 1].count - 1 == v) {
+        ranges[num_ranges - 1].count = next - ranges[num_ranges - 1].first + 1;
+      }
+      else if (num_ranges == maxRanges) {
+        /* Out of room, draw everything from here on with the last range */
+        ranges[num_ranges - 1].count = last - ranges[num_ranges - 1].first + 1;
+        return num_ranges;
+      }
+      else {
+        ranges[num_ranges].first = v;
+        ranges[num_ranges].count = next - v + 1;
+        num_ranges++;
+      }
+    }
+    v = next;
+  }
+  return num_ranges;
+}
+
+void visCulling_SetEnabled(bool enabled) {
+  enabled_ = enabled;
+}
+
+bool visCulling_IsEnabled() {
+  return enabled_;
+}
+
+void visCulling_SetViewProjection(const float *viewProjection) {
+  visFrustum_FromViewProjection(&camera_frustum_, viewProjection);
+  has_camera_ = true;
+}
+
+const visFrustum *visCulling_GetFrustum() {
+  /* Nothing pushed yet is drawn as is, as it was before culling */
+  if (!enabled_ || !has_camera_) {
+    return &everything_;
+  }
+  return &camera_frustum_;
+}
+
+float visCulling_GetDepth(const visAabbArray *boxes,
+                          uint32_t first,
+                          uint32_t count) {
+  if (!has_camera_) {
+    return 0.0f;
+  }
+  visVec3 min = {FLT_MAX, FLT_MAX, FLT_MAX};
+  visVec3 max = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+  const uint32_t end = first + count < boxes->count ? first + count : boxes->count;
+  for (uint32_t i = first; i < end; i++) {
+    min.x = fminf(min.x, boxes->min_x[i]);
+    min.y = fminf(min.y, boxes->min_y[i]);
+    min.z = fminf(min.z, boxes->min_z[i]);
+    max.x = fmaxf(max.x, boxes->max_x[i]);
+    max.y = fmaxf(max.y, boxes->max_y[i]);
+    max.z = fmaxf(max.z, boxes->max_z[i]);
+  }
+  if (min.x > max.x) {
+    return 0.0f;
+  }
+  return visFrustum_Depth(&camera_frustum_, 0.5f * (min.x + max.x), 0.5f * (min.y + max.y), 0.5f * (min.z + max.z));
+}
+
+void visCulling_NewFrame() {
+  memset(counts_, 0, sizeof(counts_));
+}
+
+void visCulling_Count(visCullLayer layer,
+                      uint32_t visible,
+                      uint32_t culled) {
+  counts_[layer].visible += visible;
+  counts_[layer].culled += culled;
+}
+
+visCullCounts visCulling_GetCounts(visCullLayer layer) {
+  return counts_[layer];
+}
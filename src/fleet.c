@@ -0,0 +1,393 @@
+#include "cvis/fleet.h"
+#include "cvis/geometry.h"
+#include "cvis/embedded_shaders.h"
+#include "cvis/gl_state.h"
+#include "cvis/profiler.h"
+#include "cvis/redraw.h"
+#include "cvis/culling.h"
+#include "cvis/render_queue.h"
+#include "cvis/shader.h"
+#include "glad/glad.h"
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#define FLEET_INITIAL_CAPACITY 64
+#define FLEET_INVALID_SLOT UINT32_MAX
+/* The last index is never used, so no handle is VIS_INVALID_ROBOT_HANDLE */
+#define FLEET_MAX_ROBOTS VIS_ROBOT_HANDLE_INDEX_MASK
+#define FLEET_GENERATION_MASK (UINT32_MAX >> VIS_ROBOT_HANDLE_INDEX_BITS)
+
+static visProgram fleet_program_;
+static uint32_t fleet_vao_ = 0;
+static uint32_t fleet_instance_vbo_ = 0;
+/* Just the robots inside the frustum, packed each frame some are culled */
+static uint32_t fleet_visible_vao_ = 0;
+static uint32_t fleet_visible_vbo_ = 0;
+/* Every robot is the unit box from the shared geometry, scaled per instance */
+static const visMesh *fleet_mesh_ = NULL;
+
+/* Robots are packed at the start of the instance array, [0, count) */
+static visFleetInstance *instances_ = NULL;
+static uint32_t count_ = 0;
+static uint32_t capacity_ = 0;
+/* Maps handle indices to instance slots and back, so robots can be moved when one is removed */
+static uint32_t *slot_of_index_ = NULL;
+static uint32_t *index_of_slot_ = NULL;
+/* Generation of the handle each index was last given out with */
+static uint32_t *generation_of_index_ = NULL;
+/* Indices of removed robots, handed out again before any new ones */
+static uint32_t *free_indices_ = NULL;
+static uint32_t num_free_indices_ = 0;
+/* Indices ever handed out */
+static uint32_t num_indices_ = 0;
+
+/* Range of slots [dirty_first_, dirty_end_) changed since the last upload */
+static uint32_t dirty_first_ = UINT32_MAX;
+static uint32_t dirty_end_ = 0;
+/* Number of instances the gpu buffer can hold */
+static uint32_t gpu_capacity_ = 0;
+
+/* Bounding sphere of each slot, one array per coordinate so they can be tested 4 at a time */
+static float *bound_x_ = NULL;
+static float *bound_y_ = NULL;
+static float *bound_z_ = NULL;
+static float *bound_radius_ = NULL;
+/* Culling result of each slot, and the visible instances gathered for upload */
+static uint8_t *visible_ = NULL;
+static visFleetInstance *visible_instances_ = NULL;
+
+static void MarkDirty(uint32_t slot) {
+  visRedraw_Request();
+  /* The box sits on the ground, centred on the pose */
+  const visFleetInstance *instance = &instances_[slot];
+  bound_x_[slot] = instance->x;
+  bound_y_[slot] = instance->y;
+  bound_z_[slot] = 0.5f * instance->height;
+  bound_radius_[slot] = 0.5f * sqrtf(instance->length * instance->length +
+                                     instance->width * instance->width +
+                                     instance->height * instance->height);
+  if (slot < dirty_first_) {
+    dirty_first_ = slot;
+  }
+  if (slot + 1 > dirty_end_) {
+    dirty_end_ = slot + 1;
+  }
+}
+
+static bool Grow() {
+  const uint32_t new_capacity = capacity_ > 0 ? capacity_ * 2 : FLEET_INITIAL_CAPACITY;
+  visFleetInstance *instances = (visFleetInstance *)realloc(instances_, new_capacity * sizeof(visFleetInstance));
+  if (!instances) {
+    return false;
+  }
+  instances_ = instances;
+  /* Every index maps to at most one slot, so all the arrays are the same size */
+  uint32_t **indices[4] = {&slot_of_index_, &index_of_slot_, &generation_of_index_, &free_indices_};
+  for (int i = 0; i < 4; i++) {
+    uint32_t *index = (uint32_t *)realloc(*indices[i], new_capacity * sizeof(uint32_t));
+    if (!index) {
+      return false;
+    }
+    *indices[i] = index;
+  }
+  float **bounds[4] = {&bound_x_, &bound_y_, &bound_z_, &bound_radius_};
+  for (int b = 0; b < 4; b++) {
+    float *bound = (float *)realloc(*bounds[b], new_capacity * sizeof(float));
+    if (!bound) {
+      return false;
+    }
+    *bounds[b] = bound;
+  }
+  uint8_t *visible = (uint8_t *)realloc(visible_, new_capacity);
+  if (!visible) {
+    return false;
+  }
+  visible_ = visible;
+  instances = (visFleetInstance *)realloc(visible_instances_, new_capacity * sizeof(visFleetInstance));
+  if (!instances) {
+    return false;
+  }
+  visible_instances_ = instances;
+  capacity_ = new_capacity;
+  return true;
+}
+
+/* Per instance attributes (pose, size, color) read from a buffer of visFleetInstance */
+static void SetupInstanceAttributes(uint32_t vbo) {
+  visGlState_BindBuffer(GL_ARRAY_BUFFER, vbo);
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(visFleetInstance), (void*)offsetof(visFleetInstance, x));
+  glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(visFleetInstance), (void*)offsetof(visFleetInstance, length));
+  glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(visFleetInstance), (void*)offsetof(visFleetInstance, color));
+  for (GLuint attribute = 1; attribute <= 3; attribute++) {
+    glEnableVertexAttribArray(attribute);
+    glVertexAttribDivisor(attribute, 1);
+  }
+}
+
+/* Get the instance for a handle, NULL if the handle is not valid or its robot was removed */
+static visFleetInstance *GetInstance(visRobotHandle robot,
+                                     uint32_t *slot) {
+  const uint32_t index = robot & VIS_ROBOT_HANDLE_INDEX_MASK;
+  if (index >= num_indices_ || slot_of_index_[index] == FLEET_INVALID_SLOT ||
+      generation_of_index_[index] != robot >> VIS_ROBOT_HANDLE_INDEX_BITS) {
+    return NULL;
+  }
+  *slot = slot_of_index_[index];
+  return &instances_[*slot];
+}
+
+void visFleet_Init() {
+  visProgram_LoadAsync(&fleet_program_,
+                       visShaderSource_fleet_shader_vs,
+                       visShaderSource_simple_shader_fs);
+
+  visGeometry_Init();
+  fleet_mesh_ = visGeometry_GetPrimitive(visPrimitive_Box);
+
+  glGenVertexArrays(1, &fleet_vao_);
+  glGenBuffers(1, &fleet_instance_vbo_);
+  visGlState_BindVertexArray(fleet_vao_);
+
+  /* Per vertex, the arena holding the box mesh. The instance attributes below need their own
+   * vertex array so the shared one can't be used directly */
+  visGeometry_AttachToVertexArray();
+
+  /* Per instance, advances once per robot instead of once per vertex */
+  SetupInstanceAttributes(fleet_instance_vbo_);
+
+  /* Same again for the culled fleet */
+  glGenVertexArrays(1, &fleet_visible_vao_);
+  glGenBuffers(1, &fleet_visible_vbo_);
+  visGlState_BindVertexArray(fleet_visible_vao_);
+  visGeometry_AttachToVertexArray();
+  SetupInstanceAttributes(fleet_visible_vbo_);
+
+  visGlState_BindBuffer(GL_ARRAY_BUFFER, 0);
+  visGlState_BindVertexArray(0);
+}
+
+visRobotHandle visFleet_AddRobot(float length,
+                                 float width,
+                                 float height) {
+  if (count_ == FLEET_MAX_ROBOTS || (count_ == capacity_ && !Grow())) {
+    return VIS_INVALID_ROBOT_HANDLE;
+  }
+  uint32_t index;
+  if (num_free_indices_ > 0) {
+    num_free_indices_ -= 1;
+    index = free_indices_[num_free_indices_];
+  }
+  else {
+    index = num_indices_;
+    num_indices_ += 1;
+    generation_of_index_[index] = 0;
+  }
+
+  const uint32_t slot = count_;
+  count_ += 1;
+  slot_of_index_[index] = slot;
+  index_of_slot_[slot] = index;
+  const visRobotHandle robot = (generation_of_index_[index] << VIS_ROBOT_HANDLE_INDEX_BITS) | index;
+
+  visFleetInstance *instance = &instances_[slot];
+  instance->x = 0.0f;
+  instance->y = 0.0f;
+  instance->heading = 0.0f;
+  instance->length = length;
+  instance->width = width;
+  instance->height = height;
+  // Default color to red, same as a single robot
+  instance->color[0] = 1.0f;
+  instance->color[1] = 0.0f;
+  instance->color[2] = 0.0f;
+  instance->color[3] = 1.0f;
+  /* Drawn until the next cull says otherwise */
+  visible_[slot] = 1;
+  MarkDirty(slot);
+  return robot;
+}
+
+void visFleet_RemoveRobot(visRobotHandle robot) {
+  uint32_t slot;
+  if (!GetInstance(robot, &slot)) {
+    return;
+  }
+  /* Keep the instances packed by moving the last one into the gap */
+  const uint32_t last = count_ - 1;
+  if (slot != last) {
+    instances_[slot] = instances_[last];
+    index_of_slot_[slot] = index_of_slot_[last];
+    slot_of_index_[index_of_slot_[slot]] = slot;
+    MarkDirty(slot);
+  }
+  count_ = last;
+  /* The index can be given out again, handles to it so far are stale */
+  const uint32_t index = robot & VIS_ROBOT_HANDLE_INDEX_MASK;
+  slot_of_index_[index] = FLEET_INVALID_SLOT;
+  generation_of_index_[index] = (generation_of_index_[index] + 1) & FLEET_GENERATION_MASK;
+  free_indices_[num_free_indices_] = index;
+  num_free_indices_ += 1;
+  visRedraw_Request();
+}
+
+void visFleet_Clear() {
+  /* Every index is free again, in reverse so the next robots get them in order. The ones in use
+   * get a new generation */
+  num_free_indices_ = 0;
+  for (uint32_t index = num_indices_; index-- > 0;) {
+    if (slot_of_index_[index] != FLEET_INVALID_SLOT) {
+      slot_of_index_[index] = FLEET_INVALID_SLOT;
+      generation_of_index_[index] = (generation_of_index_[index] + 1) & FLEET_GENERATION_MASK;
+    }
+    free_indices_[num_free_indices_] = index;
+    num_free_indices_ += 1;
+  }
+  count_ = 0;
+  dirty_first_ = UINT32_MAX;
+  dirty_end_ = 0;
+  visRedraw_Request();
+}
+
+void visFleet_SetPose(visRobotHandle robot,
+                      float x,
+                      float y,
+                      float heading) {
+  uint32_t slot;
+  visFleetInstance *instance = GetInstance(robot, &slot);
+  if (!instance) {
+    return;
+  }
+  /* Applications often set every pose every frame, only the ones that moved need uploading or
+   * redrawing */
+  if (instance->x == x && instance->y == y && instance->heading == heading) {
+    return;
+  }
+  instance->x = x;
+  instance->y = y;
+  instance->heading = heading;
+  MarkDirty(slot);
+}
+
+void visFleet_SetPoses(const visRobotHandle *robots,
+                       const float *x,
+                       const float *y,
+                       const float *heading,
+                       uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    visFleet_SetPose(robots[i], x[i], y[i], heading[i]);
+  }
+}
+
+void visFleet_SetSize(visRobotHandle robot,
+                      float length,
+                      float width,
+                      float height) {
+  uint32_t slot;
+  visFleetInstance *instance = GetInstance(robot, &slot);
+  if (!instance) {
+    return;
+  }
+  instance->length = length;
+  instance->width = width;
+  instance->height = height;
+  MarkDirty(slot);
+}
+
+void visFleet_SetColor(visRobotHandle robot,
+                       float r,
+                       float g,
+                       float b,
+                       float a) {
+  uint32_t slot;
+  visFleetInstance *instance = GetInstance(robot, &slot);
+  if (!instance) {
+    return;
+  }
+  instance->color[0] = r;
+  instance->color[1] = g;
+  instance->color[2] = b;
+  instance->color[3] = a;
+  MarkDirty(slot);
+}
+
+uint32_t visFleet_Count() {
+  return count_;
+}
+
+static void UploadInstances() {
+  visGlState_BindBuffer(GL_ARRAY_BUFFER, fleet_instance_vbo_);
+  if (count_ > gpu_capacity_) {
+    /* Grow the gpu buffer to match the cpu one and send everything */
+    gpu_capacity_ = capacity_;
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)gpu_capacity_ * sizeof(visFleetInstance), NULL, GL_DYNAMIC_DRAW);
+    dirty_first_ = 0;
+    dirty_end_ = count_;
+  }
+  if (dirty_end_ > count_) {
+    /* Robots removed after being changed, no need to send them */
+    dirty_end_ = count_;
+  }
+  if (dirty_first_ < dirty_end_) {
+    glBufferSubData(GL_ARRAY_BUFFER,
+                    (GLintptr)dirty_first_ * sizeof(visFleetInstance),
+                    (GLsizeiptr)(dirty_end_ - dirty_first_) * sizeof(visFleetInstance),
+                    &instances_[dirty_first_]);
+  }
+  dirty_first_ = UINT32_MAX;
+  dirty_end_ = 0;
+}
+
+uint32_t visFleet_Cull(const visFrustum *frustum) {
+  return visFrustum_TestSpheres(frustum, bound_x_, bound_y_, bound_z_, bound_radius_, count_, visible_);
+}
+
+bool visFleet_IsVisible(visRobotHandle robot) {
+  uint32_t slot;
+  return GetInstance(robot, &slot) && visible_[slot];
+}
+
+/* Pack the visible instances and send just those, the full buffer keeps collecting changes
+ * until everything is visible again */
+static void UploadVisibleInstances(uint32_t numVisible) {
+  uint32_t packed = 0;
+  for (uint32_t slot = 0; slot < count_; slot++) {
+    if (visible_[slot]) {
+      visible_instances_[packed] = instances_[slot];
+      packed++;
+    }
+  }
+  visGlState_BindBuffer(GL_ARRAY_BUFFER, fleet_visible_vbo_);
+  /* Orphan the last frame's data rather than wait for the gpu to finish with it */
+  glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)numVisible * sizeof(visFleetInstance), visible_instances_, GL_STREAM_DRAW);
+}
+
+void visFleet_Draw() {
+  if (count_ == 0 || !visProgram_IsReady(&fleet_program_)) {
+    return;
+  }
+  visProfiler_BeginScope("Fleet");
+  const uint32_t num_visible = visFleet_Cull(visCulling_GetFrustum());
+  visCulling_Count(visCullLayer_Fleet, num_visible, count_ - num_visible);
+  if (num_visible == 0) {
+    visProfiler_EndScope();
+    return;
+  }
+  uint32_t vertex_array = fleet_vao_;
+  if (num_visible == count_) {
+    UploadInstances();
+  }
+  else {
+    UploadVisibleInstances(num_visible);
+    vertex_array = fleet_visible_vao_;
+  }
+  visGeometry_Upload();
+
+  /* The camera comes from the shared uniform buffer, the rest is per instance */
+  visDrawCommand command = visRenderQueue_NewCommand(&fleet_program_, vertex_array, GL_TRIANGLES);
+  visGeometry_SetDrawRange(fleet_mesh_, &command);
+  command.instance_count = num_visible;
+  command.layer = "Fleet";
+  visRenderQueue_Submit(&command);
+  visProfiler_EndScope();
+}
@@ -0,0 +1,363 @@
+#include "cvis/geometry.h"
+#include "cvis/gl_state.h"
+#include "glad/glad.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define GEOMETRY_INITIAL_VERTICES 1024
+#define GEOMETRY_INITIAL_INDICES 4096
+/* Number of segments around the round shapes */
+#define GEOMETRY_SEGMENTS 24
+#define GEOMETRY_SPHERE_STACKS 12
+
+static uint32_t geometry_vao_ = 0;
+static uint32_t geometry_vbo_ = 0;
+static uint32_t geometry_ebo_ = 0;
+
+/* CPU copy of the arena, xyz per vertex */
+static float *vertices_ = NULL;
+static uint32_t num_vertices_ = 0;
+static uint32_t vertex_capacity_ = 0;
+static uint32_t *indices_ = NULL;
+static uint32_t num_indices_ = 0;
+static uint32_t index_capacity_ = 0;
+
+/* How much of the arena is on the gpu, and how much room the gpu buffers have */
+static uint32_t uploaded_vertices_ = 0;
+static uint32_t uploaded_indices_ = 0;
+static uint32_t gpu_vertex_capacity_ = 0;
+static uint32_t gpu_index_capacity_ = 0;
+
+static visMesh primitives_[visPrimitive_Count];
+static bool primitive_created_[visPrimitive_Count] = {false};
+
+/* The mesh currently being built by the primitive generators */
+static visMesh building_;
+
+static bool ReserveVertices(uint32_t count) {
+  uint32_t capacity = vertex_capacity_ > 0 ? vertex_capacity_ : GEOMETRY_INITIAL_VERTICES;
+  while (capacity < count) {
+    capacity *= 2;
+  }
+  if (capacity != vertex_capacity_) {
+    float *vertices = (float *)realloc(vertices_, 3 * capacity * sizeof(float));
+    if (!vertices) {
+      return false;
+    }
+    vertices_ = vertices;
+    vertex_capacity_ = capacity;
+  }
+  return true;
+}
+
+static bool ReserveIndices(uint32_t count) {
+  uint32_t capacity = index_capacity_ > 0 ? index_capacity_ : GEOMETRY_INITIAL_INDICES;
+  while (capacity < count) {
+    capacity *= 2;
+  }
+  if (capacity != index_capacity_) {
+    uint32_t *indices = (uint32_t *)realloc(indices_, capacity * sizeof(uint32_t));
+    if (!indices) {
+      return false;
+    }
+    indices_ = indices;
+    index_capacity_ = capacity;
+  }
+  return true;
+}
+
+static void BeginMesh() {
+  building_.first_index = num_indices_;
+  building_.index_count = 0;
+  building_.base_vertex = (int32_t)num_vertices_;
+  building_.vertex_count = 0;
+}
+
+/* Returns the index of the vertex within the mesh being built */
+static uint32_t AddVertex(float x,
+                          float y,
+                          float z) {
+  if (!ReserveVertices(num_vertices_ + 1)) {
+    return 0;
+  }
+  vertices_[3 * num_vertices_] = x;
+  vertices_[3 * num_vertices_ + 1] = y;
+  vertices_[3 * num_vertices_ + 2] = z;
+  num_vertices_ += 1;
+  building_.vertex_count += 1;
+  return building_.vertex_count - 1;
+}
+
+static void AddTriangle(uint32_t a,
+                        uint32_t b,
+                        uint32_t c) {
+  if (!ReserveIndices(num_indices_ + 3)) {
+    return;
+  }
+  indices_[num_indices_] = a;
+  indices_[num_indices_ + 1] = b;
+  indices_[num_indices_ + 2] = c;
+  num_indices_ += 3;
+  building_.index_count += 3;
+}
+
+static visMesh EndMesh() {
+  return building_;
+}
+
+/* Quad with corners (a, b, c, d) in order, as two triangles */
+static void AddQuad(uint32_t a,
+                    uint32_t b,
+                    uint32_t c,
+                    uint32_t d) {
+  AddTriangle(a, b, c);
+  AddTriangle(a, c, d);
+}
+
+/* Box shape with a different size bottom (z = -0.5) and top (z = 0.5), covers the box and the
+ * frustum */
+static visMesh CreateTaperedBox(float bottomSize,
+                                float topSize) {
+  BeginMesh();
+  const float b = 0.5f * bottomSize;
+  const float t = 0.5f * topSize;
+  /* Bottom corners 0-3, top corners 4-7, counter clockwise looking down the Z axis */
+  AddVertex(-b, -b, -0.5f);
+  AddVertex(b, -b, -0.5f);
+  AddVertex(b, b, -0.5f);
+  AddVertex(-b, b, -0.5f);
+  AddVertex(-t, -t, 0.5f);
+  AddVertex(t, -t, 0.5f);
+  AddVertex(t, t, 0.5f);
+  AddVertex(-t, t, 0.5f);
+
+  AddQuad(0, 3, 2, 1);
+  AddQuad(4, 5, 6, 7);
+  AddQuad(0, 1, 5, 4);
+  AddQuad(1, 2, 6, 5);
+  AddQuad(2, 3, 7, 6);
+  AddQuad(3, 0, 4, 7);
+  return EndMesh();
+}
+
+/* Ring of vertices around an axis (Z or Y), returns the index of the first one */
+static uint32_t AddRing(bool alongY,
+                        float position,
+                        float radius) {
+  uint32_t first = 0;
+  for (uint32_t i = 0; i < GEOMETRY_SEGMENTS; i++) {
+    const float angle = 2.0f * (float)M_PI * (float)i / GEOMETRY_SEGMENTS;
+    const float u = radius * cosf(angle);
+    const float v = radius * sinf(angle);
+    const uint32_t index = alongY ? AddVertex(v, position, u) : AddVertex(u, v, position);
+    if (i == 0) {
+      first = index;
+    }
+  }
+  return first;
+}
+
+/* Join two rings with quads */
+static void JoinRings(uint32_t ring0,
+                      uint32_t ring1) {
+  for (uint32_t i = 0; i < GEOMETRY_SEGMENTS; i++) {
+    const uint32_t next = (i + 1) % GEOMETRY_SEGMENTS;
+    AddQuad(ring0 + i, ring0 + next, ring1 + next, ring1 + i);
+  }
+}
+
+/* Close a ring with triangles to a single point */
+static void CapRing(uint32_t ring,
+                    uint32_t point) {
+  for (uint32_t i = 0; i < GEOMETRY_SEGMENTS; i++) {
+    AddTriangle(point, ring + (i + 1) % GEOMETRY_SEGMENTS, ring + i);
+  }
+}
+
+static visMesh CreateCylinder() {
+  BeginMesh();
+  const uint32_t bottom = AddRing(false, -0.5f, 0.5f);
+  const uint32_t top = AddRing(false, 0.5f, 0.5f);
+  JoinRings(bottom, top);
+  CapRing(bottom, AddVertex(0, 0, -0.5f));
+  CapRing(top, AddVertex(0, 0, 0.5f));
+  return EndMesh();
+}
+
+static visMesh CreateArrow() {
+  BeginMesh();
+  const float shaft_radius = 0.05f;
+  const float head_radius = 0.15f;
+  /* Where the shaft ends and the head starts */
+  const float head_start = 0.2f;
+
+  const uint32_t shaft_bottom = AddRing(true, -0.5f, shaft_radius);
+  const uint32_t shaft_top = AddRing(true, head_start, shaft_radius);
+  const uint32_t head_base = AddRing(true, head_start, head_radius);
+  JoinRings(shaft_bottom, shaft_top);
+  CapRing(shaft_bottom, AddVertex(0, -0.5f, 0));
+  /* Flat ring between the shaft and the back of the head */
+  JoinRings(shaft_top, head_base);
+  CapRing(head_base, AddVertex(0, 0.5f, 0));
+  return EndMesh();
+}
+
+static visMesh CreateSphere() {
+  BeginMesh();
+  const uint32_t bottom = AddVertex(0, 0, -0.5f);
+  uint32_t previous_ring = 0;
+  for (uint32_t stack = 1; stack < GEOMETRY_SPHERE_STACKS; stack++) {
+    const float angle = (float)M_PI * (float)stack / GEOMETRY_SPHERE_STACKS;
+    const uint32_t ring = AddRing(false, -0.5f * cosf(angle), 0.5f * sinf(angle));
+    if (stack == 1) {
+      CapRing(ring, bottom);
+    }
+    else {
+      JoinRings(previous_ring, ring);
+    }
+    previous_ring = ring;
+  }
+  CapRing(previous_ring, AddVertex(0, 0, 0.5f));
+  return EndMesh();
+}
+
+void visGeometry_Init() {
+  /* Every layer using the arena calls this, only the first one creates it */
+  if (geometry_vao_ != 0) {
+    return;
+  }
+  glGenVertexArrays(1, &geometry_vao_);
+  glGenBuffers(1, &geometry_vbo_);
+  glGenBuffers(1, &geometry_ebo_);
+
+  visGlState_BindVertexArray(geometry_vao_);
+  visGeometry_AttachToVertexArray();
+  visGlState_BindVertexArray(0);
+}
+
+visMesh visGeometry_AddMesh(const float *vertices,
+                            uint32_t numVertices,
+                            const uint32_t *indices,
+                            uint32_t numIndices) {
+  visMesh mesh = {0};
+  if (!ReserveVertices(num_vertices_ + numVertices) || !ReserveIndices(num_indices_ + numIndices)) {
+    return mesh;
+  }
+  BeginMesh();
+  for (uint32_t i = 0; i < numVertices; i++) {
+    AddVertex(vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2]);
+  }
+  for (uint32_t i = 0; i + 2 < numIndices; i += 3) {
+    AddTriangle(indices[i], indices[i + 1], indices[i + 2]);
+  }
+  return EndMesh();
+}
+
+const visMesh *visGeometry_GetPrimitive(visPrimitive primitive) {
+  if (primitive >= visPrimitive_Count) {
+    return NULL;
+  }
+  if (!primitive_created_[primitive]) {
+    switch (primitive) {
+      case visPrimitive_Box:
+        primitives_[primitive] = CreateTaperedBox(1.0f, 1.0f);
+        break;
+      case visPrimitive_Cylinder:
+        primitives_[primitive] = CreateCylinder();
+        break;
+      case visPrimitive_Arrow:
+        primitives_[primitive] = CreateArrow();
+        break;
+      case visPrimitive_Sphere:
+        primitives_[primitive] = CreateSphere();
+        break;
+      case visPrimitive_Frustum:
+        primitives_[primitive] = CreateTaperedBox(0.25f, 1.0f);
+        break;
+      default:
+        break;
+    }
+    primitive_created_[primitive] = true;
+  }
+  return &primitives_[primitive];
+}
+
+void visGeometry_Upload() {
+  /* Uploads go through the copy write target so they don't disturb the array buffer binding or
+   * the element buffer binding of whatever vertex array is bound */
+  if (uploaded_vertices_ != num_vertices_) {
+    visGlState_BindBuffer(GL_COPY_WRITE_BUFFER, geometry_vbo_);
+    if (num_vertices_ > gpu_vertex_capacity_) {
+      /* Grow to match the cpu capacity and send everything */
+      gpu_vertex_capacity_ = vertex_capacity_;
+      glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)gpu_vertex_capacity_ * 3 * sizeof(float), NULL, GL_STATIC_DRAW);
+      uploaded_vertices_ = 0;
+    }
+    glBufferSubData(GL_COPY_WRITE_BUFFER,
+                    (GLintptr)uploaded_vertices_ * 3 * sizeof(float),
+                    (GLsizeiptr)(num_vertices_ - uploaded_vertices_) * 3 * sizeof(float),
+                    &vertices_[3 * uploaded_vertices_]);
+    uploaded_vertices_ = num_vertices_;
+  }
+  if (uploaded_indices_ != num_indices_) {
+    visGlState_BindBuffer(GL_COPY_WRITE_BUFFER, geometry_ebo_);
+    if (num_indices_ > gpu_index_capacity_) {
+      gpu_index_capacity_ = index_capacity_;
+      glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)gpu_index_capacity_ * sizeof(uint32_t), NULL, GL_STATIC_DRAW);
+      uploaded_indices_ = 0;
+    }
+    glBufferSubData(GL_COPY_WRITE_BUFFER,
+                    (GLintptr)uploaded_indices_ * sizeof(uint32_t),
+                    (GLsizeiptr)(num_indices_ - uploaded_indices_) * sizeof(uint32_t),
+                    &indices_[uploaded_indices_]);
+    uploaded_indices_ = num_indices_;
+  }
+}
+
+void visGeometry_Bind() {
+  visGeometry_Upload();
+  visGlState_BindVertexArray(geometry_vao_);
+}
+
+void visGeometry_AttachToVertexArray() {
+  visGlState_BindBuffer(GL_ARRAY_BUFFER, geometry_vbo_);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+  glEnableVertexAttribArray(0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry_ebo_);
+}
+
+void visGeometry_DrawMesh(const visMesh *mesh) {
+  glDrawElementsBaseVertex(GL_TRIANGLES,
+                           (GLsizei)mesh->index_count,
+                           GL_UNSIGNED_INT,
+                           (void*)((uintptr_t)mesh->first_index * sizeof(uint32_t)),
+                           mesh->base_vertex);
+}
+
+void visGeometry_DrawMeshInstanced(const visMesh *mesh,
+                                   uint32_t instanceCount) {
+  glDrawElementsInstancedBaseVertex(GL_TRIANGLES,
+                                    (GLsizei)mesh->index_count,
+                                    GL_UNSIGNED_INT,
+                                    (void*)((uintptr_t)mesh->first_index * sizeof(uint32_t)),
+                                    (GLsizei)instanceCount,
+                                    mesh->base_vertex);
+}
+
+uint32_t visGeometry_GetVertexArray() {
+  return geometry_vao_;
+}
+
+void visGeometry_SetDrawRange(const visMesh *mesh,
+                              visDrawCommand *command) {
+  command->mode = GL_TRIANGLES;
+  command->indexed = true;
+  command->first = mesh->first_index;
+  command->count = mesh->index_count;
+  command->base_vertex = mesh->base_vertex;
+}
+
+uint32_t visGeometry_ArenaBytes() {
+  return num_vertices_ * 3 * sizeof(float) + num_indices_ * sizeof(uint32_t);
+}
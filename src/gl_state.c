@@ -0,0 +1,134 @@
+#include "cvis/gl_state.h"
+#include "glad/glad.h"
+#include <stddef.h>
+
+/* Value no real state can have, so the next call after an invalidate is never skipped */
+#define GL_STATE_UNKNOWN UINT32_MAX
+
+typedef enum {
+  BufferTarget_Array,
+  BufferTarget_CopyWrite,
+  BufferTarget_Uniform,
+  BufferTarget_Count
+} BufferTarget;
+
+static uint32_t program_ = GL_STATE_UNKNOWN;
+static uint32_t vertex_array_ = GL_STATE_UNKNOWN;
+static uint32_t buffers_[BufferTarget_Count] = {GL_STATE_UNKNOWN, GL_STATE_UNKNOWN, GL_STATE_UNKNOWN};
+/* 0 disabled, 1 enabled, GL_STATE_UNKNOWN */
+static uint32_t blend_ = GL_STATE_UNKNOWN;
+static uint32_t blend_source_ = GL_STATE_UNKNOWN;
+static uint32_t blend_destination_ = GL_STATE_UNKNOWN;
+static float point_size_ = -1.0f;
+
+static visGlStateCounters counters_;
+static visGlStateCounters last_frame_counters_;
+
+/* Count the call and return true if it needs to go to OpenGL */
+static bool Update(uint32_t *cached,
+                   uint32_t value) {
+  if (*cached == value) {
+    counters_.elided += 1;
+    return false;
+  }
+  *cached = value;
+  counters_.issued += 1;
+  return true;
+}
+
+void visGlState_Invalidate() {
+  program_ = GL_STATE_UNKNOWN;
+  vertex_array_ = GL_STATE_UNKNOWN;
+  for (int i = 0; i < BufferTarget_Count; i++) {
+    buffers_[i] = GL_STATE_UNKNOWN;
+  }
+  blend_ = GL_STATE_UNKNOWN;
+  blend_source_ = GL_STATE_UNKNOWN;
+  blend_destination_ = GL_STATE_UNKNOWN;
+  point_size_ = -1.0f;
+}
+
+void visGlState_NewFrame() {
+  last_frame_counters_ = counters_;
+  counters_.issued = 0;
+  counters_.elided = 0;
+  visGlState_Invalidate();
+}
+
+void visGlState_UseProgram(uint32_t program) {
+  if (Update(&program_, program)) {
+    glUseProgram(program);
+  }
+}
+
+void visGlState_BindVertexArray(uint32_t vertexArray) {
+  if (Update(&vertex_array_, vertexArray)) {
+    glBindVertexArray(vertexArray);
+  }
+}
+
+void visGlState_BindBuffer(uint32_t target,
+                           uint32_t buffer) {
+  uint32_t *cached = NULL;
+  switch (target) {
+    case GL_ARRAY_BUFFER:
+      cached = &buffers_[BufferTarget_Array];
+      break;
+    case GL_COPY_WRITE_BUFFER:
+      cached = &buffers_[BufferTarget_CopyWrite];
+      break;
+    case GL_UNIFORM_BUFFER:
+      cached = &buffers_[BufferTarget_Uniform];
+      break;
+    default:
+      break;
+  }
+  if (!cached) {
+    counters_.issued += 1;
+    glBindBuffer(target, buffer);
+  }
+  else if (Update(cached, buffer)) {
+    glBindBuffer(target, buffer);
+  }
+}
+
+void visGlState_SetBlend(bool enabled) {
+  if (Update(&blend_, enabled ? 1 : 0)) {
+    if (enabled) {
+      glEnable(GL_BLEND);
+    }
+    else {
+      glDisable(GL_BLEND);
+    }
+  }
+}
+
+void visGlState_SetBlendFunc(uint32_t sourceFactor,
+                             uint32_t destinationFactor) {
+  if (blend_source_ == sourceFactor && blend_destination_ == destinationFactor) {
+    counters_.elided += 1;
+    return;
+  }
+  blend_source_ = sourceFactor;
+  blend_destination_ = destinationFactor;
+  counters_.issued += 1;
+  glBlendFunc(sourceFactor, destinationFactor);
+}
+
+void visGlState_SetPointSize(float size) {
+  if (point_size_ == size) {
+    counters_.elided += 1;
+    return;
+  }
+  point_size_ = size;
+  counters_.issued += 1;
+  glPointSize(size);
+}
+
+visGlStateCounters visGlState_GetCounters() {
+  return counters_;
+}
+
+visGlStateCounters visGlState_GetLastFrameCounters() {
+  return last_frame_counters_;
+}
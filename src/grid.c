@@ -1,12 +1,22 @@
 #include "cvis/grid.h"
 #include "cvis/shader.h"
+#include "cvis/embedded_shaders.h"
+#include "cvis/gl_state.h"
+#include "cvis/render_queue.h"
+#include "cvis/profiler.h"
+#include "cvis/culling.h"
 #include "glad/glad.h"
+#include <stdbool.h>
 #include <stdio.h>
 
-static GLuint grid_shader_ = 0;
+static visProgram grid_program_;
 static GLuint grid_vao_ = 0;
 static GLuint grid_vbo_ = 0;
 
+/* When true the grid is drawn procedurally with the infinite grid shader */
+static bool grid_infinite_ = false;
+static float grid_spacing_ = 1.0f;
+
 /* The max number of grid vertices. There are 6 vertices per grid line, so
  * this (9600) sets a max number of lines to be 1600 */
 #define GRID_MAX_NUM_VERTICES 9600
@@ -62,21 +72,22 @@ static void SetupGridLines(float stepSize) {
 }
 
 static void GridShaderInit() {
-  grid_shader_ = visShader_LoadShaderFromFiles("/Users/adamclare/projects/quimby/spoc/vis/shaders/grid_shader.vs",
-                                               "/Users/adamclare/projects/quimby/spoc/vis/shaders/grid_shader.fs");
+  visProgram_LoadAsync(&grid_program_,
+                       visShaderSource_grid_shader_vs,
+                       visShaderSource_grid_shader_fs);
 
   glGenVertexArrays(1, &grid_vao_);
   glGenBuffers(1, &grid_vbo_);
-  glBindVertexArray(grid_vao_);
+  visGlState_BindVertexArray(grid_vao_);
 
-  glBindBuffer(GL_ARRAY_BUFFER, grid_vbo_);
+  visGlState_BindBuffer(GL_ARRAY_BUFFER, grid_vbo_);
   glBufferData(GL_ARRAY_BUFFER, sizeof(float) * num_grid_vertices_, grid_vertices, GL_STATIC_DRAW);
 
   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
   glEnableVertexAttribArray(0);
 
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindVertexArray(0);
+  visGlState_BindBuffer(GL_ARRAY_BUFFER, 0);
+  visGlState_BindVertexArray(0);
 }
 
 void visGrid_InitDefault() {
@@ -89,21 +100,62 @@ void visGrid_InitWithSpacing(float spacing) {
   GridShaderInit();
 }
 
-void visGrid_Draw(const Mat4f *view,
-                  const Mat4f *projection) {
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-  glUseProgram(grid_shader_);
+void visGrid_InitInfinite(float spacing) {
+  grid_infinite_ = true;
+  grid_spacing_ = spacing;
+  visProgram_LoadAsync(&grid_program_,
+                       visShaderSource_infinite_grid_shader_vs,
+                       visShaderSource_infinite_grid_shader_fs);
+  /* No vertex data, the quad corners come from gl_VertexID, but core profile still needs a vertex
+   * array bound to draw */
+  glGenVertexArrays(1, &grid_vao_);
+}
+
+static void DrawInfinite() {
+  visDrawCommand command = visRenderQueue_NewCommand(&grid_program_, grid_vao_, GL_TRIANGLE_STRIP);
+  command.pass = visRenderPass_Background;
+  command.blend = true;
+  command.layer = "Grid";
+  command.count = 4;
   // Grid default color is black
-  float grid_color[4] = {0, 0, 0, 1};
-  glUniform4f(glGetUniformLocation(grid_shader_, "color"),
-              grid_color[0],
-              grid_color[1],
-              grid_color[2],
-              grid_color[3]);
-  glUniformMatrix4fv(glGetUniformLocation(grid_shader_, "view"), 1, GL_FALSE, &view->mat[0]);
-  glUniformMatrix4fv(glGetUniformLocation(grid_shader_, "projection"), 1, GL_FALSE, &projection->mat[0]);
-
-  glBindVertexArray(grid_vao_);
-  glDrawArrays(GL_LINES, 0, (GLsizei)(num_grid_vertices_ * sizeof(float)) / 6);
+  command.color_location = grid_program_.uniforms[visUniform_Color];
+  command.color[3] = 1;
+  command.scalar_location = grid_program_.uniforms[visUniform_Spacing];
+  command.scalar = grid_spacing_;
+  visRenderQueue_Submit(&command);
+}
+
+void visGrid_Draw() {
+  /* Still compiling, the grid just appears a frame or two later */
+  if (!visProgram_IsReady(&grid_program_)) {
+    return;
+  }
+  visProfiler_BeginScope("Grid");
+  if (grid_infinite_) {
+    /* Covers the whole screen whatever the camera, nothing to cull */
+    DrawInfinite();
+    visCulling_Count(visCullLayer_Grid, 1, 0);
+  }
+  else {
+    /* The lines are all on the ground plane */
+    const visVec3 min = {grid_x_min_, grid_y_min_, 0.0f};
+    const visVec3 max = {grid_x_max_, grid_y_max_, 0.0f};
+    if (!visFrustum_TestAabb(visCulling_GetFrustum(), &min, &max)) {
+      visCulling_Count(visCullLayer_Grid, 0, 1);
+      visProfiler_EndScope();
+      return;
+    }
+    visCulling_Count(visCullLayer_Grid, 1, 0);
+    visDrawCommand command = visRenderQueue_NewCommand(&grid_program_, grid_vao_, GL_LINES);
+    command.pass = visRenderPass_Background;
+    command.blend = true;
+    command.layer = "Grid";
+    /* num_grid_vertices_ counts floats, 3 per vertex */
+    command.count = num_grid_vertices_ / 3;
+    // Grid default color is black
+    command.color_location = grid_program_.uniforms[visUniform_Color];
+    command.color[3] = 1;
+    visRenderQueue_Submit(&command);
+  }
+  visProfiler_EndScope();
 }
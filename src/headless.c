@@ -0,0 +1,154 @@
+#include "cvis/headless.h"
+#include "glad/glad.h"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+static EGLDisplay display_ = EGL_NO_DISPLAY;
+static EGLContext context_ = EGL_NO_CONTEXT;
+static GLuint framebuffer_ = 0;
+/* Colour and depth */
+static GLuint renderbuffers_[2] = {0, 0};
+
+static bool HasExtension(const char *extensions,
+                         const char *name) {
+  if (!extensions) {
+    return false;
+  }
+  const size_t length = strlen(name);
+  const char *found = extensions;
+  while ((found = strstr(found, name)) != NULL) {
+    /* Whole names only, the list is space separated */
+    if ((found == extensions || found[-1] == ' ') && (found[length] == ' ' || found[length] == '\0')) {
+      return true;
+    }
+    found += length;
+  }
+  return false;
+}
+
+static EGLDisplay OpenDisplay() {
+  /* The surfaceless platform needs no window system or device node at all */
+  const char *client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  if (HasExtension(client_extensions, "EGL_MESA_platform_surfaceless") &&
+      HasExtension(client_extensions, "EGL_EXT_platform_base")) {
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display) {
+      EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+      if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL)) {
+        return display;
+      }
+    }
+  }
+  EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL)) {
+    return display;
+  }
+  return EGL_NO_DISPLAY;
+}
+
+static bool CreateFramebuffer(int width,
+                              int height) {
+  glGenFramebuffers(1, &framebuffer_);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glGenRenderbuffers(2, renderbuffers_);
+  glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers_[0]);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers_[0]);
+  glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers_[1]);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers_[1]);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    printf("ERROR (Headless): Framebuffer incomplete\n");
+    return false;
+  }
+  glViewport(0, 0, width, height);
+  return true;
+}
+
+bool visHeadless_Initialize(int width,
+                            int height) {
+  display_ = OpenDisplay();
+  if (display_ == EGL_NO_DISPLAY) {
+    printf("ERROR (Headless): Could not open an EGL display\n");
+    return false;
+  }
+  if (!HasExtension(eglQueryString(display_, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context")) {
+    printf("ERROR (Headless): EGL_KHR_surfaceless_context not supported\n");
+    visHeadless_Shutdown();
+    return false;
+  }
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    printf("ERROR (Headless): Desktop OpenGL not supported by EGL\n");
+    visHeadless_Shutdown();
+    return false;
+  }
+
+  /* Everything is drawn to the framebuffer object, so there's no surface to need a config for.
+   * Mesa's surfaceless platform may not offer any configs at all */
+  EGLConfig config = EGL_NO_CONFIG_KHR;
+  if (!HasExtension(eglQueryString(display_, EGL_EXTENSIONS), "EGL_KHR_no_config_context")) {
+    const EGLint config_attributes[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+    EGLint num_configs = 0;
+    if (!eglChooseConfig(display_, config_attributes, &config, 1, &num_configs) || num_configs == 0) {
+      printf("ERROR (Headless): No EGL config for desktop OpenGL\n");
+      visHeadless_Shutdown();
+      return false;
+    }
+  }
+  /* Same version and profile as the window */
+  const EGLint context_attributes[] = {EGL_CONTEXT_MAJOR_VERSION, 3,
+                                       EGL_CONTEXT_MINOR_VERSION, 3,
+                                       EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                       EGL_NONE};
+  context_ = eglCreateContext(display_, config, EGL_NO_CONTEXT, context_attributes);
+  if (context_ == EGL_NO_CONTEXT) {
+    printf("ERROR (Headless): Failed to create an OpenGL 3.3 core context (0x%x)\n", eglGetError());
+    visHeadless_Shutdown();
+    return false;
+  }
+  if (!eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, context_)) {
+    printf("ERROR (Headless): Failed to make the context current (0x%x)\n", eglGetError());
+    visHeadless_Shutdown();
+    return false;
+  }
+  if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+    printf("GLAD ERROR: Failed to initialize\n");
+    visHeadless_Shutdown();
+    return false;
+  }
+  if (!CreateFramebuffer(width, height)) {
+    visHeadless_Shutdown();
+    return false;
+  }
+  return true;
+}
+
+uint32_t visHeadless_GetFramebuffer() {
+  return framebuffer_;
+}
+
+void visHeadless_Shutdown() {
+  if (framebuffer_ != 0) {
+    glDeleteRenderbuffers(2, renderbuffers_);
+    glDeleteFramebuffers(1, &framebuffer_);
+    framebuffer_ = 0;
+  }
+  if (display_ != EGL_NO_DISPLAY) {
+    eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context_ != EGL_NO_CONTEXT) {
+      eglDestroyContext(display_, context_);
+      context_ = EGL_NO_CONTEXT;
+    }
+    eglTerminate(display_);
+    display_ = EGL_NO_DISPLAY;
+  }
+}
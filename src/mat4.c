@@ -0,0 +1,706 @@
+#include "cvis/mat4.h"
+#include <math.h>
+#include <stdatomic.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+/* AVX2 kernels are compiled for the target cpu features on their own, whatever the build targets */
+#if defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define MAT4_HAVE_AVX2 1
+#define MAT4_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+typedef struct {
+  visMathIsa isa;
+  void (*multiply)(const float *a,
+                   const float *b,
+                   float *out);
+  bool (*inverse)(const float *m,
+                  float *out);
+  void (*transform_points)(const float *m,
+                           const float *xyz,
+                           uint32_t count,
+                           float *out);
+  void (*compose_trs)(const float *translation,
+                      const float *rotation,
+                      const float *scale,
+                      float *out);
+  void (*compose_trs_batch)(const float *const translation[3],
+                            const float *const rotation[4],
+                            const float *const scale[3],
+                            uint32_t count,
+                            float *out);
+} MathKernels;
+
+static void MultiplyScalar(const float *a,
+                           const float *b,
+                           float *out) {
+  float result[16];
+  for (int column = 0; column < 4; column++) {
+    for (int row = 0; row < 4; row++) {
+      result[4 * column + row] = a[row] * b[4 * column] + a[4 + row] * b[4 * column + 1] +
+                                 a[8 + row] * b[4 * column + 2] + a[12 + row] * b[4 * column + 3];
+    }
+  }
+  memcpy(out, result, sizeof(result));
+}
+
+/* Cofactors, as in Mesa's gluInvertMatrix */
+static bool InverseScalar(const float *m,
+                          float *out) {
+  float inverse[16];
+  inverse[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] +
+               m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+  inverse[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] -
+               m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+  inverse[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] +
+               m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+  inverse[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] -
+                m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+  inverse[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] -
+               m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+  inverse[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] +
+               m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+  inverse[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] -
+               m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+  inverse[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] +
+                m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+  inverse[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] +
+               m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+  inverse[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] -
+               m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+  inverse[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] +
+                m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+  inverse[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] -
+                m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+  inverse[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] -
+               m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+  inverse[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] +
+               m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+  inverse[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] -
+                m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+  inverse[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] +
+                m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+  const float determinant = m[0] * inverse[0] + m[1] * inverse[4] + m[2] * inverse[8] + m[3] * inverse[12];
+  if (determinant == 0.0f) {
+    return false;
+  }
+  const float scale = 1.0f / determinant;
+  for (int i = 0; i < 16; i++) {
+    out[i] = inverse[i] * scale;
+  }
+  return true;
+}
+
+static void TransformPointsScalar(const float *m,
+                                  const float *xyz,
+                                  uint32_t count,
+                                  float *out) {
+  for (uint32_t i = 0; i < count; i++) {
+    const float x = xyz[3 * i];
+    const float y = xyz[3 * i + 1];
+    const float z = xyz[3 * i + 2];
+    out[3 * i] = m[0] * x + m[4] * y + m[8] * z + m[12];
+    out[3 * i + 1] = m[1] * x + m[5] * y + m[9] * z + m[13];
+    out[3 * i + 2] = m[2] * x + m[6] * y + m[10] * z + m[14];
+  }
+}
+
+static void ComposeTrsScalar(const float *translation,
+                             const float *rotation,
+                             const float *scale,
+                             float *out) {
+  const float x = rotation[0];
+  const float y = rotation[1];
+  const float z = rotation[2];
+  const float w = rotation[3];
+  out[0] = (1.0f - 2.0f * (y * y + z * z)) * scale[0];
+  out[1] = 2.0f * (x * y + z * w) * scale[0];
+  out[2] = 2.0f * (x * z - y * w) * scale[0];
+  out[3] = 0.0f;
+  out[4] = 2.0f * (x * y - z * w) * scale[1];
+  out[5] = (1.0f - 2.0f * (x * x + z * z)) * scale[1];
+  out[6] = 2.0f * (y * z + x * w) * scale[1];
+  out[7] = 0.0f;
+  out[8] = 2.0f * (x * z + y * w) * scale[2];
+  out[9] = 2.0f * (y * z - x * w) * scale[2];
+  out[10] = (1.0f - 2.0f * (x * x + y * y)) * scale[2];
+  out[11] = 0.0f;
+  out[12] = translation[0];
+  out[13] = translation[1];
+  out[14] = translation[2];
+  out[15] = 1.0f;
+}
+
+/* Transform i of a batch for visMat4_ComposeTrs, NULL components are 0 */
+static inline void GatherTrs(const float *const translation[3],
+                             const float *const rotation[4],
+                             const float *const scale[3],
+                             uint32_t i,
+                             float *t,
+                             float *q,
+                             float *s) {
+  for (int c = 0; c < 3; c++) {
+    t[c] = translation[c] ? translation[c][i] : 0.0f;
+    s[c] = scale[c][i];
+  }
+  for (int c = 0; c < 4; c++) {
+    q[c] = rotation[c] ? rotation[c][i] : 0.0f;
+  }
+}
+
+static void ComposeTrsBatchScalar(const float *const translation[3],
+                                  const float *const rotation[4],
+                                  const float *const scale[3],
+                                  uint32_t count,
+                                  float *out) {
+  for (uint32_t i = 0; i < count; i++) {
+    float t[3];
+    float q[4];
+    float s[3];
+    GatherTrs(translation, rotation, scale, i, t, q, s);
+    ComposeTrsScalar(t, q, s, out + 16 * i);
+  }
+}
+
+static const MathKernels scalar_kernels_ = {
+    visMathIsa_Scalar, MultiplyScalar, InverseScalar, TransformPointsScalar, ComposeTrsScalar,
+    ComposeTrsBatchScalar};
+
+#if defined(__SSE2__)
+/* Lanes in the order they come out, the reverse of _MM_SHUFFLE */
+#define LANES(x, y, z, w) ((x) | ((y) << 2) | ((z) << 4) | ((w) << 6))
+#define SWIZZLE(v, x, y, z, w) _mm_shuffle_ps((v), (v), LANES(x, y, z, w))
+#define SIGNS(x, y, z, w) _mm_setr_ps((x) ? -0.0f : 0.0f, (y) ? -0.0f : 0.0f, (z) ? -0.0f : 0.0f, (w) ? -0.0f : 0.0f)
+
+static void MultiplySse2(const float *a,
+                         const float *b,
+                         float *out) {
+  const __m128 a0 = _mm_loadu_ps(a);
+  const __m128 a1 = _mm_loadu_ps(a + 4);
+  const __m128 a2 = _mm_loadu_ps(a + 8);
+  const __m128 a3 = _mm_loadu_ps(a + 12);
+  __m128 columns[4];
+  for (int column = 0; column < 4; column++) {
+    const float *b_column = b + 4 * column;
+    columns[column] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(b_column[0])),
+                                            _mm_mul_ps(a1, _mm_set1_ps(b_column[1]))),
+                                 _mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(b_column[2])),
+                                            _mm_mul_ps(a3, _mm_set1_ps(b_column[3]))));
+  }
+  /* Stored after everything is read, out can be a or b */
+  for (int column = 0; column < 4; column++) {
+    _mm_storeu_ps(out + 4 * column, columns[column]);
+  }
+}
+
+/* 2x2 matrices as (m00 m01 m10 m11). a * b */
+static inline __m128 Mat2Multiply(__m128 a,
+                                  __m128 b) {
+  return _mm_add_ps(_mm_mul_ps(a, SWIZZLE(b, 0, 3, 0, 3)), _mm_mul_ps(SWIZZLE(a, 1, 0, 3, 2), SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+/* adjugate(a) * b */
+static inline __m128 Mat2AdjugateMultiply(__m128 a,
+                                          __m128 b) {
+  return _mm_sub_ps(_mm_mul_ps(SWIZZLE(a, 3, 3, 0, 0), b), _mm_mul_ps(SWIZZLE(a, 1, 1, 2, 2), SWIZZLE(b, 2, 3, 0, 1)));
+}
+
+/* a * adjugate(b) */
+static inline __m128 Mat2MultiplyAdjugate(__m128 a,
+                                          __m128 b) {
+  return _mm_sub_ps(_mm_mul_ps(a, SWIZZLE(b, 3, 0, 3, 0)), _mm_mul_ps(SWIZZLE(a, 1, 0, 3, 2), SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+/* Block inverse of the four 2x2 sub matrices, from Eric Zhang's "Fast 4x4 Matrix Inverse with SSE
+ * SIMD, Explained". The inverse of the transpose is the transpose of the inverse, so it works on
+ * columns as well as rows */
+static bool InverseSse2(const float *m,
+                        float *out) {
+  const __m128 c0 = _mm_loadu_ps(m);
+  const __m128 c1 = _mm_loadu_ps(m + 4);
+  const __m128 c2 = _mm_loadu_ps(m + 8);
+  const __m128 c3 = _mm_loadu_ps(m + 12);
+  const __m128 a = _mm_movelh_ps(c0, c1);
+  const __m128 b = _mm_movehl_ps(c1, c0);
+  const __m128 c = _mm_movelh_ps(c2, c3);
+  const __m128 d = _mm_movehl_ps(c3, c2);
+
+  /* Determinants of a, b, c and d */
+  const __m128 sub_determinants =
+      _mm_sub_ps(_mm_mul_ps(_mm_shuffle_ps(c0, c2, LANES(0, 2, 0, 2)), _mm_shuffle_ps(c1, c3, LANES(1, 3, 1, 3))),
+                 _mm_mul_ps(_mm_shuffle_ps(c0, c2, LANES(1, 3, 1, 3)), _mm_shuffle_ps(c1, c3, LANES(0, 2, 0, 2))));
+  const __m128 determinant_a = SWIZZLE(sub_determinants, 0, 0, 0, 0);
+  const __m128 determinant_b = SWIZZLE(sub_determinants, 1, 1, 1, 1);
+  const __m128 determinant_c = SWIZZLE(sub_determinants, 2, 2, 2, 2);
+  const __m128 determinant_d = SWIZZLE(sub_determinants, 3, 3, 3, 3);
+
+  const __m128 d_c = Mat2AdjugateMultiply(d, c);
+  const __m128 a_b = Mat2AdjugateMultiply(a, b);
+  __m128 x = _mm_sub_ps(_mm_mul_ps(determinant_d, a), Mat2Multiply(b, d_c));
+  __m128 w = _mm_sub_ps(_mm_mul_ps(determinant_a, d), Mat2Multiply(c, a_b));
+  __m128 y = _mm_sub_ps(_mm_mul_ps(determinant_b, c), Mat2MultiplyAdjugate(d, a_b));
+  __m128 z = _mm_sub_ps(_mm_mul_ps(determinant_c, b), Mat2MultiplyAdjugate(a, d_c));
+
+  /* |m| = |a| |d| + |b| |c| - trace(a_b * d_c) */
+  __m128 trace = _mm_mul_ps(a_b, SWIZZLE(d_c, 0, 2, 1, 3));
+  trace = _mm_add_ps(trace, SWIZZLE(trace, 2, 3, 0, 1));
+  trace = _mm_add_ps(trace, SWIZZLE(trace, 1, 0, 3, 2));
+  const __m128 determinant = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(determinant_a, determinant_d),
+                                                   _mm_mul_ps(determinant_b, determinant_c)),
+                                        trace);
+  if (_mm_cvtss_f32(determinant) == 0.0f) {
+    return false;
+  }
+  const __m128 scale = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), determinant);
+  x = _mm_mul_ps(x, scale);
+  y = _mm_mul_ps(y, scale);
+  z = _mm_mul_ps(z, scale);
+  w = _mm_mul_ps(w, scale);
+
+  /* Adjugate of each block and back to columns in one shuffle */
+  _mm_storeu_ps(out, _mm_shuffle_ps(x, y, LANES(3, 1, 3, 1)));
+  _mm_storeu_ps(out + 4, _mm_shuffle_ps(x, y, LANES(2, 0, 2, 0)));
+  _mm_storeu_ps(out + 8, _mm_shuffle_ps(z, w, LANES(3, 1, 3, 1)));
+  _mm_storeu_ps(out + 12, _mm_shuffle_ps(z, w, LANES(2, 0, 2, 0)));
+  return true;
+}
+
+/* Four packed points, x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3, to one register per coordinate */
+static inline void LoadPoints4(const float *xyz,
+                               __m128 *x,
+                               __m128 *y,
+                               __m128 *z) {
+  const __m128 a = _mm_loadu_ps(xyz);
+  const __m128 b = _mm_loadu_ps(xyz + 4);
+  const __m128 c = _mm_loadu_ps(xyz + 8);
+  *x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, LANES(2, 3, 0, 1)), LANES(0, 3, 0, 3));
+  *y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, LANES(1, 1, 0, 0)), _mm_shuffle_ps(b, c, LANES(3, 3, 2, 2)), LANES(0, 2, 0, 2));
+  *z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, LANES(2, 2, 1, 1)), SWIZZLE(c, 0, 0, 3, 3), LANES(0, 2, 0, 2));
+}
+
+/* The reverse of LoadPoints4 */
+static inline void StorePoints4(__m128 x,
+                                __m128 y,
+                                __m128 z,
+                                float *xyz) {
+  const __m128 xy_low = _mm_unpacklo_ps(x, y);
+  const __m128 xy_high = _mm_unpackhi_ps(x, y);
+  _mm_storeu_ps(xyz, _mm_shuffle_ps(xy_low, _mm_shuffle_ps(z, xy_low, LANES(0, 0, 2, 2)), LANES(0, 1, 0, 2)));
+  _mm_storeu_ps(xyz + 4, _mm_shuffle_ps(_mm_shuffle_ps(xy_low, z, LANES(3, 3, 1, 1)), xy_high, LANES(0, 2, 0, 1)));
+  _mm_storeu_ps(xyz + 8, _mm_shuffle_ps(_mm_shuffle_ps(z, xy_high, LANES(2, 2, 2, 2)),
+                                        _mm_shuffle_ps(xy_high, z, LANES(3, 3, 3, 3)),
+                                        LANES(0, 2, 0, 2)));
+}
+
+static void TransformPointsSse2(const float *m,
+                                const float *xyz,
+                                uint32_t count,
+                                float *out) {
+  uint32_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128 x;
+    __m128 y;
+    __m128 z;
+    LoadPoints4(xyz + 3 * i, &x, &y, &z);
+    const __m128 out_x = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0]), x), _mm_mul_ps(_mm_set1_ps(m[4]), y)),
+                                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[8]), z), _mm_set1_ps(m[12])));
+    const __m128 out_y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[1]), x), _mm_mul_ps(_mm_set1_ps(m[5]), y)),
+                                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[9]), z), _mm_set1_ps(m[13])));
+    const __m128 out_z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[2]), x), _mm_mul_ps(_mm_set1_ps(m[6]), y)),
+                                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[10]), z), _mm_set1_ps(m[14])));
+    StorePoints4(out_x, out_y, out_z, out + 3 * i);
+  }
+  TransformPointsScalar(m, xyz + 3 * i, count - i, out + 3 * i);
+}
+
+static void ComposeTrsSse2(const float *translation,
+                           const float *rotation,
+                           const float *scale,
+                           float *out) {
+  /* Each rotation column is a unit axis plus 2 * two products of quaternion terms, see
+   * ComposeTrsScalar */
+  const __m128 q = _mm_loadu_ps(rotation);
+  const __m128 two = _mm_set1_ps(2.0f);
+  const __m128 xyz_mask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+  __m128 terms = _mm_add_ps(_mm_mul_ps(SWIZZLE(q, 1, 0, 0, 3), _mm_xor_ps(SWIZZLE(q, 1, 1, 2, 3), SIGNS(1, 0, 0, 0))),
+                            _mm_mul_ps(SWIZZLE(q, 2, 2, 1, 3), _mm_xor_ps(SWIZZLE(q, 2, 3, 3, 3), SIGNS(1, 0, 1, 0))));
+  const __m128 column0 = _mm_add_ps(_mm_setr_ps(1.0f, 0.0f, 0.0f, 0.0f), _mm_and_ps(_mm_mul_ps(two, terms), xyz_mask));
+  terms = _mm_add_ps(_mm_mul_ps(_mm_xor_ps(SWIZZLE(q, 0, 0, 1, 3), SIGNS(0, 1, 0, 0)), SWIZZLE(q, 1, 0, 2, 3)),
+                     _mm_mul_ps(SWIZZLE(q, 2, 2, 0, 3), _mm_xor_ps(SWIZZLE(q, 3, 2, 3, 3), SIGNS(1, 1, 0, 0))));
+  const __m128 column1 = _mm_add_ps(_mm_setr_ps(0.0f, 1.0f, 0.0f, 0.0f), _mm_and_ps(_mm_mul_ps(two, terms), xyz_mask));
+  terms = _mm_add_ps(_mm_mul_ps(_mm_xor_ps(SWIZZLE(q, 0, 1, 0, 3), SIGNS(0, 0, 1, 0)), SWIZZLE(q, 2, 2, 0, 3)),
+                     _mm_mul_ps(SWIZZLE(q, 1, 0, 1, 3), _mm_xor_ps(SWIZZLE(q, 3, 3, 1, 3), SIGNS(0, 1, 1, 0))));
+  const __m128 column2 = _mm_add_ps(_mm_setr_ps(0.0f, 0.0f, 1.0f, 0.0f), _mm_and_ps(_mm_mul_ps(two, terms), xyz_mask));
+
+  _mm_storeu_ps(out, _mm_mul_ps(column0, _mm_set1_ps(scale[0])));
+  _mm_storeu_ps(out + 4, _mm_mul_ps(column1, _mm_set1_ps(scale[1])));
+  _mm_storeu_ps(out + 8, _mm_mul_ps(column2, _mm_set1_ps(scale[2])));
+  _mm_storeu_ps(out + 12, _mm_setr_ps(translation[0], translation[1], translation[2], 1.0f));
+}
+
+static inline __m128 LoadComponent4(const float *component,
+                                    uint32_t i) {
+  return component ? _mm_loadu_ps(component + i) : _mm_setzero_ps();
+}
+
+/* One element of a column per register, a lane per transform, to that column of 4 transforms */
+static inline void StoreColumn4(__m128 a,
+                                __m128 b,
+                                __m128 c,
+                                __m128 d,
+                                float *column) {
+  _MM_TRANSPOSE4_PS(a, b, c, d);
+  _mm_storeu_ps(column, a);
+  _mm_storeu_ps(column + 16, b);
+  _mm_storeu_ps(column + 32, c);
+  _mm_storeu_ps(column + 48, d);
+}
+
+/* Four transforms at a time, each element of the matrix for all four then transposed on store.
+ * Transforms [first, count), so the AVX2 kernel can finish its tail with it */
+static void ComposeTrsRangeSse2(const float *const translation[3],
+                                const float *const rotation[4],
+                                const float *const scale[3],
+                                uint32_t first,
+                                uint32_t count,
+                                float *out) {
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  uint32_t i = first;
+  for (; i + 4 <= count; i += 4) {
+    const __m128 x = LoadComponent4(rotation[0], i);
+    const __m128 y = LoadComponent4(rotation[1], i);
+    const __m128 z = LoadComponent4(rotation[2], i);
+    const __m128 w = LoadComponent4(rotation[3], i);
+    const __m128 x2 = _mm_add_ps(x, x);
+    const __m128 y2 = _mm_add_ps(y, y);
+    const __m128 z2 = _mm_add_ps(z, z);
+    const __m128 xx = _mm_mul_ps(x, x2);
+    const __m128 yy = _mm_mul_ps(y, y2);
+    const __m128 zz = _mm_mul_ps(z, z2);
+    const __m128 xy = _mm_mul_ps(x, y2);
+    const __m128 xz = _mm_mul_ps(x, z2);
+    const __m128 yz = _mm_mul_ps(y, z2);
+    const __m128 wx = _mm_mul_ps(w, x2);
+    const __m128 wy = _mm_mul_ps(w, y2);
+    const __m128 wz = _mm_mul_ps(w, z2);
+    const __m128 sx = _mm_loadu_ps(scale[0] + i);
+    const __m128 sy = _mm_loadu_ps(scale[1] + i);
+    const __m128 sz = _mm_loadu_ps(scale[2] + i);
+
+    float *matrices = out + 16 * i;
+    StoreColumn4(_mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx),
+                 _mm_mul_ps(_mm_add_ps(xy, wz), sx),
+                 _mm_mul_ps(_mm_sub_ps(xz, wy), sx),
+                 zero,
+                 matrices);
+    StoreColumn4(_mm_mul_ps(_mm_sub_ps(xy, wz), sy),
+                 _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy),
+                 _mm_mul_ps(_mm_add_ps(yz, wx), sy),
+                 zero,
+                 matrices + 4);
+    StoreColumn4(_mm_mul_ps(_mm_add_ps(xz, wy), sz),
+                 _mm_mul_ps(_mm_sub_ps(yz, wx), sz),
+                 _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz),
+                 zero,
+                 matrices + 8);
+    StoreColumn4(LoadComponent4(translation[0], i),
+                 LoadComponent4(translation[1], i),
+                 LoadComponent4(translation[2], i),
+                 one,
+                 matrices + 12);
+  }
+  for (; i < count; i++) {
+    float t[3];
+    float q[4];
+    float s[3];
+    GatherTrs(translation, rotation, scale, i, t, q, s);
+    ComposeTrsSse2(t, q, s, out + 16 * i);
+  }
+}
+
+static void ComposeTrsBatchSse2(const float *const translation[3],
+                                const float *const rotation[4],
+                                const float *const scale[3],
+                                uint32_t count,
+                                float *out) {
+  ComposeTrsRangeSse2(translation, rotation, scale, 0, count, out);
+}
+
+static const MathKernels sse2_kernels_ = {
+    visMathIsa_Sse2, MultiplySse2, InverseSse2, TransformPointsSse2, ComposeTrsSse2,
+    ComposeTrsBatchSse2};
+#endif
+
+#if defined(MAT4_HAVE_AVX2)
+/* Two columns of the result at a time */
+MAT4_AVX2 static void MultiplyAvx2(const float *a,
+                                   const float *b,
+                                   float *out) {
+  const __m256 a0 = _mm256_broadcast_ps((const __m128 *)a);
+  const __m256 a1 = _mm256_broadcast_ps((const __m128 *)(a + 4));
+  const __m256 a2 = _mm256_broadcast_ps((const __m128 *)(a + 8));
+  const __m256 a3 = _mm256_broadcast_ps((const __m128 *)(a + 12));
+  const __m256 b01 = _mm256_loadu_ps(b);
+  const __m256 b23 = _mm256_loadu_ps(b + 8);
+  __m256 out01 = _mm256_mul_ps(a0, _mm256_permute_ps(b01, 0x00));
+  out01 = _mm256_fmadd_ps(a1, _mm256_permute_ps(b01, 0x55), out01);
+  out01 = _mm256_fmadd_ps(a2, _mm256_permute_ps(b01, 0xaa), out01);
+  out01 = _mm256_fmadd_ps(a3, _mm256_permute_ps(b01, 0xff), out01);
+  __m256 out23 = _mm256_mul_ps(a0, _mm256_permute_ps(b23, 0x00));
+  out23 = _mm256_fmadd_ps(a1, _mm256_permute_ps(b23, 0x55), out23);
+  out23 = _mm256_fmadd_ps(a2, _mm256_permute_ps(b23, 0xaa), out23);
+  out23 = _mm256_fmadd_ps(a3, _mm256_permute_ps(b23, 0xff), out23);
+  _mm256_storeu_ps(out, out01);
+  _mm256_storeu_ps(out + 8, out23);
+}
+
+/* Eight points at a time, unpacked four at a time with SSE then joined */
+MAT4_AVX2 static void TransformPointsAvx2(const float *m,
+                                          const float *xyz,
+                                          uint32_t count,
+                                          float *out) {
+  const __m256 m0 = _mm256_set1_ps(m[0]);
+  const __m256 m1 = _mm256_set1_ps(m[1]);
+  const __m256 m2 = _mm256_set1_ps(m[2]);
+  const __m256 m4 = _mm256_set1_ps(m[4]);
+  const __m256 m5 = _mm256_set1_ps(m[5]);
+  const __m256 m6 = _mm256_set1_ps(m[6]);
+  const __m256 m8 = _mm256_set1_ps(m[8]);
+  const __m256 m9 = _mm256_set1_ps(m[9]);
+  const __m256 m10 = _mm256_set1_ps(m[10]);
+  const __m256 m12 = _mm256_set1_ps(m[12]);
+  const __m256 m13 = _mm256_set1_ps(m[13]);
+  const __m256 m14 = _mm256_set1_ps(m[14]);
+  uint32_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128 x_low;
+    __m128 y_low;
+    __m128 z_low;
+    __m128 x_high;
+    __m128 y_high;
+    __m128 z_high;
+    LoadPoints4(xyz + 3 * i, &x_low, &y_low, &z_low);
+    LoadPoints4(xyz + 3 * i + 12, &x_high, &y_high, &z_high);
+    const __m256 x = _mm256_insertf128_ps(_mm256_castps128_ps256(x_low), x_high, 1);
+    const __m256 y = _mm256_insertf128_ps(_mm256_castps128_ps256(y_low), y_high, 1);
+    const __m256 z = _mm256_insertf128_ps(_mm256_castps128_ps256(z_low), z_high, 1);
+    const __m256 out_x = _mm256_fmadd_ps(m0, x, _mm256_fmadd_ps(m4, y, _mm256_fmadd_ps(m8, z, m12)));
+    const __m256 out_y = _mm256_fmadd_ps(m1, x, _mm256_fmadd_ps(m5, y, _mm256_fmadd_ps(m9, z, m13)));
+    const __m256 out_z = _mm256_fmadd_ps(m2, x, _mm256_fmadd_ps(m6, y, _mm256_fmadd_ps(m10, z, m14)));
+    StorePoints4(_mm256_castps256_ps128(out_x),
+                 _mm256_castps256_ps128(out_y),
+                 _mm256_castps256_ps128(out_z),
+                 out + 3 * i);
+    StorePoints4(_mm256_extractf128_ps(out_x, 1),
+                 _mm256_extractf128_ps(out_y, 1),
+                 _mm256_extractf128_ps(out_z, 1),
+                 out + 3 * i + 12);
+  }
+  TransformPointsSse2(m, xyz + 3 * i, count - i, out + 3 * i);
+}
+
+MAT4_AVX2 static inline __m256 LoadComponent8(const float *component,
+                                              uint32_t i) {
+  return component ? _mm256_loadu_ps(component + i) : _mm256_setzero_ps();
+}
+
+/* StoreColumn4 for 8 transforms, one half of the registers at a time */
+MAT4_AVX2 static inline void StoreColumn8(__m256 a,
+                                          __m256 b,
+                                          __m256 c,
+                                          __m256 d,
+                                          float *column) {
+  StoreColumn4(_mm256_castps256_ps128(a), _mm256_castps256_ps128(b), _mm256_castps256_ps128(c),
+               _mm256_castps256_ps128(d), column);
+  StoreColumn4(_mm256_extractf128_ps(a, 1), _mm256_extractf128_ps(b, 1), _mm256_extractf128_ps(c, 1),
+               _mm256_extractf128_ps(d, 1), column + 64);
+}
+
+/* ComposeTrsRangeSse2 eight transforms at a time */
+MAT4_AVX2 static void ComposeTrsBatchAvx2(const float *const translation[3],
+                                          const float *const rotation[4],
+                                          const float *const scale[3],
+                                          uint32_t count,
+                                          float *out) {
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0f);
+  uint32_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m256 x = LoadComponent8(rotation[0], i);
+    const __m256 y = LoadComponent8(rotation[1], i);
+    const __m256 z = LoadComponent8(rotation[2], i);
+    const __m256 w = LoadComponent8(rotation[3], i);
+    const __m256 x2 = _mm256_add_ps(x, x);
+    const __m256 y2 = _mm256_add_ps(y, y);
+    const __m256 z2 = _mm256_add_ps(z, z);
+    const __m256 xx = _mm256_mul_ps(x, x2);
+    const __m256 yy = _mm256_mul_ps(y, y2);
+    const __m256 zz = _mm256_mul_ps(z, z2);
+    const __m256 xy = _mm256_mul_ps(x, y2);
+    const __m256 xz = _mm256_mul_ps(x, z2);
+    const __m256 yz = _mm256_mul_ps(y, z2);
+    const __m256 wx = _mm256_mul_ps(w, x2);
+    const __m256 wy = _mm256_mul_ps(w, y2);
+    const __m256 wz = _mm256_mul_ps(w, z2);
+    const __m256 sx = _mm256_loadu_ps(scale[0] + i);
+    const __m256 sy = _mm256_loadu_ps(scale[1] + i);
+    const __m256 sz = _mm256_loadu_ps(scale[2] + i);
+
+    float *matrices = out + 16 * i;
+    StoreColumn8(_mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), sx),
+                 _mm256_mul_ps(_mm256_add_ps(xy, wz), sx),
+                 _mm256_mul_ps(_mm256_sub_ps(xz, wy), sx),
+                 zero,
+                 matrices);
+    StoreColumn8(_mm256_mul_ps(_mm256_sub_ps(xy, wz), sy),
+                 _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), sy),
+                 _mm256_mul_ps(_mm256_add_ps(yz, wx), sy),
+                 zero,
+                 matrices + 4);
+    StoreColumn8(_mm256_mul_ps(_mm256_add_ps(xz, wy), sz),
+                 _mm256_mul_ps(_mm256_sub_ps(yz, wx), sz),
+                 _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), sz),
+                 zero,
+                 matrices + 8);
+    StoreColumn8(LoadComponent8(translation[0], i),
+                 LoadComponent8(translation[1], i),
+                 LoadComponent8(translation[2], i),
+                 one,
+                 matrices + 12);
+  }
+  ComposeTrsRangeSse2(translation, rotation, scale, i, count, out);
+}
+
+/* A 4x4 inverse and a single compose don't fill 8 lanes, they keep the SSE2 kernels */
+static const MathKernels avx2_kernels_ = {
+    visMathIsa_Avx2, MultiplyAvx2, InverseSse2, TransformPointsAvx2, ComposeTrsSse2,
+    ComposeTrsBatchAvx2};
+
+static bool CpuHasAvx2() {
+#if defined(__AVX2__) && defined(__FMA__)
+  return true;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+#endif
+
+/* Picked on first use, see visMath_SetIsa */
+static _Atomic(const MathKernels *) kernels_ = NULL;
+
+static const MathKernels *BestKernels() {
+#if defined(MAT4_HAVE_AVX2)
+  if (CpuHasAvx2()) {
+    return &avx2_kernels_;
+  }
+#endif
+#if defined(__SSE2__)
+  return &sse2_kernels_;
+#else
+  return &scalar_kernels_;
+#endif
+}
+
+static const MathKernels *Kernels() {
+  const MathKernels *kernels = atomic_load_explicit(&kernels_, memory_order_acquire);
+  if (kernels == NULL) {
+    /* Threads racing here all pick the same kernels */
+    kernels = BestKernels();
+    atomic_store_explicit(&kernels_, kernels, memory_order_release);
+  }
+  return kernels;
+}
+
+visMathIsa visMath_GetIsa() {
+  return Kernels()->isa;
+}
+
+bool visMath_SetIsa(visMathIsa isa) {
+  const MathKernels *kernels = NULL;
+  switch (isa) {
+    case visMathIsa_Scalar:
+      kernels = &scalar_kernels_;
+      break;
+    case visMathIsa_Sse2:
+#if defined(__SSE2__)
+      kernels = &sse2_kernels_;
+#endif
+      break;
+    case visMathIsa_Avx2:
+#if defined(MAT4_HAVE_AVX2)
+      kernels = CpuHasAvx2() ? &avx2_kernels_ : NULL;
+#endif
+      break;
+  }
+  if (kernels == NULL) {
+    return false;
+  }
+  atomic_store_explicit(&kernels_, kernels, memory_order_release);
+  return true;
+}
+
+const char *visMath_IsaName(visMathIsa isa) {
+  switch (isa) {
+    case visMathIsa_Scalar:
+      return "scalar";
+    case visMathIsa_Sse2:
+      return "sse2";
+    case visMathIsa_Avx2:
+      return "avx2";
+  }
+  return "unknown";
+}
+
+void visMat4_Multiply(const float *a,
+                      const float *b,
+                      float *out) {
+  Kernels()->multiply(a, b, out);
+}
+
+bool visMat4_Inverse(const float *m,
+                     float *out) {
+  return Kernels()->inverse(m, out);
+}
+
+void visMat4_TransformPoints(const float *m,
+                             const float *xyz,
+                             uint32_t count,
+                             float *out) {
+  Kernels()->transform_points(m, xyz, count, out);
+}
+
+void visMat4_ComposeTrs(const float *translation,
+                        const float *rotation,
+                        const float *scale,
+                        float *out) {
+  Kernels()->compose_trs(translation, rotation, scale, out);
+}
+
+void visMat4_ComposeTrsBatch(const float *const translation[3],
+                             const float *const rotation[4],
+                             const float *const scale[3],
+                             uint32_t count,
+                             float *out) {
+  Kernels()->compose_trs_batch(translation, rotation, scale, count, out);
+}
+
+void visMat4_Perspective(float fovInDegrees,
+                         float aspectRatio,
+                         float nearPlane,
+                         float farPlane,
+                         float *out) {
+  const float top = nearPlane * tanf(fovInDegrees * 0.5f * (float)M_PI / 180.0f);
+  const float right = top * aspectRatio;
+  memset(out, 0, 16 * sizeof(float));
+  out[0] = nearPlane / right;
+  out[5] = nearPlane / top;
+  out[10] = -(farPlane + nearPlane) / (farPlane - nearPlane);
+  out[11] = -1.0f;
+  out[14] = -2.0f * farPlane * nearPlane / (farPlane - nearPlane);
+}
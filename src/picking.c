@@ -0,0 +1,586 @@
+#include "cvis/picking.h"
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PICKER_INITIAL_CAPACITY 64
+/* Buckets the surface area heuristic sorts centroids into along the split axis */
+#define PICKER_NUM_BINS 12
+/* From this depth nodes are split in half, which ends any (up to 2^32 primitive) tree in time.
+ * Only a pathological scene gets this deep */
+#define PICKER_MEDIAN_DEPTH (VIS_PICKER_MAX_DEPTH - 32)
+/* Refit everything when more leaves than 1 in this many moved, cheaper than walking each up */
+#define PICKER_FULL_REFIT_FRACTION 8
+
+static void EmptyBounds(visPickBounds *bounds) {
+  for (int axis = 0; axis < 3; axis++) {
+    bounds->min[axis] = FLT_MAX;
+    bounds->max[axis] = -FLT_MAX;
+  }
+}
+
+static void GrowBounds(visPickBounds *bounds,
+                       const visPickBounds *other) {
+  for (int axis = 0; axis < 3; axis++) {
+    bounds->min[axis] = other->min[axis] < bounds->min[axis] ? other->min[axis] : bounds->min[axis];
+    bounds->max[axis] = other->max[axis] > bounds->max[axis] ? other->max[axis] : bounds->max[axis];
+  }
+}
+
+static float HalfSurfaceArea(const visPickBounds *bounds) {
+  const float x = bounds->max[0] - bounds->min[0];
+  const float y = bounds->max[1] - bounds->min[1];
+  const float z = bounds->max[2] - bounds->min[2];
+  return x * y + y * z + z * x;
+}
+
+static float Centroid(const visPickBounds *bounds,
+                      int axis) {
+  return 0.5f * (bounds->min[axis] + bounds->max[axis]);
+}
+
+static void ComputePrimitiveBounds(const visPickPrimitive *primitive,
+                                   visPickBounds *bounds) {
+  if (primitive->type == visPickType_Box) {
+    /* The yawed box's extent along x and y */
+    const float c = fabsf(cosf(primitive->c));
+    const float s = fabsf(sinf(primitive->c));
+    const float half_x = c * primitive->b.x + s * primitive->b.y;
+    const float half_y = s * primitive->b.x + c * primitive->b.y;
+    bounds->min[0] = primitive->a.x - half_x;
+    bounds->min[1] = primitive->a.y - half_y;
+    bounds->min[2] = primitive->a.z - primitive->b.z;
+    bounds->max[0] = primitive->a.x + half_x;
+    bounds->max[1] = primitive->a.y + half_y;
+    bounds->max[2] = primitive->a.z + primitive->b.z;
+  } else {
+    const float r = primitive->c;
+    bounds->min[0] = fminf(primitive->a.x, primitive->b.x) - r;
+    bounds->min[1] = fminf(primitive->a.y, primitive->b.y) - r;
+    bounds->min[2] = fminf(primitive->a.z, primitive->b.z) - r;
+    bounds->max[0] = fmaxf(primitive->a.x, primitive->b.x) + r;
+    bounds->max[1] = fmaxf(primitive->a.y, primitive->b.y) + r;
+    bounds->max[2] = fmaxf(primitive->a.z, primitive->b.z) + r;
+  }
+}
+
+bool visPicker_Init(visPicker *picker) {
+  memset(picker, 0, sizeof(visPicker));
+  return visPicker_Reserve(picker, PICKER_INITIAL_CAPACITY);
+}
+
+void visPicker_Free(visPicker *picker) {
+  free(picker->primitives);
+  free(picker->primitive_bounds);
+  free(picker->primitive_leaf);
+  free(picker->nodes);
+  free(picker->parents);
+  free(picker->order);
+  free(picker->dirty_leaves);
+  free(picker->leaf_dirty);
+  memset(picker, 0, sizeof(visPicker));
+}
+
+void visPicker_Clear(visPicker *picker) {
+  picker->count = 0;
+  picker->num_nodes = 0;
+  picker->num_dirty = 0;
+  picker->needs_build = false;
+}
+
+bool visPicker_Reserve(visPicker *picker,
+                       uint32_t capacity) {
+  if (capacity <= picker->capacity) {
+    return true;
+  }
+  /* A tree of n primitives has at most 2n - 1 nodes */
+  const size_t num_nodes = 2 * (size_t)capacity;
+  visPickPrimitive *primitives = (visPickPrimitive *)realloc(picker->primitives, capacity * sizeof(visPickPrimitive));
+  if (!primitives) {
+    return false;
+  }
+  picker->primitives = primitives;
+  visPickBounds *bounds = (visPickBounds *)realloc(picker->primitive_bounds, capacity * sizeof(visPickBounds));
+  if (!bounds) {
+    return false;
+  }
+  picker->primitive_bounds = bounds;
+  uint32_t *indices = (uint32_t *)realloc(picker->primitive_leaf, capacity * sizeof(uint32_t));
+  if (!indices) {
+    return false;
+  }
+  picker->primitive_leaf = indices;
+  indices = (uint32_t *)realloc(picker->order, capacity * sizeof(uint32_t));
+  if (!indices) {
+    return false;
+  }
+  picker->order = indices;
+  visPickNode *nodes = (visPickNode *)realloc(picker->nodes, num_nodes * sizeof(visPickNode));
+  if (!nodes) {
+    return false;
+  }
+  picker->nodes = nodes;
+  indices = (uint32_t *)realloc(picker->parents, num_nodes * sizeof(uint32_t));
+  if (!indices) {
+    return false;
+  }
+  picker->parents = indices;
+  indices = (uint32_t *)realloc(picker->dirty_leaves, num_nodes * sizeof(uint32_t));
+  if (!indices) {
+    return false;
+  }
+  picker->dirty_leaves = indices;
+  uint8_t *flags = (uint8_t *)realloc(picker->leaf_dirty, num_nodes);
+  if (!flags) {
+    return false;
+  }
+  picker->leaf_dirty = flags;
+  picker->capacity = capacity;
+  return true;
+}
+
+static uint32_t AddPrimitive(visPicker *picker,
+                             const visPickPrimitive *primitive) {
+  if (picker->count == picker->capacity && !visPicker_Reserve(picker, picker->capacity * 2)) {
+    return VIS_PICKER_INVALID;
+  }
+  const uint32_t handle = picker->count++;
+  picker->primitives[handle] = *primitive;
+  ComputePrimitiveBounds(primitive, &picker->primitive_bounds[handle]);
+  picker->needs_build = true;
+  return handle;
+}
+
+uint32_t visPicker_AddBox(visPicker *picker,
+                          const visVec3 *centre,
+                          const visVec3 *halfSize,
+                          float yaw,
+                          uint32_t id) {
+  const visPickPrimitive primitive = {*centre, *halfSize, yaw, id, visPickType_Box};
+  return AddPrimitive(picker, &primitive);
+}
+
+uint32_t visPicker_AddSegment(visPicker *picker,
+                              const visVec3 *start,
+                              const visVec3 *end,
+                              float radius,
+                              uint32_t id) {
+  const visPickPrimitive primitive = {*start, *end, radius, id, visPickType_Segment};
+  return AddPrimitive(picker, &primitive);
+}
+
+static void MovePrimitive(visPicker *picker,
+                          uint32_t handle) {
+  ComputePrimitiveBounds(&picker->primitives[handle], &picker->primitive_bounds[handle]);
+  if (picker->needs_build) {
+    return;
+  }
+  const uint32_t leaf = picker->primitive_leaf[handle];
+  if (!picker->leaf_dirty[leaf]) {
+    picker->leaf_dirty[leaf] = 1;
+    picker->dirty_leaves[picker->num_dirty++] = leaf;
+  }
+}
+
+void visPicker_SetBox(visPicker *picker,
+                      uint32_t handle,
+                      const visVec3 *centre,
+                      const visVec3 *halfSize,
+                      float yaw) {
+  visPickPrimitive *primitive = &picker->primitives[handle];
+  primitive->a = *centre;
+  primitive->b = *halfSize;
+  primitive->c = yaw;
+  MovePrimitive(picker, handle);
+}
+
+void visPicker_SetSegment(visPicker *picker,
+                          uint32_t handle,
+                          const visVec3 *start,
+                          const visVec3 *end,
+                          float radius) {
+  visPickPrimitive *primitive = &picker->primitives[handle];
+  primitive->a = *start;
+  primitive->b = *end;
+  primitive->c = radius;
+  MovePrimitive(picker, handle);
+}
+
+/**
+ * Where to split order[start, end), by the surface area heuristic over PICKER_NUM_BINS buckets
+ * of centroids along the longest axis. Falls back to splitting in half, in whatever order the
+ * primitives are in
+ * \return index in order of the first primitive on the right
+ */
+static uint32_t SplitNode(visPicker *picker,
+                          uint32_t start,
+                          uint32_t end,
+                          uint32_t depth) {
+  const uint32_t middle = start + (end - start) / 2;
+  visPickBounds centroids;
+  EmptyBounds(&centroids);
+  for (uint32_t i = start; i < end; i++) {
+    const visPickBounds *bounds = &picker->primitive_bounds[picker->order[i]];
+    for (int axis = 0; axis < 3; axis++) {
+      const float centroid = Centroid(bounds, axis);
+      centroids.min[axis] = centroid < centroids.min[axis] ? centroid : centroids.min[axis];
+      centroids.max[axis] = centroid > centroids.max[axis] ? centroid : centroids.max[axis];
+    }
+  }
+  int axis = 0;
+  for (int a = 1; a < 3; a++) {
+    if (centroids.max[a] - centroids.min[a] > centroids.max[axis] - centroids.min[axis]) {
+      axis = a;
+    }
+  }
+  const float extent = centroids.max[axis] - centroids.min[axis];
+  if (extent <= 0.0f || depth >= PICKER_MEDIAN_DEPTH) {
+    /* Every split is as good as any other, or the tree is too deep already */
+    return middle;
+  }
+
+  uint32_t bin_count[PICKER_NUM_BINS] = {0};
+  visPickBounds bin_bounds[PICKER_NUM_BINS];
+  for (int b = 0; b < PICKER_NUM_BINS; b++) {
+    EmptyBounds(&bin_bounds[b]);
+  }
+  const float scale = (float)PICKER_NUM_BINS / extent;
+  for (uint32_t i = start; i < end; i++) {
+    const visPickBounds *bounds = &picker->primitive_bounds[picker->order[i]];
+    int b = (int)((Centroid(bounds, axis) - centroids.min[axis]) * scale);
+    b = b < PICKER_NUM_BINS ? b : PICKER_NUM_BINS - 1;
+    bin_count[b]++;
+    GrowBounds(&bin_bounds[b], bounds);
+  }
+
+  /* Cost of splitting after bin b, area * primitives either side */
+  float right_cost[PICKER_NUM_BINS];
+  visPickBounds sweep;
+  EmptyBounds(&sweep);
+  uint32_t count = 0;
+  for (int b = PICKER_NUM_BINS - 1; b > 0; b--) {
+    GrowBounds(&sweep, &bin_bounds[b]);
+    count += bin_count[b];
+    right_cost[b - 1] = count > 0 ? HalfSurfaceArea(&sweep) * (float)count : 0.0f;
+  }
+  EmptyBounds(&sweep);
+  count = 0;
+  int best_bin = -1;
+  float best_cost = FLT_MAX;
+  for (int b = 0; b < PICKER_NUM_BINS - 1; b++) {
+    GrowBounds(&sweep, &bin_bounds[b]);
+    count += bin_count[b];
+    if (count == 0 || count == end - start) {
+      continue;
+    }
+    const float cost = HalfSurfaceArea(&sweep) * (float)count + right_cost[b];
+    if (cost < best_cost) {
+      best_cost = cost;
+      best_bin = b;
+    }
+  }
+  if (best_bin < 0) {
+    return middle;
+  }
+
+  uint32_t i = start;
+  uint32_t j = end;
+  while (i < j) {
+    const visPickBounds *bounds = &picker->primitive_bounds[picker->order[i]];
+    int b = (int)((Centroid(bounds, axis) - centroids.min[axis]) * scale);
+    b = b < PICKER_NUM_BINS ? b : PICKER_NUM_BINS - 1;
+    if (b <= best_bin) {
+      i++;
+    } else {
+      j--;
+      const uint32_t swap = picker->order[i];
+      picker->order[i] = picker->order[j];
+      picker->order[j] = swap;
+    }
+  }
+  return i;
+}
+
+bool visPicker_Build(visPicker *picker) {
+  picker->needs_build = false;
+  picker->num_dirty = 0;
+  picker->num_nodes = 0;
+  if (picker->count == 0) {
+    return true;
+  }
+  for (uint32_t i = 0; i < picker->count; i++) {
+    picker->order[i] = i;
+  }
+  memset(picker->leaf_dirty, 0, 2 * (size_t)picker->count);
+
+  /* Depth first, each node's children are made when it is split */
+  struct {
+    uint32_t node;
+    uint32_t start;
+    uint32_t end;
+    uint32_t depth;
+  } stack[VIS_PICKER_MAX_DEPTH + 1];
+  int stack_size = 0;
+  picker->num_nodes = 1;
+  picker->parents[0] = VIS_PICKER_INVALID;
+  stack[stack_size].node = 0;
+  stack[stack_size].start = 0;
+  stack[stack_size].end = picker->count;
+  stack[stack_size].depth = 0;
+  stack_size++;
+  while (stack_size > 0) {
+    stack_size--;
+    const uint32_t index = stack[stack_size].node;
+    const uint32_t start = stack[stack_size].start;
+    const uint32_t end = stack[stack_size].end;
+    const uint32_t depth = stack[stack_size].depth;
+    visPickNode *node = &picker->nodes[index];
+    EmptyBounds(&node->bounds);
+    for (uint32_t i = start; i < end; i++) {
+      GrowBounds(&node->bounds, &picker->primitive_bounds[picker->order[i]]);
+    }
+    if (end - start <= VIS_PICKER_MAX_LEAF_SIZE) {
+      node->first = start;
+      node->count = end - start;
+      for (uint32_t i = start; i < end; i++) {
+        picker->primitive_leaf[picker->order[i]] = index;
+      }
+      continue;
+    }
+
+    const uint32_t split = SplitNode(picker, start, end, depth);
+    const uint32_t left = picker->num_nodes;
+    picker->num_nodes += 2;
+    node->first = left;
+    node->count = 0;
+    picker->parents[left] = index;
+    picker->parents[left + 1] = index;
+    stack[stack_size].node = left + 1;
+    stack[stack_size].start = split;
+    stack[stack_size].end = end;
+    stack[stack_size].depth = depth + 1;
+    stack_size++;
+    stack[stack_size].node = left;
+    stack[stack_size].start = start;
+    stack[stack_size].end = split;
+    stack[stack_size].depth = depth + 1;
+    stack_size++;
+  }
+  return true;
+}
+
+static void RefitNode(visPicker *picker,
+                      uint32_t index) {
+  visPickNode *node = &picker->nodes[index];
+  EmptyBounds(&node->bounds);
+  if (node->count > 0) {
+    for (uint32_t i = node->first; i < node->first + node->count; i++) {
+      GrowBounds(&node->bounds, &picker->primitive_bounds[picker->order[i]]);
+    }
+  } else {
+    GrowBounds(&node->bounds, &picker->nodes[node->first].bounds);
+    GrowBounds(&node->bounds, &picker->nodes[node->first + 1].bounds);
+  }
+}
+
+void visPicker_Refit(visPicker *picker) {
+  if (picker->num_dirty == 0) {
+    return;
+  }
+  if (picker->num_dirty > picker->num_nodes / PICKER_FULL_REFIT_FRACTION) {
+    /* Children come after their parents, so going backwards refits them first */
+    for (uint32_t index = picker->num_nodes; index-- > 0;) {
+      RefitNode(picker, index);
+    }
+  } else {
+    for (uint32_t d = 0; d < picker->num_dirty; d++) {
+      uint32_t index = picker->dirty_leaves[d];
+      RefitNode(picker, index);
+      /* Up to the root, or until a node's box no longer changes */
+      for (index = picker->parents[index]; index != VIS_PICKER_INVALID; index = picker->parents[index]) {
+        const visPickBounds previous = picker->nodes[index].bounds;
+        RefitNode(picker, index);
+        if (memcmp(&previous, &picker->nodes[index].bounds, sizeof(visPickBounds)) == 0) {
+          break;
+        }
+      }
+    }
+  }
+  for (uint32_t d = 0; d < picker->num_dirty; d++) {
+    picker->leaf_dirty[picker->dirty_leaves[d]] = 0;
+  }
+  picker->num_dirty = 0;
+}
+
+/**
+ * Slab test
+ * \return distance along the ray the box is entered, or FLT_MAX if it is missed or further than
+ * maxDistance
+ */
+static float IntersectBounds(const visPickBounds *bounds,
+                             const visVec3 *origin,
+                             const visVec3 *inverseDirection,
+                             float maxDistance) {
+  float t0 = (bounds->min[0] - origin->x) * inverseDirection->x;
+  float t1 = (bounds->max[0] - origin->x) * inverseDirection->x;
+  float near = fminf(t0, t1);
+  float far = fmaxf(t0, t1);
+  t0 = (bounds->min[1] - origin->y) * inverseDirection->y;
+  t1 = (bounds->max[1] - origin->y) * inverseDirection->y;
+  near = fmaxf(near, fminf(t0, t1));
+  far = fminf(far, fmaxf(t0, t1));
+  t0 = (bounds->min[2] - origin->z) * inverseDirection->z;
+  t1 = (bounds->max[2] - origin->z) * inverseDirection->z;
+  near = fmaxf(near, fminf(t0, t1));
+  far = fminf(far, fmaxf(t0, t1));
+  near = fmaxf(near, 0.0f);
+  return near <= far && near < maxDistance ? near : FLT_MAX;
+}
+
+/* The ray in the box's frame against its half size, returns the distance or FLT_MAX */
+static float IntersectBox(const visPickPrimitive *box,
+                          const visRay *ray) {
+  const float c = cosf(box->c);
+  const float s = sinf(box->c);
+  const float x = ray->origin.x - box->a.x;
+  const float y = ray->origin.y - box->a.y;
+  const visVec3 origin = {c * x + s * y, -s * x + c * y, ray->origin.z - box->a.z};
+  const visVec3 inverse_direction = {1.0f / (c * ray->direction.x + s * ray->direction.y),
+                                   1.0f / (-s * ray->direction.x + c * ray->direction.y),
+                                   1.0f / ray->direction.z};
+  const visPickBounds bounds = {{-box->b.x, -box->b.y, -box->b.z}, {box->b.x, box->b.y, box->b.z}};
+  return IntersectBounds(&bounds, &origin, &inverse_direction, FLT_MAX);
+}
+
+/**
+ * Closest approach of the ray and the segment (Ericson, Real-Time Collision Detection 5.1.9)
+ * \param closest output, the closest point on the segment
+ * \return distance along the ray, or FLT_MAX if it does not pass within the radius
+ */
+static float IntersectSegment(const visPickPrimitive *segment,
+                              const visRay *ray,
+                              visVec3 *closest) {
+  const visVec3 u = {segment->b.x - segment->a.x, segment->b.y - segment->a.y, segment->b.z - segment->a.z};
+  const visVec3 w = {ray->origin.x - segment->a.x, ray->origin.y - segment->a.y, ray->origin.z - segment->a.z};
+  const visVec3 *d = &ray->direction;
+  const float b = d->x * u.x + d->y * u.y + d->z * u.z;
+  const float c = d->x * w.x + d->y * w.y + d->z * w.z;
+  const float e = u.x * u.x + u.y * u.y + u.z * u.z;
+  const float f = u.x * w.x + u.y * w.y + u.z * w.z;
+
+  float t = 0.0f;
+  float s = 0.0f;
+  if (e <= FLT_EPSILON) {
+    /* A point */
+    t = fmaxf(-c, 0.0f);
+  } else {
+    const float denominator = e - b * b;
+    t = denominator > FLT_EPSILON * e ? fmaxf((b * f - c * e) / denominator, 0.0f) : 0.0f;
+    s = (b * t + f) / e;
+    if (s < 0.0f) {
+      s = 0.0f;
+      t = fmaxf(-c, 0.0f);
+    } else if (s > 1.0f) {
+      s = 1.0f;
+      t = fmaxf(b - c, 0.0f);
+    }
+  }
+  closest->x = segment->a.x + s * u.x;
+  closest->y = segment->a.y + s * u.y;
+  closest->z = segment->a.z + s * u.z;
+  const float dx = ray->origin.x + t * d->x - closest->x;
+  const float dy = ray->origin.y + t * d->y - closest->y;
+  const float dz = ray->origin.z + t * d->z - closest->z;
+  return dx * dx + dy * dy + dz * dz <= segment->c * segment->c ? t : FLT_MAX;
+}
+
+bool visPicker_Pick(visPicker *picker,
+                    const visRay *ray,
+                    visPickHit *hit) {
+  if (picker->needs_build) {
+    visPicker_Build(picker);
+  }
+  visPicker_Refit(picker);
+  if (picker->num_nodes == 0) {
+    return false;
+  }
+
+  const visVec3 inverse_direction = {1.0f / ray->direction.x, 1.0f / ray->direction.y, 1.0f / ray->direction.z};
+  float best = FLT_MAX;
+  uint32_t best_primitive = VIS_PICKER_INVALID;
+  visVec3 best_position = {0.0f, 0.0f, 0.0f};
+
+  /* Nearer child first, nodes further than the best hit so far are skipped */
+  struct {
+    uint32_t node;
+    float distance;
+  } stack[VIS_PICKER_MAX_DEPTH + 1];
+  int stack_size = 0;
+  const float root_distance = IntersectBounds(&picker->nodes[0].bounds, &ray->origin, &inverse_direction, best);
+  if (root_distance == FLT_MAX) {
+    return false;
+  }
+  stack[0].node = 0;
+  stack[0].distance = root_distance;
+  stack_size = 1;
+  while (stack_size > 0) {
+    stack_size--;
+    if (stack[stack_size].distance >= best) {
+      continue;
+    }
+    const visPickNode *node = &picker->nodes[stack[stack_size].node];
+    if (node->count > 0) {
+      for (uint32_t i = node->first; i < node->first + node->count; i++) {
+        const uint32_t index = picker->order[i];
+        const visPickPrimitive *primitive = &picker->primitives[index];
+        visVec3 position;
+        float distance;
+        if (primitive->type == visPickType_Box) {
+          distance = IntersectBox(primitive, ray);
+          position.x = ray->origin.x + distance * ray->direction.x;
+          position.y = ray->origin.y + distance * ray->direction.y;
+          position.z = ray->origin.z + distance * ray->direction.z;
+        } else {
+          distance = IntersectSegment(primitive, ray, &position);
+        }
+        if (distance < best) {
+          best = distance;
+          best_primitive = index;
+          best_position = position;
+        }
+      }
+      continue;
+    }
+    uint32_t near = node->first;
+    uint32_t far = node->first + 1;
+    float near_distance = IntersectBounds(&picker->nodes[near].bounds, &ray->origin, &inverse_direction, best);
+    float far_distance = IntersectBounds(&picker->nodes[far].bounds, &ray->origin, &inverse_direction, best);
+    if (far_distance < near_distance) {
+      near = node->first + 1;
+      far = node->first;
+      const float swap = near_distance;
+      near_distance = far_distance;
+      far_distance = swap;
+    }
+    if (far_distance != FLT_MAX) {
+      stack[stack_size].node = far;
+      stack[stack_size].distance = far_distance;
+      stack_size++;
+    }
+    if (near_distance != FLT_MAX) {
+      stack[stack_size].node = near;
+      stack[stack_size].distance = near_distance;
+      stack_size++;
+    }
+  }
+
+  if (best_primitive == VIS_PICKER_INVALID) {
+    return false;
+  }
+  hit->type = picker->primitives[best_primitive].type;
+  hit->id = picker->primitives[best_primitive].id;
+  hit->distance = best;
+  hit->position = best_position;
+  return true;
+}
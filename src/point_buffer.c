@@ -0,0 +1,131 @@
+#include "cvis/point_buffer.h"
+#include "cvis/gl_state.h"
+#include "glad/glad.h"
+#include <stdlib.h>
+
+#define POINT_BUFFER_DEFAULT_CAPACITY 1024
+
+bool visPointBuffer_Init(visPointBuffer *buffer,
+                         uint32_t initialCapacity) {
+  buffer->count = 0;
+  buffer->uploaded_count = 0;
+  buffer->gpu_capacity = 0;
+  buffer->vbo = 0;
+  buffer->bytes_uploaded = 0;
+  buffer->gpu_reallocations = 0;
+
+  buffer->capacity = initialCapacity > 0 ? initialCapacity : POINT_BUFFER_DEFAULT_CAPACITY;
+  buffer->points = (visVec3 *)malloc(buffer->capacity * sizeof(visVec3));
+  if (!buffer->points) {
+    buffer->capacity = 0;
+    return false;
+  }
+  return true;
+}
+
+void visPointBuffer_InitGpu(visPointBuffer *buffer) {
+  glGenBuffers(1, &buffer->vbo);
+}
+
+void visPointBuffer_Free(visPointBuffer *buffer) {
+  free(buffer->points);
+  buffer->points = NULL;
+  buffer->count = 0;
+  buffer->capacity = 0;
+  buffer->uploaded_count = 0;
+  if (buffer->vbo != 0) {
+    glDeleteBuffers(1, &buffer->vbo);
+    /* Deleting a bound buffer unbinds it behind the state cache's back */
+    visGlState_Invalidate();
+    buffer->vbo = 0;
+  }
+  buffer->gpu_capacity = 0;
+}
+
+static bool Grow(visPointBuffer *buffer) {
+  /* Double the storage so the cost of copying is amortized over all the appends */
+  uint32_t new_capacity = buffer->capacity > 0 ? buffer->capacity * 2 : POINT_BUFFER_DEFAULT_CAPACITY;
+  if (new_capacity <= buffer->capacity) {
+    /* Overflowed uint32 */
+    return false;
+  }
+  visVec3 *new_points = (visVec3 *)realloc(buffer->points, new_capacity * sizeof(visVec3));
+  if (!new_points) {
+    return false;
+  }
+  buffer->points = new_points;
+  buffer->capacity = new_capacity;
+  return true;
+}
+
+bool visPointBuffer_Append(visPointBuffer *buffer,
+                           float x,
+                           float y,
+                           float z) {
+  if (buffer->count == buffer->capacity && !Grow(buffer)) {
+    return false;
+  }
+  visVec3 *point = &buffer->points[buffer->count];
+  point->x = x;
+  point->y = y;
+  point->z = z;
+  buffer->count += 1;
+  return true;
+}
+
+bool visPointBuffer_Reserve(visPointBuffer *buffer,
+                            uint32_t count) {
+  while (buffer->capacity < count) {
+    if (!Grow(buffer)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void visPointBuffer_Clear(visPointBuffer *buffer) {
+  buffer->count = 0;
+  buffer->uploaded_count = 0;
+}
+
+visPointBufferUpload visPointBuffer_PrepareUpload(visPointBuffer *buffer) {
+  visPointBufferUpload upload = {0};
+
+  if (buffer->count > buffer->gpu_capacity) {
+    /* The gpu buffer is too small, so it gets reallocated to match the cpu capacity (which
+     * grows by doubling). Reallocating throws away the old contents so everything is re-sent,
+     * this happens O(log N) times so the total upload stays O(N) */
+    upload.reallocate = true;
+    upload.capacity = buffer->capacity;
+    upload.first = 0;
+    upload.count = buffer->count;
+    buffer->gpu_capacity = buffer->capacity;
+    buffer->gpu_reallocations += 1;
+  }
+  else {
+    upload.first = buffer->uploaded_count;
+    upload.count = buffer->count - buffer->uploaded_count;
+  }
+
+  buffer->uploaded_count = buffer->count;
+  buffer->bytes_uploaded += (uint64_t)upload.count * sizeof(visVec3);
+  return upload;
+}
+
+void visPointBuffer_Upload(visPointBuffer *buffer) {
+  visPointBufferUpload upload = visPointBuffer_PrepareUpload(buffer);
+  if (!upload.reallocate && upload.count == 0) {
+    return;
+  }
+
+  visGlState_BindBuffer(GL_ARRAY_BUFFER, buffer->vbo);
+  if (upload.reallocate) {
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)upload.capacity * sizeof(visVec3), NULL, GL_DYNAMIC_DRAW);
+  }
+  if (upload.count > 0) {
+    glBufferSubData(GL_ARRAY_BUFFER,
+                    (GLintptr)upload.first * sizeof(visVec3),
+                    (GLsizeiptr)upload.count * sizeof(visVec3),
+                    &buffer->points[upload.first]);
+  }
+}
@@ -0,0 +1,311 @@
+#include "cvis/polyline_lod.h"
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+
+/* A chunk's levels have to line up with it */
+_Static_assert(VIS_CULL_CHUNK_SHIFT % VIS_POLYLINE_LOD_FACTOR_SHIFT == 0, "chunk is not a power of 4");
+
+bool visPolylineLod_Init(visPolylineLod *lod) {
+  bool success = true;
+  visAabbArray_Init(&lod->chunks);
+  for (uint32_t l = 0; l < VIS_POLYLINE_LOD_MAX_LEVELS; l++) {
+    /* Each level is 1/4 of the size of the one below it */
+    const uint32_t capacity = 1024u >> (l < 5 ? 2 * l : 8);
+    success &= visPointBuffer_Init(&lod->levels[l], capacity);
+    lod->cell_error[l] = NULL;
+    lod->num_cells[l] = 0;
+    lod->cell_capacity[l] = 0;
+  }
+  /* Room for the fallback range if growing them fails later */
+  lod->range_capacity = 64;
+  lod->ranges = (visPolylineLodRange *)malloc(lod->range_capacity * sizeof(visPolylineLodRange));
+  lod->range_capacity = lod->ranges ? lod->range_capacity : 0;
+  success &= lod->ranges != NULL;
+  lod->num_ranges = 0;
+  visPolylineLod_Clear(lod);
+  return success;
+}
+
+void visPolylineLod_InitGpu(visPolylineLod *lod) {
+  for (uint32_t l = 0; l < VIS_POLYLINE_LOD_MAX_LEVELS; l++) {
+    visPointBuffer_InitGpu(&lod->levels[l]);
+  }
+}
+
+void visPolylineLod_Free(visPolylineLod *lod) {
+  for (uint32_t l = 0; l < VIS_POLYLINE_LOD_MAX_LEVELS; l++) {
+    visPointBuffer_Free(&lod->levels[l]);
+    free(lod->cell_error[l]);
+    lod->cell_error[l] = NULL;
+    lod->num_cells[l] = 0;
+    lod->cell_capacity[l] = 0;
+  }
+  visAabbArray_Free(&lod->chunks);
+  free(lod->ranges);
+  lod->ranges = NULL;
+  lod->num_ranges = 0;
+  lod->range_capacity = 0;
+}
+
+/* Grow a level's error up to a cell. New cells have no error */
+static bool ExtendError(visPolylineLod *lod,
+                        uint32_t level,
+                        uint32_t cell,
+                        float error) {
+  if (cell >= lod->cell_capacity[level]) {
+    uint32_t capacity = lod->cell_capacity[level] > 0 ? 2 * lod->cell_capacity[level] : 16;
+    while (capacity <= cell) {
+      capacity *= 2;
+    }
+    float *errors = (float *)realloc(lod->cell_error[level], capacity * sizeof(float));
+    if (!errors) {
+      return false;
+    }
+    lod->cell_error[level] = errors;
+    lod->cell_capacity[level] = capacity;
+  }
+  while (lod->num_cells[level] <= cell) {
+    lod->cell_error[level][lod->num_cells[level]++] = 0.0f;
+  }
+  lod->cell_error[level][cell] = fmaxf(lod->cell_error[level][cell], error);
+  return true;
+}
+
+/* Distance of point p from the segment a -> b */
+static float DistanceToSegment(const visVec3 *p,
+                               const visVec3 *a,
+                               const visVec3 *b) {
+  const float abx = b->x - a->x;
+  const float aby = b->y - a->y;
+  const float abz = b->z - a->z;
+  const float apx = p->x - a->x;
+  const float apy = p->y - a->y;
+  const float apz = p->z - a->z;
+  const float length_sq = abx * abx + aby * aby + abz * abz;
+  float t = 0.0f;
+  if (length_sq > 0.0f) {
+    t = (apx * abx + apy * aby + apz * abz) / length_sq;
+    t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+  }
+  const float dx = apx - t * abx;
+  const float dy = apy - t * aby;
+  const float dz = apz - t * abz;
+  return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+bool visPolylineLod_Append(visPolylineLod *lod,
+                           float x,
+                           float y,
+                           float z) {
+  visPointBuffer *raw = &lod->levels[0];
+  /* First point of a new chunk. An empty chunk left by a failed append is never visible */
+  const uint32_t chunk = raw->count >> VIS_CULL_CHUNK_SHIFT;
+  if (chunk == lod->chunks.count && !visAabbArray_Push(&lod->chunks)) {
+    return false;
+  }
+  if (!visPointBuffer_Append(raw, x, y, z)) {
+    return false;
+  }
+  lod->min.x = fminf(lod->min.x, x);
+  lod->min.y = fminf(lod->min.y, y);
+  lod->min.z = fminf(lod->min.z, z);
+  lod->max.x = fmaxf(lod->max.x, x);
+  lod->max.y = fmaxf(lod->max.y, y);
+  lod->max.z = fmaxf(lod->max.z, z);
+
+  const uint32_t index = raw->count - 1;
+  if (chunk > 0 && (index & (VIS_CULL_CHUNK_SIZE - 1)) == 0) {
+    /* The segment joining the chunks belongs to the previous one */
+    visAabbArray_Extend(&lod->chunks, chunk - 1, x, y, z);
+  }
+  visAabbArray_Extend(&lod->chunks, chunk, x, y, z);
+
+  for (uint32_t l = 1; l < VIS_POLYLINE_LOD_MAX_LEVELS; l++) {
+    const uint32_t stride = 1u << (VIS_POLYLINE_LOD_FACTOR_SHIFT * l);
+    if (index % stride != 0) {
+      /* Not a vertex on this level, so not on any of the coarser levels either */
+      break;
+    }
+    if (index > 0) {
+      /* A segment on this level just closed, measure how far the original points it replaces
+       * are from it. Each original point is visited once per level */
+      const visVec3 *a = &raw->points[index - stride];
+      const visVec3 *b = &raw->points[index];
+      float error = 0.0f;
+      for (uint32_t i = index - stride + 1; i < index; i++) {
+        error = fmaxf(error, DistanceToSegment(&raw->points[i], a, b));
+      }
+      /* The cell the segment starts in */
+      if (!ExtendError(lod, l, (index - stride) >> visPolylineLod_CellShift(l), error)) {
+        return false;
+      }
+    }
+    if (!visPointBuffer_Append(&lod->levels[l], x, y, z)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool visPolylineLod_Reserve(visPolylineLod *lod,
+                            uint32_t count) {
+  const uint32_t num_chunks = (count + VIS_CULL_CHUNK_SIZE - 1) >> VIS_CULL_CHUNK_SHIFT;
+  return visPointBuffer_Reserve(&lod->levels[0], count) && visAabbArray_Reserve(&lod->chunks, num_chunks);
+}
+
+void visPolylineLod_Clear(visPolylineLod *lod) {
+  for (uint32_t l = 0; l < VIS_POLYLINE_LOD_MAX_LEVELS; l++) {
+    visPointBuffer_Clear(&lod->levels[l]);
+    lod->num_cells[l] = 0;
+  }
+  lod->num_ranges = 0;
+  lod->chunks.count = 0;
+  lod->min.x = lod->min.y = lod->min.z = FLT_MAX;
+  lod->max.x = lod->max.y = lod->max.z = -FLT_MAX;
+}
+
+/* Append a range to lod->ranges
+ * \return NULL if out of memory */
+static visPolylineLodRange *NewRange(visPolylineLod *lod) {
+  if (lod->num_ranges == lod->range_capacity) {
+    const uint32_t capacity = lod->range_capacity > 0 ? 2 * lod->range_capacity : 64;
+    visPolylineLodRange *ranges = (visPolylineLodRange *)realloc(lod->ranges, capacity * sizeof(visPolylineLodRange));
+    if (!ranges) {
+      return NULL;
+    }
+    lod->ranges = ranges;
+    lod->range_capacity = capacity;
+  }
+  return &lod->ranges[lod->num_ranges++];
+}
+
+/* Add vertices [first, first + count) of a level to the ranges, joined onto the last range if
+ * it is on the same level and ends at first */
+static bool AddRange(visPolylineLod *lod,
+                     uint32_t level,
+                     uint32_t first,
+                     uint32_t count) {
+  if (count < 2) {
+    /* A single vertex is the shared one, nothing new to draw */
+    return true;
+  }
+  if (lod->num_ranges > 0) {
+    visPolylineLodRange *last = &lod->ranges[lod->num_ranges - 1];
+    if (last->level == level && last->first + last->count - 1 == first) {
+      last->count += count - 1;
+      return true;
+    }
+  }
+  visPolylineLodRange *range = NewRange(lod);
+  if (!range) {
+    return false;
+  }
+  range->level = level;
+  range->first = first;
+  range->count = count;
+  return true;
+}
+
+/* Error of the segments of a level in a cell, FLT_MAX if the level has no finished segment there */
+static float CellError(const visPolylineLod *lod,
+                       uint32_t level,
+                       uint32_t cell) {
+  return cell < lod->num_cells[level] ? lod->cell_error[level][cell] : FLT_MAX;
+}
+
+/* Draw the original points [first, last] of a chunk on the coarsest level that is good enough.
+ * Past the last vertex of that level the rest is drawn from each finer level in turn */
+static bool SelectChunk(visPolylineLod *lod,
+                        uint32_t chunk,
+                        uint32_t first,
+                        uint32_t last,
+                        float maxError) {
+  /* The error only grows with the level, so stop at the first one that is too coarse */
+  uint32_t level = 0;
+  while (level < VIS_POLYLINE_LOD_CHUNK_LEVEL && CellError(lod, level + 1, chunk) <= maxError) {
+    level++;
+  }
+  uint32_t position = first;
+  for (uint32_t l = level + 1; l-- > 0;) {
+    const uint32_t shift = VIS_POLYLINE_LOD_FACTOR_SHIFT * l;
+    const uint32_t start = position >> shift;
+    const uint32_t end = last >> shift;
+    if (!AddRange(lod, l, start, end - start + 1)) {
+      return false;
+    }
+    position = end << shift;
+  }
+  return true;
+}
+
+/* Draw the original points [first, min(first + 4^level, last)] of a segment on a level at least
+ * as coarse as a chunk, splitting it into the 4 segments of the level below if it's not good
+ * enough or not finished */
+static bool SelectSegment(visPolylineLod *lod,
+                          uint32_t level,
+                          uint32_t segment,
+                          uint32_t last,
+                          float maxError) {
+  const uint32_t shift = VIS_POLYLINE_LOD_FACTOR_SHIFT * level;
+  const uint64_t first = (uint64_t)segment << shift;
+  const uint64_t end = first + (1ull << shift);
+  if (first >= last) {
+    return true;
+  }
+  if (level == VIS_POLYLINE_LOD_CHUNK_LEVEL) {
+    return SelectChunk(lod, segment, (uint32_t)first, end < last ? (uint32_t)end : last, maxError);
+  }
+  if (end <= last && CellError(lod, level, segment) <= maxError) {
+    return AddRange(lod, level, segment, 2);
+  }
+  for (uint32_t child = 0; child < VIS_POLYLINE_LOD_FACTOR; child++) {
+    if (!SelectSegment(lod, level - 1, VIS_POLYLINE_LOD_FACTOR * segment + child, last, maxError)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint32_t visPolylineLod_Select(visPolylineLod *lod,
+                               float maxError) {
+  lod->num_ranges = 0;
+  const uint32_t count = lod->levels[0].count;
+  if (count == 0) {
+    return 0;
+  }
+  const uint32_t last = count - 1;
+  const uint32_t top = VIS_POLYLINE_LOD_MAX_LEVELS - 1;
+  bool success = true;
+  if (count == 1) {
+    /* No segments, but the point is still drawn */
+    visPolylineLodRange *range = NewRange(lod);
+    success = range != NULL;
+    if (range) {
+      range->level = 0;
+      range->first = 0;
+      range->count = 1;
+    }
+  }
+  for (uint32_t segment = 0; success && segment <= (last >> (VIS_POLYLINE_LOD_FACTOR_SHIFT * top)); segment++) {
+    success = SelectSegment(lod, top, segment, last, maxError);
+  }
+  if (!success) {
+    /* Out of memory, the original points are always right */
+    lod->num_ranges = 0;
+    if (lod->range_capacity == 0) {
+      return 0;
+    }
+    lod->ranges[0].level = 0;
+    lod->ranges[0].first = 0;
+    lod->ranges[0].count = count;
+    lod->num_ranges = 1;
+  }
+  return lod->num_ranges;
+}
+
+void visPolylineLod_Upload(visPolylineLod *lod) {
+  for (uint32_t l = 0; l < VIS_POLYLINE_LOD_MAX_LEVELS; l++) {
+    visPointBuffer_Upload(&lod->levels[l]);
+  }
+}
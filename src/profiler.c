@@ -0,0 +1,340 @@
+#include "cvis/profiler.h"
+#include "glad/glad.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* Query sets, a frame's set is read back when it comes round again */
+#define PROFILER_FRAMES_IN_FLIGHT 2
+#define PROFILER_MAX_DEPTH 16
+#define PROFILER_NO_SCOPE UINT32_MAX
+/* Distinct scope names averaged */
+#define PROFILER_MAX_NAMES 32
+
+typedef struct {
+  visProfilerFrame frame;
+  /* Query timing each scope, 0 if it has none */
+  uint32_t scope_queries[VIS_PROFILER_MAX_SCOPES];
+  /* Ended but waiting for its gpu times */
+  bool pending;
+} InFlightFrame;
+
+static bool enabled_ = false;
+static bool gpu_timing_ = true;
+static double epoch_ms_ = 0.0;
+static uint64_t frame_index_ = 0;
+
+static bool queries_created_ = false;
+static uint32_t queries_[PROFILER_FRAMES_IN_FLIGHT][VIS_PROFILER_MAX_SCOPES];
+static InFlightFrame in_flight_[PROFILER_FRAMES_IN_FLIGHT];
+/* The frame between visProfiler_BeginFrame and visProfiler_EndFrame, NULL outside a frame */
+static InFlightFrame *current_ = NULL;
+static uint32_t current_slot_ = 0;
+
+/* Scopes open in the current frame, PROFILER_NO_SCOPE for ones that didn't fit */
+static uint32_t open_scopes_[PROFILER_MAX_DEPTH];
+static uint32_t depth_ = 0;
+static bool gpu_query_open_ = false;
+
+/* Ring of complete frames */
+static visProfilerFrame history_[VIS_PROFILER_HISTORY];
+static uint32_t history_start_ = 0;
+static uint32_t history_count_ = 0;
+
+static double NowMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1.0e3 + (double)ts.tv_nsec * 1.0e-6;
+}
+
+static void PushHistory(const visProfilerFrame *frame) {
+  uint32_t slot;
+  if (history_count_ < VIS_PROFILER_HISTORY) {
+    slot = (history_start_ + history_count_) % VIS_PROFILER_HISTORY;
+    history_count_ += 1;
+  }
+  else {
+    slot = history_start_;
+    history_start_ = (history_start_ + 1) % VIS_PROFILER_HISTORY;
+  }
+  history_[slot] = *frame;
+}
+
+/* Read back the gpu times of a frame that has been in flight, never waits on the gpu */
+static void Resolve(InFlightFrame *in_flight) {
+  visProfilerFrame *frame = &in_flight->frame;
+  for (uint32_t i = 0; i < frame->num_scopes; i++) {
+    const uint32_t query = in_flight->scope_queries[i];
+    if (query == 0) {
+      continue;
+    }
+    GLint available = 0;
+    glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available) {
+      GLuint64 elapsed_ns = 0;
+      glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed_ns);
+      frame->scopes[i].gpu_ms = (float)((double)elapsed_ns * 1.0e-6);
+    }
+  }
+  PushHistory(frame);
+  in_flight->pending = false;
+}
+
+static void EndOpenQuery() {
+  if (gpu_query_open_) {
+    glEndQuery(GL_TIME_ELAPSED);
+    gpu_query_open_ = false;
+  }
+}
+
+void visProfiler_SetEnabled(bool enabled) {
+  if (enabled == enabled_) {
+    return;
+  }
+  enabled_ = enabled;
+  EndOpenQuery();
+  current_ = NULL;
+  depth_ = 0;
+  if (enabled) {
+    /* Start from a clean history, anything still in flight is from the last time it was on */
+    epoch_ms_ = NowMs();
+    frame_index_ = 0;
+    history_start_ = 0;
+    history_count_ = 0;
+    for (uint32_t i = 0; i < PROFILER_FRAMES_IN_FLIGHT; i++) {
+      in_flight_[i].pending = false;
+    }
+  }
+}
+
+bool visProfiler_IsEnabled() {
+  return enabled_;
+}
+
+void visProfiler_SetGpuTiming(bool enabled) {
+  gpu_timing_ = enabled;
+}
+
+void visProfiler_BeginFrame() {
+  if (!enabled_) {
+    return;
+  }
+  if (current_) {
+    /* The last frame was never ended */
+    visProfiler_EndFrame();
+  }
+  if (gpu_timing_ && !queries_created_) {
+    glGenQueries(PROFILER_FRAMES_IN_FLIGHT * VIS_PROFILER_MAX_SCOPES, &queries_[0][0]);
+    queries_created_ = true;
+  }
+
+  current_slot_ = (uint32_t)(frame_index_ % PROFILER_FRAMES_IN_FLIGHT);
+  current_ = &in_flight_[current_slot_];
+  if (current_->pending) {
+    Resolve(current_);
+  }
+  current_->frame.index = frame_index_;
+  current_->frame.cpu_start_ms = NowMs() - epoch_ms_;
+  current_->frame.cpu_ms = 0.0f;
+  current_->frame.num_scopes = 0;
+  depth_ = 0;
+}
+
+void visProfiler_EndFrame() {
+  if (!enabled_ || !current_) {
+    return;
+  }
+  while (depth_ > 0) {
+    visProfiler_EndScope();
+  }
+  visProfilerFrame *frame = &current_->frame;
+  frame->cpu_ms = (float)(NowMs() - epoch_ms_ - frame->cpu_start_ms);
+
+  bool has_queries = false;
+  for (uint32_t i = 0; i < frame->num_scopes; i++) {
+    has_queries = has_queries || current_->scope_queries[i] != 0;
+  }
+  if (has_queries) {
+    current_->pending = true;
+  }
+  else {
+    PushHistory(frame);
+  }
+  frame_index_ += 1;
+  current_ = NULL;
+}
+
+static void BeginScope(const char *name,
+                       bool gpu) {
+  if (!enabled_ || !current_) {
+    return;
+  }
+  if (depth_ == PROFILER_MAX_DEPTH) {
+    return;
+  }
+  visProfilerFrame *frame = &current_->frame;
+  if (frame->num_scopes == VIS_PROFILER_MAX_SCOPES) {
+    open_scopes_[depth_] = PROFILER_NO_SCOPE;
+    depth_ += 1;
+    return;
+  }
+
+  const uint32_t i = frame->num_scopes;
+  frame->num_scopes += 1;
+  open_scopes_[depth_] = i;
+  depth_ += 1;
+
+  visProfilerScope *scope = &frame->scopes[i];
+  scope->name = name;
+  scope->cpu_ms = 0.0f;
+  scope->gpu_ms = -1.0f;
+  current_->scope_queries[i] = 0;
+  if (gpu && gpu_timing_ && !gpu_query_open_) {
+    current_->scope_queries[i] = queries_[current_slot_][i];
+    glBeginQuery(GL_TIME_ELAPSED, current_->scope_queries[i]);
+    gpu_query_open_ = true;
+  }
+  /* Last, so starting the query isn't counted */
+  scope->cpu_start_ms = NowMs() - epoch_ms_;
+}
+
+void visProfiler_BeginScope(const char *name) {
+  BeginScope(name, true);
+}
+
+void visProfiler_BeginCpuScope(const char *name) {
+  BeginScope(name, false);
+}
+
+void visProfiler_EndScope() {
+  if (!enabled_ || !current_ || depth_ == 0) {
+    return;
+  }
+  depth_ -= 1;
+  const uint32_t i = open_scopes_[depth_];
+  if (i == PROFILER_NO_SCOPE) {
+    return;
+  }
+  visProfilerScope *scope = &current_->frame.scopes[i];
+  scope->cpu_ms = (float)(NowMs() - epoch_ms_ - scope->cpu_start_ms);
+  if (current_->scope_queries[i] != 0) {
+    EndOpenQuery();
+  }
+}
+
+uint32_t visProfiler_FrameCount() {
+  return history_count_;
+}
+
+const visProfilerFrame *visProfiler_GetFrame(uint32_t i) {
+  return &history_[(history_start_ + i) % VIS_PROFILER_HISTORY];
+}
+
+uint32_t visProfiler_GetAverages(visProfilerAverage *averages,
+                                 uint32_t maxAverages,
+                                 double *frameMs) {
+  if (frameMs) {
+    *frameMs = 0.0;
+  }
+  if (history_count_ == 0) {
+    return 0;
+  }
+  /* Gpu averages only count the frames that have gpu times */
+  const uint32_t max_names = maxAverages < PROFILER_MAX_NAMES ? maxAverages : PROFILER_MAX_NAMES;
+  uint32_t gpu_frames[PROFILER_MAX_NAMES] = {0};
+  uint32_t num_names = 0;
+  double frame_ms = 0.0;
+  for (uint32_t f = 0; f < history_count_; f++) {
+    const visProfilerFrame *frame = visProfiler_GetFrame(f);
+    frame_ms += frame->cpu_ms;
+    bool has_gpu[PROFILER_MAX_NAMES] = {false};
+    for (uint32_t s = 0; s < frame->num_scopes; s++) {
+      const visProfilerScope *scope = &frame->scopes[s];
+      uint32_t n = 0;
+      while (n < num_names && strcmp(averages[n].name, scope->name) != 0) {
+        n++;
+      }
+      if (n == num_names) {
+        if (num_names == max_names) {
+          continue;
+        }
+        averages[n].name = scope->name;
+        averages[n].cpu_ms = 0.0;
+        averages[n].gpu_ms = 0.0;
+        num_names += 1;
+      }
+      averages[n].cpu_ms += scope->cpu_ms;
+      if (scope->gpu_ms >= 0.0f) {
+        averages[n].gpu_ms += scope->gpu_ms;
+        has_gpu[n] = true;
+      }
+    }
+    for (uint32_t n = 0; n < num_names; n++) {
+      gpu_frames[n] += has_gpu[n] ? 1 : 0;
+    }
+  }
+
+  for (uint32_t n = 0; n < num_names; n++) {
+    averages[n].cpu_ms /= history_count_;
+    averages[n].gpu_ms = gpu_frames[n] > 0 ? averages[n].gpu_ms / gpu_frames[n] : -1.0;
+  }
+  if (frameMs) {
+    *frameMs = frame_ms / history_count_;
+  }
+  return num_names;
+}
+
+bool visProfiler_ExportChromeTrace(const char *path) {
+  FILE *file = fopen(path, "w");
+  if (!file) {
+    printf("ERROR (Profiler): Could not open %s\n", path);
+    return false;
+  }
+  /* Complete events ("ph":"X"), times in microseconds. Thread 1 is the cpu, thread 2 the gpu */
+  fprintf(file, "{\"traceEvents\":[\n");
+  fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n");
+  fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+  for (uint32_t f = 0; f < history_count_; f++) {
+    const visProfilerFrame *frame = visProfiler_GetFrame(f);
+    fprintf(file, ",\n{\"name\":\"Frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,"
+                  "\"args\":{\"frame\":%llu}}",
+            frame->cpu_start_ms * 1.0e3, frame->cpu_ms * 1.0e3, (unsigned long long)frame->index);
+    for (uint32_t s = 0; s < frame->num_scopes; s++) {
+      const visProfilerScope *scope = &frame->scopes[s];
+      fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+              scope->name, scope->cpu_start_ms * 1.0e3, scope->cpu_ms * 1.0e3);
+      if (scope->gpu_ms >= 0.0f) {
+        fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":%.3f,\"dur\":%.3f}",
+                scope->name, scope->cpu_start_ms * 1.0e3, scope->gpu_ms * 1.0e3);
+      }
+    }
+  }
+  fprintf(file, "\n]}\n");
+  const bool ok = !ferror(file);
+  fclose(file);
+  return ok;
+}
+
+bool visProfiler_ExportCsv(const char *path) {
+  FILE *file = fopen(path, "w");
+  if (!file) {
+    printf("ERROR (Profiler): Could not open %s\n", path);
+    return false;
+  }
+  fprintf(file, "frame,scope,cpu_start_ms,cpu_ms,gpu_ms\n");
+  for (uint32_t f = 0; f < history_count_; f++) {
+    const visProfilerFrame *frame = visProfiler_GetFrame(f);
+    for (uint32_t s = 0; s < frame->num_scopes; s++) {
+      const visProfilerScope *scope = &frame->scopes[s];
+      fprintf(file, "%llu,%s,%.4f,%.4f,",
+              (unsigned long long)frame->index, scope->name, scope->cpu_start_ms, scope->cpu_ms);
+      if (scope->gpu_ms >= 0.0f) {
+        fprintf(file, "%.4f", scope->gpu_ms);
+      }
+      fprintf(file, "\n");
+    }
+  }
+  const bool ok = !ferror(file);
+  fclose(file);
+  return ok;
+}
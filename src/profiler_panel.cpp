@@ -0,0 +1,44 @@
+#include "cvis/profiler.h"
+#include "imgui.h"
+
+#define PROFILER_PANEL_MAX_NAMES 32
+
+void visProfiler_DrawPanel() {
+  if (!ImGui::Begin("Profiler")) {
+    ImGui::End();
+    return;
+  }
+  bool enabled = visProfiler_IsEnabled();
+  if (ImGui::Checkbox("Enabled", &enabled)) {
+    visProfiler_SetEnabled(enabled);
+  }
+  const uint32_t num_frames = visProfiler_FrameCount();
+  if (num_frames == 0) {
+    ImGui::End();
+    return;
+  }
+
+  visProfilerAverage averages[PROFILER_PANEL_MAX_NAMES];
+  double frame_ms = 0.0;
+  const uint32_t num_averages = visProfiler_GetAverages(averages, PROFILER_PANEL_MAX_NAMES, &frame_ms);
+  ImGui::Text("Frame %.3f ms cpu (%u frames)", frame_ms, num_frames);
+  ImGui::Separator();
+  ImGui::Text("%-16s %10s %10s", "Scope", "cpu ms", "gpu ms");
+  for (uint32_t n = 0; n < num_averages; n++) {
+    if (averages[n].gpu_ms >= 0.0) {
+      ImGui::Text("%-16s %10.3f %10.3f", averages[n].name, averages[n].cpu_ms, averages[n].gpu_ms);
+    }
+    else {
+      ImGui::Text("%-16s %10.3f %10s", averages[n].name, averages[n].cpu_ms, "-");
+    }
+  }
+  ImGui::Separator();
+  if (ImGui::Button("Export trace")) {
+    visProfiler_ExportChromeTrace("cvis_trace.json");
+  }
+  ImGui::SameLine();
+  if (ImGui::Button("Export CSV")) {
+    visProfiler_ExportCsv("cvis_profile.csv");
+  }
+  ImGui::End();
+}
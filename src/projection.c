@@ -1,33 +1,26 @@
 #include "cvis/projection.h"
-#include <math.h>
+#include "cvis/mat4.h"
 
 Mat4f visProjection_Perspective(float fovInDegrees,
                                 float aspectRatio,
                                 float nearPlane,
                                 float farPlane) {
   Mat4f projection;
-  Mat4f_SetZero(&projection);
-  double top = nearPlane * tan(fovInDegrees * 0.5 * M_PI / 180.0);
-  double right = top * aspectRatio;
-  double left = -right;
-  double bottom = -top;
-  double znear = nearPlane;
-  double zfar = farPlane;
-
-  /* Right left distance */
-  float rl = (float)(right - left);
-  /* Top bottom distance */
-  float tb = (float)(top - bottom);
-  /* Far near distance */
-  float fn = (float)(zfar - znear);
-
-  projection.mat[0] = (float)(znear * 2.0f) / rl;
-  projection.mat[5] = (float)(znear * 2.0f) / tb;
-  projection.mat[8] = (float)(right + left) / rl;
-  projection.mat[9] = (float)(top + bottom) / tb;
-  projection.mat[10] = -(float)(zfar + znear) / fn;
-  projection.mat[11] = -1.0f;
-  projection.mat[14] = -(float)(zfar * znear * 2.0f) / fn;
-
+  visMat4_Perspective(fovInDegrees, aspectRatio, nearPlane, farPlane, projection.mat);
   return projection;
-}
\ No newline at end of file
+}
+
+float visProjection_WorldUnitsPerPixel(const Mat4f *projection,
+                                       float distance,
+                                       int viewportHeight) {
+  if (viewportHeight <= 0) {
+    viewportHeight = 1;
+  }
+  /* mat[5] scales y into clip space. For a perspective projection that is 1/tan(fov/2), the
+   * visible height at a distance d is 2 * d / mat[5]. For an orthographic projection it is
+   * 2 / height of the view volume, and the distance does not matter */
+  const float visible_height = projection->mat[11] != 0.0f ?
+                               2.0f * distance / projection->mat[5] :
+                               2.0f / projection->mat[5];
+  return visible_height / (float)viewportHeight;
+}
@@ -0,0 +1,8 @@
+#include "cvis/push_camera.h"
+#include "cvis/vis_camera.h"
+
+void vis::PushCamera(const Camera3D &camera) {
+  /* Eigen is column major by default, the same as the Camera uniform block */
+  vis_PushCamera(camera.GetViewMatrix().data());
+  vis_PushProjection(camera.GetProjectionMatrix().data());
+}
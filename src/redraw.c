@@ -0,0 +1,33 @@
+#include "cvis/redraw.h"
+#include <stdatomic.h>
+#include <stddef.h>
+
+typedef void (*WakeFunction)(void);
+
+/* Starts set so the first frame is always drawn */
+static atomic_bool requested_ = true;
+static _Atomic(WakeFunction) wake_ = NULL;
+
+void visRedraw_Request() {
+  /* Already requested is the common case while things are moving, don't write the cache line.
+   * Without a full fence the caller's own writes (an update pushed to the queue) can land just
+   * after a visRedraw_Take that this load missed. That's rare and costs a late frame, bounded by
+   * the window's wait timeout, where a fence would cost every push */
+  if (atomic_load_explicit(&requested_, memory_order_relaxed)) {
+    return;
+  }
+  if (!atomic_exchange_explicit(&requested_, true, memory_order_acq_rel)) {
+    const WakeFunction wake = atomic_load_explicit(&wake_, memory_order_acquire);
+    if (wake) {
+      wake();
+    }
+  }
+}
+
+bool visRedraw_Take() {
+  return atomic_exchange_explicit(&requested_, false, memory_order_acq_rel);
+}
+
+void visRedraw_SetWakeFunction(void (*wake)(void)) {
+  atomic_store_explicit(&wake_, wake, memory_order_release);
+}
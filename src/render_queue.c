@@ -0,0 +1,358 @@
+#include "cvis/render_queue.h"
+#include "cvis/gl_state.h"
+#include "cvis/profiler.h"
+#include "glad/glad.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define RENDER_QUEUE_INITIAL_CAPACITY 256
+
+#define KEY_PASS_SHIFT 62
+#define KEY_PROGRAM_BITS 16
+#define KEY_VERTEX_ARRAY_BITS 16
+#define KEY_DEPTH_BITS 24
+#define KEY_DEPTH_MAX ((1u << KEY_DEPTH_BITS) - 1)
+
+static visDrawCommand *commands_ = NULL;
+static uint64_t *keys_ = NULL;
+/* Command indices in sorted order, and scratch space for the sort */
+static uint32_t *order_ = NULL;
+static uint64_t *scratch_keys_ = NULL;
+static uint32_t *scratch_order_ = NULL;
+static uint32_t count_ = 0;
+static uint32_t capacity_ = 0;
+static bool sorted_ = true;
+
+/* Arguments for the multi draws, grown to the biggest merged group */
+static GLint *draw_firsts_ = NULL;
+static GLsizei *draw_counts_ = NULL;
+static const void **draw_offsets_ = NULL;
+static GLint *draw_base_vertices_ = NULL;
+static uint32_t draw_capacity_ = 0;
+
+static visRenderQueueStats last_stats_;
+
+static bool Grow() {
+  const uint32_t new_capacity = capacity_ > 0 ? capacity_ * 2 : RENDER_QUEUE_INITIAL_CAPACITY;
+  visDrawCommand *commands = (visDrawCommand *)realloc(commands_, new_capacity * sizeof(visDrawCommand));
+  if (!commands) {
+    return false;
+  }
+  /* Keeps the old commands and capacity if the rest fail, the bigger buffer is just unused */
+  commands_ = commands;
+  uint64_t *keys = (uint64_t *)malloc(new_capacity * sizeof(uint64_t));
+  uint32_t *order = (uint32_t *)malloc(new_capacity * sizeof(uint32_t));
+  uint64_t *scratch_keys = (uint64_t *)malloc(new_capacity * sizeof(uint64_t));
+  uint32_t *scratch_order = (uint32_t *)malloc(new_capacity * sizeof(uint32_t));
+  if (!keys || !order || !scratch_keys || !scratch_order) {
+    free(keys);
+    free(order);
+    free(scratch_keys);
+    free(scratch_order);
+    return false;
+  }
+  /* These are rebuilt by every sort so their contents don't need keeping */
+  free(keys_);
+  free(order_);
+  free(scratch_keys_);
+  free(scratch_order_);
+  keys_ = keys;
+  order_ = order;
+  scratch_keys_ = scratch_keys;
+  scratch_order_ = scratch_order;
+  capacity_ = new_capacity;
+  return true;
+}
+
+visDrawCommand visRenderQueue_NewCommand(const visProgram *program,
+                                         uint32_t vertexArray,
+                                         uint32_t mode) {
+  visDrawCommand command;
+  memset(&command, 0, sizeof(command));
+  command.pass = visRenderPass_Opaque;
+  command.program = program->id;
+  command.vertex_array = vertexArray;
+  command.mode = mode;
+  command.color_location = -1;
+  command.scalar_location = -1;
+  command.model_location = -1;
+  return command;
+}
+
+void visRenderQueue_Submit(const visDrawCommand *command) {
+  if (count_ == capacity_ && !Grow()) {
+    return;
+  }
+  commands_[count_] = *command;
+  count_ += 1;
+  sorted_ = false;
+}
+
+uint64_t visRenderQueue_MakeKey(const visDrawCommand *command) {
+  const uint64_t pass = (uint64_t)command->pass & 0x3;
+  const uint64_t program = command->program & ((1u << KEY_PROGRAM_BITS) - 1);
+  const uint64_t vertex_array = command->vertex_array & ((1u << KEY_VERTEX_ARRAY_BITS) - 1);
+  const uint64_t blend = command->blend ? 1 : 0;
+  float depth = command->depth;
+  depth = depth < 0.0f ? 0.0f : (depth > 1.0f ? 1.0f : depth);
+  uint64_t depth_bits = (uint64_t)(depth * (float)KEY_DEPTH_MAX);
+
+  /* State is program | vertex array | blend, 33 bits */
+  const uint64_t state = (program << 17) | (vertex_array << 1) | blend;
+  if (command->pass == visRenderPass_Transparent) {
+    /* Back to front, furthest (largest depth) first */
+    depth_bits = KEY_DEPTH_MAX - depth_bits;
+    return (pass << KEY_PASS_SHIFT) | (depth_bits << 38) | (state << 5);
+  }
+  return (pass << KEY_PASS_SHIFT) | (state << 29) | (depth_bits << 5);
+}
+
+/* LSD radix sort of (key, index) pairs, a byte at a time. Stable, and bytes that are the same in
+ * every key (most of them with only a few programs and vertex arrays) are skipped */
+static void RadixSort() {
+  uint64_t *keys = keys_;
+  uint32_t *order = order_;
+  uint64_t *other_keys = scratch_keys_;
+  uint32_t *other_order = scratch_order_;
+
+  for (uint32_t shift = 0; shift < 64; shift += 8) {
+    uint32_t histogram[256] = {0};
+    for (uint32_t i = 0; i < count_; i++) {
+      histogram[(keys[i] >> shift) & 0xff] += 1;
+    }
+    if (histogram[(keys[0] >> shift) & 0xff] == count_) {
+      continue;
+    }
+    uint32_t offset = 0;
+    for (uint32_t b = 0; b < 256; b++) {
+      const uint32_t bucket = histogram[b];
+      histogram[b] = offset;
+      offset += bucket;
+    }
+    for (uint32_t i = 0; i < count_; i++) {
+      const uint32_t destination = histogram[(keys[i] >> shift) & 0xff]++;
+      other_keys[destination] = keys[i];
+      other_order[destination] = order[i];
+    }
+    uint64_t *swap_keys = keys;
+    keys = other_keys;
+    other_keys = swap_keys;
+    uint32_t *swap_order = order;
+    order = other_order;
+    other_order = swap_order;
+  }
+
+  /* Results always end up in keys_/order_ */
+  if (keys != keys_) {
+    memcpy(keys_, keys, count_ * sizeof(uint64_t));
+    memcpy(order_, order, count_ * sizeof(uint32_t));
+  }
+}
+
+void visRenderQueue_Sort() {
+  if (sorted_) {
+    return;
+  }
+  for (uint32_t i = 0; i < count_; i++) {
+    keys_[i] = visRenderQueue_MakeKey(&commands_[i]);
+    order_[i] = i;
+  }
+  if (count_ > 1) {
+    RadixSort();
+  }
+  sorted_ = true;
+}
+
+const visDrawCommand *visRenderQueue_GetSorted(uint32_t i) {
+  return &commands_[order_[i]];
+}
+
+uint32_t visRenderQueue_Count() {
+  return count_;
+}
+
+/* Two commands can go in one multi draw if everything but the range is the same */
+static bool CanMerge(const visDrawCommand *a,
+                     const visDrawCommand *b) {
+  return a->program == b->program &&
+         a->vertex_array == b->vertex_array &&
+         a->mode == b->mode &&
+         a->blend == b->blend &&
+         a->indexed == b->indexed &&
+         a->instance_count == 0 && b->instance_count == 0 &&
+         a->point_size == b->point_size &&
+         a->color_location == b->color_location &&
+         (a->color_location < 0 || memcmp(a->color, b->color, sizeof(a->color)) == 0) &&
+         a->scalar_location == b->scalar_location &&
+         (a->scalar_location < 0 || a->scalar == b->scalar) &&
+         a->model_location == b->model_location &&
+         a->model == b->model;
+}
+
+/* \return number of sorted commands, starting at first, that go in one draw call */
+static uint32_t GroupSize(uint32_t first) {
+  const visDrawCommand *command = visRenderQueue_GetSorted(first);
+  uint32_t size = 1;
+  while (first + size < count_ && CanMerge(command, visRenderQueue_GetSorted(first + size))) {
+    size += 1;
+  }
+  return size;
+}
+
+uint32_t visRenderQueue_CountDrawCalls() {
+  visRenderQueue_Sort();
+  uint32_t draw_calls = 0;
+  for (uint32_t i = 0; i < count_; i += GroupSize(i)) {
+    draw_calls += 1;
+  }
+  return draw_calls;
+}
+
+static bool ReserveDraws(uint32_t size) {
+  if (size <= draw_capacity_) {
+    return true;
+  }
+  GLint *firsts = (GLint *)realloc(draw_firsts_, size * sizeof(GLint));
+  if (firsts) {
+    draw_firsts_ = firsts;
+  }
+  GLsizei *counts = (GLsizei *)realloc(draw_counts_, size * sizeof(GLsizei));
+  if (counts) {
+    draw_counts_ = counts;
+  }
+  const void **offsets = (const void **)realloc((void *)draw_offsets_, size * sizeof(void *));
+  if (offsets) {
+    draw_offsets_ = offsets;
+  }
+  GLint *base_vertices = (GLint *)realloc(draw_base_vertices_, size * sizeof(GLint));
+  if (base_vertices) {
+    draw_base_vertices_ = base_vertices;
+  }
+  if (!firsts || !counts || !offsets || !base_vertices) {
+    return false;
+  }
+  draw_capacity_ = size;
+  return true;
+}
+
+static const void *IndexOffset(uint32_t firstIndex) {
+  return (const void *)((uintptr_t)firstIndex * sizeof(uint32_t));
+}
+
+static void SetState(const visDrawCommand *command) {
+  visGlState_SetBlend(command->blend);
+  if (command->blend) {
+    visGlState_SetBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  }
+  visGlState_UseProgram(command->program);
+  if (command->point_size > 0.0f) {
+    visGlState_SetPointSize(command->point_size);
+  }
+  if (command->color_location >= 0) {
+    glUniform4fv(command->color_location, 1, command->color);
+  }
+  if (command->scalar_location >= 0) {
+    glUniform1f(command->scalar_location, command->scalar);
+  }
+  if (command->model_location >= 0 && command->model) {
+    glUniformMatrix4fv(command->model_location, 1, GL_FALSE, command->model);
+  }
+  visGlState_BindVertexArray(command->vertex_array);
+}
+
+static void DrawSingle(const visDrawCommand *command) {
+  if (command->indexed) {
+    if (command->instance_count > 0) {
+      glDrawElementsInstancedBaseVertex(command->mode,
+                                        (GLsizei)command->count,
+                                        GL_UNSIGNED_INT,
+                                        IndexOffset(command->first),
+                                        (GLsizei)command->instance_count,
+                                        command->base_vertex);
+    }
+    else {
+      glDrawElementsBaseVertex(command->mode,
+                               (GLsizei)command->count,
+                               GL_UNSIGNED_INT,
+                               IndexOffset(command->first),
+                               command->base_vertex);
+    }
+  }
+  else if (command->instance_count > 0) {
+    glDrawArraysInstanced(command->mode,
+                          (GLint)command->first,
+                          (GLsizei)command->count,
+                          (GLsizei)command->instance_count);
+  }
+  else {
+    glDrawArrays(command->mode, (GLint)command->first, (GLsizei)command->count);
+  }
+}
+
+static void DrawGroup(uint32_t first,
+                      uint32_t size) {
+  const visDrawCommand *command = visRenderQueue_GetSorted(first);
+  if (size == 1 || !ReserveDraws(size)) {
+    for (uint32_t i = 0; i < size; i++) {
+      DrawSingle(visRenderQueue_GetSorted(first + i));
+    }
+    return;
+  }
+  for (uint32_t i = 0; i < size; i++) {
+    const visDrawCommand *merged = visRenderQueue_GetSorted(first + i);
+    draw_firsts_[i] = (GLint)merged->first;
+    draw_counts_[i] = (GLsizei)merged->count;
+    draw_offsets_[i] = IndexOffset(merged->first);
+    draw_base_vertices_[i] = merged->base_vertex;
+  }
+  if (command->indexed) {
+    glMultiDrawElementsBaseVertex(command->mode,
+                                  draw_counts_,
+                                  GL_UNSIGNED_INT,
+                                  draw_offsets_,
+                                  (GLsizei)size,
+                                  draw_base_vertices_);
+  }
+  else {
+    glMultiDrawArrays(command->mode, draw_firsts_, draw_counts_, (GLsizei)size);
+  }
+}
+
+void visRenderQueue_Execute() {
+  visRenderQueue_Sort();
+  last_stats_.commands = count_;
+  last_stats_.draw_calls = 0;
+
+  const char *layer = NULL;
+  uint32_t i = 0;
+  while (i < count_) {
+    const visDrawCommand *command = visRenderQueue_GetSorted(i);
+    if (command->layer != layer) {
+      if (layer) {
+        visProfiler_EndScope();
+      }
+      layer = command->layer;
+      if (layer) {
+        visProfiler_BeginScope(layer);
+      }
+    }
+    const uint32_t size = GroupSize(i);
+    SetState(command);
+    DrawGroup(i, size);
+    last_stats_.draw_calls += 1;
+    i += size;
+  }
+  if (layer) {
+    visProfiler_EndScope();
+  }
+  visRenderQueue_Clear();
+}
+
+void visRenderQueue_Clear() {
+  count_ = 0;
+  sorted_ = true;
+}
+
+visRenderQueueStats visRenderQueue_GetLastStats() {
+  return last_stats_;
+}
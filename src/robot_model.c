@@ -0,0 +1,136 @@
+#include "cvis/robot_model.h"
+#include "cvis/mat4.h"
+#include <math.h>
+#include <stddef.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* Robots per visMat4_ComposeTrsBatch call, the trig for a chunk is kept on the stack */
+#define ROBOT_MODEL_CHUNK 256
+
+/* Half the rotation angle of a robot, for its quaternion. 90 - angle since the kinematic equations
+ * use theta as angle from x axis but I want the angle to be from Y axis to be alligned with
+ * navigation heading (w.r.t North) */
+static inline float HalfRotation(float heading) {
+  return 0.25f * (float)M_PI - 0.5f * heading;
+}
+
+/* Model matrix for one robot, translation * rotation * scale. sine and cosine are of HalfRotation,
+ * the rotation is about z */
+static void ComposeModelMatrix(float x,
+                               float y,
+                               float sine,
+                               float cosine,
+                               float length,
+                               float width,
+                               float height,
+                               float *model) {
+  /* We want the robot to appear at a height (Z) of 0, so its on top of the ground plane. To do this
+   * we need to shift the robot up 1/2 of the height. If we dont do this, half of the robot will be below
+   * the ground, and the other half above.
+   * This is because the default vertices, which are centered on 0, go from -0.5 to 0.5,
+   * so by default half of the vertices are below 0 (all the -0.5) */
+  const float translation[3] = {x, y, 0.5f * height};
+  const float rotation[4] = {0.0f, 0.0f, sine, cosine};
+  /* Since the default vertices are for a 1x1x1 cube, the robot w/l/h parameters are the
+   * scaling values for x/y/z */
+  const float scale[3] = {width, length, height};
+  visMat4_ComposeTrs(translation, rotation, scale, model);
+}
+
+#if defined(__SSE2__)
+/* Sine and cosine of 4 angles at once. Reduces the angle to [-pi/4, pi/4] around the nearest
+ * multiple of pi/2 and uses the minimax polynomials from Cephes, accurate to ~1e-7 for the
+ * range of angles a heading can be */
+static void SinCos4(__m128 angle,
+                    __m128 *sine,
+                    __m128 *cosine) {
+  const __m128 two_over_pi = _mm_set1_ps(0.63661977236758134f);
+  /* pi/2 split in three parts so the reduction does not lose precision */
+  const __m128 pi_over_2_a = _mm_set1_ps(1.5703125f);
+  const __m128 pi_over_2_b = _mm_set1_ps(4.837512969970703125e-4f);
+  const __m128 pi_over_2_c = _mm_set1_ps(7.54978995489188216e-8f);
+
+  /* Nearest quadrant */
+  const __m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(angle, two_over_pi));
+  const __m128 q = _mm_cvtepi32_ps(quadrant);
+  __m128 r = _mm_sub_ps(angle, _mm_mul_ps(q, pi_over_2_a));
+  r = _mm_sub_ps(r, _mm_mul_ps(q, pi_over_2_b));
+  r = _mm_sub_ps(r, _mm_mul_ps(q, pi_over_2_c));
+  const __m128 r2 = _mm_mul_ps(r, r);
+
+  /* sin(r) ~ r + r^3 * (s0 + r^2 * (s1 + r^2 * s2)) */
+  __m128 sin_r = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-1.9515295891e-4f), r2), _mm_set1_ps(8.3321608736e-3f));
+  sin_r = _mm_add_ps(_mm_mul_ps(sin_r, r2), _mm_set1_ps(-1.6666654611e-1f));
+  sin_r = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sin_r, r2), r), r);
+
+  /* cos(r) ~ 1 - r^2 / 2 + r^4 * (c0 + r^2 * (c1 + r^2 * c2)) */
+  __m128 cos_r = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.443315711809948e-5f), r2), _mm_set1_ps(-1.388731625493765e-3f));
+  cos_r = _mm_add_ps(_mm_mul_ps(cos_r, r2), _mm_set1_ps(4.166664568298827e-2f));
+  cos_r = _mm_mul_ps(_mm_mul_ps(cos_r, r2), r2);
+  cos_r = _mm_add_ps(_mm_sub_ps(cos_r, _mm_mul_ps(_mm_set1_ps(0.5f), r2)), _mm_set1_ps(1.0f));
+
+  /* Quadrant 1 and 3 swap sine and cosine, quadrant 1 and 2 negate the sine, 2 and 3 negate
+   * the cosine */
+  const __m128i one = _mm_set1_epi32(1);
+  const __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, one), one));
+  const __m128 sin_value = _mm_or_ps(_mm_and_ps(swap, cos_r), _mm_andnot_ps(swap, sin_r));
+  const __m128 cos_value = _mm_or_ps(_mm_and_ps(swap, sin_r), _mm_andnot_ps(swap, cos_r));
+  const __m128 sin_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(2)), 30));
+  const __m128 cos_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, one),
+                                                                        _mm_set1_epi32(2)), 30));
+  *sine = _mm_xor_ps(sin_value, sin_sign);
+  *cosine = _mm_xor_ps(cos_value, cos_sign);
+}
+#endif
+
+void visRobot_ComputeModelMatrices(const float *x,
+                                   const float *y,
+                                   const float *heading,
+                                   const float *length,
+                                   const float *width,
+                                   const float *height,
+                                   uint32_t count,
+                                   float *models) {
+  float sines[ROBOT_MODEL_CHUNK];
+  float cosines[ROBOT_MODEL_CHUNK];
+  float lifts[ROBOT_MODEL_CHUNK];
+  /* Groups of 4 go through the batch kernel, the rest (and a single robot) one at a time */
+  const uint32_t batched = count & ~3u;
+  uint32_t first = 0;
+  for (; first < batched; first += ROBOT_MODEL_CHUNK) {
+    const uint32_t chunk = batched - first < ROBOT_MODEL_CHUNK ? batched - first : ROBOT_MODEL_CHUNK;
+#if defined(__SSE2__)
+    const __m128 quarter_pi = _mm_set1_ps(0.25f * (float)M_PI);
+    const __m128 half = _mm_set1_ps(0.5f);
+    for (uint32_t i = 0; i < chunk; i += 4) {
+      /* The trig is the expensive part, 4 headings at once, see HalfRotation */
+      __m128 sine;
+      __m128 cosine;
+      SinCos4(_mm_sub_ps(quarter_pi, _mm_mul_ps(half, _mm_loadu_ps(&heading[first + i]))), &sine, &cosine);
+      _mm_storeu_ps(&sines[i], sine);
+      _mm_storeu_ps(&cosines[i], cosine);
+    }
+#else
+    for (uint32_t i = 0; i < chunk; i++) {
+      const float half_rotation = HalfRotation(heading[first + i]);
+      sines[i] = sinf(half_rotation);
+      cosines[i] = cosf(half_rotation);
+    }
+#endif
+    /* Up half the height and scaled by width, length and height, see ComposeModelMatrix */
+    for (uint32_t i = 0; i < chunk; i++) {
+      lifts[i] = 0.5f * height[first + i];
+    }
+    const float *const translation[3] = {&x[first], &y[first], lifts};
+    const float *const rotation[4] = {NULL, NULL, sines, cosines};
+    const float *const scale[3] = {&width[first], &length[first], &height[first]};
+    visMat4_ComposeTrsBatch(translation, rotation, scale, chunk, &models[16 * first]);
+  }
+  for (uint32_t i = batched; i < count; i++) {
+    const float half_rotation = HalfRotation(heading[i]);
+    ComposeModelMatrix(x[i], y[i], sinf(half_rotation), cosf(half_rotation), length[i], width[i], height[i],
+                       &models[16 * i]);
+  }
+}
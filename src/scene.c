@@ -0,0 +1,72 @@
+#include "cvis/scene.h"
+#include "cvis/redraw.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Set in middle_ when the buffer in the middle hasn't been taken by the reader yet */
+#define SCENE_FRESH 4u
+#define SCENE_INDEX_MASK 3u
+#define SCENE_INITIAL_FLEET_CAPACITY 256
+
+static visSceneState buffers_[3];
+/* Only ever touched by the writer */
+static uint32_t write_index_ = 0;
+static uint64_t sequence_ = 0;
+/* Only ever touched by the reader */
+static uint32_t read_index_ = 1;
+/* Buffer in between the two, plus SCENE_FRESH */
+static atomic_uint middle_ = 2;
+
+visSceneState *visScene_BeginWrite() {
+  return &buffers_[write_index_];
+}
+
+bool visScene_ReserveFleet(visSceneState *scene,
+                           uint32_t count) {
+  if (count <= scene->fleet_capacity) {
+    return true;
+  }
+  if (count > VIS_SCENE_MAX_FLEET_POSES) {
+    return false;
+  }
+  uint32_t new_capacity = scene->fleet_capacity > 0 ? scene->fleet_capacity : SCENE_INITIAL_FLEET_CAPACITY;
+  while (new_capacity < count) {
+    new_capacity *= 2;
+  }
+  if (new_capacity > VIS_SCENE_MAX_FLEET_POSES) {
+    new_capacity = VIS_SCENE_MAX_FLEET_POSES;
+  }
+  /* The writer owns this buffer until it is published, the reader never sees it being moved */
+  visScenePose *fleet = (visScenePose *)realloc(scene->fleet, new_capacity * sizeof(visScenePose));
+  if (!fleet) {
+    return false;
+  }
+  scene->fleet = fleet;
+  scene->fleet_capacity = new_capacity;
+  return true;
+}
+
+bool visScene_Publish() {
+  visSceneState *scene = &buffers_[write_index_];
+  const bool whole = scene->num_fleet_poses <= scene->fleet_capacity;
+  if (!whole) {
+    printf("ERROR (Scene): %u fleet poses but only room for %u, see visScene_ReserveFleet\n",
+           scene->num_fleet_poses, scene->fleet_capacity);
+    scene->num_fleet_poses = scene->fleet_capacity;
+  }
+  sequence_ += 1;
+  scene->sequence = sequence_;
+  /* Release so the reader sees the finished snapshot, acquire so the buffer handed back isn't
+   * written before the reader is done with it */
+  write_index_ = atomic_exchange_explicit(&middle_, write_index_ | SCENE_FRESH, memory_order_acq_rel) & SCENE_INDEX_MASK;
+  visRedraw_Request();
+  return whole;
+}
+
+const visSceneState *visScene_Latest() {
+  if (atomic_load_explicit(&middle_, memory_order_relaxed) & SCENE_FRESH) {
+    read_index_ = atomic_exchange_explicit(&middle_, read_index_, memory_order_acq_rel) & SCENE_INDEX_MASK;
+  }
+  return &buffers_[read_index_];
+}
@@ -1,8 +1,73 @@
 #include "cvis/shader.h"
 #include "glad/glad.h"
+#include <errno.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/* Programs already built in this process, so layers sharing a shader pair share one program */
+#define SHADER_MAX_CACHED_PROGRAMS 64
+/* "CVSB", identifies a program binary file written by this cache */
+#define SHADER_BINARY_MAGIC 0x42535643u
+#define SHADER_BINARY_VERSION 1u
+#define SHADER_MAX_PATH 1024
+
+/* GL_KHR_parallel_shader_compile, glad is generated without extensions */
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+typedef struct {
+  /* Hash of the source pair */
+  uint64_t key;
+  /* key combined with the driver, the name of the binary on disk */
+  uint64_t disk_key;
+  visShader program;
+  /* Compiled and linked but the results not checked yet, the shaders are kept for their logs */
+  bool pending;
+  bool save_binary;
+  uint32_t vertex_shader;
+  uint32_t fragment_shader;
+} CachedProgram;
+
+/* Header written in front of the driver's binary blob */
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t key;
+  uint32_t format;
+  uint32_t length;
+} BinaryHeader;
+
+static CachedProgram cached_programs_[SHADER_MAX_CACHED_PROGRAMS];
+static uint32_t num_cached_programs_ = 0;
+static visShaderCacheStats cache_stats_;
+
+/* Directory for program binaries, empty when the disk cache is off */
+static char cache_directory_[SHADER_MAX_PATH];
+static bool cache_directory_set_ = false;
+/* Hash of the vendor, renderer and version strings, a binary is only valid for the exact driver
+ * that wrote it */
+static uint64_t driver_key_ = 0;
+
+static uint64_t Fnv1a(uint64_t hash,
+                      const void *data,
+                      size_t size) {
+  const unsigned char *bytes = (const unsigned char *)data;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+/* Hashes the terminating null as well so ("ab", "c") and ("a", "bc") differ */
+static uint64_t Fnv1aString(uint64_t hash,
+                            const char *string) {
+  return Fnv1a(hash, string, strlen(string) + 1);
+}
 
 static char* LoadShaderFile(const char *file) {
 
@@ -22,61 +87,408 @@ static char* LoadShaderFile(const char *file) {
   shader_code = (char *)malloc((file_size + 1)  * sizeof(char));
   fread(shader_code, sizeof(char), file_size, shader_file);
   shader_code[file_size] = '\0';
+  fclose(shader_file);
 
   return shader_code;
 }
 
-visShader visShader_LoadShaderFromFiles(const char *vertexSourceFile,
-                                       const char *fragmentShaderFile) {
-  int32_t shader_success = 0;
-  visShader shader = 0;
-  char shader_error_log[512];
+static bool MakeDirectory(const char *path) {
+  return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
 
-  uint32_t vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-  char *shader_source = LoadShaderFile(vertexSourceFile);
-  if (!shader_source) {
-    return shader;
+/* Default to ~/.cache/cvis, no disk cache if there is no home directory */
+static void SetDefaultCacheDirectory() {
+  const char *home = getenv("HOME");
+  cache_directory_[0] = '\0';
+  if (!home || home[0] == '\0') {
+    return;
   }
-  /* OpenGL requires pointer to const char * so need to set that up */
-  const char *vs = shader_source;
-  glShaderSource(vertex_shader, 1, &vs, NULL);
-  glCompileShader(vertex_shader);
-  glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &shader_success);
-  if (!shader_success) {
-    glGetShaderInfoLog(vertex_shader, 512, NULL, shader_error_log);
-    printf("VERTEX SHADER ERROR: %s\n", shader_error_log);
-    return 0;
+  char path[SHADER_MAX_PATH];
+  snprintf(path, sizeof(path), "%s/.cache", home);
+  if (!MakeDirectory(path)) {
+    return;
+  }
+  snprintf(path, sizeof(path), "%s/.cache/cvis", home);
+  if (!MakeDirectory(path)) {
+    return;
   }
+  snprintf(cache_directory_, sizeof(cache_directory_), "%s", path);
+}
 
-  uint32_t fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-  shader_source = LoadShaderFile(fragmentShaderFile);
-  if (!shader_source) {
-    return shader;
+/* The disk cache needs glGetProgramBinary (GL 4.1 or ARB_get_program_binary) and at least one
+ * binary format, some drivers support the calls but offer no formats */
+static bool DiskCacheAvailable() {
+  if (!cache_directory_set_) {
+    SetDefaultCacheDirectory();
+    cache_directory_set_ = true;
   }
-  /* OpenGL requires pointer to const char * so need to set that up */
-  const char *fs = shader_source;
-  glShaderSource(fragment_shader, 1, &fs, NULL);
-  glCompileShader(fragment_shader);
-  glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &shader_success);
-  if (!shader_success) {
-    glGetShaderInfoLog(fragment_shader, 512, NULL, shader_error_log);
-    printf("FRAGMENT SHADER ERROR: %s\n", shader_error_log);
+  if (cache_directory_[0] == '\0' || !glad_glGetProgramBinary || !glad_glProgramBinary) {
+    return false;
+  }
+  GLint num_formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+  if (num_formats <= 0) {
+    return false;
+  }
+  if (driver_key_ == 0) {
+    driver_key_ = 0xcbf29ce484222325ull;
+    driver_key_ = Fnv1aString(driver_key_, (const char *)glGetString(GL_VENDOR));
+    driver_key_ = Fnv1aString(driver_key_, (const char *)glGetString(GL_RENDERER));
+    driver_key_ = Fnv1aString(driver_key_, (const char *)glGetString(GL_VERSION));
+  }
+  return true;
+}
+
+static void BinaryPath(uint64_t key,
+                       char *path,
+                       size_t size) {
+  snprintf(path, size, "%s/%016llx.bin", cache_directory_, (unsigned long long)key);
+}
+
+/* \return the program, 0 if there is no usable binary for the key */
+static visShader LoadProgramBinary(uint64_t key) {
+  char path[SHADER_MAX_PATH + 32];
+  BinaryPath(key, path, sizeof(path));
+  FILE *file = fopen(path, "rb");
+  if (!file) {
     return 0;
   }
+  BinaryHeader header;
+  void *binary = NULL;
+  bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+               header.magic == SHADER_BINARY_MAGIC &&
+               header.version == SHADER_BINARY_VERSION &&
+               header.key == key &&
+               header.length > 0;
+  if (valid) {
+    binary = malloc(header.length);
+    valid = binary && fread(binary, 1, header.length, file) == header.length;
+  }
+  fclose(file);
+
+  visShader program = 0;
+  if (valid) {
+    program = glCreateProgram();
+    glProgramBinary(program, header.format, binary, (GLsizei)header.length);
+    GLint success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+      /* Usually the driver was updated without changing its version string */
+      glDeleteProgram(program);
+      program = 0;
+    }
+  }
+  free(binary);
+  if (program == 0) {
+    cache_stats_.disk_rejected += 1;
+    remove(path);
+  }
+  return program;
+}
+
+static void SaveProgramBinary(visShader program,
+                              uint64_t key) {
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return;
+  }
+  void *binary = malloc((size_t)length);
+  if (!binary) {
+    return;
+  }
+  BinaryHeader header;
+  header.magic = SHADER_BINARY_MAGIC;
+  header.version = SHADER_BINARY_VERSION;
+  header.key = key;
+  GLenum format = 0;
+  glGetProgramBinary(program, length, NULL, &format, binary);
+  header.format = format;
+  header.length = (uint32_t)length;
+
+  /* Write to a temporary file and rename it, so another process never reads half a binary */
+  char path[SHADER_MAX_PATH + 32];
+  char temp_path[SHADER_MAX_PATH + 36];
+  BinaryPath(key, path, sizeof(path));
+  snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+  FILE *file = fopen(temp_path, "wb");
+  if (file) {
+    const bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                         fwrite(binary, 1, (size_t)length, file) == (size_t)length;
+    fclose(file);
+    if (!written || rename(temp_path, path) != 0) {
+      remove(temp_path);
+    }
+  }
+  free(binary);
+}
+
+/* Compile and link without checking any status, so the driver can keep working (on other threads
+ * if it supports parallel compiles) while more programs are submitted */
+static void SubmitProgram(CachedProgram *entry,
+                          const char *vertexSource,
+                          const char *fragmentSource,
+                          bool retrievable) {
+  entry->vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+  glShaderSource(entry->vertex_shader, 1, &vertexSource, NULL);
+  glCompileShader(entry->vertex_shader);
+
+  entry->fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+  glShaderSource(entry->fragment_shader, 1, &fragmentSource, NULL);
+  glCompileShader(entry->fragment_shader);
+
+  entry->program = glCreateProgram();
+  if (retrievable) {
+    glProgramParameteri(entry->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+  glAttachShader(entry->program, entry->vertex_shader);
+  glAttachShader(entry->program, entry->fragment_shader);
+  glLinkProgram(entry->program);
+  entry->pending = true;
+}
 
-  shader = glCreateProgram();
-  glAttachShader(shader, vertex_shader);
-  glAttachShader(shader, fragment_shader);
-  glLinkProgram(shader);
-  glGetProgramiv(shader, GL_LINK_STATUS, &shader_success);
+/* Check the compile and link results of a submitted program, this blocks until the driver is done
+ * with it. Failed programs are deleted and left as 0 */
+static void FinishProgram(CachedProgram *entry) {
+  int32_t shader_success = 0;
+  char shader_error_log[512];
+  entry->pending = false;
+
+  glGetShaderiv(entry->vertex_shader, GL_COMPILE_STATUS, &shader_success);
   if (!shader_success) {
-    glGetProgramInfoLog(shader, 512, NULL, shader_error_log);
-    printf("SHADER PROGRAM ERROR: %s\n", shader_error_log);
-    return 0;
+    glGetShaderInfoLog(entry->vertex_shader, 512, NULL, shader_error_log);
+    printf("VERTEX SHADER ERROR: %s\n", shader_error_log);
+  }
+  else {
+    glGetShaderiv(entry->fragment_shader, GL_COMPILE_STATUS, &shader_success);
+    if (!shader_success) {
+      glGetShaderInfoLog(entry->fragment_shader, 512, NULL, shader_error_log);
+      printf("FRAGMENT SHADER ERROR: %s\n", shader_error_log);
+    }
+    else {
+      glGetProgramiv(entry->program, GL_LINK_STATUS, &shader_success);
+      if (!shader_success) {
+        glGetProgramInfoLog(entry->program, 512, NULL, shader_error_log);
+        printf("SHADER PROGRAM ERROR: %s\n", shader_error_log);
+      }
+    }
   }
   /* Once linked we can delete the vertex/fragment shaders */
-  glDeleteShader(vertex_shader);
-  glDeleteShader(fragment_shader);
+  glDeleteShader(entry->vertex_shader);
+  glDeleteShader(entry->fragment_shader);
+  entry->vertex_shader = 0;
+  entry->fragment_shader = 0;
+
+  if (!shader_success) {
+    glDeleteProgram(entry->program);
+    entry->program = 0;
+    return;
+  }
+  if (entry->save_binary) {
+    SaveProgramBinary(entry->program, entry->disk_key);
+  }
+}
 
+/* Parallel compiles are core in GL 4.6 as ARB, older drivers may have either extension */
+static bool HasParallelCompile() {
+  static int has_parallel_compile = -1;
+  if (has_parallel_compile < 0) {
+    has_parallel_compile = 0;
+    GLint num_extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+    for (GLint i = 0; i < num_extensions; i++) {
+      const char *extension = (const char *)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+      if (extension &&
+          (strcmp(extension, "GL_KHR_parallel_shader_compile") == 0 ||
+           strcmp(extension, "GL_ARB_parallel_shader_compile") == 0)) {
+        has_parallel_compile = 1;
+        break;
+      }
+    }
+  }
+  return has_parallel_compile == 1;
+}
+
+/* \return true once a submitted program is finished, without blocking if the driver can say so */
+static bool PollProgram(CachedProgram *entry) {
+  if (!entry->pending) {
+    return true;
+  }
+  if (HasParallelCompile()) {
+    GLint complete = 0;
+    glGetProgramiv(entry->program, GL_COMPLETION_STATUS_KHR, &complete);
+    if (!complete) {
+      return false;
+    }
+  }
+  /* Without the extension this is the deferred check, by now every program has been submitted */
+  FinishProgram(entry);
+  return true;
+}
+
+static CachedProgram *FindProgram(visShader program) {
+  for (uint32_t i = 0; i < num_cached_programs_; i++) {
+    if (cached_programs_[i].program == program) {
+      return &cached_programs_[i];
+    }
+  }
+  return NULL;
+}
+
+/* Find or start building the program for a source pair, it may still be pending when returned */
+static CachedProgram *SubmitSources(const char *vertexSource,
+                                    const char *fragmentSource,
+                                    CachedProgram *uncached) {
+  uint64_t key = 0xcbf29ce484222325ull;
+  key = Fnv1aString(key, vertexSource);
+  key = Fnv1aString(key, fragmentSource);
+  for (uint32_t i = 0; i < num_cached_programs_; i++) {
+    if (cached_programs_[i].key == key) {
+      cache_stats_.memory_hits += 1;
+      return &cached_programs_[i];
+    }
+  }
+
+  /* When the cache is full the program is still built, it just won't be shared */
+  CachedProgram *entry = uncached;
+  if (num_cached_programs_ < SHADER_MAX_CACHED_PROGRAMS) {
+    entry = &cached_programs_[num_cached_programs_];
+    num_cached_programs_ += 1;
+  }
+  memset(entry, 0, sizeof(*entry));
+  entry->key = key;
+
+  const bool disk_cache = DiskCacheAvailable();
+  entry->disk_key = Fnv1a(key, &driver_key_, sizeof(driver_key_));
+  if (disk_cache) {
+    entry->program = LoadProgramBinary(entry->disk_key);
+    if (entry->program != 0) {
+      cache_stats_.disk_hits += 1;
+      return entry;
+    }
+  }
+  entry->save_binary = disk_cache;
+  SubmitProgram(entry, vertexSource, fragmentSource, disk_cache);
+  cache_stats_.compiles += 1;
+  return entry;
+}
+
+static visShader LoadProgram(const char *vertexSource,
+                             const char *fragmentSource) {
+  CachedProgram uncached;
+  CachedProgram *entry = SubmitSources(vertexSource, fragmentSource, &uncached);
+  if (entry->pending) {
+    FinishProgram(entry);
+  }
+  return entry->program;
+}
+
+visShader visShader_LoadShaderFromFiles(const char *vertexSourceFile,
+                                       const char *fragmentShaderFile) {
+  char *vertex_source = LoadShaderFile(vertexSourceFile);
+  if (!vertex_source) {
+    return 0;
+  }
+  char *fragment_source = LoadShaderFile(fragmentShaderFile);
+  if (!fragment_source) {
+    free(vertex_source);
+    return 0;
+  }
+  visShader shader = LoadProgram(vertex_source, fragment_source);
+  free(vertex_source);
+  free(fragment_source);
   return shader;
-}
\ No newline at end of file
+}
+
+visShader visShader_LoadShaderFromSource(const char *vertexSource,
+                                         const char *fragmentSource) {
+  return LoadProgram(vertexSource, fragmentSource);
+}
+
+void visShader_SetCacheDirectory(const char *directory) {
+  cache_directory_set_ = true;
+  if (!directory || !MakeDirectory(directory)) {
+    cache_directory_[0] = '\0';
+    return;
+  }
+  snprintf(cache_directory_, sizeof(cache_directory_), "%s", directory);
+}
+
+visShaderCacheStats visShader_GetCacheStats() {
+  return cache_stats_;
+}
+
+static const char *const uniform_names_[visUniform_Count] = {
+    "model",
+    "color",
+    "spacing",
+};
+
+static bool ResolveProgram(visProgram *program) {
+  program->ready = program->id != 0;
+  for (int i = 0; i < visUniform_Count; i++) {
+    program->uniforms[i] = program->id != 0 ? glGetUniformLocation(program->id, uniform_names_[i]) : -1;
+  }
+  if (program->id == 0) {
+    return false;
+  }
+
+  GLuint camera_block = glGetUniformBlockIndex(program->id, "Camera");
+  if (camera_block != GL_INVALID_INDEX) {
+    glUniformBlockBinding(program->id, camera_block, VIS_CAMERA_BLOCK_BINDING);
+  }
+  return true;
+}
+
+bool visProgram_LoadFromFiles(visProgram *program,
+                              const char *vertexSourceFile,
+                              const char *fragmentShaderFile) {
+  program->id = visShader_LoadShaderFromFiles(vertexSourceFile, fragmentShaderFile);
+  return ResolveProgram(program);
+}
+
+bool visProgram_LoadFromSource(visProgram *program,
+                               const char *vertexSource,
+                               const char *fragmentSource) {
+  program->id = visShader_LoadShaderFromSource(vertexSource, fragmentSource);
+  return ResolveProgram(program);
+}
+
+void visProgram_LoadAsync(visProgram *program,
+                          const char *vertexSource,
+                          const char *fragmentSource) {
+  CachedProgram uncached;
+  CachedProgram *entry = SubmitSources(vertexSource, fragmentSource, &uncached);
+  if (entry == &uncached && entry->pending) {
+    /* Nowhere to keep track of it, so finish it now. A binary loaded from disk is already done */
+    FinishProgram(entry);
+  }
+  program->id = entry->program;
+  program->ready = false;
+  for (int i = 0; i < visUniform_Count; i++) {
+    program->uniforms[i] = -1;
+  }
+  if (!entry->pending) {
+    ResolveProgram(program);
+  }
+}
+
+bool visProgram_IsReady(visProgram *program) {
+  if (program->ready) {
+    return true;
+  }
+  if (program->id == 0) {
+    return false;
+  }
+  CachedProgram *entry = FindProgram(program->id);
+  if (!entry) {
+    /* Failed programs are deleted and their entry set to 0, so this one failed for someone else */
+    program->id = 0;
+    return false;
+  }
+  if (!PollProgram(entry)) {
+    return false;
+  }
+  program->id = entry->program;
+  return ResolveProgram(program);
+}
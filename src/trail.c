@@ -0,0 +1,307 @@
+#include "cvis/trail.h"
+#include "cvis/culling.h"
+#include "cvis/embedded_shaders.h"
+#include "cvis/gl_state.h"
+#include "cvis/profiler.h"
+#include "cvis/redraw.h"
+#include "cvis/render_queue.h"
+#include "cvis/shader.h"
+#include "glad/glad.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Most pieces culling cuts a trail into, past this the rest is drawn whole */
+#define TRAIL_MAX_VISIBLE_RANGES 32
+
+/* All trails share the same shader */
+static visProgram trail_program_;
+
+bool visTrail_Init(visTrail *trail,
+                   uint32_t capacity) {
+  trail->capacity = 0;
+  trail->head = 0;
+  trail->count = 0;
+  trail->dirty_count = 0;
+  trail->vao = 0;
+  trail->vbo = 0;
+  trail->bytes_uploaded = 0;
+  visAabbArray_Init(&trail->chunks);
+  trail->chunk_visible = NULL;
+  // Default color to green
+  visTrail_SetColor(trail, 0, 0.6f, 0, 1);
+
+  if (capacity == 0) {
+    trail->points = NULL;
+    return false;
+  }
+  trail->points = (visVec3 *)calloc(capacity + 1, sizeof(visVec3));
+  if (!trail->points) {
+    return false;
+  }
+  const uint32_t num_chunks = (capacity + VIS_CULL_CHUNK_SIZE - 1) >> VIS_CULL_CHUNK_SHIFT;
+  trail->chunk_visible = (uint8_t *)malloc(num_chunks);
+  if (!trail->chunk_visible || !visAabbArray_Reserve(&trail->chunks, num_chunks)) {
+    visTrail_Free(trail);
+    return false;
+  }
+  while (trail->chunks.count < num_chunks) {
+    visAabbArray_Push(&trail->chunks);
+  }
+  trail->capacity = capacity;
+  return true;
+}
+
+void visTrail_InitGpu(visTrail *trail) {
+  if (trail_program_.id == 0) {
+    visProgram_LoadAsync(&trail_program_,
+                         visShaderSource_grid_shader_vs,
+                         visShaderSource_grid_shader_fs);
+  }
+
+  glGenVertexArrays(1, &trail->vao);
+  glGenBuffers(1, &trail->vbo);
+  visGlState_BindVertexArray(trail->vao);
+
+  /* The whole ring (plus the mirror slot) is allocated once, after this only sub data updates */
+  visGlState_BindBuffer(GL_ARRAY_BUFFER, trail->vbo);
+  glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(trail->capacity + 1) * sizeof(visVec3), NULL, GL_DYNAMIC_DRAW);
+
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+  glEnableVertexAttribArray(0);
+
+  visGlState_BindBuffer(GL_ARRAY_BUFFER, 0);
+  visGlState_BindVertexArray(0);
+}
+
+void visTrail_Free(visTrail *trail) {
+  free(trail->points);
+  trail->points = NULL;
+  free(trail->chunk_visible);
+  trail->chunk_visible = NULL;
+  visAabbArray_Free(&trail->chunks);
+  if (trail->vbo != 0) {
+    glDeleteBuffers(1, &trail->vbo);
+    glDeleteVertexArrays(1, &trail->vao);
+    /* Deleting bound objects unbinds them behind the state cache's back */
+    visGlState_Invalidate();
+    trail->vbo = 0;
+    trail->vao = 0;
+  }
+  trail->capacity = 0;
+  trail->head = 0;
+  trail->count = 0;
+  trail->dirty_count = 0;
+}
+
+void visTrail_Push(visTrail *trail,
+                   float x,
+                   float y,
+                   float z) {
+  visVec3 *point = &trail->points[trail->head];
+  point->x = x;
+  point->y = y;
+  point->z = z;
+  if (trail->head == 0) {
+    trail->points[trail->capacity] = *point;
+  }
+
+  const uint32_t chunk = trail->head >> VIS_CULL_CHUNK_SHIFT;
+  if ((trail->head & (VIS_CULL_CHUNK_SIZE - 1)) == 0) {
+    /* The chunk's old points are being overwritten from here on */
+    visAabbArray_Reset(&trail->chunks, chunk);
+    /* The segment joining the chunks belongs to the previous one. Slot 0 joins on to the last
+     * chunk through the mirror slot, once the ring has wrapped */
+    if (chunk > 0) {
+      visAabbArray_Extend(&trail->chunks, chunk - 1, x, y, z);
+    }
+    else if (trail->count == trail->capacity) {
+      visAabbArray_Extend(&trail->chunks, trail->chunks.count - 1, x, y, z);
+    }
+  }
+  visAabbArray_Extend(&trail->chunks, chunk, x, y, z);
+
+  trail->head += 1;
+  if (trail->head == trail->capacity) {
+    trail->head = 0;
+  }
+  if (trail->count < trail->capacity) {
+    trail->count += 1;
+  }
+  if (trail->dirty_count < trail->capacity) {
+    trail->dirty_count += 1;
+  }
+  visRedraw_Request();
+}
+
+void visTrail_Clear(visTrail *trail) {
+  trail->head = 0;
+  trail->count = 0;
+  trail->dirty_count = 0;
+  for (uint32_t c = 0; c < trail->chunks.count; c++) {
+    visAabbArray_Reset(&trail->chunks, c);
+  }
+  visRedraw_Request();
+}
+
+void visTrail_SetColor(visTrail *trail,
+                       float r,
+                       float g,
+                       float b,
+                       float a) {
+  trail->color[0] = r;
+  trail->color[1] = g;
+  trail->color[2] = b;
+  trail->color[3] = a;
+  visRedraw_Request();
+}
+
+visTrailUpload visTrail_PrepareUpload(visTrail *trail) {
+  visTrailUpload upload = {0};
+  if (trail->dirty_count == 0) {
+    return upload;
+  }
+
+  /* The dirty slots are the dirty_count slots written just before head */
+  const uint32_t first = (trail->head + trail->capacity - trail->dirty_count) % trail->capacity;
+  if (first + trail->dirty_count <= trail->capacity) {
+    upload.ranges[0].first = first;
+    upload.ranges[0].count = trail->dirty_count;
+    upload.num_ranges = 1;
+    upload.upload_mirror = first == 0;
+  }
+  else {
+    upload.ranges[0].first = first;
+    upload.ranges[0].count = trail->capacity - first;
+    upload.ranges[1].first = 0;
+    upload.ranges[1].count = trail->dirty_count - upload.ranges[0].count;
+    upload.num_ranges = 2;
+    upload.upload_mirror = true;
+  }
+
+  trail->bytes_uploaded += (uint64_t)(trail->dirty_count + (upload.upload_mirror ? 1 : 0)) * sizeof(visVec3);
+  trail->dirty_count = 0;
+  return upload;
+}
+
+uint32_t visTrail_GetDrawRanges(const visTrail *trail,
+                                visTrailRange *ranges) {
+  if (trail->count == 0) {
+    return 0;
+  }
+  /* Not wrapped yet (or wrapped exactly back to the start), the points are in order */
+  if (trail->count < trail->capacity || trail->head == 0) {
+    ranges[0].first = 0;
+    ranges[0].count = trail->count;
+    return 1;
+  }
+  /* Oldest point is at head. The first range runs through the mirror slot, which is a copy of
+   * slot 0, so it joins up with the second range */
+  ranges[0].first = trail->head;
+  ranges[0].count = trail->capacity - trail->head + 1;
+  ranges[1].first = 0;
+  ranges[1].count = trail->head;
+  return 2;
+}
+
+uint32_t visTrail_GetVisibleRanges(visTrail *trail,
+                                   const visFrustum *frustum,
+                                   visCullRange *ranges,
+                                   uint32_t maxRanges,
+                                   visCullCounts *counts) {
+  counts->visible = 0;
+  counts->culled = 0;
+  visTrailRange draw_ranges[2];
+  const uint32_t num_draw_ranges = visTrail_GetDrawRanges(trail, draw_ranges);
+  if (num_draw_ranges == 0) {
+    return 0;
+  }
+
+  /* Only the chunks holding points, the rest are empty until the ring first gets to them */
+  visAabbArray used = trail->chunks;
+  used.count = (trail->count + VIS_CULL_CHUNK_SIZE - 1) >> VIS_CULL_CHUNK_SHIFT;
+  counts->visible = visFrustum_TestAabbs(frustum, &used, trail->chunk_visible);
+  if (trail->count == trail->capacity) {
+    const uint32_t head_chunk = trail->head >> VIS_CULL_CHUNK_SHIFT;
+    counts->visible += trail->chunk_visible[head_chunk] ? 0 : 1;
+    trail->chunk_visible[head_chunk] = 1;
+  }
+  counts->culled = used.count - counts->visible;
+
+  uint32_t num_ranges = 0;
+  for (uint32_t i = 0; i < num_draw_ranges; i++) {
+    /* Leave room for the second range */
+    const uint32_t room = maxRanges - num_ranges - (num_draw_ranges - 1 - i);
+    num_ranges += visCulling_ClipStrip(draw_ranges[i].first,
+                                       draw_ranges[i].count,
+                                       0,
+                                       trail->chunk_visible,
+                                       used.count,
+                                       &ranges[num_ranges],
+                                       room);
+  }
+  return num_ranges;
+}
+
+static void Upload(visTrail *trail) {
+  visTrailUpload upload = visTrail_PrepareUpload(trail);
+  if (upload.num_ranges == 0) {
+    return;
+  }
+  visGlState_BindBuffer(GL_ARRAY_BUFFER, trail->vbo);
+  for (uint32_t i = 0; i < upload.num_ranges; i++) {
+    glBufferSubData(GL_ARRAY_BUFFER,
+                    (GLintptr)upload.ranges[i].first * sizeof(visVec3),
+                    (GLsizeiptr)upload.ranges[i].count * sizeof(visVec3),
+                    &trail->points[upload.ranges[i].first]);
+  }
+  if (upload.upload_mirror) {
+    glBufferSubData(GL_ARRAY_BUFFER,
+                    (GLintptr)trail->capacity * sizeof(visVec3),
+                    sizeof(visVec3),
+                    &trail->points[trail->capacity]);
+  }
+}
+
+void visTrail_Draw(visTrail *trail) {
+  visProfiler_BeginScope("Trail");
+  Upload(trail);
+
+  if (!visProgram_IsReady(&trail_program_)) {
+    visProfiler_EndScope();
+    return;
+  }
+  visCullRange ranges[TRAIL_MAX_VISIBLE_RANGES];
+  visCullCounts counts;
+  const uint32_t num_ranges = visTrail_GetVisibleRanges(trail,
+                                                        visCulling_GetFrustum(),
+                                                        ranges,
+                                                        TRAIL_MAX_VISIBLE_RANGES,
+                                                        &counts);
+  visCulling_Count(visCullLayer_Trail, counts.visible, counts.culled);
+  if (num_ranges == 0) {
+    visProfiler_EndScope();
+    return;
+  }
+
+  /* The ranges share everything else, so the queue merges them into one multi draw */
+  visDrawCommand command = visRenderQueue_NewCommand(&trail_program_, trail->vao, GL_LINE_STRIP);
+  command.pass = visRenderPass_Transparent;
+  command.blend = true;
+  command.layer = "Trail";
+  command.color_location = trail_program_.uniforms[visUniform_Color];
+  memcpy(command.color, trail->color, sizeof(command.color));
+  for (uint32_t i = 0; i < num_ranges; i++) {
+    command.first = ranges[i].first;
+    command.count = ranges[i].count;
+    /* Sorted back to front with the other blended layers by the chunks the range goes through */
+    const uint32_t first_chunk = ranges[i].first >> VIS_CULL_CHUNK_SHIFT;
+    const uint32_t last_chunk = (ranges[i].first + ranges[i].count - 1) >> VIS_CULL_CHUNK_SHIFT;
+    command.depth = visCulling_GetDepth(&trail->chunks, first_chunk, last_chunk - first_chunk + 1);
+    visRenderQueue_Submit(&command);
+  }
+  visProfiler_EndScope();
+}
+
+size_t visTrail_MemoryBytes(const visTrail *trail) {
+  return trail->points ? (trail->capacity + 1) * sizeof(visVec3) : 0;
+}
@@ -0,0 +1,134 @@
+#include "cvis/updates.h"
+#include "cvis/redraw.h"
+#include <stdatomic.h>
+#include <stddef.h>
+#include <string.h>
+
+#define UPDATES_MASK (VIS_UPDATE_QUEUE_CAPACITY - 1)
+#define UPDATES_CACHE_LINE 64
+
+/* Each cell's sequence says who may use it next: a producer when it equals the enqueue position,
+ * the consumer when it equals that position + 1. It is stored minus the cell's index so the
+ * starting state (sequence == index) is all zeros, and the queue needs no initialisation */
+typedef struct {
+  atomic_size_t sequence;
+  visUpdate update;
+} Cell;
+
+/* Producers and the consumer each hammer their own position, keep them on separate cache lines */
+static _Alignas(UPDATES_CACHE_LINE) atomic_size_t enqueue_position_;
+static _Alignas(UPDATES_CACHE_LINE) atomic_size_t dequeue_position_;
+static _Alignas(UPDATES_CACHE_LINE) atomic_uint_fast64_t dropped_;
+static Cell cells_[VIS_UPDATE_QUEUE_CAPACITY];
+
+static size_t LoadSequence(size_t position) {
+  const size_t index = position & UPDATES_MASK;
+  return atomic_load_explicit(&cells_[index].sequence, memory_order_acquire) + index;
+}
+
+static void StoreSequence(size_t position,
+                          size_t sequence) {
+  const size_t index = position & UPDATES_MASK;
+  atomic_store_explicit(&cells_[index].sequence, sequence - index, memory_order_release);
+}
+
+bool visUpdates_Push(const visUpdate *update) {
+  size_t position = atomic_load_explicit(&enqueue_position_, memory_order_relaxed);
+  for (;;) {
+    const intptr_t difference = (intptr_t)LoadSequence(position) - (intptr_t)position;
+    if (difference == 0) {
+      /* Free cell, claim it. On failure position is reloaded and we go again */
+      if (atomic_compare_exchange_weak_explicit(&enqueue_position_, &position, position + 1,
+                                                memory_order_relaxed, memory_order_relaxed)) {
+        break;
+      }
+    }
+    else if (difference < 0) {
+      /* The consumer hasn't freed this cell from the last time round, full */
+      atomic_fetch_add_explicit(&dropped_, 1, memory_order_relaxed);
+      return false;
+    }
+    else {
+      /* Another producer claimed it first */
+      position = atomic_load_explicit(&enqueue_position_, memory_order_relaxed);
+    }
+  }
+  cells_[position & UPDATES_MASK].update = *update;
+  /* Publishes the update to the consumer */
+  StoreSequence(position, position + 1);
+  visRedraw_Request();
+  return true;
+}
+
+bool visUpdates_Pop(visUpdate *update) {
+  size_t position = atomic_load_explicit(&dequeue_position_, memory_order_relaxed);
+  for (;;) {
+    const intptr_t difference = (intptr_t)LoadSequence(position) - (intptr_t)(position + 1);
+    if (difference == 0) {
+      if (atomic_compare_exchange_weak_explicit(&dequeue_position_, &position, position + 1,
+                                                memory_order_relaxed, memory_order_relaxed)) {
+        break;
+      }
+    }
+    else if (difference < 0) {
+      /* Nothing published here yet, empty */
+      return false;
+    }
+    else {
+      position = atomic_load_explicit(&dequeue_position_, memory_order_relaxed);
+    }
+  }
+  *update = cells_[position & UPDATES_MASK].update;
+  /* Hands the cell back to the producers for the next time round the ring */
+  StoreSequence(position, position + VIS_UPDATE_QUEUE_CAPACITY);
+  return true;
+}
+
+bool visUpdates_PushRobotPose(float x,
+                              float y,
+                              float heading) {
+  visUpdate update;
+  update.type = visUpdate_RobotPose;
+  update.pose.robot = VIS_INVALID_ROBOT_HANDLE;
+  update.pose.x = x;
+  update.pose.y = y;
+  update.pose.heading = heading;
+  return visUpdates_Push(&update);
+}
+
+bool visUpdates_PushFleetPose(visRobotHandle robot,
+                              float x,
+                              float y,
+                              float heading) {
+  visUpdate update;
+  update.type = visUpdate_FleetPose;
+  update.pose.robot = robot;
+  update.pose.x = x;
+  update.pose.y = y;
+  update.pose.heading = heading;
+  return visUpdates_Push(&update);
+}
+
+bool visUpdates_PushWaypoints(const float *xyz,
+                              uint32_t count) {
+  visUpdate update;
+  update.type = visUpdate_Waypoints;
+  for (uint32_t first = 0; first < count; first += VIS_UPDATE_MAX_WAYPOINTS) {
+    update.waypoints.count = count - first < VIS_UPDATE_MAX_WAYPOINTS ? count - first : VIS_UPDATE_MAX_WAYPOINTS;
+    memcpy(update.waypoints.xyz, &xyz[3 * first], 3 * update.waypoints.count * sizeof(float));
+    if (!visUpdates_Push(&update)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool visUpdates_PushClearWaypoints() {
+  visUpdate update;
+  update.type = visUpdate_ClearWaypoints;
+  return visUpdates_Push(&update);
+}
+
+uint64_t visUpdates_Dropped() {
+  return atomic_load_explicit(&dropped_, memory_order_relaxed);
+}
@@ -1,20 +1,71 @@
 #include "cvis/vis.h"
+#include "cvis/gl_state.h"
+#include "cvis/mat4.h"
+#include "glad/glad.h"
+#include <string.h>
 
-static const Mat4f *current_view_;
-static const Mat4f *current_projection_;
+/* Matches the std140 layout of the Camera uniform block in the shaders, three mat4s back to back */
+typedef struct {
+  Mat4f view;
+  Mat4f projection;
+  Mat4f view_projection;
+} CameraBlock;
 
-void vis_PushCamera(const visCamera *camera) {
-  current_view_ = &camera->view;
+static CameraBlock camera_block_;
+static GLuint camera_ubo_ = 0;
+
+/* Copy of the camera matrices to the uniform buffer every program reads them from */
+static void UploadCameraBlock() {
+  visMat4_Multiply(camera_block_.projection.mat, camera_block_.view.mat, camera_block_.view_projection.mat);
+  visCulling_SetViewProjection(camera_block_.view_projection.mat);
+
+  if (camera_ubo_ == 0) {
+    glGenBuffers(1, &camera_ubo_);
+    visGlState_BindBuffer(GL_UNIFORM_BUFFER, camera_ubo_);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, VIS_CAMERA_BLOCK_BINDING, camera_ubo_);
+  }
+  else {
+    visGlState_BindBuffer(GL_UNIFORM_BUFFER, camera_ubo_);
+  }
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraBlock), &camera_block_);
 }
 
-void vis_PushProjection(const Mat4f *projection) {
-  current_projection_ = projection;
+void vis_PushCamera(const float *view) {
+  /* Pushed every frame, only a camera that moved means the next frame looks different */
+  if (memcmp(camera_block_.view.mat, view, sizeof(camera_block_.view.mat)) != 0) {
+    visRedraw_Request();
+  }
+  memcpy(camera_block_.view.mat, view, sizeof(camera_block_.view.mat));
+  UploadCameraBlock();
+}
+
+void vis_PushProjection(const float *projection) {
+  if (memcmp(camera_block_.projection.mat, projection, sizeof(camera_block_.projection.mat)) != 0) {
+    visRedraw_Request();
+  }
+  memcpy(camera_block_.projection.mat, projection, sizeof(camera_block_.projection.mat));
+  UploadCameraBlock();
 }
 
 const Mat4f* vis_GetCurrentView() {
-  return current_view_;
+  return &camera_block_.view;
 }
 
 const Mat4f* vis_GetCurrentProjection() {
-  return current_projection_;
-}
\ No newline at end of file
+  return &camera_block_.projection;
+}
+
+const Mat4f* vis_GetCurrentViewProjection() {
+  return &camera_block_.view_projection;
+}
+
+Vec3f vis_GetCurrentCameraPosition() {
+  /* The view matrix is [R | t] with t = -R * position, so position = -R^T * t */
+  const float *m = camera_block_.view.mat;
+  Vec3f position;
+  position.x = -(m[0] * m[12] + m[1] * m[13] + m[2] * m[14]);
+  position.y = -(m[4] * m[12] + m[5] * m[13] + m[6] * m[14]);
+  position.z = -(m[8] * m[12] + m[9] * m[13] + m[10] * m[14]);
+  return position;
+}
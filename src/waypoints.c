@@ -1,63 +1,182 @@
 #include "cvis/vis.h"
-#include "cmat/vec3f.h"
+#include "cvis/polyline_lod.h"
+#include "cvis/projection.h"
+#include "cvis/embedded_shaders.h"
+#include "cvis/gl_state.h"
+#include "cvis/profiler.h"
+#include "cvis/redraw.h"
 #include "glad/glad.h"
-#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
 
-#define MAX_WAYPOINTS 1000
-static Vec3f waypoints[MAX_WAYPOINTS] = {0};
+/* How far (in pixels) the simplified path is allowed to be from the real path */
+#define WAYPOINTS_MAX_PIXEL_ERROR 1.0f
+/* Most pieces a level of detail range is cut into by culling, past this the rest is drawn whole */
+#define WAYPOINTS_MAX_VISIBLE_RANGES 64
 
-static int number_of_waypoints_ = 0;
+static visPolylineLod waypoints_;
 
-static visShader waypoints_shader_ = 0;
-static uint32_t waypoints_vao_, waypoints_vbo_;
+static visProgram waypoints_program_;
+/* One vertex array per level of detail, each level has its own vertex buffer */
+static uint32_t waypoints_vao_[VIS_POLYLINE_LOD_MAX_LEVELS];
+/* Culling result per chunk, see visPolylineLod.chunks */
+static uint8_t *chunk_visible_ = NULL;
+static uint32_t chunk_visible_capacity_ = 0;
+/* Chunks with a result in chunk_visible_, 0 if they couldn't be tested */
+static uint32_t num_chunks_tested_ = 0;
 
 void visWaypoints_Init() {
-  waypoints_shader_ = visShader_LoadShaderFromFiles("/Users/adamclare/projects/quimby/spoc/vis/shaders/grid_shader.vs",
-                                                   "/Users/adamclare/projects/quimby/spoc/vis/shaders/grid_shader.fs");
+  visProgram_LoadAsync(&waypoints_program_,
+                       visShaderSource_grid_shader_vs,
+                       visShaderSource_grid_shader_fs);
 
-  glGenVertexArrays(1, &waypoints_vao_);
-  glGenBuffers(1, &waypoints_vbo_);
-  glBindVertexArray(waypoints_vao_);
+  visPolylineLod_Init(&waypoints_);
+  visPolylineLod_InitGpu(&waypoints_);
 
-  glBindBuffer(GL_ARRAY_BUFFER, waypoints_vbo_);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(waypoints), waypoints, GL_DYNAMIC_DRAW);
+  glGenVertexArrays(VIS_POLYLINE_LOD_MAX_LEVELS, waypoints_vao_);
+  for (uint32_t l = 0; l < VIS_POLYLINE_LOD_MAX_LEVELS; l++) {
+    visGlState_BindVertexArray(waypoints_vao_[l]);
+    /* The gpu storage is allocated on the first upload, the buffer object just needs to be bound
+     * here so it gets attached to the vertex array */
+    visGlState_BindBuffer(GL_ARRAY_BUFFER, waypoints_.levels[l].vbo);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+  }
 
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-  glEnableVertexAttribArray(0);
-
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindVertexArray(0);
+  visGlState_BindBuffer(GL_ARRAY_BUFFER, 0);
+  visGlState_BindVertexArray(0);
 }
 
 void visWaypoints_Add(float x,
                       float y,
                       float z) {
-  assert(number_of_waypoints_ < MAX_WAYPOINTS);
-  waypoints[number_of_waypoints_].x = x;
-  waypoints[number_of_waypoints_].y = y;
-  waypoints[number_of_waypoints_].z = z;
-  number_of_waypoints_ += 1;
+  if (!visPolylineLod_Append(&waypoints_, x, y, z)) {
+    printf("ERROR (Waypoints): Could not grow waypoint buffer, dropping waypoint\n");
+    return;
+  }
+  visRedraw_Request();
+}
+
+void visWaypoints_AddBatch(const float *xyz,
+                           uint32_t count) {
+  visRedraw_Request();
+  /* Grow once up front instead of (possibly) several times part way through the batch */
+  visPolylineLod_Reserve(&waypoints_, visPolylineLod_Count(&waypoints_) + count);
+  for (uint32_t i = 0; i < count; i++) {
+    if (!visPolylineLod_Append(&waypoints_, xyz[3 * i], xyz[3 * i + 1], xyz[3 * i + 2])) {
+      printf("ERROR (Waypoints): Could not grow waypoint buffer, dropped %u waypoints\n", count - i);
+      return;
+    }
+  }
+}
+
+void visWaypoints_AddBatchSoA(const float *x,
+                              const float *y,
+                              const float *z,
+                              uint32_t count) {
+  visRedraw_Request();
+  visPolylineLod_Reserve(&waypoints_, visPolylineLod_Count(&waypoints_) + count);
+  for (uint32_t i = 0; i < count; i++) {
+    if (!visPolylineLod_Append(&waypoints_, x[i], y[i], z ? z[i] : 0.0f)) {
+      printf("ERROR (Waypoints): Could not grow waypoint buffer, dropped %u waypoints\n", count - i);
+      return;
+    }
+  }
+}
+
+void visWaypoints_Clear() {
+  visPolylineLod_Clear(&waypoints_);
+  visRedraw_Request();
+}
 
-  glBindBuffer(GL_ARRAY_BUFFER, waypoints_vbo_);
-  glBufferSubData(GL_ARRAY_BUFFER, 0, number_of_waypoints_ * sizeof(float) * 3, waypoints);
+/* Distance from the camera to the closest point of the waypoints bounding box. Using the
+ * closest point means the error is under a pixel for the nearest waypoints, and less for
+ * the ones further away */
+static float DistanceToWaypoints() {
+  const Vec3f camera = vis_GetCurrentCameraPosition();
+  const float dx = fmaxf(fmaxf(waypoints_.min.x - camera.x, 0.0f), camera.x - waypoints_.max.x);
+  const float dy = fmaxf(fmaxf(waypoints_.min.y - camera.y, 0.0f), camera.y - waypoints_.max.y);
+  const float dz = fmaxf(fmaxf(waypoints_.min.z - camera.z, 0.0f), camera.z - waypoints_.max.z);
+  return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+static uint32_t SelectRanges() {
+  int width = 0;
+  int height = 0;
+  visWindow_GetFramebufferSize(&width, &height);
+  const float pixel_size = visProjection_WorldUnitsPerPixel(vis_GetCurrentProjection(),
+                                                            DistanceToWaypoints(),
+                                                            height);
+  return visPolylineLod_Select(&waypoints_, WAYPOINTS_MAX_PIXEL_ERROR * pixel_size);
+}
+
+/* Test every chunk against the frustum
+ * \return number of visible chunks */
+static uint32_t CullChunks() {
+  const visAabbArray *chunks = &waypoints_.chunks;
+  if (chunks->count > chunk_visible_capacity_) {
+    uint8_t *visible = (uint8_t *)realloc(chunk_visible_, chunks->capacity);
+    if (!visible) {
+      /* Can't cull, chunks without a result are drawn */
+      num_chunks_tested_ = 0;
+      return chunks->count;
+    }
+    chunk_visible_ = visible;
+    chunk_visible_capacity_ = chunks->capacity;
+  }
+  const uint32_t num_visible = visFrustum_TestAabbs(visCulling_GetFrustum(), chunks, chunk_visible_);
+  num_chunks_tested_ = chunks->count;
+  visCulling_Count(visCullLayer_Waypoints, num_visible, chunks->count - num_visible);
+  return num_visible;
 }
 
 void visWaypoints_Draw() {
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-  glUseProgram(waypoints_shader_);
-  glPointSize(5);
+  visProfiler_BeginScope("Waypoints");
+  /* Everything added since the last frame goes up in a single upload (per level) */
+  visPolylineLod_Upload(&waypoints_);
+
+  const uint32_t num_ranges = SelectRanges();
+  const visPolylineLodRange *ranges = waypoints_.ranges;
+  if (num_ranges == 0 || !visProgram_IsReady(&waypoints_program_) || CullChunks() == 0) {
+    visProfiler_EndScope();
+    return;
+  }
+
+  visDrawCommand command = visRenderQueue_NewCommand(&waypoints_program_, 0, GL_POINTS);
+  command.pass = visRenderPass_Transparent;
+  command.blend = true;
+  command.point_size = 5;
+  command.layer = "Waypoints";
   // Default color to blue
-  float wp_color[4] = {0, 0, 1, 1};
-  glUniform4f(glGetUniformLocation(waypoints_shader_, "color"),
-              wp_color[0],
-              wp_color[1],
-              wp_color[2],
-              wp_color[3]);
-  glUniformMatrix4fv(glGetUniformLocation(waypoints_shader_, "view"), 1, GL_FALSE, &vis_GetCurrentView()->mat[0]);
-  glUniformMatrix4fv(glGetUniformLocation(waypoints_shader_, "projection"), 1, GL_FALSE, &vis_GetCurrentProjection()->mat[0]);
-
-  glBindVertexArray(waypoints_vao_);
-  glDrawArrays(GL_POINTS, 0, (GLsizei)number_of_waypoints_);
-  glDrawArrays(GL_LINE_STRIP, 0, (GLsizei)number_of_waypoints_);
-}
\ No newline at end of file
+  command.color_location = waypoints_program_.uniforms[visUniform_Color];
+  command.color[2] = 1;
+  command.color[3] = 1;
+
+  for (uint32_t i = 0; i < num_ranges; i++) {
+    /* Only the parts of the range over visible chunks */
+    visCullRange visible[WAYPOINTS_MAX_VISIBLE_RANGES];
+    const uint32_t num_visible = visCulling_ClipStrip(ranges[i].first,
+                                                      ranges[i].count,
+                                                      VIS_POLYLINE_LOD_FACTOR_SHIFT * ranges[i].level,
+                                                      chunk_visible_,
+                                                      num_chunks_tested_,
+                                                      visible,
+                                                      WAYPOINTS_MAX_VISIBLE_RANGES);
+    command.vertex_array = waypoints_vao_[ranges[i].level];
+    const uint32_t shift = VIS_POLYLINE_LOD_FACTOR_SHIFT * ranges[i].level;
+    for (uint32_t v = 0; v < num_visible; v++) {
+      command.first = visible[v].first;
+      command.count = visible[v].count;
+      /* Sorted back to front with the other blended layers by the chunks the vertices cover */
+      const uint32_t first_chunk = (visible[v].first << shift) >> VIS_CULL_CHUNK_SHIFT;
+      const uint32_t last_chunk = ((visible[v].first + visible[v].count - 1) << shift) >> VIS_CULL_CHUNK_SHIFT;
+      command.depth = visCulling_GetDepth(&waypoints_.chunks, first_chunk, last_chunk - first_chunk + 1);
+      command.mode = GL_POINTS;
+      visRenderQueue_Submit(&command);
+      command.mode = GL_LINE_STRIP;
+      visRenderQueue_Submit(&command);
+    }
+  }
+  visProfiler_EndScope();
+}
@@ -2,16 +2,50 @@
 #include "glad/glad.h"
 #include "GLFW/glfw3.h"
 #include "cvis/projection.h"
+#include "cvis/gl_state.h"
+#include "cvis/render_queue.h"
+#include "cvis/profiler.h"
+#include "cvis/updates.h"
+#include "cvis/scene.h"
+#include "cvis/capture.h"
+#include "cvis/redraw.h"
+#include "cvis/culling.h"
+#include "cvis/robot.h"
+#include "cvis/waypoints.h"
+#include "cvis/fleet.h"
+#if defined(CVIS_HEADLESS)
+#include "cvis/headless.h"
+#endif
 #include <math.h>
+#include <stdio.h>
+#include <time.h>
+
+/* Frames still drawn after the last change when rendering on demand. ImGui reacts to input a
+ * frame late (hover, a button released) */
+#define WINDOW_SETTLE_FRAMES 2
 
 /* Main window object */
 static GLFWwindow *window_ = NULL;
+/* Rendering offscreen without a window, see visWindow_InitializeHeadless */
+static bool headless_ = false;
+/* Only render when something changed, see visWindow_SetOnDemand */
+static bool on_demand_ = false;
+static double wait_timeout_ = 0.0;
+static int settle_frames_ = 0;
+/* Start of the last headless frame, seconds. ImGui needs the time between frames */
+static double headless_frame_time_ = 0.0;
 static float field_of_view_deg_ = 45;
 static int window_width_ = 0;
 static int window_height_ = 0;
 static bool mouse_left_pushed_ = false;
+/* Sequence of the last scene snapshot applied to the layers */
+static uint64_t scene_sequence_ = 0;
 static double prev_mouse_x_ = 0.0;
 static double prev_mouse_y_ = 0.0;
+/* Left click not yet taken with visWindow_TakeClick */
+static bool click_pending_ = false;
+static double click_x_ = 0.0;
+static double click_y_ = 0.0;
 
 Mat4f projection_;
 
@@ -38,8 +72,61 @@ static void WindowResizeCallback(GLFWwindow *window,
                                  int width,
                                  int height);
 
+static void WindowCharCallback(GLFWwindow *window,
+                               unsigned int codepoint);
+
+static void WindowRefreshCallback(GLFWwindow *window);
+
 static void UpdateProjectionMatrix();
 
+/* Apply the updates other threads queued since the last frame. At most one queue's worth, so
+ * producers that keep pushing can't hold up the frame */
+static void ApplyUpdates() {
+  visUpdate update;
+  for (uint32_t i = 0; i < VIS_UPDATE_QUEUE_CAPACITY && visUpdates_Pop(&update); i++) {
+    switch (update.type) {
+      case visUpdate_RobotPose: {
+        Vec3f pose;
+        pose.x = update.pose.x;
+        pose.y = update.pose.y;
+        pose.z = update.pose.heading;
+        visRobot_UpdatePosition(pose);
+        break;
+      }
+      case visUpdate_FleetPose:
+        visFleet_SetPose(update.pose.robot, update.pose.x, update.pose.y, update.pose.heading);
+        break;
+      case visUpdate_Waypoints:
+        visWaypoints_AddBatch(update.waypoints.xyz, update.waypoints.count);
+        break;
+      case visUpdate_ClearWaypoints:
+        visWaypoints_Clear();
+        break;
+    }
+  }
+}
+
+/* Apply the newest scene snapshot, if one was published since the last frame */
+static void ApplyScene() {
+  const visSceneState *scene = visScene_Latest();
+  if (scene->sequence == scene_sequence_) {
+    return;
+  }
+  scene_sequence_ = scene->sequence;
+  if (scene->has_robot) {
+    Vec3f pose;
+    pose.x = scene->robot.x;
+    pose.y = scene->robot.y;
+    pose.z = scene->robot.heading;
+    visRobot_UpdatePosition(pose);
+  }
+  /* visScene_Publish keeps num_fleet_poses within the buffer */
+  for (uint32_t i = 0; i < scene->num_fleet_poses; i++) {
+    const visScenePose *pose = &scene->fleet[i];
+    visFleet_SetPose(pose->robot, pose->x, pose->y, pose->heading);
+  }
+}
+
 bool visWindow_Initialize(const char *windowName,
                           int width,
                           int height) {
@@ -73,6 +160,8 @@ bool visWindow_Initialize(const char *windowName,
   glfwSetKeyCallback(window_, WindowKeyboardCallback);
   glfwSetScrollCallback(window_, WindowScrollCallback);
   glfwSetMouseButtonCallback(window_, WindowMouseButtonCallback);
+  glfwSetCharCallback(window_, WindowCharCallback);
+  glfwSetWindowRefreshCallback(window_, WindowRefreshCallback);
   
   glfwMakeContextCurrent(window_);
   /* Enable vsync, when this is disabled was getting high cpu usage */
@@ -91,24 +180,153 @@ bool visWindow_Initialize(const char *windowName,
   return true;
 }
 
+static double NowSeconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1.0e-9;
+}
+
+bool visWindow_InitializeHeadless(int width,
+                                  int height) {
+#if defined(CVIS_HEADLESS)
+  if (!visHeadless_Initialize(width, height)) {
+    return false;
+  }
+  headless_ = true;
+  window_width_ = width;
+  window_height_ = height;
+  UpdateProjectionMatrix();
+
+  /* No platform backend, the display size and frame time are filled in every frame instead */
+  igCreateContext(NULL);
+  ImGui_ImplOpenGL3_Init("#version 330 core");
+  igStyleColorsDark(NULL);
+  headless_frame_time_ = NowSeconds();
+  return true;
+#else
+  (void)width;
+  (void)height;
+  printf("ERROR (Window): Built without headless support, configure with -DCVIS_HEADLESS=ON\n");
+  return false;
+#endif
+}
+
+bool visWindow_IsHeadless() {
+  return headless_;
+}
+
+void visWindow_SetVsync(bool enabled) {
+  /* Headless frames are never throttled */
+  if (!headless_) {
+    glfwSwapInterval(enabled ? 1 : 0);
+  }
+}
+
+void visWindow_SetOnDemand(bool enabled,
+                           double maxWait) {
+  /* Headless frames are only rendered when the application asks for them anyway */
+  on_demand_ = enabled && !headless_;
+  wait_timeout_ = maxWait;
+  /* Lets other threads' updates end the wait early */
+  visRedraw_SetWakeFunction(on_demand_ ? glfwPostEmptyEvent : NULL);
+  visRedraw_Request();
+}
+
 bool visWindow_ShouldClose() {
+  /* Offscreen the application decides how many frames to render */
+  if (headless_) {
+    return false;
+  }
   return glfwWindowShouldClose(window_);
 }
 
-void visWindow_NewFrame() {
-  glfwPollEvents();
+static void NewHeadlessFrame() {
+  const double now = NowSeconds();
+  ImGuiIO *io = igGetIO();
+  io->DisplaySize.x = (float)window_width_;
+  io->DisplaySize.y = (float)window_height_;
+  /* ImGui asserts the frame time is positive */
+  io->DeltaTime = now > headless_frame_time_ ? (float)(now - headless_frame_time_) : 1.0e-6f;
+  headless_frame_time_ = now;
+}
+
+/* Wait for input, a redraw request or the timeout
+ * \return whether to render a frame */
+static bool WaitForChanges() {
+  if (settle_frames_ > 0) {
+    /* Still settling, render straight away */
+    glfwPollEvents();
+  }
+  else {
+    glfwWaitEventsTimeout(wait_timeout_);
+  }
+  /* A capture records every frame, changed or not */
+  if (visRedraw_Take() || visCapture_IsActive() || glfwWindowShouldClose(window_)) {
+    settle_frames_ = WINDOW_SETTLE_FRAMES;
+    return true;
+  }
+  if (settle_frames_ > 0) {
+    settle_frames_ -= 1;
+    return true;
+  }
+  return false;
+}
+
+bool visWindow_NewFrame() {
+  if (on_demand_ && !WaitForChanges()) {
+    return false;
+  }
+  visProfiler_BeginFrame();
+  visCulling_NewFrame();
+  /* ImGui (and anything else outside cvis) may have changed the state since the last frame */
+  visGlState_NewFrame();
+  if (headless_) {
+    NewHeadlessFrame();
+  }
+  else if (!on_demand_) {
+    glfwPollEvents();
+  }
+  visProfiler_BeginCpuScope("Updates");
+  ApplyUpdates();
+  ApplyScene();
+  visProfiler_EndScope();
   glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
   glClear(GL_COLOR_BUFFER_BIT);
 
   ImGui_ImplOpenGL3_NewFrame();
-  ImGui_ImplGlfw_NewFrame();
+  if (!headless_) {
+    ImGui_ImplGlfw_NewFrame();
+  }
   igNewFrame();
+  return true;
 }
 
 void visWindow_EndFrame() {
+  /* Everything the layers submitted this frame, sorted, before ImGui goes on top. Cpu only, the
+   * queue times each layer's draws on the gpu itself */
+  visProfiler_BeginCpuScope("Render Queue");
+  visRenderQueue_Execute();
+  visProfiler_EndScope();
+
+  visProfiler_BeginScope("ImGui");
   igRender();
   ImGui_ImplOpenGL3_RenderDrawData(igGetDrawData());
-  glfwSwapBuffers(window_);
+  visProfiler_EndScope();
+
+  /* Queued before the swap so it reads this frame's back buffer, ImGui included */
+  if (visCapture_IsActive()) {
+    visProfiler_BeginCpuScope("Capture");
+    visCapture_Frame();
+    visProfiler_EndScope();
+  }
+
+  /* Nothing to present offscreen, the frame stays in the framebuffer object */
+  if (!headless_) {
+    visProfiler_BeginCpuScope("Swap");
+    glfwSwapBuffers(window_);
+    visProfiler_EndScope();
+  }
+  visProfiler_EndFrame();
 }
 
 void visWindow_ChangeFieldOfView(float fovInDegrees) {
@@ -121,12 +339,50 @@ void visWindow_ChangeFieldOfView(float fovInDegrees) {
   }
 
   UpdateProjectionMatrix();
+  visRedraw_Request();
 }
 
 const Mat4f* visWindow_GetProjectionMatrix() {
   return &projection_;
 }
 
+void visWindow_GetFramebufferSize(int *width,
+                                  int *height) {
+  *width = window_width_;
+  *height = window_height_;
+}
+
+void visWindow_GetWindowSize(int *width,
+                             int *height) {
+  /* Headless there is no scaling, ImGui's display is the framebuffer */
+  if (headless_ || !window_) {
+    *width = window_width_;
+    *height = window_height_;
+    return;
+  }
+  glfwGetWindowSize(window_, width, height);
+}
+
+bool visWindow_TakeClick(double *x,
+                         double *y) {
+  if (!click_pending_) {
+    return false;
+  }
+  click_pending_ = false;
+  *x = click_x_;
+  *y = click_y_;
+  return true;
+}
+
+bool visWindow_ReadPixels(uint8_t *rgba) {
+  if (!headless_) {
+    return false;
+  }
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, window_width_, window_height_, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+  return true;
+}
+
 static void WindowResizeCallback(GLFWwindow *window,
                                  int width,
                                  int height) {
@@ -134,11 +390,23 @@ static void WindowResizeCallback(GLFWwindow *window,
   window_width_ = width;
   window_height_ = height;
   UpdateProjectionMatrix();
+  visRedraw_Request();
+}
+
+static void WindowCharCallback(GLFWwindow *window,
+                               unsigned int codepoint) {
+  visRedraw_Request();
+}
+
+/* The window was uncovered or resized and its contents are gone */
+static void WindowRefreshCallback(GLFWwindow *window) {
+  visRedraw_Request();
 }
 
 void WindowMouseCallback(GLFWwindow* win,
                          double xpos,
                          double ypos) {
+  visRedraw_Request();
   // static const double angle_scale = 0.2;
   // struct ImGuiIO* io = igGetIO();
   // if (mouse_left_pushed && !io->WantCaptureMouse) {
@@ -159,6 +427,7 @@ void WindowKeyboardCallback(GLFWwindow* win,
                                     int scancode,
                                     int action,
                                     int mods) {
+  visRedraw_Request();
   // if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {  
   //   glfwSetWindowShouldClose(window_, 1);
   // }                                  
@@ -211,12 +480,16 @@ void WindowMouseButtonCallback(GLFWwindow* win,
                                int button,
                                int action,
                                int mods) {
+  visRedraw_Request();
   if (!igGetIO()->WantCaptureMouse) {
     if (button == GLFW_MOUSE_BUTTON_LEFT) {
       if (action == GLFW_PRESS) {
         /* Get the mouse position from when the left button is clicked */
         glfwGetCursorPos(win, &prev_mouse_x_, &prev_mouse_y_);
         mouse_left_pushed_ = true;
+        click_x_ = prev_mouse_x_;
+        click_y_ = prev_mouse_y_;
+        click_pending_ = true;
       } else {
         mouse_left_pushed_ = false;
       }
@@ -1,7 +1,37 @@
 #include "tests_camera.h"
 #include "tests_projection.h"
+#include "tests_trail.h"
+#include "tests_polyline_lod.h"
+#include "tests_render_queue.h"
+#include "tests_profiler.h"
+#include "tests_updates.h"
+#include "tests_scene.h"
+#include "tests_capture.h"
+#include "tests_redraw.h"
+#include "tests_camera3d.h"
+#include "tests_culling.h"
+#include "tests_picking.h"
+#include "tests_mat4.h"
+#include "tests_fleet.h"
+#include "tests_robot_model.h"
+#include "tests_shader.h"
 
 int main() {
   test_camera3_run();
   tests_projection_run();
+  tests_trail_run();
+  tests_polyline_lod_run();
+  tests_render_queue_run();
+  tests_profiler_run();
+  tests_updates_run();
+  tests_scene_run();
+  tests_capture_run();
+  tests_redraw_run();
+  tests_camera3d_run();
+  tests_culling_run();
+  tests_picking_run();
+  tests_mat4_run();
+  tests_fleet_run();
+  tests_robot_model_run();
+  tests_shader_run();
 }
\ No newline at end of file
@@ -0,0 +1,170 @@
+#ifndef CVIS_TESTS_CAMERA3D_H_
+#define CVIS_TESTS_CAMERA3D_H_
+
+#include "ctest/unit_test.h"
+#include "cvis/camera3d.h"
+#include <cmath>
+
+static float PlaneDistance(const Eigen::Vector4f &plane,
+                           float x,
+                           float y,
+                           float z) {
+  return plane.x() * x + plane.y() * y + plane.z() * z + plane.w();
+}
+
+void test_camera3d_view_projection() {
+  vis::Camera3D camera;
+  camera.SetPerspective(60.0f, 1.5f, 0.1f, 100.0f);
+  camera.SetOrientationAngles(20.0f, 30.0f, 0.0f);
+  camera.SetTargetPosition(1.0f, 2.0f, 3.0f);
+
+  const Eigen::Matrix4f view_projection = camera.GetProjectionMatrix() * camera.GetViewMatrix();
+  UNIT_TEST_EXPECT_EQ_ARRAY_F("", camera.GetViewProjectionMatrix().data(), view_projection.data(), 16, 1.0e-5f);
+
+  const Eigen::Matrix4f identity = Eigen::Matrix4f::Identity();
+  const Eigen::Matrix4f view = camera.GetInverseViewMatrix() * camera.GetViewMatrix();
+  UNIT_TEST_EXPECT_EQ_ARRAY_F("", view.data(), identity.data(), 16, 1.0e-5f);
+  const Eigen::Matrix4f both = camera.GetInverseViewProjectionMatrix() * camera.GetViewProjectionMatrix();
+  UNIT_TEST_EXPECT_EQ_ARRAY_F("", both.data(), identity.data(), 16, 1.0e-4f);
+}
+
+void test_camera3d_lazy() {
+  /* Only the last of several setters counts, and matches a camera set once */
+  vis::Camera3D camera;
+  camera.SetPerspective(45.0f, 1.0f, 0.1f, 100.0f);
+  for (int i = 0; i < 100; i++) {
+    camera.SetOrientationAngles((float)i, (float)-i, 0.0f);
+    camera.SetTargetPosition((float)i, 0.0f, 0.0f);
+  }
+  camera.SetPerspective(60.0f, 2.0f, 0.5f, 50.0f);
+
+  vis::Camera3D expected;
+  expected.SetOrientationAngles(99.0f, -99.0f, 0.0f);
+  expected.SetTargetPosition(99.0f, 0.0f, 0.0f);
+  expected.SetPerspective(60.0f, 2.0f, 0.5f, 50.0f);
+  UNIT_TEST_EXPECT_EQ_ARRAY_F("", camera.GetViewProjectionMatrix().data(), expected.GetViewProjectionMatrix().data(), 16, 1.0e-5f);
+  UNIT_TEST_EXPECT_EQ_ARRAY_F("", camera.GetPosition().data(), expected.GetPosition().data(), 3, 1.0e-5f);
+
+  /* A later setter is picked up by the next getter */
+  camera.SetTargetPosition(-5.0f, 0.0f, 0.0f);
+  UNIT_TEST_EXPECT_EQ_FLOAT("", camera.GetViewMatrix()(12), 5.0f * camera.GetViewMatrix()(0));
+}
+
+void test_camera3d_frustum() {
+  /* Looking down -z from the origin, 90 degrees both ways */
+  vis::Camera3D camera;
+  camera.SetPerspective(90.0f, 1.0f, 1.0f, 100.0f);
+  const vis::Camera3D::FrustumPlanes &planes = camera.GetFrustumPlanes();
+
+  for (const Eigen::Vector4f &plane : planes) {
+    UNIT_TEST_EXPECT_EQ_FLOAT("", plane.head<3>().norm(), 1.0f);
+    UNIT_TEST_EXPECT_TRUE("", PlaneDistance(plane, 0.0f, 0.0f, -10.0f) > 0.0f);
+  }
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", PlaneDistance(planes[vis::Camera3D::NEAR_PLANE], 0.0f, 0.0f, -10.0f), 9.0f, 1.0e-4f);
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", PlaneDistance(planes[vis::Camera3D::FAR_PLANE], 0.0f, 0.0f, -10.0f), 90.0f, 1.0e-3f);
+  UNIT_TEST_EXPECT_TRUE("", PlaneDistance(planes[vis::Camera3D::NEAR_PLANE], 0.0f, 0.0f, 10.0f) < 0.0f);
+  UNIT_TEST_EXPECT_TRUE("", PlaneDistance(planes[vis::Camera3D::RIGHT_PLANE], 20.0f, 0.0f, -10.0f) < 0.0f);
+  UNIT_TEST_EXPECT_TRUE("", PlaneDistance(planes[vis::Camera3D::LEFT_PLANE], -20.0f, 0.0f, -10.0f) < 0.0f);
+  UNIT_TEST_EXPECT_TRUE("", PlaneDistance(planes[vis::Camera3D::TOP_PLANE], 0.0f, 20.0f, -10.0f) < 0.0f);
+  UNIT_TEST_EXPECT_TRUE("", PlaneDistance(planes[vis::Camera3D::BOTTOM_PLANE], 0.0f, -20.0f, -10.0f) < 0.0f);
+  /* 45 degrees off the axis is on the side planes */
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", PlaneDistance(planes[vis::Camera3D::RIGHT_PLANE], 10.0f, 0.0f, -10.0f), 0.0f, 1.0e-4f);
+
+  /* The planes move with the camera */
+  camera.SetTargetPosition(0.0f, 0.0f, -20.0f);
+  UNIT_TEST_EXPECT_TRUE("", PlaneDistance(camera.GetFrustumPlanes()[vis::Camera3D::NEAR_PLANE], 0.0f, 0.0f, -10.0f) < 0.0f);
+}
+
+void test_camera3d_project_to_screen() {
+  /* Looking down -z from the origin, 90 degrees both ways, a 200 x 100 viewport at 10, 20 */
+  vis::Camera3D camera;
+  camera.SetPerspective(90.0f, 1.0f, 1.0f, 100.0f);
+  camera.SetViewport(10.0f, 20.0f, 200.0f, 100.0f);
+
+  const float x[5] = {0.0f, 10.0f, -10.0f, 0.0f, 0.0f};
+  const float y[5] = {0.0f, 10.0f, 0.0f, 0.0f, 0.0f};
+  const float z[5] = {-10.0f, -10.0f, -20.0f, 10.0f, -200.0f};
+  float pixel_x[5];
+  float pixel_y[5];
+  float depth[5];
+  uint8_t on_screen[5];
+  UNIT_TEST_EXPECT_EQ_INT("", camera.ProjectToScreen(x, y, z, 5, pixel_x, pixel_y, depth, on_screen), 3);
+
+  /* Centre, top right corner, half way to the left edge */
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", pixel_x[0], 110.0f, 1.0e-3f);
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", pixel_y[0], 70.0f, 1.0e-3f);
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", pixel_x[1], 210.0f, 1.0e-3f);
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", pixel_y[1], 20.0f, 1.0e-3f);
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", pixel_x[2], 60.0f, 1.0e-3f);
+  /* Further is deeper */
+  UNIT_TEST_EXPECT_TRUE("", depth[0] > 0.0f && depth[0] < depth[2] && depth[2] < 1.0f);
+  const uint8_t expected[5] = {1, 1, 1, 0, 0};
+  for (int i = 0; i < 5; i++) {
+    UNIT_TEST_EXPECT_EQ_INT("", on_screen[i], expected[i]);
+  }
+}
+
+void test_camera3d_project_to_screen_batch() {
+  /* The four at a time path, its tail and the packed version all agree with the view projection */
+  vis::Camera3D camera;
+  camera.SetPerspective(60.0f, 1.5f, 0.1f, 100.0f);
+  camera.SetOrientationAngles(20.0f, 30.0f, 0.0f);
+  camera.SetTargetPosition(1.0f, 2.0f, 3.0f);
+  camera.SetViewport(0.0f, 0.0f, 1200.0f, 800.0f);
+  const Eigen::Matrix4f &view_projection = camera.GetViewProjectionMatrix();
+
+  const size_t count = 1003;
+  float x[count];
+  float y[count];
+  float z[count];
+  float xyz[3 * count];
+  for (size_t i = 0; i < count; i++) {
+    x[i] = xyz[3 * i] = (float)(i % 17) - 8.0f;
+    y[i] = xyz[3 * i + 1] = (float)(i % 13) - 6.0f;
+    z[i] = xyz[3 * i + 2] = (float)(i % 11) - 5.0f;
+  }
+  float pixel_x[count];
+  float pixel_y[count];
+  float depth[count];
+  uint8_t on_screen[count];
+  float pixel_xy[2 * count];
+  float packed_depth[count];
+  uint8_t packed_on_screen[count];
+  const size_t num_on_screen = camera.ProjectToScreen(x, y, z, count, pixel_x, pixel_y, depth, on_screen);
+  UNIT_TEST_EXPECT_EQ_INT("", camera.ProjectToScreen(xyz, count, pixel_xy, packed_depth, packed_on_screen), num_on_screen);
+  UNIT_TEST_EXPECT_TRUE("", num_on_screen > 0 && num_on_screen < count);
+
+  size_t expected_on_screen = 0;
+  bool same = true;
+  for (size_t i = 0; i < count; i++) {
+    const Eigen::Vector4f clip = view_projection * Eigen::Vector4f(x[i], y[i], z[i], 1.0f);
+    const bool inside = clip.w() > 0.0f && std::fabs(clip.x()) <= clip.w() &&
+                        std::fabs(clip.y()) <= clip.w() && std::fabs(clip.z()) <= clip.w();
+    expected_on_screen += inside ? 1 : 0;
+    same = same && on_screen[i] == (inside ? 1 : 0) && packed_on_screen[i] == on_screen[i];
+    if (inside) {
+      same = same && std::fabs(pixel_x[i] - 600.0f * (1.0f + clip.x() / clip.w())) < 1.0e-2f;
+      same = same && std::fabs(pixel_y[i] - 400.0f * (1.0f - clip.y() / clip.w())) < 1.0e-2f;
+      same = same && std::fabs(depth[i] - 0.5f * (1.0f + clip.z() / clip.w())) < 1.0e-5f;
+      same = same && pixel_xy[2 * i] == pixel_x[i] && pixel_xy[2 * i + 1] == pixel_y[i];
+      same = same && packed_depth[i] == depth[i];
+    }
+  }
+  UNIT_TEST_EXPECT_TRUE("", same);
+  UNIT_TEST_EXPECT_EQ_INT("", num_on_screen, expected_on_screen);
+
+  /* Depth and the mask are optional */
+  UNIT_TEST_EXPECT_EQ_INT("", camera.ProjectToScreen(x, y, z, count, pixel_x, pixel_y, nullptr, nullptr), num_on_screen);
+}
+
+void tests_camera3d_run() {
+  UNIT_TEST_SETUP("Camera3D");
+  UNIT_TEST_RUN_TEST("View Projection", test_camera3d_view_projection);
+  UNIT_TEST_RUN_TEST("Lazy", test_camera3d_lazy);
+  UNIT_TEST_RUN_TEST("Frustum", test_camera3d_frustum);
+  UNIT_TEST_RUN_TEST("Project To Screen", test_camera3d_project_to_screen);
+  UNIT_TEST_RUN_TEST("Project To Screen Batch", test_camera3d_project_to_screen_batch);
+  UNIT_TEST_FINISH("Camera3D");
+}
+
+#endif
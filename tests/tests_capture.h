@@ -0,0 +1,94 @@
+#ifndef CVIS_TESTS_CAPTURE_H_
+#define CVIS_TESTS_CAPTURE_H_
+
+#include "ctest/unit_test.h"
+#include "cvis/capture.h"
+#include <string.h>
+
+static void FillRow(uint8_t *rgba,
+                    int width,
+                    int row,
+                    uint8_t r,
+                    uint8_t g,
+                    uint8_t b) {
+  for (int x = 0; x < width; x++) {
+    rgba[4 * (row * width + x)] = r;
+    rgba[4 * (row * width + x) + 1] = g;
+    rgba[4 * (row * width + x) + 2] = b;
+    rgba[4 * (row * width + x) + 3] = 255;
+  }
+}
+
+void test_capture_colours() {
+  uint8_t rgba[4 * 4 * 2];
+  uint8_t y[8], u[2], v[2];
+  FillRow(rgba, 4, 0, 255, 255, 255);
+  FillRow(rgba, 4, 1, 255, 255, 255);
+  visCapture_RgbaToYuv420(rgba, 4, 2, y, u, v);
+  UNIT_TEST_EXPECT_EQ_INT("", y[0], 255);
+  UNIT_TEST_EXPECT_EQ_INT("", y[7], 255);
+  UNIT_TEST_EXPECT_EQ_INT("", u[0], 128);
+  UNIT_TEST_EXPECT_EQ_INT("", v[1], 128);
+
+  FillRow(rgba, 4, 0, 255, 0, 0);
+  FillRow(rgba, 4, 1, 255, 0, 0);
+  visCapture_RgbaToYuv420(rgba, 4, 2, y, u, v);
+  UNIT_TEST_EXPECT_EQ_INT("", y[3], 77);
+  UNIT_TEST_EXPECT_EQ_INT("", u[0], 85);
+  UNIT_TEST_EXPECT_EQ_INT("", v[0], 255);
+
+  memset(rgba, 0, sizeof(rgba));
+  visCapture_RgbaToYuv420(rgba, 4, 2, y, u, v);
+  UNIT_TEST_EXPECT_EQ_INT("", y[5], 0);
+  UNIT_TEST_EXPECT_EQ_INT("", u[1], 128);
+  UNIT_TEST_EXPECT_EQ_INT("", v[1], 128);
+}
+
+void test_capture_flip() {
+  /* OpenGL's bottom row comes out last */
+  uint8_t rgba[4 * 2 * 2];
+  uint8_t y[4], u[1], v[1];
+  FillRow(rgba, 2, 0, 0, 0, 0);
+  FillRow(rgba, 2, 1, 255, 255, 255);
+  visCapture_RgbaToYuv420(rgba, 2, 2, y, u, v);
+  UNIT_TEST_EXPECT_EQ_INT("", y[0], 255);
+  UNIT_TEST_EXPECT_EQ_INT("", y[1], 255);
+  UNIT_TEST_EXPECT_EQ_INT("", y[2], 0);
+  UNIT_TEST_EXPECT_EQ_INT("", y[3], 0);
+  UNIT_TEST_EXPECT_EQ_INT("", u[0], 128);
+}
+
+void test_capture_odd_size() {
+  /* 3x3 gives 2x2 chroma, the last row and column only cover themselves */
+  uint8_t rgba[4 * 3 * 3];
+  uint8_t y[9], u[4], v[4];
+  FillRow(rgba, 3, 0, 0, 0, 255);
+  FillRow(rgba, 3, 1, 255, 0, 0);
+  FillRow(rgba, 3, 2, 255, 0, 0);
+  visCapture_RgbaToYuv420(rgba, 3, 3, y, u, v);
+  UNIT_TEST_EXPECT_EQ_INT("", y[0], 77);
+  UNIT_TEST_EXPECT_EQ_INT("", y[8], 29);
+  UNIT_TEST_EXPECT_EQ_INT("", u[0], 85);
+  UNIT_TEST_EXPECT_EQ_INT("", u[1], 85);
+  UNIT_TEST_EXPECT_EQ_INT("", u[2], 255);
+  UNIT_TEST_EXPECT_EQ_INT("", u[3], 255);
+  UNIT_TEST_EXPECT_EQ_INT("", v[3], 107);
+}
+
+void test_capture_empty_size() {
+  /* Rejected before any file or GL buffer is created */
+  UNIT_TEST_EXPECT_TRUE("", !visCapture_Start("cvis_test_capture.y4m", 0, 720, visCaptureFormat_Y4m, 60));
+  UNIT_TEST_EXPECT_TRUE("", !visCapture_Start("cvis_test_capture.y4m", 1280, -1, visCaptureFormat_Y4m, 60));
+  UNIT_TEST_EXPECT_TRUE("", !visCapture_IsActive());
+}
+
+void tests_capture_run() {
+  UNIT_TEST_SETUP("Capture");
+  UNIT_TEST_RUN_TEST("Colours", test_capture_colours);
+  UNIT_TEST_RUN_TEST("Flip", test_capture_flip);
+  UNIT_TEST_RUN_TEST("Odd Size", test_capture_odd_size);
+  UNIT_TEST_RUN_TEST("Empty Size", test_capture_empty_size);
+  UNIT_TEST_FINISH("Capture");
+}
+
+#endif
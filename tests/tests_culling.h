@@ -0,0 +1,242 @@
+#ifndef CVIS_TESTS_CULLING_H_
+#define CVIS_TESTS_CULLING_H_
+
+#include "ctest/unit_test.h"
+#include "cvis/culling.h"
+#include "cvis/camera3d.h"
+#include "cvis/fleet.h"
+#include "cvis/polyline_lod.h"
+#include "cvis/trail.h"
+#include <cstdlib>
+
+/* Everything with minX <= x <= maxX */
+static visFrustum SlabFrustum(float minX,
+                              float maxX) {
+  visFrustum frustum;
+  visFrustum_SetEverything(&frustum);
+  frustum.planes[0][0] = 1.0f;
+  frustum.planes[0][3] = -minX;
+  frustum.planes[1][0] = -1.0f;
+  frustum.planes[1][3] = maxX;
+  return frustum;
+}
+
+static float RandomFloat(float min,
+                         float max) {
+  return min + (max - min) * (float)rand() / (float)RAND_MAX;
+}
+
+void test_culling_camera_planes() {
+  /* Same planes as the camera's own */
+  vis::Camera3D camera;
+  camera.SetPerspective(60.0f, 1.5f, 0.1f, 100.0f);
+  camera.SetOrientationAngles(20.0f, 30.0f, 0.0f);
+  camera.SetTargetPosition(1.0f, 2.0f, 3.0f);
+  visFrustum frustum;
+  visFrustum_FromViewProjection(&frustum, camera.GetViewProjectionMatrix().data());
+  for (int p = 0; p < VIS_FRUSTUM_NUM_PLANES; p++) {
+    UNIT_TEST_EXPECT_EQ_ARRAY_F("", frustum.planes[p], camera.GetFrustumPlanes()[p].data(), 4, 1.0e-5f);
+  }
+}
+
+void test_culling_spheres() {
+  vis::Camera3D camera;
+  camera.SetPerspective(45.0f, 1.0f, 0.1f, 50.0f);
+  visFrustum frustum;
+  visFrustum_FromViewProjection(&frustum, camera.GetViewProjectionMatrix().data());
+
+  /* Odd count so the scalar tail runs too */
+  const uint32_t count = 1003;
+  float x[count];
+  float y[count];
+  float z[count];
+  float radius[count];
+  uint8_t visible[count];
+  srand(2);
+  for (uint32_t i = 0; i < count; i++) {
+    x[i] = RandomFloat(-40.0f, 40.0f);
+    y[i] = RandomFloat(-40.0f, 40.0f);
+    z[i] = RandomFloat(-60.0f, 10.0f);
+    radius[i] = RandomFloat(0.0f, 3.0f);
+  }
+  const uint32_t num_visible = visFrustum_TestSpheres(&frustum, x, y, z, radius, count, visible);
+  uint32_t expected_visible = 0;
+  bool same = true;
+  for (uint32_t i = 0; i < count; i++) {
+    const bool expected = visFrustum_TestSphere(&frustum, x[i], y[i], z[i], radius[i]);
+    expected_visible += expected ? 1 : 0;
+    same = same && expected == (visible[i] == 1);
+  }
+  UNIT_TEST_EXPECT_TRUE("", same);
+  UNIT_TEST_EXPECT_EQ_INT("", num_visible, expected_visible);
+  UNIT_TEST_EXPECT_TRUE("", num_visible > 0 && num_visible < count);
+}
+
+void test_culling_boxes() {
+  const visFrustum frustum = SlabFrustum(0.0f, 10.0f);
+  visAabbArray boxes;
+  visAabbArray_Init(&boxes);
+  const float min_x[7] = {-5.0f, -5.0f, 9.0f, 11.0f, 2.0f, -20.0f, 0.0f};
+  const float max_x[7] = {-1.0f, 1.0f, 12.0f, 15.0f, 3.0f, 20.0f, 0.0f};
+  for (int i = 0; i < 7; i++) {
+    visAabbArray_Push(&boxes);
+    visAabbArray_Extend(&boxes, i, min_x[i], 0.0f, 0.0f);
+    visAabbArray_Extend(&boxes, i, max_x[i], 1.0f, 1.0f);
+  }
+  /* Empty */
+  visAabbArray_Push(&boxes);
+
+  uint8_t visible[8];
+  UNIT_TEST_EXPECT_EQ_INT("", visFrustum_TestAabbs(&frustum, &boxes, visible), 5);
+  const uint8_t expected[8] = {0, 1, 1, 0, 1, 1, 1, 0};
+  for (int i = 0; i < 8; i++) {
+    UNIT_TEST_EXPECT_EQ_INT("", visible[i], expected[i]);
+  }
+  for (int i = 0; i < 7; i++) {
+    const visVec3 min = {boxes.min_x[i], boxes.min_y[i], boxes.min_z[i]};
+    const visVec3 max = {boxes.max_x[i], boxes.max_y[i], boxes.max_z[i]};
+    UNIT_TEST_EXPECT_EQ_INT("", visFrustum_TestAabb(&frustum, &min, &max) ? 1 : 0, expected[i]);
+  }
+  visAabbArray_Free(&boxes);
+}
+
+void test_culling_clip_strip() {
+  const uint32_t chunk = VIS_CULL_CHUNK_SIZE;
+  const uint8_t visible[5] = {1, 0, 0, 1, 1};
+  visCullRange ranges[8];
+
+  /* Level 0, the two visible runs of chunks */
+  UNIT_TEST_EXPECT_EQ_INT("", visCulling_ClipStrip(0, 5 * chunk, 0, visible, 5, ranges, 8), 2);
+  UNIT_TEST_EXPECT_EQ_INT("", ranges[0].first, 0);
+  UNIT_TEST_EXPECT_EQ_INT("", ranges[0].count, chunk + 1);
+  UNIT_TEST_EXPECT_EQ_INT("", ranges[1].first, 3 * chunk);
+  UNIT_TEST_EXPECT_EQ_INT("", ranges[1].count, 2 * chunk);
+
+  /* A coarse level where each segment covers 4 chunks */
+  const uint8_t only_fifth[8] = {0, 0, 0, 0, 0, 1, 0, 0};
+  const uint32_t shift = VIS_CULL_CHUNK_SHIFT + 2;
+  UNIT_TEST_EXPECT_EQ_INT("", visCulling_ClipStrip(0, 3, shift, only_fifth, 8, ranges, 8), 1);
+  UNIT_TEST_EXPECT_EQ_INT("", ranges[0].first, 1);
+  UNIT_TEST_EXPECT_EQ_INT("", ranges[0].count, 2);
+
+  /* Out of ranges, the last one runs to the end */
+  UNIT_TEST_EXPECT_EQ_INT("", visCulling_ClipStrip(0, 5 * chunk, 0, visible, 5, ranges, 1), 1);
+  UNIT_TEST_EXPECT_EQ_INT("", ranges[0].first, 0);
+  UNIT_TEST_EXPECT_EQ_INT("", ranges[0].count, 5 * chunk);
+
+  /* Nothing visible */
+  const uint8_t none[5] = {0, 0, 0, 0, 0};
+  UNIT_TEST_EXPECT_EQ_INT("", visCulling_ClipStrip(10, 100, 0, none, 5, ranges, 8), 0);
+}
+
+void test_culling_polyline_chunks() {
+  visPolylineLod lod;
+  visPolylineLod_Init(&lod);
+  for (int i = 0; i < 3000; i++) {
+    visPolylineLod_Append(&lod, (float)i, 0.0f, 0.0f);
+  }
+  UNIT_TEST_EXPECT_EQ_INT("", lod.chunks.count, 3);
+  /* Each chunk reaches the first point of the next */
+  UNIT_TEST_EXPECT_EQ_FLOAT("", lod.chunks.min_x[0], 0.0f);
+  UNIT_TEST_EXPECT_EQ_FLOAT("", lod.chunks.max_x[0], (float)VIS_CULL_CHUNK_SIZE);
+  UNIT_TEST_EXPECT_EQ_FLOAT("", lod.chunks.min_x[1], (float)VIS_CULL_CHUNK_SIZE);
+  UNIT_TEST_EXPECT_EQ_FLOAT("", lod.chunks.max_x[2], 2999.0f);
+
+  visPolylineLod_Clear(&lod);
+  UNIT_TEST_EXPECT_EQ_INT("", lod.chunks.count, 0);
+  visPolylineLod_Free(&lod);
+}
+
+void test_culling_trail() {
+  visTrail trail;
+  visTrail_Init(&trail, 3000);
+  for (int i = 0; i < 5000; i++) {
+    visTrail_Push(&trail, (float)i, 0.0f, 0.0f);
+  }
+  /* Slots 0-1999 hold x = 3000-4999, slots 2000-2999 hold x = 2000-2999. Only chunk 0 is in view,
+   * chunk 1 is being overwritten so it is drawn too */
+  const visFrustum frustum = SlabFrustum(3100.0f, 3200.0f);
+  visCullRange ranges[8];
+  visCullCounts counts;
+  UNIT_TEST_EXPECT_EQ_INT("", visTrail_GetVisibleRanges(&trail, &frustum, ranges, 8, &counts), 2);
+  UNIT_TEST_EXPECT_EQ_INT("", ranges[0].first, 2000);
+  UNIT_TEST_EXPECT_EQ_INT("", ranges[0].count, 2 * VIS_CULL_CHUNK_SIZE - 2000 + 1);
+  UNIT_TEST_EXPECT_EQ_INT("", ranges[1].first, 0);
+  UNIT_TEST_EXPECT_EQ_INT("", ranges[1].count, 2000);
+  UNIT_TEST_EXPECT_EQ_INT("", counts.visible, 2);
+  UNIT_TEST_EXPECT_EQ_INT("", counts.culled, 1);
+
+  /* The last chunk joins on to slot 0 through the mirror slot */
+  const visFrustum mirror = SlabFrustum(2999.5f, 3000.0f);
+  UNIT_TEST_EXPECT_EQ_INT("", visTrail_GetVisibleRanges(&trail, &mirror, ranges, 8, &counts), 2);
+  UNIT_TEST_EXPECT_EQ_INT("", ranges[0].first + ranges[0].count, 3001);
+
+  visTrail_Free(&trail);
+}
+
+void test_culling_fleet() {
+  visFleet_Clear();
+  visRobotHandle robots[10];
+  for (int i = 0; i < 10; i++) {
+    robots[i] = visFleet_AddRobot(1.0f, 1.0f, 1.0f);
+    visFleet_SetPose(robots[i], 10.0f * (float)i, 0.0f, 0.0f);
+  }
+  const visFrustum frustum = SlabFrustum(15.0f, 55.0f);
+  UNIT_TEST_EXPECT_EQ_INT("", visFleet_Cull(&frustum), 4);
+  for (int i = 0; i < 10; i++) {
+    UNIT_TEST_EXPECT_EQ_INT("", visFleet_IsVisible(robots[i]) ? 1 : 0, (i >= 2 && i <= 5) ? 1 : 0);
+  }
+  /* Moved robots are culled where they are now */
+  visFleet_SetPose(robots[0], 30.0f, 0.0f, 0.0f);
+  visFleet_RemoveRobot(robots[3]);
+  UNIT_TEST_EXPECT_EQ_INT("", visFleet_Cull(&frustum), 4);
+  UNIT_TEST_EXPECT_TRUE("", visFleet_IsVisible(robots[0]));
+  visFleet_Clear();
+}
+
+void test_culling_depth() {
+  /* Looking down -z from the origin, 1m to 101m */
+  vis::Camera3D camera;
+  camera.SetPerspective(60.0f, 1.5f, 1.0f, 101.0f);
+  visFrustum frustum;
+  visFrustum_FromViewProjection(&frustum, camera.GetViewProjectionMatrix().data());
+  UNIT_TEST_EXPECT_EQ_FLOAT("", visFrustum_Depth(&frustum, 0.0f, 0.0f, -1.0f), 0.0f);
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", visFrustum_Depth(&frustum, 5.0f, -3.0f, -51.0f), 0.5f, 1.0e-4f);
+  UNIT_TEST_EXPECT_EQ_FLOAT("", visFrustum_Depth(&frustum, 0.0f, 0.0f, -500.0f), 1.0f);
+  visFrustum everything;
+  visFrustum_SetEverything(&everything);
+  UNIT_TEST_EXPECT_EQ_FLOAT("", visFrustum_Depth(&everything, 0.0f, 0.0f, -51.0f), 0.0f);
+
+  /* Boxes by their centre, with culling off too */
+  visAabbArray boxes;
+  visAabbArray_Init(&boxes);
+  visAabbArray_Push(&boxes);
+  visAabbArray_Extend(&boxes, 0, -1.0f, -1.0f, -12.0f);
+  visAabbArray_Extend(&boxes, 0, 1.0f, 1.0f, -10.0f);
+  visAabbArray_Push(&boxes);
+  visAabbArray_Extend(&boxes, 1, 0.0f, 0.0f, -81.0f);
+  visAabbArray_Push(&boxes);
+  visCulling_SetViewProjection(camera.GetViewProjectionMatrix().data());
+  visCulling_SetEnabled(false);
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", visCulling_GetDepth(&boxes, 0, 1), 0.1f, 1.0e-4f);
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", visCulling_GetDepth(&boxes, 1, 1), 0.8f, 1.0e-4f);
+  /* The empty third box is left out */
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", visCulling_GetDepth(&boxes, 0, 3), 0.445f, 1.0e-4f);
+  visCulling_SetEnabled(true);
+  visAabbArray_Free(&boxes);
+}
+
+void tests_culling_run() {
+  UNIT_TEST_SETUP("Culling");
+  UNIT_TEST_RUN_TEST("Camera Planes", test_culling_camera_planes);
+  UNIT_TEST_RUN_TEST("Spheres", test_culling_spheres);
+  UNIT_TEST_RUN_TEST("Boxes", test_culling_boxes);
+  UNIT_TEST_RUN_TEST("Clip Strip", test_culling_clip_strip);
+  UNIT_TEST_RUN_TEST("Polyline Chunks", test_culling_polyline_chunks);
+  UNIT_TEST_RUN_TEST("Trail", test_culling_trail);
+  UNIT_TEST_RUN_TEST("Fleet", test_culling_fleet);
+  UNIT_TEST_RUN_TEST("Depth", test_culling_depth);
+  UNIT_TEST_FINISH("Culling");
+}
+
+#endif
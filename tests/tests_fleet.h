@@ -0,0 +1,55 @@
+#ifndef CVIS_TESTS_FLEET_H_
+#define CVIS_TESTS_FLEET_H_
+
+#include "ctest/unit_test.h"
+#include "cvis/fleet.h"
+
+void test_fleet_stale_handles() {
+  visFleet_Clear();
+  const visRobotHandle first = visFleet_AddRobot(1.0f, 1.0f, 1.0f);
+  const visRobotHandle second = visFleet_AddRobot(1.0f, 1.0f, 1.0f);
+  UNIT_TEST_EXPECT_TRUE("", first != VIS_INVALID_ROBOT_HANDLE && second != VIS_INVALID_ROBOT_HANDLE);
+
+  /* The new robot gets the removed one's index, but not its handle */
+  visFleet_RemoveRobot(first);
+  const visRobotHandle reused = visFleet_AddRobot(1.0f, 1.0f, 1.0f);
+  UNIT_TEST_EXPECT_EQ_INT("", reused & VIS_ROBOT_HANDLE_INDEX_MASK, first & VIS_ROBOT_HANDLE_INDEX_MASK);
+  UNIT_TEST_EXPECT_TRUE("", reused != first);
+  UNIT_TEST_EXPECT_EQ_INT("", visFleet_Count(), 2);
+
+  /* Only x >= 15 is visible. A stale handle, e.g. from a queued update, doesn't move the new robot */
+  visFrustum frustum;
+  visFrustum_SetEverything(&frustum);
+  frustum.planes[0][0] = 1.0f;
+  frustum.planes[0][1] = 0.0f;
+  frustum.planes[0][2] = 0.0f;
+  frustum.planes[0][3] = -15.0f;
+  visFleet_SetPose(first, 20.0f, 0.0f, 0.0f);
+  UNIT_TEST_EXPECT_EQ_INT("", visFleet_Cull(&frustum), 0);
+  UNIT_TEST_EXPECT_TRUE("", !visFleet_IsVisible(first));
+  visFleet_SetPose(reused, 20.0f, 0.0f, 0.0f);
+  UNIT_TEST_EXPECT_EQ_INT("", visFleet_Cull(&frustum), 1);
+  UNIT_TEST_EXPECT_TRUE("", visFleet_IsVisible(reused));
+  /* Removing through a stale handle does nothing */
+  visFleet_RemoveRobot(first);
+  UNIT_TEST_EXPECT_EQ_INT("", visFleet_Count(), 2);
+
+  /* Clearing makes every handle stale, and the indices are handed out again from the start */
+  visFleet_Clear();
+  const visRobotHandle after_clear = visFleet_AddRobot(1.0f, 1.0f, 1.0f);
+  UNIT_TEST_EXPECT_EQ_INT("", after_clear & VIS_ROBOT_HANDLE_INDEX_MASK, 0);
+  UNIT_TEST_EXPECT_TRUE("", after_clear != first && after_clear != reused);
+  visFleet_SetPose(reused, 20.0f, 0.0f, 0.0f);
+  visFleet_SetPose(second, 20.0f, 0.0f, 0.0f);
+  UNIT_TEST_EXPECT_EQ_INT("", visFleet_Cull(&frustum), 0);
+  UNIT_TEST_EXPECT_EQ_INT("", visFleet_Count(), 1);
+  visFleet_Clear();
+}
+
+void tests_fleet_run() {
+  UNIT_TEST_SETUP("Fleet");
+  UNIT_TEST_RUN_TEST("Stale Handles", test_fleet_stale_handles);
+  UNIT_TEST_FINISH("Fleet");
+}
+
+#endif
@@ -0,0 +1,221 @@
+#ifndef CVIS_TESTS_MAT4_H_
+#define CVIS_TESTS_MAT4_H_
+
+#include "ctest/unit_test.h"
+#include "cvis/mat4.h"
+#include "Eigen/Geometry"
+#include "Eigen/LU"
+
+/* Every set of kernels this build and cpu have, against Eigen */
+static const visMathIsa mat4_isas_[3] = {visMathIsa_Scalar, visMathIsa_Sse2, visMathIsa_Avx2};
+
+static Eigen::Matrix4f TestTransform() {
+  Eigen::Affine3f transform = Eigen::Translation3f(1.0f, -2.0f, 3.0f) *
+                              Eigen::AngleAxisf(0.7f, Eigen::Vector3f(1.0f, 2.0f, 3.0f).normalized()) *
+                              Eigen::Scaling(2.0f, 0.5f, 1.5f);
+  return transform.matrix();
+}
+
+static Eigen::Matrix4f TestProjection() {
+  Eigen::Matrix4f projection = Eigen::Matrix4f::Zero();
+  projection(0, 0) = 1.3f;
+  projection(1, 1) = 1.7f;
+  projection(2, 2) = -1.002f;
+  projection(2, 3) = -0.2002f;
+  projection(3, 2) = -1.0f;
+  return projection;
+}
+
+void test_mat4_multiply() {
+  const visMathIsa isa = visMath_GetIsa();
+  const Eigen::Matrix4f a = TestProjection();
+  const Eigen::Matrix4f b = TestTransform();
+  const Eigen::Matrix4f expected = a * b;
+  for (visMathIsa test_isa : mat4_isas_) {
+    if (!visMath_SetIsa(test_isa)) {
+      continue;
+    }
+    Eigen::Matrix4f result;
+    visMat4_Multiply(a.data(), b.data(), result.data());
+    UNIT_TEST_EXPECT_EQ_ARRAY_F("", result.data(), expected.data(), 16, 1.0e-5f);
+    /* Into one of the inputs */
+    Eigen::Matrix4f in_place = b;
+    visMat4_Multiply(a.data(), in_place.data(), in_place.data());
+    UNIT_TEST_EXPECT_EQ_ARRAY_F("", in_place.data(), expected.data(), 16, 1.0e-5f);
+    in_place = a;
+    visMat4_Multiply(in_place.data(), b.data(), in_place.data());
+    UNIT_TEST_EXPECT_EQ_ARRAY_F("", in_place.data(), expected.data(), 16, 1.0e-5f);
+  }
+  visMath_SetIsa(isa);
+}
+
+void test_mat4_inverse() {
+  const visMathIsa isa = visMath_GetIsa();
+  const Eigen::Matrix4f matrices[2] = {TestTransform(), TestProjection() * TestTransform()};
+  const Eigen::Matrix4f identity = Eigen::Matrix4f::Identity();
+  for (visMathIsa test_isa : mat4_isas_) {
+    if (!visMath_SetIsa(test_isa)) {
+      continue;
+    }
+    for (const Eigen::Matrix4f &m : matrices) {
+      const Eigen::Matrix4f expected = m.inverse();
+      Eigen::Matrix4f result;
+      UNIT_TEST_EXPECT_TRUE("", visMat4_Inverse(m.data(), result.data()));
+      UNIT_TEST_EXPECT_EQ_ARRAY_F("", result.data(), expected.data(), 16, 1.0e-4f);
+      const Eigen::Matrix4f product = m * result;
+      UNIT_TEST_EXPECT_EQ_ARRAY_F("", product.data(), identity.data(), 16, 1.0e-5f);
+    }
+    /* A singular matrix (scaled to nothing along z) leaves the output alone */
+    Eigen::Matrix4f singular = TestTransform();
+    singular.col(2).setZero();
+    Eigen::Matrix4f result = identity;
+    UNIT_TEST_EXPECT_TRUE("", !visMat4_Inverse(singular.data(), result.data()));
+    UNIT_TEST_EXPECT_EQ_ARRAY_F("", result.data(), identity.data(), 16, 0.0f);
+  }
+  visMath_SetIsa(isa);
+}
+
+void test_mat4_transform_points() {
+  const visMathIsa isa = visMath_GetIsa();
+  const Eigen::Matrix4f m = TestTransform();
+  /* Enough for the 8 and 4 wide loops and a tail */
+  const uint32_t count = 23;
+  float xyz[3 * count];
+  float expected[3 * count];
+  for (uint32_t i = 0; i < count; i++) {
+    const Eigen::Vector4f point((float)i, 0.5f * (float)i - 3.0f, 10.0f - (float)(i * i) * 0.1f, 1.0f);
+    xyz[3 * i] = point.x();
+    xyz[3 * i + 1] = point.y();
+    xyz[3 * i + 2] = point.z();
+    const Eigen::Vector4f transformed = m * point;
+    expected[3 * i] = transformed.x();
+    expected[3 * i + 1] = transformed.y();
+    expected[3 * i + 2] = transformed.z();
+  }
+  for (visMathIsa test_isa : mat4_isas_) {
+    if (!visMath_SetIsa(test_isa)) {
+      continue;
+    }
+    float result[3 * count];
+    visMat4_TransformPoints(m.data(), xyz, count, result);
+    UNIT_TEST_EXPECT_EQ_ARRAY_F("", result, expected, 3 * count, 1.0e-4f);
+    float in_place[3 * count];
+    for (uint32_t i = 0; i < 3 * count; i++) {
+      in_place[i] = xyz[i];
+    }
+    visMat4_TransformPoints(m.data(), in_place, count, in_place);
+    UNIT_TEST_EXPECT_EQ_ARRAY_F("", in_place, expected, 3 * count, 1.0e-4f);
+  }
+  visMath_SetIsa(isa);
+}
+
+void test_mat4_compose_trs() {
+  const visMathIsa isa = visMath_GetIsa();
+  const Eigen::Quaternionf rotation(Eigen::AngleAxisf(0.7f, Eigen::Vector3f(1.0f, 2.0f, 3.0f).normalized()));
+  const float translation[3] = {1.0f, -2.0f, 3.0f};
+  const float quaternion[4] = {rotation.x(), rotation.y(), rotation.z(), rotation.w()};
+  const float scale[3] = {2.0f, 0.5f, 1.5f};
+  const Eigen::Matrix4f expected = TestTransform();
+  for (visMathIsa test_isa : mat4_isas_) {
+    if (!visMath_SetIsa(test_isa)) {
+      continue;
+    }
+    Eigen::Matrix4f result;
+    visMat4_ComposeTrs(translation, quaternion, scale, result.data());
+    UNIT_TEST_EXPECT_EQ_ARRAY_F("", result.data(), expected.data(), 16, 1.0e-5f);
+  }
+  visMath_SetIsa(isa);
+}
+
+void test_mat4_compose_trs_batch() {
+  const visMathIsa isa = visMath_GetIsa();
+  /* Enough for the 8 and 4 wide loops and a tail */
+  const uint32_t count = 23;
+  float components[10][count];
+  float expected[16 * count];
+  for (uint32_t i = 0; i < count; i++) {
+    const Eigen::Vector3f translation((float)i, 2.0f - 0.5f * (float)i, 0.1f * (float)(i * i));
+    const Eigen::Vector3f axis = Eigen::Vector3f(1.0f + (float)i, 2.0f, 3.0f - (float)i).normalized();
+    const Eigen::Quaternionf rotation(Eigen::AngleAxisf(0.3f * (float)i - 2.0f, axis));
+    const Eigen::Vector3f scale(1.0f + 0.1f * (float)i, 0.5f, 2.0f - 0.05f * (float)i);
+    for (int c = 0; c < 3; c++) {
+      components[c][i] = translation[c];
+      components[7 + c][i] = scale[c];
+    }
+    components[3][i] = rotation.x();
+    components[4][i] = rotation.y();
+    components[5][i] = rotation.z();
+    components[6][i] = rotation.w();
+    const Eigen::Affine3f transform = Eigen::Translation3f(translation) * rotation * Eigen::Scaling(scale);
+    Eigen::Map<Eigen::Matrix4f>(expected + 16 * i) = transform.matrix();
+  }
+  const float *const translation[3] = {components[0], components[1], components[2]};
+  const float *const rotation[4] = {components[3], components[4], components[5], components[6]};
+  const float *const scale[3] = {components[7], components[8], components[9]};
+
+  /* Missing components are 0: no translation, and a rotation about z like the robots use */
+  float z_rotation[2][count];
+  float z_expected[16 * count];
+  for (uint32_t i = 0; i < count; i++) {
+    const Eigen::Quaternionf rotation(Eigen::AngleAxisf(0.4f * (float)i, Eigen::Vector3f::UnitZ()));
+    z_rotation[0][i] = rotation.z();
+    z_rotation[1][i] = rotation.w();
+    const Eigen::Affine3f transform = rotation * Eigen::Scaling(components[7][i], components[8][i], components[9][i]);
+    Eigen::Map<Eigen::Matrix4f>(z_expected + 16 * i) = transform.matrix();
+  }
+  const float *const no_translation[3] = {NULL, NULL, NULL};
+  const float *const z_rotation_only[4] = {NULL, NULL, z_rotation[0], z_rotation[1]};
+
+  for (visMathIsa test_isa : mat4_isas_) {
+    if (!visMath_SetIsa(test_isa)) {
+      continue;
+    }
+    float result[16 * count];
+    visMat4_ComposeTrsBatch(translation, rotation, scale, count, result);
+    UNIT_TEST_EXPECT_EQ_ARRAY_F("", result, expected, 16 * count, 1.0e-4f);
+    visMat4_ComposeTrsBatch(no_translation, z_rotation_only, scale, count, result);
+    UNIT_TEST_EXPECT_EQ_ARRAY_F("", result, z_expected, 16 * count, 1.0e-5f);
+  }
+  visMath_SetIsa(isa);
+}
+
+void test_mat4_perspective() {
+  /* 90 degrees: the top of the near plane is as far up as the plane is away */
+  Eigen::Matrix4f projection;
+  visMat4_Perspective(90.0f, 2.0f, 1.0f, 101.0f, projection.data());
+  const Eigen::Vector4f near_corner = projection * Eigen::Vector4f(2.0f, 1.0f, -1.0f, 1.0f);
+  const Eigen::Vector4f far_centre = projection * Eigen::Vector4f(0.0f, 0.0f, -101.0f, 1.0f);
+  const float expected_near[3] = {1.0f, 1.0f, -1.0f};
+  const float expected_far[3] = {0.0f, 0.0f, 1.0f};
+  const Eigen::Vector3f near_ndc = near_corner.head<3>() / near_corner.w();
+  const Eigen::Vector3f far_ndc = far_centre.head<3>() / far_centre.w();
+  UNIT_TEST_EXPECT_EQ_ARRAY_F("", near_ndc.data(), expected_near, 3, 1.0e-5f);
+  UNIT_TEST_EXPECT_EQ_ARRAY_F("", far_ndc.data(), expected_far, 3, 1.0e-5f);
+  UNIT_TEST_EXPECT_EQ_FLOAT("", projection(3, 3), 0.0f);
+}
+
+void test_mat4_isa() {
+  /* Scalar is always there, whatever else there is is used by default */
+  const visMathIsa isa = visMath_GetIsa();
+  UNIT_TEST_EXPECT_TRUE("", visMath_SetIsa(visMathIsa_Scalar));
+  UNIT_TEST_EXPECT_EQ_INT("", visMath_GetIsa(), visMathIsa_Scalar);
+#if defined(__SSE2__)
+  UNIT_TEST_EXPECT_TRUE("", isa != visMathIsa_Scalar);
+#endif
+  UNIT_TEST_EXPECT_TRUE("", visMath_SetIsa(isa));
+  UNIT_TEST_EXPECT_EQ_INT("", visMath_GetIsa(), isa);
+}
+
+void tests_mat4_run() {
+  UNIT_TEST_SETUP("Mat4");
+  UNIT_TEST_RUN_TEST("Multiply", test_mat4_multiply);
+  UNIT_TEST_RUN_TEST("Inverse", test_mat4_inverse);
+  UNIT_TEST_RUN_TEST("Transform Points", test_mat4_transform_points);
+  UNIT_TEST_RUN_TEST("Compose TRS", test_mat4_compose_trs);
+  UNIT_TEST_RUN_TEST("Compose TRS Batch", test_mat4_compose_trs_batch);
+  UNIT_TEST_RUN_TEST("Perspective", test_mat4_perspective);
+  UNIT_TEST_RUN_TEST("Isa", test_mat4_isa);
+  UNIT_TEST_FINISH("Mat4");
+}
+
+#endif
@@ -0,0 +1,256 @@
+#ifndef CVIS_TESTS_PICKING_H_
+#define CVIS_TESTS_PICKING_H_
+
+#include "ctest/unit_test.h"
+#include "cvis/camera3d.h"
+#include "cvis/picking.h"
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+
+static visRay DownRay(float x,
+                      float y) {
+  visRay ray = {{x, y, 100.0f}, {0.0f, 0.0f, -1.0f}};
+  return ray;
+}
+
+/* Slab test against an axis aligned box, the distance or FLT_MAX */
+static float RayBoxDistance(const visRay &ray,
+                            const visVec3 &centre,
+                            const visVec3 &halfSize) {
+  const float origin[3] = {ray.origin.x, ray.origin.y, ray.origin.z};
+  const float direction[3] = {ray.direction.x, ray.direction.y, ray.direction.z};
+  const float min[3] = {centre.x - halfSize.x, centre.y - halfSize.y, centre.z - halfSize.z};
+  const float max[3] = {centre.x + halfSize.x, centre.y + halfSize.y, centre.z + halfSize.z};
+  float near = 0.0f;
+  float far = FLT_MAX;
+  for (int axis = 0; axis < 3; axis++) {
+    const float t0 = (min[axis] - origin[axis]) / direction[axis];
+    const float t1 = (max[axis] - origin[axis]) / direction[axis];
+    near = std::fmax(near, std::fmin(t0, t1));
+    far = std::fmin(far, std::fmax(t0, t1));
+  }
+  return near <= far ? near : FLT_MAX;
+}
+
+void test_picking_boxes() {
+  visPicker picker;
+  visPicker_Init(&picker);
+  /* A 10 x 10 grid of robots 5 m apart, 1 m tall */
+  const visVec3 half_size = {1.0f, 0.5f, 0.5f};
+  for (uint32_t i = 0; i < 100; i++) {
+    const visVec3 centre = {5.0f * (float)(i % 10), 5.0f * (float)(i / 10), 0.5f};
+    visPicker_AddBox(&picker, &centre, &half_size, 0.0f, 1000 + i);
+  }
+  visPickHit hit;
+  visRay ray = DownRay(15.5f, 20.2f);
+  UNIT_TEST_EXPECT_TRUE("", visPicker_Pick(&picker, &ray, &hit));
+  UNIT_TEST_EXPECT_EQ_INT("", hit.type, visPickType_Box);
+  UNIT_TEST_EXPECT_EQ_INT("", hit.id, 1043);
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", hit.distance, 99.0f, 1.0e-4f);
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", hit.position.z, 1.0f, 1.0e-4f);
+
+  /* Between robots, and past the half width */
+  ray = DownRay(17.5f, 20.0f);
+  UNIT_TEST_EXPECT_TRUE("", !visPicker_Pick(&picker, &ray, &hit));
+  ray = DownRay(15.0f, 20.7f);
+  UNIT_TEST_EXPECT_TRUE("", !visPicker_Pick(&picker, &ray, &hit));
+
+  /* Turned 90 degrees it is 1 m wide in y */
+  const visVec3 turned = {15.0f, 20.0f, 0.5f};
+  visPicker_SetBox(&picker, 43, &turned, &half_size, (float)M_PI_2);
+  UNIT_TEST_EXPECT_TRUE("", visPicker_Pick(&picker, &ray, &hit));
+  UNIT_TEST_EXPECT_EQ_INT("", hit.id, 1043);
+
+  /* From the side the nearest robot in the row is hit */
+  ray = {{-10.0f, 10.0f, 0.5f}, {1.0f, 0.0f, 0.0f}};
+  UNIT_TEST_EXPECT_TRUE("", visPicker_Pick(&picker, &ray, &hit));
+  UNIT_TEST_EXPECT_EQ_INT("", hit.id, 1020);
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", hit.position.x, -1.0f, 1.0e-4f);
+  visPicker_Free(&picker);
+}
+
+void test_picking_segments() {
+  visPicker picker;
+  visPicker_Init(&picker);
+  /* A path along x at height 1, and a waypoint on its own */
+  for (uint32_t i = 0; i < 50; i++) {
+    const visVec3 start = {(float)i, 0.0f, 1.0f};
+    const visVec3 end = {(float)(i + 1), 0.0f, 1.0f};
+    visPicker_AddSegment(&picker, &start, &end, 0.1f, i);
+  }
+  const visVec3 waypoint = {10.0f, 10.0f, 0.0f};
+  visPicker_AddSegment(&picker, &waypoint, &waypoint, 0.2f, 99);
+
+  visPickHit hit;
+  visRay ray = DownRay(20.5f, 0.05f);
+  UNIT_TEST_EXPECT_TRUE("", visPicker_Pick(&picker, &ray, &hit));
+  UNIT_TEST_EXPECT_EQ_INT("", hit.type, visPickType_Segment);
+  UNIT_TEST_EXPECT_EQ_INT("", hit.id, 20);
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", hit.distance, 99.0f, 1.0e-4f);
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", hit.position.x, 20.5f, 1.0e-4f);
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", hit.position.y, 0.0f, 1.0e-4f);
+  ray = DownRay(20.5f, 0.15f);
+  UNIT_TEST_EXPECT_TRUE("", !visPicker_Pick(&picker, &ray, &hit));
+
+  ray = DownRay(10.1f, 9.9f);
+  UNIT_TEST_EXPECT_TRUE("", visPicker_Pick(&picker, &ray, &hit));
+  UNIT_TEST_EXPECT_EQ_INT("", hit.id, 99);
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", hit.position.x, 10.0f, 1.0e-4f);
+
+  /* Along the path the first segment is hit where the ray meets it */
+  ray = {{-5.0f, 0.0f, 1.0f}, {1.0f, 0.0f, 0.0f}};
+  UNIT_TEST_EXPECT_TRUE("", visPicker_Pick(&picker, &ray, &hit));
+  UNIT_TEST_EXPECT_EQ_INT("", hit.id, 0);
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", hit.distance, 5.0f, 1.0e-4f);
+  visPicker_Free(&picker);
+}
+
+void test_picking_refit() {
+  visPicker picker;
+  visPicker_Init(&picker);
+  const visVec3 half_size = {0.5f, 0.5f, 0.5f};
+  for (uint32_t i = 0; i < 1000; i++) {
+    const visVec3 centre = {2.0f * (float)(i % 40), 2.0f * (float)(i / 40), 0.5f};
+    visPicker_AddBox(&picker, &centre, &half_size, 0.0f, i);
+  }
+  visPicker_Build(&picker);
+  const uint32_t num_nodes = picker.num_nodes;
+
+  /* Moved well outside the tree's old bounds */
+  const visVec3 far_away = {500.0f, 500.0f, 0.5f};
+  visPicker_SetBox(&picker, 7, &far_away, &half_size, 0.0f);
+  visPickHit hit;
+  visRay ray = DownRay(500.0f, 500.0f);
+  UNIT_TEST_EXPECT_TRUE("", visPicker_Pick(&picker, &ray, &hit));
+  UNIT_TEST_EXPECT_EQ_INT("", hit.id, 7);
+  ray = DownRay(14.0f, 0.0f);
+  UNIT_TEST_EXPECT_TRUE("", !visPicker_Pick(&picker, &ray, &hit));
+  /* Refit, not built again */
+  UNIT_TEST_EXPECT_EQ_INT("", picker.num_nodes, num_nodes);
+  UNIT_TEST_EXPECT_EQ_INT("", picker.num_dirty, 0);
+
+  /* Everything moved, the whole tree is refit */
+  for (uint32_t i = 0; i < 1000; i++) {
+    const visVec3 raised = {2.0f * (float)(i % 40), 2.0f * (float)(i / 40), 10.5f};
+    visPicker_SetBox(&picker, i, &raised, &half_size, 0.0f);
+  }
+  ray = DownRay(14.0f, 0.0f);
+  UNIT_TEST_EXPECT_TRUE("", visPicker_Pick(&picker, &ray, &hit));
+  UNIT_TEST_EXPECT_EQ_INT("", hit.id, 7);
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", hit.position.z, 11.0f, 1.0e-4f);
+
+  /* Adding builds it again */
+  const visVec3 added = {-20.0f, 0.0f, 0.5f};
+  visPicker_AddBox(&picker, &added, &half_size, 0.0f, 5000);
+  ray = DownRay(-20.0f, 0.0f);
+  UNIT_TEST_EXPECT_TRUE("", visPicker_Pick(&picker, &ray, &hit));
+  UNIT_TEST_EXPECT_EQ_INT("", hit.id, 5000);
+  visPicker_Free(&picker);
+}
+
+void test_picking_random() {
+  /* Against testing every box */
+  visPicker picker;
+  visPicker_Init(&picker);
+  const uint32_t count = 5000;
+  visVec3 centres[count];
+  visVec3 half_sizes[count];
+  srand(3);
+  for (uint32_t i = 0; i < count; i++) {
+    centres[i] = {RandomFloat(-100.0f, 100.0f), RandomFloat(-100.0f, 100.0f), RandomFloat(-10.0f, 10.0f)};
+    half_sizes[i] = {RandomFloat(0.1f, 2.0f), RandomFloat(0.1f, 2.0f), RandomFloat(0.1f, 2.0f)};
+    visPicker_AddBox(&picker, &centres[i], &half_sizes[i], 0.0f, i);
+  }
+  int num_hits = 0;
+  bool same = true;
+  for (int r = 0; r < 500; r++) {
+    visRay ray;
+    ray.origin = {RandomFloat(-150.0f, 150.0f), RandomFloat(-150.0f, 150.0f), 50.0f};
+    const visVec3 target = {RandomFloat(-100.0f, 100.0f), RandomFloat(-100.0f, 100.0f), 0.0f};
+    const float dx = target.x - ray.origin.x;
+    const float dy = target.y - ray.origin.y;
+    const float dz = target.z - ray.origin.z;
+    const float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+    ray.direction = {dx / length, dy / length, dz / length};
+
+    float expected = FLT_MAX;
+    for (uint32_t i = 0; i < count; i++) {
+      expected = std::fmin(expected, RayBoxDistance(ray, centres[i], half_sizes[i]));
+    }
+    visPickHit hit;
+    const bool picked = visPicker_Pick(&picker, &ray, &hit);
+    same = same && picked == (expected != FLT_MAX);
+    if (picked) {
+      num_hits++;
+      same = same && std::fabs(hit.distance - expected) < 1.0e-3f;
+      same = same && std::fabs(RayBoxDistance(ray, centres[hit.id], half_sizes[hit.id]) - expected) < 1.0e-3f;
+    }
+  }
+  UNIT_TEST_EXPECT_TRUE("", same);
+  UNIT_TEST_EXPECT_TRUE("", num_hits > 0 && num_hits < 500);
+  visPicker_Free(&picker);
+}
+
+void test_picking_cursor_ray() {
+  /* Clicking on the pixel a robot projects to picks it */
+  vis::Camera3D camera;
+  camera.SetPerspective(60.0f, 1.5f, 0.1f, 500.0f);
+  /* Above the robots looking down, a little off vertical */
+  camera.SetOrientationAngles(10.0f, 5.0f, 0.0f);
+  camera.SetTargetPosition(12.0f, 20.0f, 30.0f);
+  camera.SetViewport(0.0f, 0.0f, 1200.0f, 800.0f);
+
+  visPicker picker;
+  visPicker_Init(&picker);
+  const visVec3 half_size = {0.5f, 0.5f, 0.5f};
+  for (uint32_t i = 0; i < 400; i++) {
+    const visVec3 centre = {3.0f * (float)(i % 20), 3.0f * (float)(i / 20), 0.5f};
+    visPicker_AddBox(&picker, &centre, &half_size, 0.0f, i);
+  }
+  /* The top of robot 123 */
+  const float x = 3.0f * 3.0f;
+  const float y = 3.0f * 6.0f;
+  const float z = 1.0f;
+  float pixel_x;
+  float pixel_y;
+  UNIT_TEST_EXPECT_EQ_INT("", camera.ProjectToScreen(&x, &y, &z, 1, &pixel_x, &pixel_y, nullptr, nullptr), 1);
+
+  Eigen::Vector3f origin;
+  Eigen::Vector3f direction;
+  camera.GetCursorRay(pixel_x, pixel_y, &origin, &direction);
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", direction.norm(), 1.0f, 1.0e-5f);
+  /* The ray goes through the point */
+  const Eigen::Vector3f to_point = Eigen::Vector3f(x, y, z) - origin;
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", (to_point - to_point.dot(direction) * direction).norm(), 0.0f, 1.0e-3f);
+
+  visRay ray = {{origin.x(), origin.y(), origin.z()}, {direction.x(), direction.y(), direction.z()}};
+  visPickHit hit;
+  UNIT_TEST_EXPECT_TRUE("", visPicker_Pick(&picker, &ray, &hit));
+  UNIT_TEST_EXPECT_EQ_INT("", hit.id, 123);
+
+  /* The same window at a content scale of 2: the viewport and the click are window coordinates,
+   * half the framebuffer pixels, and the ray is the same */
+  camera.SetViewport(0.0f, 0.0f, 600.0f, 400.0f);
+  float scaled_x;
+  float scaled_y;
+  camera.ProjectToScreen(&x, &y, &z, 1, &scaled_x, &scaled_y, nullptr, nullptr);
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", scaled_x, 0.5f * pixel_x, 1.0e-3f);
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", scaled_y, 0.5f * pixel_y, 1.0e-3f);
+  Eigen::Vector3f scaled_direction;
+  camera.GetCursorRay(scaled_x, scaled_y, &origin, &scaled_direction);
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", (scaled_direction - direction).norm(), 0.0f, 1.0e-4f);
+  visPicker_Free(&picker);
+}
+
+void tests_picking_run() {
+  UNIT_TEST_SETUP("Picking");
+  UNIT_TEST_RUN_TEST("Boxes", test_picking_boxes);
+  UNIT_TEST_RUN_TEST("Segments", test_picking_segments);
+  UNIT_TEST_RUN_TEST("Refit", test_picking_refit);
+  UNIT_TEST_RUN_TEST("Random", test_picking_random);
+  UNIT_TEST_RUN_TEST("Cursor Ray", test_picking_cursor_ray);
+  UNIT_TEST_FINISH("Picking");
+}
+
+#endif
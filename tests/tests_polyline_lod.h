@@ -0,0 +1,148 @@
+#ifndef CVIS_TESTS_POLYLINE_LOD_H_
+#define CVIS_TESTS_POLYLINE_LOD_H_
+
+#include "ctest/unit_test.h"
+#include "cvis/polyline_lod.h"
+#include <math.h>
+
+/* The ranges should walk the whole path without gaps, each one starting where the last ended */
+static bool RangesCoverPath(const visPolylineLod *lod,
+                            int numPoints) {
+  const visVec3 *expected_start = &lod->levels[0].points[0];
+  for (uint32_t r = 0; r < lod->num_ranges; r++) {
+    const visPointBuffer *level = &lod->levels[lod->ranges[r].level];
+    const visVec3 *start = &level->points[lod->ranges[r].first];
+    if (start->x != expected_start->x || start->y != expected_start->y) {
+      return false;
+    }
+    expected_start = &level->points[lod->ranges[r].first + lod->ranges[r].count - 1];
+  }
+  return expected_start->x == lod->levels[0].points[numPoints - 1].x;
+}
+
+void test_polyline_lod_levels() {
+  visPolylineLod lod;
+  visPolylineLod_Init(&lod);
+
+  /* Straight line, every level is exact */
+  for (int i = 0; i < 17; i++) {
+    visPolylineLod_Append(&lod, (float)i, 0, 0);
+  }
+  UNIT_TEST_EXPECT_EQ_INT("", lod.levels[0].count, 17);
+  UNIT_TEST_EXPECT_EQ_INT("", lod.levels[1].count, 5);
+  UNIT_TEST_EXPECT_EQ_INT("", lod.levels[2].count, 2);
+  UNIT_TEST_EXPECT_EQ_INT("", lod.levels[3].count, 1);
+  UNIT_TEST_EXPECT_EQ_FLOAT("", lod.levels[1].points[4].x, 16.0f);
+  UNIT_TEST_EXPECT_EQ_INT("", lod.num_cells[2], 1);
+  UNIT_TEST_EXPECT_EQ_FLOAT("", lod.cell_error[2][0], 0.0f);
+  /* Level 3 has no finished segment so it can't be used */
+  UNIT_TEST_EXPECT_EQ_INT("", lod.num_cells[3], 0);
+  UNIT_TEST_EXPECT_EQ_INT("", visPolylineLod_Select(&lod, 0.1f), 1);
+  UNIT_TEST_EXPECT_EQ_INT("", lod.ranges[0].level, 2);
+  UNIT_TEST_EXPECT_EQ_INT("", lod.ranges[0].count, 2);
+
+  /* A bump of 1m half way along the first level 1 segment */
+  visPolylineLod_Clear(&lod);
+  for (int i = 0; i < 17; i++) {
+    visPolylineLod_Append(&lod, (float)i, i == 2 ? 1.0f : 0.0f, 0);
+  }
+  UNIT_TEST_EXPECT_EQ_FLOAT("", lod.cell_error[1][0], 1.0f);
+  UNIT_TEST_EXPECT_EQ_FLOAT("", lod.cell_error[2][0], 1.0f);
+  UNIT_TEST_EXPECT_EQ_INT("", visPolylineLod_Select(&lod, 0.5f), 1);
+  UNIT_TEST_EXPECT_EQ_INT("", lod.ranges[0].level, 0);
+  UNIT_TEST_EXPECT_EQ_INT("", lod.ranges[0].count, 17);
+  UNIT_TEST_EXPECT_EQ_INT("", visPolylineLod_Select(&lod, 1.5f), 1);
+  UNIT_TEST_EXPECT_EQ_INT("", lod.ranges[0].level, 2);
+
+  visPolylineLod_Free(&lod);
+}
+
+void test_polyline_lod_draw_ranges() {
+  visPolylineLod lod;
+  visPolylineLod_Init(&lod);
+  /* 16 * 3 + 4 + 2 + 1 points, so the tail needs a range on every finer level */
+  const int num_points = 16 * 3 + 4 + 2 + 1;
+  for (int i = 0; i < num_points; i++) {
+    visPolylineLod_Append(&lod, (float)i, 0, 0);
+  }
+
+  /* Straight, so level 2 is the coarsest with a finished segment */
+  const uint32_t num_ranges = visPolylineLod_Select(&lod, 0.1f);
+  UNIT_TEST_EXPECT_EQ_INT("", num_ranges, 3);
+  UNIT_TEST_EXPECT_EQ_INT("", lod.ranges[0].level, 2);
+  UNIT_TEST_EXPECT_EQ_INT("", lod.ranges[1].level, 1);
+  UNIT_TEST_EXPECT_EQ_INT("", lod.ranges[2].level, 0);
+  UNIT_TEST_EXPECT_TRUE("", RangesCoverPath(&lod, num_points));
+
+  /* A single point is still drawn */
+  visPolylineLod_Clear(&lod);
+  visPolylineLod_Append(&lod, 1.0f, 2.0f, 3.0f);
+  UNIT_TEST_EXPECT_EQ_INT("", visPolylineLod_Select(&lod, 0.1f), 1);
+  UNIT_TEST_EXPECT_EQ_INT("", lod.ranges[0].count, 1);
+
+  visPolylineLod_Free(&lod);
+}
+
+void test_polyline_lod_per_chunk() {
+  visPolylineLod lod;
+  visPolylineLod_Init(&lod);
+
+  /* 16 straight chunks with a sharp turn in the middle of chunk 5, only that chunk should be fine */
+  const int num_points = 16 * VIS_CULL_CHUNK_SIZE + 1;
+  const int turn = 5 * VIS_CULL_CHUNK_SIZE + VIS_CULL_CHUNK_SIZE / 2 + 1;
+  for (int i = 0; i < num_points; i++) {
+    visPolylineLod_Append(&lod, (float)i, i == turn ? 5.0f : 0.0f, 0);
+  }
+  UNIT_TEST_EXPECT_EQ_FLOAT("", lod.cell_error[1][5], 5.0f);
+  UNIT_TEST_EXPECT_EQ_FLOAT("", lod.cell_error[1][4], 0.0f);
+
+  const uint32_t num_ranges = visPolylineLod_Select(&lod, 0.1f);
+  UNIT_TEST_EXPECT_TRUE("", RangesCoverPath(&lod, num_points));
+  uint32_t num_vertices = 0;
+  for (uint32_t r = 0; r < num_ranges; r++) {
+    num_vertices += lod.ranges[r].count;
+    if (lod.ranges[r].level == 0) {
+      /* Only around the turn */
+      const uint32_t first = lod.ranges[r].first;
+      UNIT_TEST_EXPECT_TRUE("", first >= 5 * VIS_CULL_CHUNK_SIZE && first < 6 * VIS_CULL_CHUNK_SIZE);
+    }
+  }
+  /* The turn's chunk at full detail, the rest a handful of coarse segments */
+  UNIT_TEST_EXPECT_TRUE("", num_vertices < VIS_CULL_CHUNK_SIZE + 32);
+
+  visPolylineLod_Free(&lod);
+}
+
+void test_polyline_lod_vertex_count() {
+  visPolylineLod lod;
+  visPolylineLod_Init(&lod);
+
+  /* A wiggly 2M point survey path, zoomed out so a pixel is 10m the vertex count drawn should be
+   * tiny and not depend on the path length */
+  const int num_points = 2000000;
+  for (int i = 0; i < num_points; i++) {
+    const float t = (float)i * 0.01f;
+    visPolylineLod_Append(&lod, t, 0.2f * sinf(t), 0);
+  }
+
+  const uint32_t num_ranges = visPolylineLod_Select(&lod, 10.0f);
+  uint32_t num_vertices = 0;
+  for (uint32_t r = 0; r < num_ranges; r++) {
+    num_vertices += lod.ranges[r].count;
+  }
+  UNIT_TEST_EXPECT_TRUE("", RangesCoverPath(&lod, num_points));
+  UNIT_TEST_EXPECT_TRUE("", num_vertices < 100);
+
+  visPolylineLod_Free(&lod);
+}
+
+void tests_polyline_lod_run() {
+  UNIT_TEST_SETUP("Polyline LOD");
+  UNIT_TEST_RUN_TEST("Levels", test_polyline_lod_levels);
+  UNIT_TEST_RUN_TEST("Draw Ranges", test_polyline_lod_draw_ranges);
+  UNIT_TEST_RUN_TEST("Per Chunk", test_polyline_lod_per_chunk);
+  UNIT_TEST_RUN_TEST("Vertex Count", test_polyline_lod_vertex_count);
+  UNIT_TEST_FINISH("Polyline LOD");
+}
+
+#endif
@@ -0,0 +1,178 @@
+#ifndef CVIS_TESTS_PROFILER_H_
+#define CVIS_TESTS_PROFILER_H_
+
+#include "ctest/unit_test.h"
+#include "cvis/profiler.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Gpu timing is turned off throughout, so none of this needs a GL context */
+
+void test_profiler_disabled() {
+  visProfiler_SetGpuTiming(false);
+  visProfiler_SetEnabled(false);
+  visProfiler_SetEnabled(true);
+  visProfiler_SetEnabled(false);
+
+  /* Nothing is recorded, and unbalanced calls are harmless */
+  visProfiler_BeginFrame();
+  visProfiler_BeginScope("Grid");
+  visProfiler_EndScope();
+  visProfiler_EndScope();
+  visProfiler_EndFrame();
+  UNIT_TEST_EXPECT_EQ_INT("", visProfiler_FrameCount(), 0);
+}
+
+void test_profiler_scopes() {
+  visProfiler_SetGpuTiming(false);
+  visProfiler_SetEnabled(false);
+  visProfiler_SetEnabled(true);
+
+  for (int frame = 0; frame < 3; frame++) {
+    visProfiler_BeginFrame();
+    visProfiler_BeginScope("Grid");
+    visProfiler_EndScope();
+    visProfiler_BeginCpuScope("Render Queue");
+    visProfiler_BeginScope("Trail");
+    visProfiler_EndScope();
+    visProfiler_EndScope();
+    /* Left open, ended with the frame */
+    visProfiler_BeginScope("Swap");
+    visProfiler_EndFrame();
+  }
+
+  UNIT_TEST_EXPECT_EQ_INT("", visProfiler_FrameCount(), 3);
+  const visProfilerFrame *frame = visProfiler_GetFrame(2);
+  UNIT_TEST_EXPECT_EQ_INT("", frame->index, 2);
+  UNIT_TEST_EXPECT_EQ_INT("", frame->num_scopes, 4);
+  UNIT_TEST_EXPECT_TRUE("", strcmp(frame->scopes[0].name, "Grid") == 0);
+  UNIT_TEST_EXPECT_TRUE("", strcmp(frame->scopes[2].name, "Trail") == 0);
+  /* The outer scope contains the inner one */
+  UNIT_TEST_EXPECT_TRUE("", frame->scopes[1].cpu_start_ms <= frame->scopes[2].cpu_start_ms);
+  UNIT_TEST_EXPECT_TRUE("", frame->scopes[1].cpu_ms >= frame->scopes[2].cpu_ms);
+  UNIT_TEST_EXPECT_TRUE("", frame->scopes[3].cpu_ms >= 0.0f);
+  UNIT_TEST_EXPECT_TRUE("", frame->scopes[0].gpu_ms < 0.0f);
+  UNIT_TEST_EXPECT_TRUE("", frame->cpu_start_ms >= visProfiler_GetFrame(1)->cpu_start_ms);
+
+  visProfiler_SetEnabled(false);
+}
+
+void test_profiler_history() {
+  visProfiler_SetGpuTiming(false);
+  visProfiler_SetEnabled(false);
+  visProfiler_SetEnabled(true);
+
+  /* Scopes past the limit are dropped, the frame is still recorded */
+  const int num_frames = VIS_PROFILER_HISTORY + 10;
+  for (int frame = 0; frame < num_frames; frame++) {
+    visProfiler_BeginFrame();
+    for (int i = 0; i < VIS_PROFILER_MAX_SCOPES + 5; i++) {
+      visProfiler_BeginScope("Trail");
+      visProfiler_EndScope();
+    }
+    visProfiler_EndFrame();
+  }
+  UNIT_TEST_EXPECT_EQ_INT("", visProfiler_FrameCount(), VIS_PROFILER_HISTORY);
+  UNIT_TEST_EXPECT_EQ_INT("", visProfiler_GetFrame(0)->index, 10);
+  UNIT_TEST_EXPECT_EQ_INT("", visProfiler_GetFrame(VIS_PROFILER_HISTORY - 1)->num_scopes, VIS_PROFILER_MAX_SCOPES);
+
+  visProfiler_SetEnabled(false);
+}
+
+void test_profiler_averages() {
+  visProfiler_SetGpuTiming(false);
+  visProfiler_SetEnabled(false);
+  visProfiler_SetEnabled(true);
+
+  visProfilerAverage averages[2];
+  double frame_ms = -1.0;
+  UNIT_TEST_EXPECT_EQ_INT("", visProfiler_GetAverages(averages, 2, &frame_ms), 0);
+  UNIT_TEST_EXPECT_EQ_DOUBLE("", frame_ms, 0.0);
+
+  /* A name drawn twice in a frame is summed, names past the limit are left out */
+  for (int frame = 0; frame < 4; frame++) {
+    visProfiler_BeginFrame();
+    visProfiler_BeginScope("Trail");
+    visProfiler_EndScope();
+    visProfiler_BeginScope("Grid");
+    visProfiler_EndScope();
+    visProfiler_BeginScope("Trail");
+    visProfiler_EndScope();
+    visProfiler_BeginScope("Robot");
+    visProfiler_EndScope();
+    visProfiler_EndFrame();
+  }
+  UNIT_TEST_EXPECT_EQ_INT("", visProfiler_GetAverages(averages, 2, &frame_ms), 2);
+  UNIT_TEST_EXPECT_TRUE("", strcmp(averages[0].name, "Trail") == 0);
+  UNIT_TEST_EXPECT_TRUE("", strcmp(averages[1].name, "Grid") == 0);
+  UNIT_TEST_EXPECT_TRUE("", averages[0].cpu_ms >= 0.0);
+  UNIT_TEST_EXPECT_TRUE("", frame_ms >= averages[0].cpu_ms);
+  /* No gpu times */
+  UNIT_TEST_EXPECT_TRUE("", averages[0].gpu_ms < 0.0);
+  UNIT_TEST_EXPECT_EQ_INT("", visProfiler_GetAverages(averages, 2, NULL), 2);
+
+  visProfiler_SetEnabled(false);
+}
+
+void test_profiler_export() {
+  visProfiler_SetGpuTiming(false);
+  visProfiler_SetEnabled(false);
+  visProfiler_SetEnabled(true);
+  for (int frame = 0; frame < 2; frame++) {
+    visProfiler_BeginFrame();
+    visProfiler_BeginScope("Robot");
+    visProfiler_EndScope();
+    visProfiler_EndFrame();
+  }
+  visProfiler_SetEnabled(false);
+
+  /* Header and one row per scope */
+  const char *path = "cvis_test_profile.csv";
+  UNIT_TEST_EXPECT_TRUE("", visProfiler_ExportCsv(path));
+  FILE *file = fopen(path, "r");
+  UNIT_TEST_EXPECT_TRUE("", file != NULL);
+  char line[256];
+  int num_lines = 0;
+  while (fgets(line, sizeof(line), file)) {
+    if (num_lines == 0) {
+      UNIT_TEST_EXPECT_TRUE("", strcmp(line, "frame,scope,cpu_start_ms,cpu_ms,gpu_ms\n") == 0);
+    }
+    else {
+      UNIT_TEST_EXPECT_TRUE("", strstr(line, ",Robot,") != NULL);
+    }
+    num_lines++;
+  }
+  fclose(file);
+  remove(path);
+  UNIT_TEST_EXPECT_EQ_INT("", num_lines, 3);
+
+  /* Two frame events, two cpu scope events, no gpu events */
+  path = "cvis_test_trace.json";
+  UNIT_TEST_EXPECT_TRUE("", visProfiler_ExportChromeTrace(path));
+  file = fopen(path, "r");
+  UNIT_TEST_EXPECT_TRUE("", file != NULL);
+  int num_events = 0;
+  int num_gpu_events = 0;
+  while (fgets(line, sizeof(line), file)) {
+    num_events += strstr(line, "\"ph\":\"X\"") != NULL ? 1 : 0;
+    num_gpu_events += strstr(line, "\"ph\":\"X\"") != NULL && strstr(line, "\"tid\":2") != NULL ? 1 : 0;
+  }
+  fclose(file);
+  remove(path);
+  UNIT_TEST_EXPECT_EQ_INT("", num_events, 4);
+  UNIT_TEST_EXPECT_EQ_INT("", num_gpu_events, 0);
+
+  UNIT_TEST_EXPECT_TRUE("", !visProfiler_ExportCsv("/nonexistent/directory/profile.csv"));
+}
+
+void tests_profiler_run() {
+  UNIT_TEST_SETUP("Profiler");
+  UNIT_TEST_RUN_TEST("Disabled", test_profiler_disabled);
+  UNIT_TEST_RUN_TEST("Scopes", test_profiler_scopes);
+  UNIT_TEST_RUN_TEST("History", test_profiler_history);
+  UNIT_TEST_RUN_TEST("Averages", test_profiler_averages);
+  UNIT_TEST_RUN_TEST("Export", test_profiler_export);
+  UNIT_TEST_FINISH("Profiler");
+}
+
+#endif
@@ -46,9 +46,23 @@ void test_projection_perspective() {
   UNIT_TEST_EXPECT_EQ_ARRAY_F("", projection.mat, true_projection.mat, 16, 1.0e-5f);
 }
 
+void test_projection_world_units_per_pixel() {
+  // 90 degree fov, at 10m away the view is 20m high
+  Mat4f projection = visProjection_Perspective(90, 4.0f/3.0f, 0.01f, 1000.0f);
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", visProjection_WorldUnitsPerPixel(&projection, 10.0f, 1000), 0.02f, 1.0e-6f);
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", visProjection_WorldUnitsPerPixel(&projection, 20.0f, 1000), 0.04f, 1.0e-6f);
+
+  // Orthographic 50m high view volume, distance has no effect
+  Mat4f_SetIdentity(&projection);
+  projection.mat[5] = 2.0f / 50.0f;
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", visProjection_WorldUnitsPerPixel(&projection, 10.0f, 500), 0.1f, 1.0e-6f);
+  UNIT_TEST_EXPECT_EQ_FLOAT_EPS("", visProjection_WorldUnitsPerPixel(&projection, 100.0f, 500), 0.1f, 1.0e-6f);
+}
+
 void tests_projection_run() {
   UNIT_TEST_SETUP("Projection");
   UNIT_TEST_RUN_TEST("Perspective", test_projection_perspective);
+  UNIT_TEST_RUN_TEST("World Units Per Pixel", test_projection_world_units_per_pixel);
   UNIT_TEST_FINISH("Projection");
 }
 
@@ -0,0 +1,68 @@
+#ifndef CVIS_TESTS_REDRAW_H_
+#define CVIS_TESTS_REDRAW_H_
+
+#include "ctest/unit_test.h"
+#include "cvis/redraw.h"
+#include "cvis/updates.h"
+#include <atomic>
+#include <thread>
+
+static std::atomic<int> num_wakes_(0);
+
+static void CountWake() {
+  num_wakes_ += 1;
+}
+
+void test_redraw_take() {
+  visRedraw_Take();
+  UNIT_TEST_EXPECT_TRUE("", !visRedraw_Take());
+  visRedraw_Request();
+  UNIT_TEST_EXPECT_TRUE("", visRedraw_Take());
+  UNIT_TEST_EXPECT_TRUE("", !visRedraw_Take());
+}
+
+void test_redraw_wake_once() {
+  visRedraw_Take();
+  num_wakes_ = 0;
+  visRedraw_SetWakeFunction(CountWake);
+  visRedraw_Request();
+  visRedraw_Request();
+  visRedraw_Request();
+  UNIT_TEST_EXPECT_EQ_INT("", num_wakes_.load(), 1);
+  visRedraw_Take();
+  visRedraw_Request();
+  UNIT_TEST_EXPECT_EQ_INT("", num_wakes_.load(), 2);
+  visRedraw_SetWakeFunction(NULL);
+  visRedraw_Take();
+  visRedraw_Request();
+  UNIT_TEST_EXPECT_EQ_INT("", num_wakes_.load(), 2);
+  visRedraw_Take();
+}
+
+void test_redraw_updates() {
+  /* Pushing from another thread requests a redraw and wakes the render thread */
+  visUpdate update;
+  while (visUpdates_Pop(&update)) {
+  }
+  visRedraw_Take();
+  num_wakes_ = 0;
+  visRedraw_SetWakeFunction(CountWake);
+  std::thread producer([]() {
+    visUpdates_PushRobotPose(1.0f, 2.0f, 0.5f);
+  });
+  producer.join();
+  visRedraw_SetWakeFunction(NULL);
+  UNIT_TEST_EXPECT_EQ_INT("", num_wakes_.load(), 1);
+  UNIT_TEST_EXPECT_TRUE("", visRedraw_Take());
+  UNIT_TEST_EXPECT_TRUE("", visUpdates_Pop(&update));
+}
+
+void tests_redraw_run() {
+  UNIT_TEST_SETUP("Redraw");
+  UNIT_TEST_RUN_TEST("Take", test_redraw_take);
+  UNIT_TEST_RUN_TEST("Wake Once", test_redraw_wake_once);
+  UNIT_TEST_RUN_TEST("Updates", test_redraw_updates);
+  UNIT_TEST_FINISH("Redraw");
+}
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef CVIS_TESTS_RENDER_QUEUE_H_
+#define CVIS_TESTS_RENDER_QUEUE_H_
+
+#include "ctest/unit_test.h"
+#include "cvis/render_queue.h"
+#include "glad/glad.h"
+
+/* Programs are only used for their id here, nothing is built or drawn */
+static visProgram MakeTestProgram(uint32_t id) {
+  visProgram program;
+  program.id = id;
+  program.ready = true;
+  for (int i = 0; i < visUniform_Count; i++) {
+    program.uniforms[i] = -1;
+  }
+  return program;
+}
+
+void test_render_queue_sort() {
+  visRenderQueue_Clear();
+  visProgram grid = MakeTestProgram(1);
+  visProgram robot = MakeTestProgram(2);
+  visProgram trail = MakeTestProgram(3);
+
+  /* Submitted in the wrong order on purpose */
+  visDrawCommand command = visRenderQueue_NewCommand(&trail, 30, GL_LINE_STRIP);
+  command.pass = visRenderPass_Transparent;
+  visRenderQueue_Submit(&command);
+  command = visRenderQueue_NewCommand(&robot, 20, GL_TRIANGLES);
+  visRenderQueue_Submit(&command);
+  command = visRenderQueue_NewCommand(&grid, 10, GL_LINES);
+  command.pass = visRenderPass_Background;
+  visRenderQueue_Submit(&command);
+  command = visRenderQueue_NewCommand(&grid, 11, GL_LINES);
+  command.pass = visRenderPass_Overlay;
+  visRenderQueue_Submit(&command);
+  command = visRenderQueue_NewCommand(&trail, 20, GL_TRIANGLES);
+  visRenderQueue_Submit(&command);
+
+  UNIT_TEST_EXPECT_EQ_INT("", visRenderQueue_Count(), 5);
+  visRenderQueue_Sort();
+  /* By pass first, then program, then vertex array */
+  UNIT_TEST_EXPECT_EQ_INT("", visRenderQueue_GetSorted(0)->vertex_array, 10);
+  UNIT_TEST_EXPECT_EQ_INT("", visRenderQueue_GetSorted(1)->program, 2);
+  UNIT_TEST_EXPECT_EQ_INT("", visRenderQueue_GetSorted(2)->program, 3);
+  UNIT_TEST_EXPECT_EQ_INT("", visRenderQueue_GetSorted(2)->vertex_array, 20);
+  UNIT_TEST_EXPECT_EQ_INT("", visRenderQueue_GetSorted(3)->vertex_array, 30);
+  UNIT_TEST_EXPECT_EQ_INT("", visRenderQueue_GetSorted(4)->vertex_array, 11);
+  UNIT_TEST_EXPECT_EQ_INT("", visRenderQueue_CountDrawCalls(), 5);
+
+  visRenderQueue_Clear();
+}
+
+void test_render_queue_stable() {
+  visRenderQueue_Clear();
+  visProgram program = MakeTestProgram(1);
+
+  /* Equal keys keep the order they were submitted in */
+  visDrawCommand command = visRenderQueue_NewCommand(&program, 1, GL_POINTS);
+  for (uint32_t i = 0; i < 100; i++) {
+    command.first = i;
+    command.mode = i % 2 == 0 ? GL_POINTS : GL_LINE_STRIP;
+    visRenderQueue_Submit(&command);
+  }
+  visRenderQueue_Sort();
+  for (uint32_t i = 0; i < 100; i++) {
+    UNIT_TEST_EXPECT_EQ_INT("", visRenderQueue_GetSorted(i)->first, i);
+  }
+  /* Alternating primitives can't be merged */
+  UNIT_TEST_EXPECT_EQ_INT("", visRenderQueue_CountDrawCalls(), 100);
+
+  visRenderQueue_Clear();
+}
+
+void test_render_queue_transparent_depth() {
+  visRenderQueue_Clear();
+  visProgram near_program = MakeTestProgram(1);
+  visProgram far_program = MakeTestProgram(2);
+
+  /* Blended geometry goes back to front whatever the program, opaque geometry ignores depth when
+   * the program differs */
+  visDrawCommand command = visRenderQueue_NewCommand(&near_program, 1, GL_TRIANGLES);
+  command.pass = visRenderPass_Transparent;
+  command.depth = 0.1f;
+  visRenderQueue_Submit(&command);
+  command = visRenderQueue_NewCommand(&far_program, 1, GL_TRIANGLES);
+  command.pass = visRenderPass_Transparent;
+  command.depth = 0.9f;
+  visRenderQueue_Submit(&command);
+  command = visRenderQueue_NewCommand(&far_program, 1, GL_TRIANGLES);
+  command.depth = 0.9f;
+  visRenderQueue_Submit(&command);
+  command = visRenderQueue_NewCommand(&near_program, 1, GL_TRIANGLES);
+  command.depth = 0.1f;
+  visRenderQueue_Submit(&command);
+
+  visRenderQueue_Sort();
+  UNIT_TEST_EXPECT_EQ_INT("", visRenderQueue_GetSorted(0)->pass, visRenderPass_Opaque);
+  UNIT_TEST_EXPECT_EQ_INT("", visRenderQueue_GetSorted(0)->program, 1);
+  UNIT_TEST_EXPECT_EQ_INT("", visRenderQueue_GetSorted(1)->program, 2);
+  UNIT_TEST_EXPECT_EQ_INT("", visRenderQueue_GetSorted(2)->pass, visRenderPass_Transparent);
+  UNIT_TEST_EXPECT_EQ_FLOAT("", visRenderQueue_GetSorted(2)->depth, 0.9f);
+  UNIT_TEST_EXPECT_EQ_FLOAT("", visRenderQueue_GetSorted(3)->depth, 0.1f);
+
+  visRenderQueue_Clear();
+}
+
+void test_render_queue_merge() {
+  visRenderQueue_Clear();
+  visProgram program = MakeTestProgram(1);
+  program.uniforms[visUniform_Color] = 0;
+
+  /* 50 trails of two ranges each, every trail with its own vertex array: each trail's ranges merge
+   * into one draw */
+  for (uint32_t trail = 0; trail < 50; trail++) {
+    visDrawCommand command = visRenderQueue_NewCommand(&program, 100 + trail, GL_LINE_STRIP);
+    command.color_location = program.uniforms[visUniform_Color];
+    command.color[1] = 0.6f;
+    command.color[3] = 1;
+    command.first = 10;
+    command.count = 90;
+    visRenderQueue_Submit(&command);
+    command.first = 0;
+    command.count = 10;
+    visRenderQueue_Submit(&command);
+  }
+  visRenderQueue_Sort();
+  UNIT_TEST_EXPECT_EQ_INT("", visRenderQueue_Count(), 100);
+  UNIT_TEST_EXPECT_EQ_INT("", visRenderQueue_CountDrawCalls(), 50);
+
+  /* A different color breaks the merge, instanced draws never merge */
+  visDrawCommand command = visRenderQueue_NewCommand(&program, 100, GL_LINE_STRIP);
+  command.color_location = program.uniforms[visUniform_Color];
+  command.color[0] = 1;
+  command.count = 5;
+  visRenderQueue_Submit(&command);
+  command = visRenderQueue_NewCommand(&program, 200, GL_TRIANGLES);
+  command.instance_count = 10;
+  command.count = 36;
+  visRenderQueue_Submit(&command);
+  visRenderQueue_Submit(&command);
+  visRenderQueue_Sort();
+  UNIT_TEST_EXPECT_EQ_INT("", visRenderQueue_CountDrawCalls(), 53);
+
+  visRenderQueue_Clear();
+}
+
+void tests_render_queue_run() {
+  UNIT_TEST_SETUP("Render Queue");
+  UNIT_TEST_RUN_TEST("Sort", test_render_queue_sort);
+  UNIT_TEST_RUN_TEST("Stable", test_render_queue_stable);
+  UNIT_TEST_RUN_TEST("Transparent Depth", test_render_queue_transparent_depth);
+  UNIT_TEST_RUN_TEST("Merge", test_render_queue_merge);
+  UNIT_TEST_FINISH("Render Queue");
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef CVIS_TESTS_ROBOT_MODEL_H_
+#define CVIS_TESTS_ROBOT_MODEL_H_
+
+#include "ctest/unit_test.h"
+#include "cvis/robot_model.h"
+#include "Eigen/Geometry"
+#include <cmath>
+
+void test_robot_model_matrices() {
+  /* Not a multiple of 4, so both the batched robots and the ones left over are checked */
+  const uint32_t count = 7;
+  float x[count], y[count], heading[count], length[count], width[count], height[count];
+  for (uint32_t i = 0; i < count; i++) {
+    x[i] = 3.0f * (float)i - 10.0f;
+    y[i] = 5.0f - 2.0f * (float)i;
+    heading[i] = -3.0f + 1.1f * (float)i;
+    length[i] = 1.0f + 0.1f * (float)i;
+    width[i] = 0.5f + 0.2f * (float)i;
+    height[i] = 0.3f + 0.05f * (float)i;
+  }
+  float models[16 * count];
+  visRobot_ComputeModelMatrices(x, y, heading, length, width, height, count, models);
+
+  for (uint32_t i = 0; i < count; i++) {
+    /* The heading is from the Y axis (north), the rotation about z is from the x axis. The unit box
+     * is centred on 0, so it is lifted by half its height to sit on the ground */
+    const Eigen::Affine3f transform = Eigen::Translation3f(x[i], y[i], 0.5f * height[i]) *
+                                      Eigen::AngleAxisf((float)M_PI_2 - heading[i], Eigen::Vector3f::UnitZ()) *
+                                      Eigen::Scaling(width[i], length[i], height[i]);
+    UNIT_TEST_EXPECT_EQ_ARRAY_F("", &models[16 * i], transform.matrix().data(), 16, 1.0e-5f);
+  }
+}
+
+void tests_robot_model_run() {
+  UNIT_TEST_SETUP("Robot Model");
+  UNIT_TEST_RUN_TEST("Matrices", test_robot_model_matrices);
+  UNIT_TEST_FINISH("Robot Model");
+}
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef CVIS_TESTS_SCENE_H_
+#define CVIS_TESTS_SCENE_H_
+
+#include "ctest/unit_test.h"
+#include "cvis/scene.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#define TEST_SCENE_FLEET_POSES 256
+
+/* Every field of the snapshot is set from one number, so a snapshot mixing two writes shows up as
+ * fields that disagree */
+static void WriteSnapshot(uint64_t step) {
+  visSceneState *scene = visScene_BeginWrite();
+  const float value = (float)(step % 1000000);
+  scene->time = (double)step * 0.001;
+  scene->has_robot = true;
+  scene->robot.x = value;
+  scene->robot.y = value;
+  scene->robot.heading = value;
+  visScene_ReserveFleet(scene, TEST_SCENE_FLEET_POSES);
+  scene->num_fleet_poses = TEST_SCENE_FLEET_POSES;
+  for (uint32_t i = 0; i < TEST_SCENE_FLEET_POSES; i++) {
+    scene->fleet[i].robot = (visRobotHandle)i;
+    scene->fleet[i].x = value;
+    scene->fleet[i].y = value;
+    scene->fleet[i].heading = value;
+  }
+  visScene_Publish();
+}
+
+static bool SnapshotIsWhole(const visSceneState *scene) {
+  const float value = scene->robot.x;
+  if (scene->robot.y != value || scene->robot.heading != value ||
+      (float)((uint64_t)(scene->time * 1000.0 + 0.5) % 1000000) != value) {
+    return false;
+  }
+  for (uint32_t i = 0; i < scene->num_fleet_poses; i++) {
+    if (scene->fleet[i].robot != i || scene->fleet[i].x != value || scene->fleet[i].y != value ||
+        scene->fleet[i].heading != value) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Runs the writer and reader together, each sleeping for its period between steps (0 to run flat
+ * out), until the writer has published num_steps snapshots */
+static void RunScene(uint64_t num_steps,
+                     std::chrono::microseconds writer_period,
+                     std::chrono::microseconds reader_period,
+                     uint64_t *num_reads,
+                     uint64_t *num_distinct,
+                     uint64_t *num_torn,
+                     bool *in_order) {
+  std::atomic<bool> writer_done(false);
+  const uint64_t first_sequence = visScene_Latest()->sequence;
+  std::thread writer([&]() {
+    for (uint64_t step = 1; step <= num_steps; step++) {
+      WriteSnapshot(first_sequence + step);
+      if (writer_period.count() > 0) {
+        std::this_thread::sleep_for(writer_period);
+      }
+    }
+    writer_done.store(true);
+  });
+
+  *num_reads = 0;
+  *num_distinct = 0;
+  *num_torn = 0;
+  *in_order = true;
+  uint64_t last_sequence = first_sequence;
+  bool done = false;
+  while (!done) {
+    /* One more read after the writer finishes, which has to see the last snapshot */
+    done = writer_done.load();
+    const visSceneState *scene = visScene_Latest();
+    *num_reads += 1;
+    if (scene->sequence < last_sequence) {
+      *in_order = false;
+    }
+    if (scene->sequence != last_sequence) {
+      *num_distinct += 1;
+      if (!SnapshotIsWhole(scene)) {
+        *num_torn += 1;
+      }
+      last_sequence = scene->sequence;
+    }
+    if (reader_period.count() > 0) {
+      std::this_thread::sleep_for(reader_period);
+    }
+  }
+  writer.join();
+  if (last_sequence != first_sequence + num_steps) {
+    *in_order = false;
+  }
+}
+
+void test_scene_single_thread() {
+  /* Nothing new, the same snapshot comes back */
+  const uint64_t first = visScene_Latest()->sequence;
+  UNIT_TEST_EXPECT_TRUE("", visScene_Latest()->sequence == first);
+
+  /* Several publishes between reads, only the newest is seen */
+  WriteSnapshot(first + 1);
+  WriteSnapshot(first + 2);
+  WriteSnapshot(first + 3);
+  const visSceneState *scene = visScene_Latest();
+  UNIT_TEST_EXPECT_EQ_INT("", scene->sequence, first + 3);
+  UNIT_TEST_EXPECT_TRUE("", SnapshotIsWhole(scene));
+  UNIT_TEST_EXPECT_EQ_FLOAT("", scene->robot.x, (float)(first + 3));
+  UNIT_TEST_EXPECT_TRUE("", visScene_Latest() == scene);
+
+  /* Writing doesn't touch the snapshot being read */
+  visSceneState *next = visScene_BeginWrite();
+  UNIT_TEST_EXPECT_TRUE("", next != scene);
+  next->robot.x = -1.0f;
+  UNIT_TEST_EXPECT_EQ_FLOAT("", scene->robot.x, (float)(first + 3));
+  WriteSnapshot(first + 4);
+  UNIT_TEST_EXPECT_EQ_FLOAT("", visScene_Latest()->robot.x, (float)(first + 4));
+}
+
+void test_scene_fast_writer() {
+  /* Simulation flat out, renderer at ~500 Hz: most snapshots are skipped, none are torn */
+  uint64_t num_reads, num_distinct, num_torn;
+  bool in_order;
+  RunScene(200000, std::chrono::microseconds(0), std::chrono::microseconds(2000),
+           &num_reads, &num_distinct, &num_torn, &in_order);
+  UNIT_TEST_EXPECT_TRUE("", in_order);
+  UNIT_TEST_EXPECT_EQ_INT("", num_torn, 0);
+  UNIT_TEST_EXPECT_TRUE("", num_distinct <= num_reads);
+}
+
+void test_scene_fast_reader() {
+  /* Simulation at ~1 kHz, renderer flat out: the same snapshot is read many times */
+  uint64_t num_reads, num_distinct, num_torn;
+  bool in_order;
+  RunScene(100, std::chrono::microseconds(1000), std::chrono::microseconds(0),
+           &num_reads, &num_distinct, &num_torn, &in_order);
+  UNIT_TEST_EXPECT_TRUE("", in_order);
+  UNIT_TEST_EXPECT_EQ_INT("", num_torn, 0);
+  UNIT_TEST_EXPECT_TRUE("", num_distinct <= 100);
+  UNIT_TEST_EXPECT_TRUE("", num_reads >= num_distinct);
+}
+
+void test_scene_fleet_capacity() {
+  /* A fleet bigger than the first allocation */
+  const uint32_t count = 10000;
+  visSceneState *scene = visScene_BeginWrite();
+  UNIT_TEST_EXPECT_TRUE("", visScene_ReserveFleet(scene, count));
+  UNIT_TEST_EXPECT_TRUE("", scene->fleet_capacity >= count);
+  scene->has_robot = false;
+  scene->num_fleet_poses = count;
+  for (uint32_t i = 0; i < count; i++) {
+    scene->fleet[i].robot = (visRobotHandle)i;
+    scene->fleet[i].x = (float)i;
+    scene->fleet[i].y = 0.0f;
+    scene->fleet[i].heading = 0.0f;
+  }
+  UNIT_TEST_EXPECT_TRUE("", visScene_Publish());
+  const visSceneState *latest = visScene_Latest();
+  UNIT_TEST_EXPECT_EQ_INT("", latest->num_fleet_poses, count);
+  UNIT_TEST_EXPECT_EQ_FLOAT("", latest->fleet[count - 1].x, (float)(count - 1));
+
+  /* More than a fleet can hold is refused, the buffer is left alone */
+  scene = visScene_BeginWrite();
+  const uint32_t capacity = scene->fleet_capacity;
+  UNIT_TEST_EXPECT_TRUE("", !visScene_ReserveFleet(scene, VIS_SCENE_MAX_FLEET_POSES + 1));
+  UNIT_TEST_EXPECT_EQ_INT("", scene->fleet_capacity, capacity);
+
+  /* Poses past the capacity are reported and cut off, never read */
+  scene->num_fleet_poses = capacity + 1;
+  UNIT_TEST_EXPECT_TRUE("", !visScene_Publish());
+  UNIT_TEST_EXPECT_EQ_INT("", visScene_Latest()->num_fleet_poses, capacity);
+}
+
+void tests_scene_run() {
+  UNIT_TEST_SETUP("Scene");
+  UNIT_TEST_RUN_TEST("Single Thread", test_scene_single_thread);
+  UNIT_TEST_RUN_TEST("Fast Writer", test_scene_fast_writer);
+  UNIT_TEST_RUN_TEST("Fast Reader", test_scene_fast_reader);
+  UNIT_TEST_RUN_TEST("Fleet Capacity", test_scene_fleet_capacity);
+  UNIT_TEST_FINISH("Scene");
+}
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef CVIS_TESTS_SHADER_H_
+#define CVIS_TESTS_SHADER_H_
+
+#include "ctest/unit_test.h"
+#include "cvis/shader.h"
+#include "glad/glad.h"
+#include <stdio.h>
+#include <string.h>
+
+/* A pretend driver behind glad's function pointers, so the cache can be tested without a context.
+ * Every shader compiles and every program links, shader 0 (like in GL) has no status at all */
+static GLuint fake_next_id_ = 1;
+static uint32_t fake_deleted_programs_ = 0;
+
+static GLuint APIENTRY FakeCreate() { return fake_next_id_++; }
+static GLuint APIENTRY FakeCreateShader(GLenum) { return fake_next_id_++; }
+static void APIENTRY FakeShaderSource(GLuint, GLsizei, const GLchar *const *, const GLint *) {}
+static void APIENTRY FakeUseId(GLuint) {}
+static void APIENTRY FakeUseIds(GLuint, GLuint) {}
+static void APIENTRY FakeDeleteProgram(GLuint) { fake_deleted_programs_ += 1; }
+static void APIENTRY FakeProgramParameteri(GLuint, GLenum, GLint) {}
+static void APIENTRY FakeInfoLog(GLuint, GLsizei, GLsizei *, GLchar *log) { log[0] = '\0'; }
+static GLint APIENTRY FakeGetUniformLocation(GLuint, const GLchar *) { return -1; }
+static GLuint APIENTRY FakeGetUniformBlockIndex(GLuint, const GLchar *) { return GL_INVALID_INDEX; }
+static void APIENTRY FakeUniformBlockBinding(GLuint, GLuint, GLuint) {}
+
+static void APIENTRY FakeGetShaderiv(GLuint shader,
+                                     GLenum,
+                                     GLint *params) {
+  if (shader != 0) {
+    *params = GL_TRUE;
+  }
+}
+
+static void APIENTRY FakeGetProgramiv(GLuint program,
+                                      GLenum pname,
+                                      GLint *params) {
+  if (program == 0) {
+    return;
+  }
+  *params = pname == GL_PROGRAM_BINARY_LENGTH ? 4 : GL_TRUE;
+}
+
+static void APIENTRY FakeGetIntegerv(GLenum pname,
+                                     GLint *data) {
+  *data = pname == GL_NUM_PROGRAM_BINARY_FORMATS ? 1 : 0;
+}
+
+static const GLubyte *APIENTRY FakeGetString(GLenum) {
+  return (const GLubyte *)"cvis test driver";
+}
+
+static void APIENTRY FakeGetProgramBinary(GLuint,
+                                          GLsizei,
+                                          GLsizei *,
+                                          GLenum *format,
+                                          void *binary) {
+  *format = 1;
+  memcpy(binary, "cvis", 4);
+}
+
+static void APIENTRY FakeProgramBinary(GLuint, GLenum, const void *, GLsizei) {}
+
+static void InstallFakeDriver() {
+  glad_glCreateProgram = FakeCreate;
+  glad_glCreateShader = FakeCreateShader;
+  glad_glShaderSource = FakeShaderSource;
+  glad_glCompileShader = FakeUseId;
+  glad_glAttachShader = FakeUseIds;
+  glad_glLinkProgram = FakeUseId;
+  glad_glDeleteShader = FakeUseId;
+  glad_glDeleteProgram = FakeDeleteProgram;
+  glad_glProgramParameteri = FakeProgramParameteri;
+  glad_glGetShaderiv = FakeGetShaderiv;
+  glad_glGetProgramiv = FakeGetProgramiv;
+  glad_glGetShaderInfoLog = FakeInfoLog;
+  glad_glGetProgramInfoLog = FakeInfoLog;
+  glad_glGetUniformLocation = FakeGetUniformLocation;
+  glad_glGetUniformBlockIndex = FakeGetUniformBlockIndex;
+  glad_glUniformBlockBinding = FakeUniformBlockBinding;
+  glad_glGetIntegerv = FakeGetIntegerv;
+  glad_glGetString = FakeGetString;
+  glad_glGetProgramBinary = FakeGetProgramBinary;
+  glad_glProgramBinary = FakeProgramBinary;
+}
+
+void test_shader_full_cache_disk_hit() {
+  InstallFakeDriver();
+  visShader_SetCacheDirectory("cvis_test_shader_cache");
+
+  /* Fill the in-process cache, it is never emptied so the sources only have to be new */
+  char vertex_source[64];
+  char fragment_source[64];
+  for (int i = 0; i < 64; i++) {
+    snprintf(vertex_source, sizeof(vertex_source), "// full cache vertex %d", i);
+    snprintf(fragment_source, sizeof(fragment_source), "// full cache fragment %d", i);
+    UNIT_TEST_EXPECT_TRUE("", visShader_LoadShaderFromSource(vertex_source, fragment_source) != 0);
+  }
+
+  /* Not shared any more, but still saved to (or loaded from) disk */
+  const char *vertex = "// uncached vertex";
+  const char *fragment = "// uncached fragment";
+  UNIT_TEST_EXPECT_TRUE("", visShader_LoadShaderFromSource(vertex, fragment) != 0);
+
+  /* The disk hit is already linked, there are no shaders to check */
+  const visShaderCacheStats before = visShader_GetCacheStats();
+  fake_deleted_programs_ = 0;
+  visProgram program;
+  visProgram_LoadAsync(&program, vertex, fragment);
+  const visShaderCacheStats after = visShader_GetCacheStats();
+  UNIT_TEST_EXPECT_EQ_INT("", after.disk_hits, before.disk_hits + 1);
+  UNIT_TEST_EXPECT_EQ_INT("", after.compiles, before.compiles);
+  UNIT_TEST_EXPECT_EQ_INT("", fake_deleted_programs_, 0);
+  UNIT_TEST_EXPECT_TRUE("", program.id != 0);
+  UNIT_TEST_EXPECT_TRUE("", program.ready);
+  UNIT_TEST_EXPECT_TRUE("", visProgram_IsReady(&program));
+}
+
+void tests_shader_run() {
+  UNIT_TEST_SETUP("Shader");
+  UNIT_TEST_RUN_TEST("Full Cache Disk Hit", test_shader_full_cache_disk_hit);
+  UNIT_TEST_FINISH("Shader");
+}
+
+#endif
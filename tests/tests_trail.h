@@ -0,0 +1,156 @@
+#ifndef CVIS_TESTS_TRAIL_H_
+#define CVIS_TESTS_TRAIL_H_
+
+#include "ctest/unit_test.h"
+#include "cvis/trail.h"
+
+void test_trail_fill() {
+  visTrail trail;
+  visTrail_Init(&trail, 4);
+
+  visTrailRange ranges[2];
+  UNIT_TEST_EXPECT_EQ_INT("", visTrail_GetDrawRanges(&trail, ranges), 0);
+
+  visTrail_Push(&trail, 1, 0, 0);
+  visTrail_Push(&trail, 2, 0, 0);
+  visTrail_Push(&trail, 3, 0, 0);
+  UNIT_TEST_EXPECT_EQ_INT("", visTrail_GetDrawRanges(&trail, ranges), 1);
+  UNIT_TEST_EXPECT_EQ_INT("", ranges[0].first, 0);
+  UNIT_TEST_EXPECT_EQ_INT("", ranges[0].count, 3);
+
+  /* First upload sends the three new points, slot 0 was written so the mirror goes too */
+  visTrailUpload upload = visTrail_PrepareUpload(&trail);
+  UNIT_TEST_EXPECT_EQ_INT("", upload.num_ranges, 1);
+  UNIT_TEST_EXPECT_EQ_INT("", upload.ranges[0].first, 0);
+  UNIT_TEST_EXPECT_EQ_INT("", upload.ranges[0].count, 3);
+  UNIT_TEST_EXPECT_TRUE("", upload.upload_mirror);
+  UNIT_TEST_EXPECT_EQ_FLOAT("", trail.points[4].x, 1.0f);
+
+  /* Nothing new, nothing to send */
+  upload = visTrail_PrepareUpload(&trail);
+  UNIT_TEST_EXPECT_EQ_INT("", upload.num_ranges, 0);
+
+  visTrail_Free(&trail);
+}
+
+void test_trail_wrap() {
+  visTrail trail;
+  visTrail_Init(&trail, 4);
+  for (int i = 0; i < 4; i++) {
+    visTrail_Push(&trail, (float)i, 0, 0);
+  }
+  visTrail_PrepareUpload(&trail);
+
+  /* Overwrites slots 0 and 1, the oldest point is now in slot 2 */
+  visTrail_Push(&trail, 4, 0, 0);
+  visTrail_Push(&trail, 5, 0, 0);
+  UNIT_TEST_EXPECT_EQ_INT("", trail.count, 4);
+
+  visTrailUpload upload = visTrail_PrepareUpload(&trail);
+  UNIT_TEST_EXPECT_EQ_INT("", upload.num_ranges, 1);
+  UNIT_TEST_EXPECT_EQ_INT("", upload.ranges[0].first, 0);
+  UNIT_TEST_EXPECT_EQ_INT("", upload.ranges[0].count, 2);
+  UNIT_TEST_EXPECT_TRUE("", upload.upload_mirror);
+
+  visTrailRange ranges[2];
+  UNIT_TEST_EXPECT_EQ_INT("", visTrail_GetDrawRanges(&trail, ranges), 2);
+  UNIT_TEST_EXPECT_EQ_INT("", ranges[0].first, 2);
+  UNIT_TEST_EXPECT_EQ_INT("", ranges[0].count, 3);
+  UNIT_TEST_EXPECT_EQ_INT("", ranges[1].first, 0);
+  UNIT_TEST_EXPECT_EQ_INT("", ranges[1].count, 2);
+
+  /* Walking the draw ranges should give the points oldest to newest, with the mirror slot
+   * repeating the first point of the second range */
+  float expected[] = {2, 3, 4, 4, 5};
+  int n = 0;
+  for (uint32_t r = 0; r < 2; r++) {
+    for (uint32_t i = 0; i < ranges[r].count; i++) {
+      UNIT_TEST_EXPECT_EQ_FLOAT("", trail.points[ranges[r].first + i].x, expected[n]);
+      n++;
+    }
+  }
+
+  /* Dirty slots that wrap around the end of the ring are sent as two ranges */
+  visTrail_Push(&trail, 6, 0, 0);
+  visTrail_Push(&trail, 7, 0, 0);
+  visTrail_Push(&trail, 8, 0, 0);
+  upload = visTrail_PrepareUpload(&trail);
+  UNIT_TEST_EXPECT_EQ_INT("", upload.num_ranges, 2);
+  UNIT_TEST_EXPECT_EQ_INT("", upload.ranges[0].first, 2);
+  UNIT_TEST_EXPECT_EQ_INT("", upload.ranges[0].count, 2);
+  UNIT_TEST_EXPECT_EQ_INT("", upload.ranges[1].first, 0);
+  UNIT_TEST_EXPECT_EQ_INT("", upload.ranges[1].count, 1);
+  UNIT_TEST_EXPECT_TRUE("", upload.upload_mirror);
+
+  visTrail_Free(&trail);
+}
+
+void test_trail_24_hours() {
+  /* 10 minutes of trail at 10Hz, run for a simulated 24 hours at 60 frames per second */
+  const uint32_t rate_hz = 10;
+  const uint32_t capacity = 10 * 60 * rate_hz;
+  const uint32_t num_points = 24 * 60 * 60 * rate_hz;
+
+  visTrail trail;
+  visTrail_Init(&trail, capacity);
+  const visVec3 *storage = trail.points;
+  const size_t memory = visTrail_MemoryBytes(&trail);
+
+  uint64_t max_frame_bytes = 0;
+  uint32_t pushed = 0;
+  uint32_t frame = 0;
+  while (pushed < num_points) {
+    /* 60 fps with 10 points a second, alternate between 0 and 1 points per frame, with the odd
+     * stall that pushes a large burst */
+    uint32_t to_push = (frame % 6 == 0) ? 1 : 0;
+    if (frame % 100000 == 0) {
+      to_push = 2 * capacity;
+    }
+    for (uint32_t i = 0; i < to_push && pushed < num_points; i++, pushed++) {
+      visTrail_Push(&trail, (float)pushed, 0, 0);
+    }
+
+    const uint64_t before = trail.bytes_uploaded;
+    visTrail_PrepareUpload(&trail);
+    if (trail.bytes_uploaded - before > max_frame_bytes) {
+      max_frame_bytes = trail.bytes_uploaded - before;
+    }
+    frame++;
+  }
+
+  /* Nothing was reallocated and the memory never grew */
+  UNIT_TEST_EXPECT_TRUE("", trail.points == storage);
+  UNIT_TEST_EXPECT_EQ_INT("", visTrail_MemoryBytes(&trail), memory);
+  UNIT_TEST_EXPECT_EQ_INT("", trail.count, capacity);
+  /* Even the bursts never upload more than the ring */
+  UNIT_TEST_EXPECT_TRUE("", max_frame_bytes <= (capacity + 1) * sizeof(visVec3));
+
+  /* The trail holds exactly the most recent points, in order */
+  visTrailRange ranges[2];
+  const uint32_t num_ranges = visTrail_GetDrawRanges(&trail, ranges);
+  float expected = (float)(num_points - capacity);
+  for (uint32_t r = 0; r < num_ranges; r++) {
+    for (uint32_t i = 0; i < ranges[r].count; i++) {
+      const uint32_t slot = ranges[r].first + i;
+      if (slot == capacity) {
+        /* Mirror of slot 0 */
+        continue;
+      }
+      UNIT_TEST_EXPECT_EQ_FLOAT("", trail.points[slot].x, expected);
+      expected += 1.0f;
+    }
+  }
+  UNIT_TEST_EXPECT_EQ_FLOAT("", expected, (float)num_points);
+
+  visTrail_Free(&trail);
+}
+
+void tests_trail_run() {
+  UNIT_TEST_SETUP("Trail");
+  UNIT_TEST_RUN_TEST("Fill", test_trail_fill);
+  UNIT_TEST_RUN_TEST("Wrap", test_trail_wrap);
+  UNIT_TEST_RUN_TEST("24 Hours", test_trail_24_hours);
+  UNIT_TEST_FINISH("Trail");
+}
+
+#endif
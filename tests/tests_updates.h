@@ -0,0 +1,142 @@
+#ifndef CVIS_TESTS_UPDATES_H_
+#define CVIS_TESTS_UPDATES_H_
+
+#include "ctest/unit_test.h"
+#include "cvis/updates.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+static void DrainUpdates() {
+  visUpdate update;
+  while (visUpdates_Pop(&update)) {
+  }
+}
+
+void test_updates_fifo() {
+  DrainUpdates();
+
+  visUpdate update;
+  UNIT_TEST_EXPECT_TRUE("", !visUpdates_Pop(&update));
+  visUpdates_PushRobotPose(1, 2, 3);
+  visUpdates_PushClearWaypoints();
+  visUpdates_PushFleetPose(7, 4, 5, 6);
+
+  UNIT_TEST_EXPECT_TRUE("", visUpdates_Pop(&update));
+  UNIT_TEST_EXPECT_EQ_INT("", update.type, visUpdate_RobotPose);
+  UNIT_TEST_EXPECT_EQ_FLOAT("", update.pose.heading, 3.0f);
+  UNIT_TEST_EXPECT_TRUE("", visUpdates_Pop(&update));
+  UNIT_TEST_EXPECT_EQ_INT("", update.type, visUpdate_ClearWaypoints);
+  UNIT_TEST_EXPECT_TRUE("", visUpdates_Pop(&update));
+  UNIT_TEST_EXPECT_EQ_INT("", update.type, visUpdate_FleetPose);
+  UNIT_TEST_EXPECT_EQ_INT("", update.pose.robot, 7);
+  UNIT_TEST_EXPECT_EQ_FLOAT("", update.pose.x, 4.0f);
+  UNIT_TEST_EXPECT_TRUE("", !visUpdates_Pop(&update));
+}
+
+void test_updates_waypoints() {
+  DrainUpdates();
+
+  /* 45 waypoints split 20, 20, 5 */
+  float xyz[3 * 45];
+  for (int i = 0; i < 3 * 45; i++) {
+    xyz[i] = (float)i;
+  }
+  UNIT_TEST_EXPECT_TRUE("", visUpdates_PushWaypoints(xyz, 45));
+
+  visUpdate update;
+  uint32_t counts[3] = {VIS_UPDATE_MAX_WAYPOINTS, VIS_UPDATE_MAX_WAYPOINTS, 5};
+  float expected = 0.0f;
+  for (int u = 0; u < 3; u++) {
+    UNIT_TEST_EXPECT_TRUE("", visUpdates_Pop(&update));
+    UNIT_TEST_EXPECT_EQ_INT("", update.type, visUpdate_Waypoints);
+    UNIT_TEST_EXPECT_EQ_INT("", update.waypoints.count, counts[u]);
+    for (uint32_t i = 0; i < 3 * update.waypoints.count; i++) {
+      UNIT_TEST_EXPECT_EQ_FLOAT("", update.waypoints.xyz[i], expected);
+      expected += 1.0f;
+    }
+  }
+  UNIT_TEST_EXPECT_TRUE("", !visUpdates_Pop(&update));
+}
+
+void test_updates_full() {
+  DrainUpdates();
+
+  /* A full queue drops instead of waiting, and works again once drained */
+  const uint64_t dropped = visUpdates_Dropped();
+  for (int i = 0; i < VIS_UPDATE_QUEUE_CAPACITY; i++) {
+    UNIT_TEST_EXPECT_TRUE("", visUpdates_PushRobotPose((float)i, 0, 0));
+  }
+  UNIT_TEST_EXPECT_TRUE("", !visUpdates_PushRobotPose(-1, 0, 0));
+  UNIT_TEST_EXPECT_EQ_INT("", visUpdates_Dropped() - dropped, 1);
+
+  visUpdate update;
+  UNIT_TEST_EXPECT_TRUE("", visUpdates_Pop(&update));
+  UNIT_TEST_EXPECT_EQ_FLOAT("", update.pose.x, 0.0f);
+  UNIT_TEST_EXPECT_TRUE("", visUpdates_PushRobotPose(-1, 0, 0));
+  DrainUpdates();
+}
+
+void test_updates_threads() {
+  DrainUpdates();
+
+  /* 8 producers each push a numbered sequence of poses (retrying when the queue is full) while
+   * this thread pops. Every pose has to arrive exactly once, in order per producer */
+  const int num_producers = 8;
+  const int num_updates = 200000;
+  std::atomic<int> finished(0);
+  std::vector<std::thread> producers;
+  for (int p = 0; p < num_producers; p++) {
+    producers.emplace_back([p, num_updates, &finished]() {
+      for (int i = 0; i < num_updates; i++) {
+        while (!visUpdates_PushFleetPose((visRobotHandle)p, (float)i, 0, 0)) {
+          std::this_thread::yield();
+        }
+      }
+      finished.fetch_add(1);
+    });
+  }
+
+  std::vector<int> next(num_producers, 0);
+  int received = 0;
+  bool in_order = true;
+  visUpdate update;
+  while (received < num_producers * num_updates) {
+    if (!visUpdates_Pop(&update)) {
+      /* Only give up once every producer is done and the queue is still empty */
+      if (finished.load() < num_producers) {
+        continue;
+      }
+      if (!visUpdates_Pop(&update)) {
+        break;
+      }
+    }
+    /* Keep draining after a mismatch so the producers can finish */
+    const int p = (int)update.pose.robot;
+    if (p < 0 || p >= num_producers) {
+      in_order = false;
+      continue;
+    }
+    in_order = in_order && (int)update.pose.x == next[p];
+    next[p] = (int)update.pose.x + 1;
+    received += 1;
+  }
+  for (std::thread &producer : producers) {
+    producer.join();
+  }
+  DrainUpdates();
+
+  UNIT_TEST_EXPECT_TRUE("", in_order);
+  UNIT_TEST_EXPECT_EQ_INT("", received, num_producers * num_updates);
+}
+
+void tests_updates_run() {
+  UNIT_TEST_SETUP("Updates");
+  UNIT_TEST_RUN_TEST("FIFO", test_updates_fifo);
+  UNIT_TEST_RUN_TEST("Waypoints", test_updates_waypoints);
+  UNIT_TEST_RUN_TEST("Full", test_updates_full);
+  UNIT_TEST_RUN_TEST("Threads", test_updates_threads);
+  UNIT_TEST_FINISH("Updates");
+}
+
+#endif